@@ -0,0 +1,346 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Broadcast groups
+ *
+ * A camera commonly serves one encoded stream to many viewers. Rather than
+ * packetizing per peer connection, a group packetizes each frame once into
+ * shared reference-counted payloads and hands them to each member in turn.
+ *
+ * Viewers joining mid-GOP cannot decode until the next keyframe, which may
+ * be seconds away, and forcing one early costs every other viewer its
+ * bitrate. Instead, copies of the payloads since the last keyframe are
+ * kept, and replayed to the joining member ahead of live frames.
+ */
+
+#include <stdlib.h>                     // malloc, realloc, free
+#include <string.h>                     // memset
+
+#include "bcast.h"
+#include "err.h"
+#include "h264.h"
+#include "log.h"
+
+int bcast_init(struct bcast *g, bcast_send_fn *send) {
+    if (!g || !send) return -URTC_ERR_BAD_ARGUMENT;
+
+    *g = (struct bcast){
+        .send = send,
+        .idr_window_us = BCAST_IDR_WINDOW_US,
+        .idr_interval_us = BCAST_IDR_INTERVAL_US
+    };
+    if (0 != pthread_mutex_init(&g->lock, NULL)) return -URTC_ERR;
+
+    return 0;
+}
+
+int bcast_join(struct bcast *g, void *member) {
+    int rv = -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    if (!g || !member) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&g->lock);
+    for (int i = 0; i < g->count; i++) {
+        if (g->members[i] == member) {
+            rv = 0;
+            goto _unlock;
+        }
+    }
+    if (g->count < BCAST_MAX_MEMBERS) {
+        g->gop_sent[g->count] = false;
+        g->members[g->count++] = member;
+        rv = 0;
+    }
+_unlock:
+    pthread_mutex_unlock(&g->lock);
+
+    return rv;
+}
+
+int bcast_leave(struct bcast *g, void *member) {
+    int rv = -URTC_ERR_BAD_ARGUMENT;
+
+    if (!g) return rv;
+
+    pthread_mutex_lock(&g->lock);
+    for (int i = 0; i < g->count; i++) {
+        if (g->members[i] == member) {
+            g->members[i] = g->members[--g->count];
+            g->gop_sent[i] = g->gop_sent[g->count];
+            rv = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    return rv;
+}
+
+/**
+ * Collect payload of frame being packetized
+ */
+static int collect(struct rtp_payload *p, void *arg) {
+    struct bcast_frame *f = arg;
+
+    if (f->count == f->cap) {
+        size_t cap = f->cap ? 2 * f->cap : 64;
+        struct rtp_payload **pkts = realloc(f->pkts, cap * sizeof(*pkts));
+        if (!pkts) {
+            rtp_payload_unref(p);
+            return -URTC_ERR_INSUFFICIENT_MEMORY;
+        }
+        f->pkts = pkts;
+        f->cap = cap;
+    }
+    f->pkts[f->count++] = p;
+
+    return 0;
+}
+
+/**
+ * Release payloads of frame, keeping storage for reuse
+ */
+static void frame_release(struct bcast_frame *f) {
+    for (size_t i = 0; i < f->count; i++) {
+        rtp_payload_unref(f->pkts[i]);
+    }
+    f->count = 0;
+}
+
+/**
+ * Packetize frame, once
+ *
+ * \return 0 on success, negative on error.
+ */
+static int frame_packetize(
+    struct bcast_frame *f,
+    const uint8_t *au,
+    size_t len
+) {
+    int rv;
+
+    if (f->count) return 0;
+
+    rv = h264_packetize(au, len, RTP_MAX_PAYLOAD_SIZE, collect, f);
+    if (rv < 0) frame_release(f);
+
+    return rv < 0 ? rv : 0;
+}
+
+/**
+ * Drop all cached frames
+ */
+static void gop_clear(struct bcast *g) {
+    for (int i = 0; i < g->frames; i++) {
+        frame_release(&g->gop[i]);
+        free(g->gop[i].pkts);
+    }
+    g->frames = 0;
+    g->gop_bytes = 0;
+    g->gop_key = false;
+    memset(g->gop_sent, 0, sizeof(g->gop_sent));
+}
+
+/**
+ * Whether frame is to be cached, starting over if it starts a new GOP
+ *
+ * A keyframe starts a new cache, after any parameter sets sent ahead of it.
+ * Frames that follow are added until the next keyframe. A GOP that outgrows
+ * the cache is dropped, as it could not be replayed whole; nothing is kept
+ * then until the next keyframe.
+ */
+static bool gop_admit(struct bcast *g, size_t len, bool start) {
+    if (start && g->gop_key) gop_clear(g);
+    if ((!start && !g->gop_key) ||
+            BCAST_GOP_MAX_FRAMES == g->frames ||
+            g->gop_bytes + len > BCAST_GOP_MAX_BYTES) {
+        gop_clear(g);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Cache copies of payloads of frame being sent
+ *
+ * Copies hold their own bytes, so they are copied once, here, and then
+ * shared by every member they are replayed to.
+ */
+static void gop_put(
+    struct bcast *g,
+    const struct bcast_frame *live,
+    size_t len,
+    bool keyframe
+) {
+    struct bcast_frame *f = &g->gop[g->frames];
+
+    *f = (struct bcast_frame){
+        .ts = live->ts,
+        .start = live->start,
+        .pkts = malloc(live->count * sizeof(*f->pkts)),
+        .cap = live->count
+    };
+    if (!f->pkts) goto _fail;
+    for (size_t i = 0; i < live->count; i++) {
+        if (f->pkts[i] = rtp_payload_dup(live->pkts[i]), !f->pkts[i]) {
+            goto _fail;
+        }
+        f->count++;
+    }
+
+    g->frames++;
+    g->gop_bytes += len;
+    g->gop_key |= keyframe;
+    return;
+
+_fail:
+    frame_release(f);
+    free(f->pkts);
+    gop_clear(g);
+}
+
+/**
+ * Send cached frames to member waiting for a keyframe
+ *
+ * \return 1 if sent, 0 if there is nothing the member can start from.
+ */
+static int gop_replay(struct bcast *g, int i) {
+    if (!g->gop_key || g->gop_sent[i]) return 0;
+
+    for (int j = 0; j < g->frames; j++) {
+        struct bcast_frame *f = &g->gop[j];
+        if (g->send(g->members[i], f->pkts, f->count, f->ts, f->start,
+                true) < 0) {
+            break;
+        }
+    }
+    g->gop_sent[i] = true;
+
+    return 1;
+}
+
+int bcast_send_frame(
+    struct bcast *g,
+    const uint8_t *au,
+    size_t len,
+    uint32_t ts
+) {
+    struct bcast_frame *f;
+    bool keyframe, start, cache;
+    int rv, waiting = 0;
+
+    if (!g || !au) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&g->lock);
+
+    keyframe = h264_is_keyframe(au, len);
+    start = keyframe || h264_is_parameter_set(au, len);
+    if (keyframe) {
+        // serves everyone who asked so far
+        g->idr_pending_us = 0;
+        g->idr_awaited = false;
+    }
+
+    // kept even if nobody is watching yet, for the first to join
+    cache = gop_admit(g, len, start);
+
+    // nobody watching, nothing to keep: skip packetization too
+    if (!g->count && !cache) {
+        rv = 0;
+        goto _unlock;
+    }
+
+    // live payloads reference the caller's buffer
+    f = &g->frame;
+    f->ts = ts;
+    f->start = start;
+    rv = frame_packetize(f, au, len);
+    if (rv < 0) goto _release;
+    if (cache) gop_put(g, f, len, keyframe);
+
+    for (int i = 0; i < g->count; i++) {
+        rv = g->send(g->members[i], f->pkts, f->count, ts, keyframe,
+                false);
+        if (rv < 0) {
+            urtc_log(URTC_WARN, "[bcast] send to member %d failed", i);
+        } else if (BCAST_SENT == rv) {
+            g->gop_sent[i] = true;
+        } else if (BCAST_WAITING == rv && !gop_replay(g, i)) {
+            waiting++;
+        }
+    }
+    rv = waiting;
+
+_release:
+    frame_release(&g->frame);
+_unlock:
+    pthread_mutex_unlock(&g->lock);
+
+    return rv;
+}
+
+int bcast_request_idr(struct bcast *g, bool request, uint64_t now) {
+    void (*cb)(void *arg) = NULL;
+    void *arg;
+
+    if (!g) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&g->lock);
+    if (request && !g->idr_pending_us &&
+            !(g->idr_awaited && now - g->idr_forced_us < g->idr_interval_us)) {
+        // zero is reserved for none held
+        g->idr_pending_us = now ? now : 1;
+    }
+    if (g->idr_pending_us &&
+            now - g->idr_pending_us >= g->idr_window_us &&
+            (!g->idr_forced_us ||
+             now - g->idr_forced_us >= g->idr_interval_us)) {
+        g->idr_pending_us = 0;
+        g->idr_forced_us = now ? now : 1;
+        g->idr_awaited = true;
+        cb = g->force_idr;
+        arg = g->force_idr_arg;
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    if (!cb) return 0;
+    cb(arg);
+
+    return 1;
+}
+
+void bcast_destroy(struct bcast *g) {
+    if (!g) return;
+
+    gop_clear(g);
+    frame_release(&g->frame);
+    free(g->frame.pkts);
+    pthread_mutex_destroy(&g->lock);
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,228 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_BCAST_H
+#define _URTC_BCAST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtp.h"
+
+#define BCAST_MAX_MEMBERS               32
+#define BCAST_IDR_WINDOW_US          20000  // keyframe requests coalesced
+#define BCAST_IDR_INTERVAL_US       500000  // least between forced keyframes
+#define BCAST_GOP_MAX_FRAMES           300  // cached for joining members
+#define BCAST_GOP_MAX_BYTES    (768 << 10)  // within members' pacer queue
+
+// results of bcast_send_fn, besides negative errors
+#define BCAST_SENT                       0
+#define BCAST_WAITING                    1  // skipped, waiting for a keyframe
+#define BCAST_SKIPPED                    2  // skipped, e.g. not connected
+
+/**
+ * (callback) Send packetized frame to one member
+ *
+ * Payloads are shared with other members and must not be modified. Live
+ * payloads reference bytes of the caller's access unit, which are only
+ * valid during the call; use rtp_payload_copy() to keep payload data beyond
+ * it. Replayed payloads are the group's copies, which hold their own bytes,
+ * and may be kept by taking a reference instead.
+ *
+ * \param member Member, as passed to bcast_join().
+ * \param pkts Payloads of one access unit, in order.
+ * \param count Number of payloads.
+ * \param ts Timestamp of access unit (90 kHz clock).
+ * \param keyframe Whether decoding can start at access unit, i.e. it is a
+ *        keyframe (see h264_is_keyframe()), or parameter sets ahead of one.
+ * \param replay Whether payloads are the group's copies, replayed.
+ *
+ * \return BCAST_SENT, BCAST_WAITING if the member skipped the frame to wait
+ *         for a keyframe, BCAST_SKIPPED if it skipped the frame otherwise
+ *         (e.g. not connected yet), or negative on error.
+ */
+typedef int (bcast_send_fn)(
+    void *member,
+    struct rtp_payload *const *pkts,
+    size_t count,
+    uint32_t ts,
+    bool keyframe,
+    bool replay
+);
+
+/**
+ * Payloads of an access unit
+ */
+struct bcast_frame {
+    uint32_t ts;
+    bool start;                         // keyframe, or parameter sets
+    struct rtp_payload **pkts;
+    size_t count;
+    size_t cap;
+};
+
+/**
+ * Broadcast group
+ *
+ * Frames sent to the group are packetized once; members only write their
+ * own RTP headers and apply their own SRTP.
+ */
+struct bcast {
+    pthread_mutex_t lock;               // guards members and pkts
+
+    void *members[BCAST_MAX_MEMBERS];
+    bool gop_sent[BCAST_MAX_MEMBERS];   // member sent frames of current GOP
+    int count;
+
+    bcast_send_fn *send;
+
+    // pacing applied to members by their owner, if factor is set
+    uint32_t bitrate;
+    double pacing;
+
+    // share of the device uplink, and encoder target chosen from it by the
+    // owner (see uplink_allocate())
+    unsigned weight;
+    uint32_t floor_bps;
+    uint32_t target_bps;
+    void (*on_target)(uint32_t bps, void *arg);
+    void *on_target_arg;
+
+    // keyframe requests from members, coalesced into one for the encoder
+    uint64_t idr_window_us;
+    uint64_t idr_interval_us;
+    uint64_t idr_pending_us;            // of first request not forwarded
+    uint64_t idr_forced_us;             // of last request forwarded
+    bool idr_awaited;                   // forwarded, keyframe not yet sent
+    void (*force_idr)(void *arg);
+    void *force_idr_arg;
+
+    // copies of payloads since the last keyframe, and of parameter sets
+    // ahead of it, for members that join mid-GOP
+    struct bcast_frame gop[BCAST_GOP_MAX_FRAMES];
+    int frames;
+    size_t gop_bytes;
+    bool gop_key;                       // cache holds a keyframe
+
+    // payloads of frame being sent, reused across frames
+    struct bcast_frame frame;
+};
+
+/**
+ * Initialize empty group
+ *
+ * \param g Group.
+ * \param send Per-member send callback.
+ *
+ * \return 0 on success, negative on error.
+ */
+int bcast_init(struct bcast *g, bcast_send_fn *send);
+
+/**
+ * Add member to group
+ *
+ * Takes effect from the next frame sent.
+ *
+ * \return 0 on success, negative on error (e.g. group is full).
+ */
+int bcast_join(struct bcast *g, void *member);
+
+/**
+ * Remove member from group
+ *
+ * On return, the member is not (and will not be) called by the group.
+ *
+ * \return 0 on success, negative if not a member.
+ */
+int bcast_leave(struct bcast *g, void *member);
+
+/**
+ * Packetize an H.264 access unit once and send it to all members
+ *
+ * Copies of the payloads since the last keyframe are kept. A member that
+ * skips a frame waiting for a keyframe, having just joined or connected, is
+ * sent the kept frames instead, so that it starts at once without
+ * disturbing the others with a new keyframe. Members are expected to pace
+ * them out. Members that were sent any frame of the GOP are not, since
+ * timestamps would go back. A GOP that outgrows the cache is dropped, and
+ * members wait for the next keyframe.
+ *
+ * \param g Group.
+ * \param au Annex-B access unit.
+ * \param len Size of access unit.
+ * \param ts Timestamp (90 kHz clock).
+ *
+ * \return Number of members still waiting for a keyframe, having nothing
+ *         kept to start from, or negative on error. Failure to send to one
+ *         member does not stop others.
+ */
+int bcast_send_frame(
+    struct bcast *g,
+    const uint8_t *au,
+    size_t len,
+    uint32_t ts
+);
+
+/**
+ * Request keyframe on behalf of a member, e.g. on picture loss
+ *
+ * Members losing the same packets ask at about the same time, but one
+ * keyframe serves them all. Requests are held for the group's window, so
+ * that others join them, and then forwarded to the encoder as one, no more
+ * often than the group's interval. Requests made while a keyframe is on its
+ * way are served by it. Call again with \a request false, e.g. per frame, to
+ * forward held requests once due.
+ *
+ * The force_idr callback is called outside the group lock.
+ *
+ * \param g Group.
+ * \param request Whether a member requests a keyframe, else only whether a
+ *        held request is due.
+ * \param now Current time (in microseconds).
+ *
+ * \return 1 if forwarded to the encoder, 0 if held or served otherwise,
+ *         negative on error.
+ */
+int bcast_request_idr(struct bcast *g, bool request, uint64_t now);
+
+/**
+ * Free group resources
+ */
+void bcast_destroy(struct bcast *g);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_BCAST_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,302 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Process-wide DTLS certificate store.
+ *
+ * Generating an ECDSA key pair and signing a certificate takes tens of
+ * milliseconds on embedded processors. Every peer connection shares one
+ * certificate instead, generated (or loaded from disk) once and replaced
+ * on a schedule. Its SHA-256 fingerprint is computed once and copied into
+ * each session description.
+ */
+
+#include <fcntl.h>                      // open
+#include <pthread.h>
+#include <stdio.h>                      // fdopen, rename
+#include <string.h>                     // memcpy, strlen
+#include <unistd.h>                     // close, unlink
+
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+
+#include "cert.h"
+#include "err.h"
+#include "log.h"
+
+static struct {
+    X509 *cert;
+    EVP_PKEY *key;
+    uint8_t fingerprint[32];
+    char path[256];
+    unsigned int rotate;
+} store = { .rotate = CERT_ROTATE_S };
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void log_ssl_errors(void) {
+    unsigned long e;
+    char buf[256];
+
+    while ((e = ERR_get_error())) {
+        ERR_error_string_n(e, buf, sizeof(buf));
+        urtc_log(URTC_ERROR, "[cert] %s", buf);
+    }
+}
+
+/**
+ * Seconds elapsed since certificate was issued
+ */
+static long age(X509 *cert) {
+    int days, secs;
+
+    if (!ASN1_TIME_diff(&days, &secs, X509_get0_notBefore(cert), NULL)) {
+        return -1;
+    }
+
+    // validity starts before issue (see cert_generate())
+    return (long)days * 24 * 3600 + secs - CERT_BACKDATE_S;
+}
+
+/**
+ * Load key and certificate from PEM file. Lock must be held.
+ */
+static int load(const char *path) {
+    EVP_PKEY *key = NULL;
+    X509 *cert = NULL;
+    unsigned int len;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return -URTC_ERR;
+
+    key = PEM_read_PrivateKey(f, NULL, NULL, NULL);
+    cert = PEM_read_X509(f, NULL, NULL, NULL);
+    fclose(f);
+
+    if (!key || !cert) goto _fail;
+    if (1 != X509_check_private_key(cert, key)) goto _fail;
+
+    long a = age(cert);
+    if (a < 0 || a >= (long)store.rotate) {
+        urtc_log(URTC_INFO, "[cert] %s is due for rotation", path);
+        goto _fail;
+    }
+
+    if (!X509_digest(cert, EVP_sha256(), store.fingerprint, &len)) goto _fail;
+    store.cert = cert;
+    store.key = key;
+
+    return 0;
+
+_fail:
+    log_ssl_errors();
+    X509_free(cert);
+    EVP_PKEY_free(key);
+
+    return -URTC_ERR;
+}
+
+/**
+ * Save key and certificate as PEM file, readable by owner only. Lock must
+ * be held.
+ */
+static int save(const char *path) {
+    char tmp[sizeof(store.path) + 4];
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (-1 == fd) return -URTC_ERR;
+
+    FILE *f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        return -URTC_ERR;
+    }
+
+    int ok = PEM_write_PrivateKey(f, store.key, NULL, NULL, 0, NULL, NULL) &&
+             PEM_write_X509(f, store.cert);
+    if (0 != fclose(f)) ok = 0;
+
+    // replace atomically, so a crash never leaves a truncated file
+    if (!ok || -1 == rename(tmp, path)) {
+        unlink(tmp);
+        return -URTC_ERR;
+    }
+
+    return 0;
+}
+
+/**
+ * Replace current certificate with a new one. Lock must be held.
+ */
+static int rotate(void) {
+    X509 *cert;
+    EVP_PKEY *key;
+    uint8_t fingerprint[32];
+
+    if (cert_generate(&cert, &key, fingerprint) < 0) return -URTC_ERR;
+
+    // connections holding references to the old certificate keep them
+    X509_free(store.cert);
+    EVP_PKEY_free(store.key);
+    store.cert = cert;
+    store.key = key;
+    memcpy(store.fingerprint, fingerprint, sizeof(store.fingerprint));
+
+    if (strlen(store.path) && save(store.path) < 0) {
+        urtc_log(URTC_WARN, "[cert] could not save %s", store.path);
+    }
+
+    urtc_log(URTC_INFO, "[cert] generated new certificate");
+
+    return 0;
+}
+
+int cert_generate(X509 **cert, EVP_PKEY **key, uint8_t fingerprint[32]) {
+    EVP_PKEY_CTX *kctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    X509 *x = NULL;
+    unsigned int len;
+
+    if (!cert || !key || !fingerprint) return -URTC_ERR_BAD_ARGUMENT;
+
+    // generate ECDSA P-256 key
+    if (kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL), !kctx) goto _fail;
+    if (1 != EVP_PKEY_keygen_init(kctx)) goto _fail;
+    if (1 != EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+        kctx,
+        NID_X9_62_prime256v1
+    )) goto _fail;
+    if (1 != EVP_PKEY_keygen(kctx, &pkey)) goto _fail;
+    EVP_PKEY_CTX_free(kctx);
+    kctx = NULL;
+
+    // self-sign certificate
+    if (x = X509_new(), !x) goto _fail;
+    X509_set_version(x, 2);
+    {
+        uint8_t serial[8];
+        BIGNUM *bn;
+        if (1 != RAND_bytes(serial, sizeof(serial))) goto _fail;
+        serial[0] &= 0x7F;
+        if (bn = BN_bin2bn(serial, sizeof(serial), NULL), !bn) goto _fail;
+        BN_to_ASN1_INTEGER(bn, X509_get_serialNumber(x));
+        BN_free(bn);
+    }
+    X509_gmtime_adj(X509_getm_notBefore(x), -CERT_BACKDATE_S);
+    X509_gmtime_adj(X509_getm_notAfter(x), CERT_LIFETIME_S);
+    X509_NAME_add_entry_by_txt(
+        X509_get_subject_name(x),
+        "CN",
+        MBSTRING_ASC,
+        (const unsigned char *)"liburtc",
+        -1,
+        -1,
+        0
+    );
+    X509_set_issuer_name(x, X509_get_subject_name(x));
+    if (1 != X509_set_pubkey(x, pkey)) goto _fail;
+    if (!X509_sign(x, pkey, EVP_sha256())) goto _fail;
+
+    if (!X509_digest(x, EVP_sha256(), fingerprint, &len)) goto _fail;
+
+    *cert = x;
+    *key = pkey;
+
+    return 0;
+
+_fail:
+    log_ssl_errors();
+    X509_free(x);
+    EVP_PKEY_free(pkey);
+    EVP_PKEY_CTX_free(kctx);
+
+    return -URTC_ERR;
+}
+
+int cert_init(const char *path, unsigned int rotate_s) {
+    int rv = 0;
+
+    if (path && strlen(path) >= sizeof(store.path)) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    X509_free(store.cert);
+    EVP_PKEY_free(store.key);
+    store.cert = NULL;
+    store.key = NULL;
+    store.rotate = rotate_s ? rotate_s : CERT_ROTATE_S;
+    if (store.rotate > CERT_LIFETIME_S) store.rotate = CERT_LIFETIME_S;
+    strcpy(store.path, path ? path : "");
+
+    if (!path || load(path) < 0) {
+        rv = rotate();
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return rv;
+}
+
+int cert_acquire(X509 **cert, EVP_PKEY **key, uint8_t fingerprint[32]) {
+    int rv = 0;
+
+    if (!cert || !key || !fingerprint) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&lock);
+
+    if (!store.cert || age(store.cert) >= (long)store.rotate) {
+        if (rv = rotate(), rv < 0) goto _unlock;
+    }
+
+    X509_up_ref(store.cert);
+    EVP_PKEY_up_ref(store.key);
+    *cert = store.cert;
+    *key = store.key;
+    memcpy(fingerprint, store.fingerprint, sizeof(store.fingerprint));
+
+_unlock:
+    pthread_mutex_unlock(&lock);
+
+    return rv;
+}
+
+void cert_cleanup(void) {
+    pthread_mutex_lock(&lock);
+
+    X509_free(store.cert);
+    EVP_PKEY_free(store.key);
+    store.cert = NULL;
+    store.key = NULL;
+
+    pthread_mutex_unlock(&lock);
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_CERT_H
+#define _URTC_CERT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#define CERT_LIFETIME_S       (30*24*3600)  // self-signed validity
+#define CERT_ROTATE_S          (7*24*3600)  // default rotation period
+#define CERT_BACKDATE_S          (24*3600)  // valid before issue (clock skew)
+
+/**
+ * Generate a self-signed ECDSA P-256 certificate
+ *
+ * \param[out] cert Certificate. Free with X509_free().
+ * \param[out] key Private key. Free with EVP_PKEY_free().
+ * \param[out] fingerprint SHA-256 fingerprint of certificate.
+ *
+ * \return 0 on success, negative on error.
+ */
+int cert_generate(X509 **cert, EVP_PKEY **key, uint8_t fingerprint[32]);
+
+/**
+ * Initialize process-wide certificate store
+ *
+ * If \a path names a readable PEM file holding a private key and
+ * certificate, and the certificate is younger than \a rotate seconds, it is
+ * loaded. Otherwise a new certificate is generated and, if \a path is set,
+ * saved there for the next start.
+ *
+ * Calling this is optional. Without it, a certificate is generated (and
+ * never saved) on first use.
+ *
+ * \param path PEM file path, or NULL to keep certificate in memory only.
+ * \param rotate Seconds after which the certificate is replaced, or 0 for
+ *               CERT_ROTATE_S.
+ *
+ * \return 0 on success, negative on error.
+ */
+int cert_init(const char *path, unsigned int rotate);
+
+/**
+ * Acquire references to the current certificate
+ *
+ * Rotates the certificate first if it is due. Peer connections keep the
+ * certificate they acquired for their lifetime, so rotation never affects
+ * an established association.
+ *
+ * \param[out] cert Certificate. Release with X509_free().
+ * \param[out] key Private key. Release with EVP_PKEY_free().
+ * \param[out] fingerprint Cached SHA-256 fingerprint of certificate.
+ *
+ * \return 0 on success, negative on error.
+ */
+int cert_acquire(X509 **cert, EVP_PKEY **key, uint8_t fingerprint[32]);
+
+/**
+ * Release certificate store
+ */
+void cert_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_CERT_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,532 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * DTLS-SRTP handshake [^RFC5764] over OpenSSL memory BIOs.
+ *
+ * [^RFC5764]: https://tools.ietf.org/html/rfc5764
+ */
+
+#include <pthread.h>
+#include <string.h>                     // memcmp, memcpy, memset
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include "dtls.h"
+#include "err.h"
+#include "log.h"
+
+#define DTLS_MAX_TIMEOUT_US       60000000  // retransmission backoff cap
+
+#define DTLS_RECORD_HEADER_SIZE         13  // DTLSPlaintext (and 1.2 ciphertext)
+
+// DTLS 1.3 unified header flags [^RFC9147 4]
+#define DTLS_UNIFIED_MASK             0xE0
+#define DTLS_UNIFIED_FIXED            0x20
+#define DTLS_UNIFIED_C                0x10  // connection id present
+#define DTLS_UNIFIED_S                0x08  // 16-bit sequence number
+#define DTLS_UNIFIED_L                0x04  // length present
+
+// Key share groups offered, in order. Matching the group browsers send a
+// key share for avoids a DTLS 1.3 HelloRetryRequest round trip.
+#define DTLS_GROUPS "X25519:P-256"
+
+#define DTLS_CIPHERS \
+    "ECDHE-ECDSA-AES128-GCM-SHA256:" \
+    "ECDHE-ECDSA-AES256-GCM-SHA384:" \
+    "ECDHE-ECDSA-CHACHA20-POLY1305:" \
+    "ECDHE-ECDSA-AES128-SHA"
+
+// SRTP protection profiles, in order of preference. AEAD profiles need a
+// single pass over each packet and use AES-NI or ARMv8 crypto extensions.
+#define DTLS_SRTP_PROFILES \
+    "SRTP_AEAD_AES_128_GCM:" \
+    "SRTP_AEAD_AES_256_GCM:" \
+    "SRTP_AES128_CM_SHA1_80:" \
+    "SRTP_AES128_CM_SHA1_32"
+
+#define DTLS_SRTP_EXPORTER_LABEL "EXTRACTOR-dtls_srtp"
+
+// One context for all associations so session tickets issued by this
+// process can be decrypted when a peer reconnects.
+static SSL_CTX *ctx;
+static pthread_once_t ctx_once = PTHREAD_ONCE_INIT;
+
+static void log_ssl_errors(void) {
+    unsigned long e;
+    char buf[256];
+
+    while ((e = ERR_get_error())) {
+        ERR_error_string_n(e, buf, sizeof(buf));
+        urtc_log(URTC_ERROR, "[dtls] %s", buf);
+    }
+}
+
+/**
+ * Whether certificate matches the fingerprint from the remote description
+ */
+static bool fingerprint_matches(struct dtls *d, X509 *cert) {
+    uint8_t md[EVP_MAX_MD_SIZE];
+    unsigned int len;
+
+    if (!d || !cert) return false;
+    if (!X509_digest(cert, EVP_sha256(), md, &len)) return false;
+    if (32 != len || 0 != memcmp(md, d->fingerprint, 32)) {
+        urtc_log(URTC_ERROR, "[dtls] remote fingerprint mismatch");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Pin remote certificate to the fingerprint from the remote description
+ *
+ * WebRTC endpoints use self-signed certificates, so chain validation is
+ * meaningless. Instead, the leaf certificate must match the fingerprint
+ * signaled out-of-band.
+ */
+static int verify_callback(int preverify_ok, X509_STORE_CTX *store) {
+    // only the leaf is pinned
+    if (0 != X509_STORE_CTX_get_error_depth(store)) return 1;
+
+    SSL *ssl = X509_STORE_CTX_get_ex_data(
+        store,
+        SSL_get_ex_data_X509_STORE_CTX_idx()
+    );
+    struct dtls *d = SSL_get_app_data(ssl);
+    X509 *cert = X509_STORE_CTX_get_current_cert(store);
+
+    return fingerprint_matches(d, cert);
+}
+
+/**
+ * Pin remote certificate of a completed handshake
+ *
+ * A resumed handshake skips verify_callback(): the remote certificate is
+ * the one remembered in the session, which need not be the one signaled
+ * for this association.
+ */
+static bool peer_matches(struct dtls *d) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return fingerprint_matches(d, SSL_get0_peer_certificate(d->ssl));
+#else
+    X509 *cert = SSL_get_peer_certificate(d->ssl);
+    bool match = fingerprint_matches(d, cert);
+    X509_free(cert);
+    return match;
+#endif
+}
+
+/**
+ * Retransmission backoff, replacing OpenSSL's one second default
+ */
+static unsigned int timer_callback(SSL *ssl, unsigned int timer_us) {
+    if (0 == timer_us) return DTLS_INITIAL_TIMEOUT_US;
+    if (timer_us >= DTLS_MAX_TIMEOUT_US / 2) return DTLS_MAX_TIMEOUT_US;
+    return 2 * timer_us;
+}
+
+static void ctx_init(void) {
+    ctx = SSL_CTX_new(DTLS_method());
+    if (!ctx) {
+        log_ssl_errors();
+        return;
+    }
+
+    // prefer DTLS 1.3 (one fewer round trip) where OpenSSL supports it,
+    // falling back to DTLS 1.2 for older peers
+    SSL_CTX_set_min_proto_version(ctx, DTLS1_2_VERSION);
+#ifdef DTLS1_3_VERSION
+    SSL_CTX_set_max_proto_version(ctx, DTLS1_3_VERSION);
+#else
+    SSL_CTX_set_max_proto_version(ctx, DTLS1_2_VERSION);
+#endif
+    if (1 != SSL_CTX_set1_groups_list(ctx, DTLS_GROUPS)) goto _fail;
+    SSL_CTX_set_options(ctx, SSL_OP_NO_QUERY_MTU);
+    SSL_CTX_set_verify(
+        ctx,
+        SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+        verify_callback
+    );
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH);
+
+    if (1 != SSL_CTX_set_cipher_list(ctx, DTLS_CIPHERS)) goto _fail;
+
+    // note: returns zero on success
+    if (0 != SSL_CTX_set_tlsext_use_srtp(ctx, DTLS_SRTP_PROFILES)) goto _fail;
+
+    // peers reconnecting within the ticket lifetime resume abbreviated
+    {
+        static const unsigned char sid_ctx[] = "liburtc";
+        SSL_CTX_set_session_id_context(ctx, sid_ctx, sizeof(sid_ctx) - 1);
+    }
+
+    return;
+
+_fail:
+    log_ssl_errors();
+    SSL_CTX_free(ctx);
+    ctx = NULL;
+}
+
+/**
+ * Size of the record at the head of a buffer
+ *
+ * Handles the fixed DTLS 1.2 header as well as the DTLS 1.3 unified
+ * header. A unified header without a length field extends to the end of
+ * the buffer.
+ *
+ * \param buf Buffer starting with a record.
+ * \param len Bytes in buffer.
+ *
+ * \return Size of record including header, or 0 if truncated.
+ */
+static size_t record_size(const uint8_t *buf, size_t len) {
+    size_t hdr, body;
+
+    if (len < 1) return 0;
+
+    if (DTLS_UNIFIED_FIXED == (buf[0] & DTLS_UNIFIED_MASK)) {
+        // connection ids are never negotiated
+        if (buf[0] & DTLS_UNIFIED_C) return 0;
+        hdr = 1 + ((buf[0] & DTLS_UNIFIED_S) ? 2 : 1);
+        if (!(buf[0] & DTLS_UNIFIED_L)) return len;
+        if (len < hdr + 2) return 0;
+        body = (buf[hdr] << 8) | buf[hdr + 1];
+        hdr += 2;
+    } else {
+        if (len < DTLS_RECORD_HEADER_SIZE) return 0;
+        hdr = DTLS_RECORD_HEADER_SIZE;
+        body = (buf[11] << 8) | buf[12];
+    }
+
+    return hdr + body <= len ? hdr + body : 0;
+}
+
+/**
+ * Drain outgoing records and transmit them
+ *
+ * Records are read directly out of the memory BIO and packed, whole, into
+ * datagrams of at most DTLS_MTU bytes.
+ */
+static int flush(struct dtls *d) {
+    const uint8_t *buf;
+    long len = BIO_get_mem_data(d->wbio, (char **)&buf);
+    int rv = 0;
+
+    size_t start = 0, end = 0;
+    while (end < (size_t)len) {
+        size_t rec = record_size(buf + end, len - end);
+        if (0 == rec) break;
+
+        // datagram full? send what has accumulated.
+        if (end > start && end + rec - start > DTLS_MTU) {
+            if (d->send(buf + start, end - start, d->arg) < 0) rv = -URTC_ERR;
+            start = end;
+        }
+        end += rec;
+    }
+    if (end > start) {
+        if (d->send(buf + start, end - start, d->arg) < 0) rv = -URTC_ERR;
+    }
+
+    (void)BIO_reset(d->wbio);
+
+    return rv;
+}
+
+/**
+ * Export SRTP keying material [^RFC5764 4.2]
+ */
+static int export_keys(struct dtls *d) {
+    uint8_t km[2 * (DTLS_SRTP_MAX_KEY_SIZE + DTLS_SRTP_MAX_SALT_SIZE)];
+    struct dtls_srtp_keys *k = &d->keys;
+
+    SRTP_PROTECTION_PROFILE *p = SSL_get_selected_srtp_profile(d->ssl);
+    if (!p) {
+        urtc_log(URTC_ERROR, "[dtls] no srtp profile negotiated");
+        return -URTC_ERR;
+    }
+
+    switch (p->id) {
+    case SRTP_AES128_CM_SHA1_80:
+    case SRTP_AES128_CM_SHA1_32:
+        k->key_len = 16;
+        k->salt_len = 14;
+        break;
+    case SRTP_AEAD_AES_128_GCM:
+        k->key_len = 16;
+        k->salt_len = 12;
+        break;
+    case SRTP_AEAD_AES_256_GCM:
+        k->key_len = 32;
+        k->salt_len = 12;
+        break;
+    default:
+        return -URTC_ERR_NOT_IMPLEMENTED;
+    }
+    k->profile = p->id;
+
+    size_t n = 2 * (k->key_len + k->salt_len);
+    if (1 != SSL_export_keying_material(
+        d->ssl,
+        km,
+        n,
+        DTLS_SRTP_EXPORTER_LABEL,
+        strlen(DTLS_SRTP_EXPORTER_LABEL),
+        NULL,
+        0,
+        0
+    )) {
+        log_ssl_errors();
+        return -URTC_ERR;
+    }
+
+    // layout: client key | server key | client salt | server salt
+    const uint8_t *ck = km;
+    const uint8_t *sk = km + k->key_len;
+    const uint8_t *cs = km + 2 * k->key_len;
+    const uint8_t *ss = km + 2 * k->key_len + k->salt_len;
+
+    memcpy(k->local_key,   d->client ? ck : sk, k->key_len);
+    memcpy(k->remote_key,  d->client ? sk : ck, k->key_len);
+    memcpy(k->local_salt,  d->client ? cs : ss, k->salt_len);
+    memcpy(k->remote_salt, d->client ? ss : cs, k->salt_len);
+
+    OPENSSL_cleanse(km, sizeof(km));
+
+    return 0;
+}
+
+/**
+ * Advance handshake and transmit any resulting flight
+ */
+static int handshake(struct dtls *d) {
+    int rv = SSL_do_handshake(d->ssl);
+
+    if (1 == rv) {
+        if (!peer_matches(d) || export_keys(d) < 0) {
+            d->state = DTLS_STATE_FAILED;
+        } else {
+            d->state = DTLS_STATE_CONNECTED;
+            urtc_log(URTC_INFO, "[dtls] connected (%s, %s%s)",
+                SSL_get_version(d->ssl),
+                SSL_get_cipher_name(d->ssl),
+                SSL_session_reused(d->ssl) ? ", resumed" : "");
+        }
+    } else {
+        switch (SSL_get_error(d->ssl, rv)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            break;
+        default:
+            log_ssl_errors();
+            d->state = DTLS_STATE_FAILED;
+            break;
+        }
+    }
+
+    // transmit flight, including any fatal alert
+    flush(d);
+
+    return DTLS_STATE_FAILED == d->state ? -URTC_ERR : 0;
+}
+
+int dtls_start(
+    struct dtls *d,
+    bool client,
+    const uint8_t fingerprint[32],
+    X509 *cert,
+    EVP_PKEY *key,
+    const uint8_t *session,
+    size_t session_len,
+    dtls_send_fn *send,
+    void *arg
+) {
+    if (!d || !fingerprint || !cert || !key || !send) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+
+    pthread_once(&ctx_once, ctx_init);
+    if (!ctx) return -URTC_ERR;
+
+    memset(d, 0, sizeof(*d));
+    d->client = client;
+    d->send = send;
+    d->arg = arg;
+    memcpy(d->fingerprint, fingerprint, sizeof(d->fingerprint));
+
+    if (d->ssl = SSL_new(ctx), !d->ssl) goto _fail_ssl_new;
+    if (d->rbio = BIO_new(BIO_s_mem()), !d->rbio) goto _fail_bio;
+    if (d->wbio = BIO_new(BIO_s_mem()), !d->wbio) goto _fail_bio;
+
+    // empty read BIO means "try again", not end-of-file
+    BIO_set_mem_eof_return(d->rbio, -1);
+
+    // SSL takes ownership of BIOs
+    SSL_set_bio(d->ssl, d->rbio, d->wbio);
+    SSL_set_app_data(d->ssl, d);
+    SSL_set_mtu(d->ssl, DTLS_MTU);
+    DTLS_set_timer_cb(d->ssl, timer_callback);
+
+    if (1 != SSL_use_certificate(d->ssl, cert)) goto _fail_identity;
+    if (1 != SSL_use_PrivateKey(d->ssl, key)) goto _fail_identity;
+
+    // offer previous session for abbreviated handshake
+    if (client && session && session_len) {
+        const unsigned char *p = session;
+        SSL_SESSION *s = d2i_SSL_SESSION(NULL, &p, session_len);
+        if (s) {
+            SSL_set_session(d->ssl, s);
+            SSL_SESSION_free(s);
+        }
+    }
+
+    d->state = DTLS_STATE_CONNECTING;
+
+    if (client) {
+        SSL_set_connect_state(d->ssl);
+        return handshake(d);
+    }
+
+    SSL_set_accept_state(d->ssl);
+
+    return 0;
+
+_fail_identity:
+_fail_bio:
+    if (!SSL_get_rbio(d->ssl)) {
+        BIO_free(d->rbio);
+        BIO_free(d->wbio);
+    }
+    SSL_free(d->ssl);
+_fail_ssl_new:
+    log_ssl_errors();
+    memset(d, 0, sizeof(*d));
+
+    return -URTC_ERR;
+}
+
+int dtls_recv(struct dtls *d, const uint8_t *pkt, size_t n) {
+    uint8_t buf[DTLS_MTU];
+
+    if (!d || !d->ssl) return -URTC_ERR_BAD_ARGUMENT;
+
+    if (BIO_write(d->rbio, pkt, n) != (int)n) return -URTC_ERR;
+
+    switch (d->state) {
+    case DTLS_STATE_CONNECTING:
+        return handshake(d);
+
+    case DTLS_STATE_CONNECTED:
+        // no application data expected; watch for alerts and close_notify
+        for (;;) {
+            int rv = SSL_read(d->ssl, buf, sizeof(buf));
+            if (rv > 0) continue;
+            switch (SSL_get_error(d->ssl, rv)) {
+            case SSL_ERROR_WANT_READ:
+                break;
+            case SSL_ERROR_ZERO_RETURN:
+                urtc_log(URTC_INFO, "[dtls] closed by peer");
+                d->state = DTLS_STATE_CLOSED;
+                break;
+            default:
+                log_ssl_errors();
+                d->state = DTLS_STATE_FAILED;
+                break;
+            }
+            break;
+        }
+        flush(d);
+        return 0;
+
+    default:
+        return -URTC_ERR;
+    }
+}
+
+int dtls_timeout(struct dtls *d, uint64_t *us) {
+    struct timeval tv;
+
+    if (!d || !d->ssl || !us) return -URTC_ERR_BAD_ARGUMENT;
+    if (DTLS_STATE_CONNECTING != d->state) return -URTC_ERR;
+    if (1 != DTLSv1_get_timeout(d->ssl, &tv)) return -URTC_ERR;
+
+    *us = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+
+    return 0;
+}
+
+int dtls_handle_timeout(struct dtls *d) {
+    if (!d || !d->ssl) return -URTC_ERR_BAD_ARGUMENT;
+    if (DTLS_STATE_CONNECTING != d->state) return 0;
+
+    if (DTLSv1_handle_timeout(d->ssl) < 0) {
+        urtc_log(URTC_ERROR, "[dtls] handshake timed out");
+        d->state = DTLS_STATE_FAILED;
+        return -URTC_ERR;
+    }
+
+    return flush(d);
+}
+
+int dtls_get_session(struct dtls *d, uint8_t *dst, size_t size) {
+    if (!d || !d->ssl || !dst) return -URTC_ERR_BAD_ARGUMENT;
+
+    SSL_SESSION *s = SSL_get_session(d->ssl);
+    if (!s || !SSL_SESSION_is_resumable(s)) return -URTC_ERR;
+
+    int n = i2d_SSL_SESSION(s, NULL);
+    if (n <= 0 || (size_t)n > size) return -URTC_ERR;
+
+    unsigned char *p = dst;
+    return i2d_SSL_SESSION(s, &p);
+}
+
+int dtls_version(struct dtls *d) {
+    return d && d->ssl ? SSL_version(d->ssl) : 0;
+}
+
+bool dtls_resumed(struct dtls *d) {
+    return d && d->ssl && SSL_session_reused(d->ssl);
+}
+
+void dtls_stop(struct dtls *d) {
+    if (!d || !d->ssl) return;
+
+    if (DTLS_STATE_CONNECTED == d->state) {
+        SSL_shutdown(d->ssl);
+        flush(d);
+    }
+
+    SSL_free(d->ssl);                   // also frees BIOs
+    memset(d, 0, sizeof(*d));
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
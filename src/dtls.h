@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_DTLS_H
+#define _URTC_DTLS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <openssl/ssl.h>
+
+#define DTLS_MTU                      1200  // max datagram size (in bytes)
+#define DTLS_INITIAL_TIMEOUT_US     250000  // first retransmission timeout
+
+#define DTLS_SRTP_MAX_KEY_SIZE          32
+#define DTLS_SRTP_MAX_SALT_SIZE         14
+
+enum dtls_state {
+    DTLS_STATE_NEW = 0,
+    DTLS_STATE_CONNECTING,
+    DTLS_STATE_CONNECTED,
+    DTLS_STATE_FAILED,
+    DTLS_STATE_CLOSED
+};
+
+/**
+ * SRTP master keys and salts exported from a completed handshake
+ *
+ * Local and remote refer to the direction of protection: local keys protect
+ * outgoing packets, remote keys unprotect incoming packets.
+ */
+struct dtls_srtp_keys {
+    unsigned long profile;              // SRTP_AEAD_AES_128_GCM, etc.
+    size_t key_len;
+    size_t salt_len;
+    uint8_t local_key[DTLS_SRTP_MAX_KEY_SIZE];
+    uint8_t local_salt[DTLS_SRTP_MAX_SALT_SIZE];
+    uint8_t remote_key[DTLS_SRTP_MAX_KEY_SIZE];
+    uint8_t remote_salt[DTLS_SRTP_MAX_SALT_SIZE];
+};
+
+/**
+ * (callback) Transmit one DTLS datagram to the remote peer
+ *
+ * \return 0 on success, negative on error.
+ */
+typedef int (dtls_send_fn)(const uint8_t *pkt, size_t n, void *arg);
+
+/**
+ * DTLS-SRTP association
+ *
+ * Records never touch a socket inside OpenSSL. Incoming datagrams are
+ * written to a memory BIO and outgoing records are drained from another,
+ * then handed to the send callback. Retransmissions are driven by the owner
+ * via dtls_timeout() and dtls_handle_timeout().
+ */
+struct dtls {
+    SSL *ssl;
+    BIO *rbio;                          // incoming records
+    BIO *wbio;                          // outgoing records
+
+    enum dtls_state state;
+    bool client;
+
+    uint8_t fingerprint[32];            // expected remote fingerprint
+
+    dtls_send_fn *send;
+    void *arg;
+
+    struct dtls_srtp_keys keys;         // valid once connected
+};
+
+/**
+ * Begin DTLS handshake
+ *
+ * As client, the first flight is sent immediately. As server, the
+ * association waits for the remote ClientHello.
+ *
+ * \param d Association (zero-initialized).
+ * \param client True for DTLS client (a=setup:active), else server.
+ * \param fingerprint Expected SHA-256 fingerprint of remote certificate.
+ * \param cert Local certificate.
+ * \param key Local private key.
+ * \param session Serialized session to resume (client only), or NULL.
+ * \param session_len Size of serialized session.
+ * \param send Datagram transmit callback.
+ * \param arg Argument passed to transmit callback.
+ *
+ * \return 0 on success, negative on error.
+ */
+int dtls_start(
+    struct dtls *d,
+    bool client,
+    const uint8_t fingerprint[32],
+    X509 *cert,
+    EVP_PKEY *key,
+    const uint8_t *session,
+    size_t session_len,
+    dtls_send_fn *send,
+    void *arg
+);
+
+/**
+ * Process one incoming DTLS datagram
+ *
+ * \param d Association.
+ * \param pkt Datagram.
+ * \param n Size of datagram.
+ *
+ * \return 0 on success, negative on error. Check d->state for transitions.
+ */
+int dtls_recv(struct dtls *d, const uint8_t *pkt, size_t n);
+
+/**
+ * Time until the next retransmission is due
+ *
+ * \param d Association.
+ * \param[out] us Microseconds until retransmission.
+ *
+ * \return 0 if a retransmission timer is running, negative otherwise.
+ */
+int dtls_timeout(struct dtls *d, uint64_t *us);
+
+/**
+ * Retransmit last flight if its timer has expired
+ *
+ * \param d Association.
+ *
+ * \return 0 on success, negative on error (e.g. retransmissions exhausted).
+ */
+int dtls_handle_timeout(struct dtls *d);
+
+/**
+ * Serialize negotiated session for later resumption
+ *
+ * \param d Connected association.
+ * \param dst Destination buffer.
+ * \param size Capacity of destination buffer.
+ *
+ * \return Size of serialized session, or negative on error.
+ */
+int dtls_get_session(struct dtls *d, uint8_t *dst, size_t size);
+
+/**
+ * Negotiated protocol version
+ *
+ * \return DTLS1_2_VERSION or (where supported) DTLS1_3_VERSION once
+ *         connected.
+ */
+int dtls_version(struct dtls *d);
+
+/**
+ * Whether the handshake was an abbreviated (resumed) one
+ */
+bool dtls_resumed(struct dtls *d);
+
+/**
+ * Send close_notify (if connected) and free association resources
+ *
+ * \param d Association.
+ */
+void dtls_stop(struct dtls *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_DTLS_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -52,7 +52,9 @@ typedef enum err {
     URTC_ERR_SDP_MALFORMED_ATTRIBUTE,
     URTC_ERR_SDP_UNSUPPORTED_FINGERPRINT_ALGO,
     URTC_ERR_SDP_UNSUPPORTED_MEDIA_PROTOCOL,
-    URTC_ERR_SDP_UNSUPPORTED_MEDIA_TYPE
+    URTC_ERR_SDP_UNSUPPORTED_MEDIA_TYPE,
+
+    URTC_ERR_SRTP_REPLAYED
 } err_t;
 
 #ifdef __cplusplus
@@ -0,0 +1,391 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Flexible forward error correction [^RFC8627], one-dimensional
+ * non-interleaved (row) protection with a flexible mask.
+ *
+ * Parity is accumulated as source packets are sent, from the plaintext
+ * copy kept for retransmission, so a repair packet costs one XOR pass over
+ * each protected payload and no extra copies.
+ */
+
+#include <string.h>                     // memcpy, memset
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "err.h"
+#include "fec.h"
+#include "rtp.h"
+
+// loss below which protection is off (about one percent)
+#define MIN_LOSS                         3
+
+void fec_xor_scalar(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] ^= src[i];
+    }
+}
+
+#if defined(__AVX2__)
+
+void fec_xor(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (; n >= 32; dst += 32, src += 32, n -= 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)dst);
+        __m256i b = _mm256_loadu_si256((const __m256i *)src);
+        _mm256_storeu_si256((__m256i *)dst, _mm256_xor_si256(a, b));
+    }
+    if (n >= 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)dst);
+        __m128i b = _mm_loadu_si128((const __m128i *)src);
+        _mm_storeu_si128((__m128i *)dst, _mm_xor_si128(a, b));
+        dst += 16, src += 16, n -= 16;
+    }
+    fec_xor_scalar(dst, src, n);
+}
+
+#elif defined(__SSE2__)
+
+void fec_xor(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (; n >= 16; dst += 16, src += 16, n -= 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)dst);
+        __m128i b = _mm_loadu_si128((const __m128i *)src);
+        _mm_storeu_si128((__m128i *)dst, _mm_xor_si128(a, b));
+    }
+    fec_xor_scalar(dst, src, n);
+}
+
+#elif defined(__ARM_NEON)
+
+void fec_xor(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (; n >= 16; dst += 16, src += 16, n -= 16) {
+        vst1q_u8(dst, veorq_u8(vld1q_u8(dst), vld1q_u8(src)));
+    }
+    fec_xor_scalar(dst, src, n);
+}
+
+#else
+
+void fec_xor(uint8_t *dst, const uint8_t *src, size_t n) {
+    fec_xor_scalar(dst, src, n);
+}
+
+#endif
+
+/**
+ * XOR packet into parity: header fields, with the length of everything
+ * after the fixed header in place of the sequence number, then the rest
+ * [^RFC8627 6.2]
+ *
+ * \param parity Header fields (8 bytes), then payload parity.
+ * \param len Payload parity length, extended (with zeros) as needed.
+ * \param pkt Packet, at least RTP_HEADER_SIZE bytes.
+ * \param n Size of packet.
+ */
+static void accumulate(
+    uint8_t *parity,
+    size_t *len,
+    const uint8_t *pkt,
+    size_t n
+) {
+    size_t plen = n - RTP_HEADER_SIZE;
+
+    parity[0] ^= pkt[0];
+    parity[1] ^= pkt[1];
+    parity[2] ^= plen >> 8;
+    parity[3] ^= plen;
+    parity[4] ^= pkt[4];
+    parity[5] ^= pkt[5];
+    parity[6] ^= pkt[6];
+    parity[7] ^= pkt[7];
+
+    if (plen > *len) {
+        memset(parity + 8 + *len, 0, plen - *len);
+        *len = plen;
+    }
+    fec_xor(parity + 8, pkt + RTP_HEADER_SIZE, plen);
+}
+
+void fec_enc_init(struct fec_enc *e) {
+    memset(e, 0, offsetof(struct fec_enc, parity));
+}
+
+void fec_enc_set_loss(struct fec_enc *e, uint8_t fraction) {
+    e->loss = fraction > e->loss ? fraction : (3 * e->loss + fraction) / 4;
+
+    // about three times the loss rate in overhead: one lost packet in a
+    // group is recovered, two are not, so groups are kept short enough
+    // that two losses in one are unlikely
+    if (e->loss < MIN_LOSS) {
+        e->group = 0;
+    } else {
+        int k = 256 / (3 * e->loss);
+        e->group = k < 2 ? 2 : k > FEC_MAX_GROUP ? FEC_MAX_GROUP : k;
+    }
+}
+
+void fec_enc_nack(struct fec_enc *e, size_t count) {
+    e->lost += count;
+}
+
+int fec_enc_add(struct fec_enc *e, const uint8_t *pkt, size_t n) {
+    if (!e || !pkt) return -URTC_ERR_BAD_ARGUMENT;
+    if (n < RTP_HEADER_SIZE || n > FEC_MAX_PACKET_SIZE) {
+        return -URTC_ERR_MALFORMED;
+    }
+
+    if (++e->sent >= FEC_LOSS_WINDOW) {
+        uint32_t lost = e->lost < e->sent ? e->lost : e->sent;
+        fec_enc_set_loss(e, lost * 255 / e->sent);
+        e->sent = e->lost = 0;
+    }
+
+    if (!e->group) {
+        e->count = 0;
+        return 0;
+    }
+
+    uint16_t seq = (pkt[2] << 8) | pkt[3];
+    if (e->count && (uint16_t)(e->base + e->count) != seq) e->count = 0;
+    if (!e->count) {
+        memset(e->parity, 0, 8);
+        e->base = seq;
+        e->len = 0;
+    }
+
+    accumulate(e->parity, &e->len, pkt, n);
+    e->ts = ((uint32_t)pkt[4] << 24) | (pkt[5] << 16) | (pkt[6] << 8) |
+        pkt[7];
+    e->count++;
+
+    // close group at end of frame
+    return e->count >= e->group || (pkt[1] & 0x80) ? 1 : 0;
+}
+
+int fec_enc_write(
+    struct fec_enc *e,
+    uint8_t *pkt,
+    size_t cap,
+    uint8_t pt,
+    uint16_t seq,
+    uint32_t ssrc,
+    uint32_t media
+) {
+    size_t off = RTP_HEADER_SIZE + 4;
+    uint16_t mask;
+
+    if (!e || !pkt) return -URTC_ERR_BAD_ARGUMENT;
+    if (!e->count) return -URTC_ERR_MALFORMED;
+    if (off + FEC_HEADER_SIZE + e->len > cap) {
+        return -URTC_ERR_INSUFFICIENT_MEMORY;
+    }
+
+    rtp_header_write(pkt, pt, false, seq, e->ts, ssrc);
+    pkt[0] |= 1;                        // one csrc
+    pkt[12] = media >> 24;
+    pkt[13] = media >> 16;
+    pkt[14] = media >> 8;
+    pkt[15] = media;
+
+    // R and F clear: flexible mask, retransmission bit off
+    memcpy(pkt + off, e->parity, 8);
+    pkt[off] &= 0x3f;
+    pkt[off + 8] = e->base >> 8;
+    pkt[off + 9] = e->base;
+    mask = 0x8000 | (((1 << e->count) - 1) << (15 - e->count));
+    pkt[off + 10] = mask >> 8;
+    pkt[off + 11] = mask;
+    memcpy(pkt + off + FEC_HEADER_SIZE, e->parity + 8, e->len);
+
+    e->count = 0;
+
+    return (int)(off + FEC_HEADER_SIZE + e->len);
+}
+
+void fec_dec_init(struct fec_dec *d, fec_recover_fn *cb, void *arg) {
+    for (int i = 0; i < FEC_DEC_SLOTS; i++) d->sources[i].valid = false;
+    for (int i = 0; i < FEC_DEC_REPAIRS; i++) d->repairs[i].valid = false;
+    d->next = 0;
+    d->recovered = 0;
+    d->cb = cb;
+    d->arg = arg;
+}
+
+static struct fec_source *lookup(struct fec_dec *d, uint16_t seq) {
+    struct fec_source *s = &d->sources[seq & (FEC_DEC_SLOTS - 1)];
+    return s->valid && s->seq == seq ? s : NULL;
+}
+
+/**
+ * Recover the one missing packet of a repair's group, if exactly one is
+ *
+ * \return True if repair is spent (nothing or one packet missing).
+ */
+static bool recover(struct fec_dec *d, struct fec_repair *r) {
+    struct fec_source *s, *lost = NULL;
+    uint16_t seq = 0;
+    size_t len = r->len - 8;
+
+    for (int i = 0; i < 64; i++) {
+        if (!(r->mask >> i & 1)) continue;
+        if (lookup(d, r->base + i)) continue;
+        if (lost) return false;         // two or more missing, wait
+        seq = r->base + i;
+        lost = &d->sources[seq & (FEC_DEC_SLOTS - 1)];
+    }
+    if (!lost) return true;
+
+    // repair older than the packets kept
+    if (lost->valid && (int16_t)(lost->seq - seq) > 0) return true;
+
+    for (int i = 0; i < 64; i++) {
+        if (!(r->mask >> i & 1) || (uint16_t)(r->base + i) == seq) continue;
+        s = lookup(d, r->base + i);
+        if (s->len - RTP_HEADER_SIZE > len) return true;
+        accumulate(r->parity, &len, s->pkt, s->len);
+    }
+
+    len = (r->parity[2] << 8) | r->parity[3];
+    if (8 + len > r->len || RTP_HEADER_SIZE + len > FEC_MAX_PACKET_SIZE) {
+        return true;
+    }
+
+    lost->pkt[0] = (RTP_VERSION << 6) | (r->parity[0] & 0x3f);
+    lost->pkt[1] = r->parity[1];
+    lost->pkt[2] = seq >> 8;
+    lost->pkt[3] = seq;
+    memcpy(lost->pkt + 4, r->parity + 4, 4);
+    lost->pkt[8] = r->ssrc >> 24;
+    lost->pkt[9] = r->ssrc >> 16;
+    lost->pkt[10] = r->ssrc >> 8;
+    lost->pkt[11] = r->ssrc;
+    memcpy(lost->pkt + RTP_HEADER_SIZE, r->parity + 8, len);
+    lost->len = RTP_HEADER_SIZE + len;
+    lost->seq = seq;
+    lost->valid = true;
+
+    d->recovered++;
+    if (d->cb) d->cb(lost->pkt, lost->len, d->arg);
+
+    return true;
+}
+
+/**
+ * Try pending repairs, until no more packets are recovered
+ */
+static void recover_all(struct fec_dec *d) {
+    bool progress = true;
+
+    while (progress) {
+        progress = false;
+        for (int i = 0; i < FEC_DEC_REPAIRS; i++) {
+            struct fec_repair *r = &d->repairs[i];
+            uint32_t before = d->recovered;
+            if (r->valid && recover(d, r)) {
+                r->valid = false;
+                progress |= before != d->recovered;
+            }
+        }
+    }
+}
+
+int fec_dec_put_source(struct fec_dec *d, const uint8_t *pkt, size_t n) {
+    if (!d || !pkt) return -URTC_ERR_BAD_ARGUMENT;
+    if (n < RTP_HEADER_SIZE || n > FEC_MAX_PACKET_SIZE) {
+        return -URTC_ERR_MALFORMED;
+    }
+
+    uint16_t seq = (pkt[2] << 8) | pkt[3];
+    struct fec_source *s = &d->sources[seq & (FEC_DEC_SLOTS - 1)];
+    if (s->valid && s->seq == seq) return 0;  // duplicate, or recovered
+    memcpy(s->pkt, pkt, n);
+    s->len = n;
+    s->seq = seq;
+    s->valid = true;
+
+    recover_all(d);
+
+    return 0;
+}
+
+int fec_dec_put_repair(struct fec_dec *d, const uint8_t *pkt, size_t n) {
+    struct rtp_header h;
+    const uint8_t *p;
+    uint64_t mask;
+    size_t hlen;
+    int rv;
+
+    if (!d || !pkt) return -URTC_ERR_BAD_ARGUMENT;
+    if (rv = rtp_header_read(pkt, n, &h), rv < 0) return rv;
+
+    // protected source is the one csrc; R and F set are other schemes
+    if (1 != (pkt[0] & 0x0f)) return -URTC_ERR_NOT_IMPLEMENTED;
+    p = pkt + h.payload;
+    if (h.payload_len < FEC_HEADER_SIZE) return -URTC_ERR_MALFORMED;
+    if (p[0] & 0xc0) return -URTC_ERR_NOT_IMPLEMENTED;
+
+    // flexible mask: 15, 46 or 109 bits, each part led by a k bit set on
+    // the last part [^RFC8627 4.2.2.1]
+    mask = 0;
+    for (int i = 0; i < 15; i++) {
+        mask |= (uint64_t)(p[10 + (i + 1) / 8] >> (7 - (i + 1) % 8) & 1) << i;
+    }
+    hlen = FEC_HEADER_SIZE;
+    if (!(p[10] & 0x80)) {
+        if (h.payload_len < FEC_HEADER_SIZE + 4) return -URTC_ERR_MALFORMED;
+        for (int i = 0; i < 31; i++) {
+            mask |= (uint64_t)(p[12 + (i + 1) / 8] >> (7 - (i + 1) % 8) & 1)
+                << (15 + i);
+        }
+        hlen += 4;
+        if (!(p[12] & 0x80)) return -URTC_ERR_NOT_IMPLEMENTED;
+    }
+
+    struct fec_repair *r = &d->repairs[d->next];
+    d->next = (d->next + 1) % FEC_DEC_REPAIRS;
+
+    r->base = (p[8] << 8) | p[9];
+    r->mask = mask;
+    r->ssrc = ((uint32_t)pkt[12] << 24) | (pkt[13] << 16) |
+        (pkt[14] << 8) | pkt[15];
+    r->len = 8 + h.payload_len - hlen;
+    if (r->len > sizeof(r->parity)) return -URTC_ERR_MALFORMED;
+    memcpy(r->parity, p, 8);
+    memcpy(r->parity + 8, p + hlen, h.payload_len - hlen);
+    r->valid = true;
+
+    recover_all(d);
+
+    return 0;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,232 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_FEC_H
+#define _URTC_FEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FEC_HEADER_SIZE                 12  // flexible mask, up to 15 packets
+#define FEC_MAX_GROUP                   15  // source packets per repair packet
+#define FEC_MAX_PACKET_SIZE           1500  // largest source packet
+#define FEC_REPAIR_WINDOW_US        200000  // advertised in sdp
+
+#define FEC_DEC_SLOTS                   64  // received packets kept, pow. of 2
+#define FEC_DEC_REPAIRS                  8  // repair packets awaiting media
+
+#define FEC_LOSS_WINDOW                256  // packets per loss estimate
+
+/**
+ * XOR \a n bytes of \a src into \a dst
+ *
+ * Processes 16 or 32 bytes per step with SSE2, AVX2 or NEON where the
+ * compiler targets them, and falls back to fec_xor_scalar() otherwise.
+ */
+void fec_xor(uint8_t *dst, const uint8_t *src, size_t n);
+
+/**
+ * Reference byte-at-a-time implementation of fec_xor()
+ */
+void fec_xor_scalar(uint8_t *dst, const uint8_t *src, size_t n);
+
+/**
+ * FlexFEC encoder of one RTP stream [^RFC8627]
+ *
+ * Consecutive source packets are grouped, and each group is protected by
+ * one repair packet holding their XOR parity, so any one lost packet of a
+ * group is recovered without a round trip. A group closes with the last
+ * packet of a frame, so repair never waits for the next frame. Group size
+ * (and with it, overhead) follows measured loss; protection is off below
+ * about one percent.
+ */
+struct fec_enc {
+    uint8_t loss;                       // smoothed loss fraction (1/256)
+    int group;                          // packets per group, 0 if off
+    int count;                          // packets in current group
+    uint16_t base;                      // first sequence number of group
+    uint32_t ts;                        // timestamp of newest packet
+    size_t len;                         // longest payload in group
+
+    // loss estimate from NACKs, until receiver reports are available
+    uint32_t sent;
+    uint32_t lost;
+
+    // XOR of header fields, then of payloads [^RFC8627 6.2]
+    uint8_t parity[8 + FEC_MAX_PACKET_SIZE];
+};
+
+/**
+ * (callback) Recovered source packet
+ *
+ * \param pkt Packet, valid only during callback.
+ * \param n Size of packet.
+ * \param arg User specified argument.
+ */
+typedef void (fec_recover_fn)(const uint8_t *pkt, size_t n, void *arg);
+
+struct fec_source {
+    bool valid;
+    uint16_t seq;
+    size_t len;
+    uint8_t pkt[FEC_MAX_PACKET_SIZE];
+};
+
+struct fec_repair {
+    bool valid;
+    uint16_t base;                      // first protected sequence number
+    uint64_t mask;                      // protected packets, lsb is base
+    uint32_t ssrc;                      // protected source
+    size_t len;                         // header fields and parity
+    uint8_t parity[8 + FEC_MAX_PACKET_SIZE];
+};
+
+/**
+ * FlexFEC decoder of one RTP stream [^RFC8627]
+ *
+ * Recent source packets are kept, so a repair packet can recover the one
+ * packet of its group that is missing, whether the repair arrives before
+ * or after the rest of the group. Repairs missing more than one packet are
+ * kept until they can be used or are displaced by newer ones.
+ */
+struct fec_dec {
+    struct fec_source sources[FEC_DEC_SLOTS];
+    struct fec_repair repairs[FEC_DEC_REPAIRS];
+    int next;                           // repair slot to replace next
+
+    uint32_t recovered;                 // statistics
+
+    fec_recover_fn *cb;
+    void *arg;
+};
+
+/**
+ * Initialize encoder, with protection off
+ */
+void fec_enc_init(struct fec_enc *e);
+
+/**
+ * Set protection level from measured loss
+ *
+ * Increases take effect immediately, decreases are smoothed.
+ *
+ * \param e Encoder.
+ * \param fraction Fraction of packets lost (in 1/256), as reported in RTCP
+ *                 receiver reports.
+ */
+void fec_enc_set_loss(struct fec_enc *e, uint8_t fraction);
+
+/**
+ * Account for NACKed packets in loss estimate
+ *
+ * \param e Encoder.
+ * \param count Number of packets requested again.
+ */
+void fec_enc_nack(struct fec_enc *e, size_t count);
+
+/**
+ * Add sent source packet to current group
+ *
+ * Packets of a group must have consecutive sequence numbers; a gap starts
+ * a new group.
+ *
+ * \param e Encoder.
+ * \param pkt RTP packet (plaintext).
+ * \param n Size of packet.
+ *
+ * \return 1 if group is complete and a repair packet should be written,
+ *         0 if not, negative on error.
+ */
+int fec_enc_add(struct fec_enc *e, const uint8_t *pkt, size_t n);
+
+/**
+ * Write repair packet of current group, and start the next group
+ *
+ * The packet has one CSRC, the protected source [^RFC8627 4.2.1].
+ *
+ * \param e Encoder.
+ * \param pkt Destination.
+ * \param cap Capacity of destination.
+ * \param pt Repair payload type.
+ * \param seq Repair sequence number.
+ * \param ssrc Repair synchronization source.
+ * \param media Protected synchronization source.
+ *
+ * \return Size of repair packet, or negative on error.
+ */
+int fec_enc_write(
+    struct fec_enc *e,
+    uint8_t *pkt,
+    size_t cap,
+    uint8_t pt,
+    uint16_t seq,
+    uint32_t ssrc,
+    uint32_t media
+);
+
+/**
+ * Initialize decoder
+ *
+ * \param d Decoder.
+ * \param cb Recovered packet callback.
+ * \param arg Argument passed to callback.
+ */
+void fec_dec_init(struct fec_dec *d, fec_recover_fn *cb, void *arg);
+
+/**
+ * Process received (or retransmitted) source packet
+ *
+ * \param d Decoder.
+ * \param pkt RTP packet (plaintext).
+ * \param n Size of packet.
+ *
+ * \return 0 on success, negative on error.
+ */
+int fec_dec_put_source(struct fec_dec *d, const uint8_t *pkt, size_t n);
+
+/**
+ * Process received repair packet
+ *
+ * \param d Decoder.
+ * \param pkt RTP packet (plaintext).
+ * \param n Size of packet.
+ *
+ * \return 0 on success, negative on error.
+ */
+int fec_dec_put_repair(struct fec_dec *d, const uint8_t *pkt, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_FEC_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
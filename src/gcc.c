@@ -0,0 +1,415 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Delay-based and loss-based bandwidth estimation, after Google congestion
+ * control [^GCC], from transport-wide feedback.
+ */
+
+#include <string.h>                     // memset
+
+#include "gcc.h"
+
+#define SMOOTHING                      0.9  // of accumulated delay
+#define THRESHOLD_GAIN                 4.0  // trend scaled by, vs threshold
+#define THRESHOLD_INIT_MS             12.5
+#define THRESHOLD_MIN_MS               6.0
+#define THRESHOLD_MAX_MS             600.0
+#define K_UP                        0.0087  // threshold adaptation rates
+#define K_DOWN                       0.039
+#define OVERUSE_MS                    10.0  // over threshold before overuse
+#define BETA                          0.85  // decrease, of received bitrate
+#define ETA                           0.08  // multiplicative increase per s.
+#define ADDITIVE_BPS                 40000  // additive increase per second
+#define DECREASE_INTERVAL_US        200000  // between blind decreases
+#define LOSS_HIGH                       26  // of 256, about 10%
+#define LOSS_LOW                         5  // of 256, about 2%
+#define PROBE_PACKET_SIZE             1200  // for minimum probe size
+#define PROBE_CONTINUE                 0.7  // of probing rate carried
+
+static double dabs(double v) {
+    return v < 0 ? -v : v;
+}
+
+static uint32_t clamp(double bps) {
+    if (bps < GCC_MIN_BITRATE) return GCC_MIN_BITRATE;
+    if (bps > GCC_MAX_BITRATE) return GCC_MAX_BITRATE;
+    return (uint32_t)bps;
+}
+
+void gcc_init(struct gcc *g, uint32_t start_bps) {
+    memset(g, 0, sizeof(*g));
+    g->threshold_ms = THRESHOLD_INIT_MS;
+    g->overuse_ms = -1;
+    gcc_set_bitrate(g, start_bps);
+}
+
+void gcc_set_bitrate(struct gcc *g, uint32_t bps) {
+    g->target_bps = g->delay_bps = g->loss_bps = clamp(bps);
+    g->state = GCC_HOLD;
+    g->link_bps = 0;
+}
+
+static void probe_queue(struct gcc *g, double bps) {
+    for (int i = 0; i < GCC_PROBE_CLUSTERS; i++) {
+        if (!g->probes[i].bps) {
+            memset(&g->probes[i], 0, sizeof(g->probes[i]));
+            g->probes[i].bps = clamp(bps);
+            return;
+        }
+    }
+}
+
+void gcc_probe_start(struct gcc *g) {
+    probe_queue(g, 3.0 * g->target_bps);
+    probe_queue(g, 6.0 * g->target_bps);
+}
+
+int gcc_probe_next(struct gcc *g, uint32_t *bps, size_t *bytes) {
+    for (int i = 0; i < GCC_PROBE_CLUSTERS; i++) {
+        struct gcc_probe *p = &g->probes[i];
+        if (!p->bps || p->started) continue;
+
+        p->started = true;
+        p->bytes = p->bps / 8.0 * GCC_PROBE_DURATION_US / 1e6;
+        if (p->bytes < GCC_PROBE_MIN_PACKETS * PROBE_PACKET_SIZE) {
+            p->bytes = GCC_PROBE_MIN_PACKETS * PROBE_PACKET_SIZE;
+        }
+        *bps = p->bps;
+        *bytes = p->bytes;
+
+        return i + 1;
+    }
+
+    return 0;
+}
+
+void gcc_on_sent(
+    struct gcc *g,
+    uint16_t seq,
+    size_t len,
+    uint64_t now,
+    int cluster
+) {
+    struct gcc_sent *s = &g->sent[seq & (GCC_HISTORY - 1)];
+
+    s->send_us = now;
+    s->seq = seq;
+    s->len = len > UINT16_MAX ? UINT16_MAX : len ? len : 1;
+    s->cluster = cluster > 0 && cluster <= GCC_PROBE_CLUSTERS ? cluster : 0;
+
+    if (s->cluster) {
+        struct gcc_probe *p = &g->probes[cluster - 1];
+        if (!p->sent) p->first_send_us = now;
+        p->last_send_us = now;
+        p->last_sent_len = s->len;
+        p->sent_bytes += s->len;
+        p->sent++;
+    }
+}
+
+static void probe_arrived(struct gcc_probe *p, size_t len, int64_t arrival_us) {
+    if (!p->received || arrival_us < p->first_arrival_us) {
+        p->first_arrival_us = arrival_us;
+        p->first_received_len = len;
+    }
+    if (!p->received || arrival_us > p->last_arrival_us) {
+        p->last_arrival_us = arrival_us;
+    }
+    p->received_bytes += len;
+    p->received++;
+}
+
+/**
+ * Raise estimate to what completed probes were received at
+ *
+ * A probe's bitrate is the lower of what it was sent and received at,
+ * each measured between its first and last packet. If a probe carried
+ * most of its probing rate, a probe at double the result follows.
+ */
+static void probe_results(struct gcc *g, uint64_t now) {
+    double best = 0;
+    bool active = false;
+
+    for (int i = 0; i < GCC_PROBE_CLUSTERS; i++) {
+        struct gcc_probe *p = &g->probes[i];
+        double send, recv, bps;
+
+        if (!p->bps || !p->started) {
+            active |= p->bps != 0;
+            continue;
+        }
+        if (p->sent && now - p->first_send_us > GCC_PROBE_TIMEOUT_US) {
+            p->bps = 0;
+            continue;
+        }
+        if (p->sent_bytes < p->bytes || p->received + p->lost < p->sent) {
+            active = true;
+            continue;
+        }
+
+        if (p->received >= GCC_PROBE_MIN_PACKETS &&
+                p->last_send_us > p->first_send_us &&
+                p->last_arrival_us > p->first_arrival_us) {
+            send = (p->sent_bytes - p->last_sent_len) * 8e6 /
+                (p->last_send_us - p->first_send_us);
+            recv = (p->received_bytes - p->first_received_len) * 8e6 /
+                (p->last_arrival_us - p->first_arrival_us);
+            // received well below sent: the path is saturated
+            bps = recv < 0.9 * send ? 0.95 * recv : send < recv ? send : recv;
+            if (bps > g->delay_bps) {
+                g->delay_bps = clamp(bps);
+                g->link_bps = 0;
+            }
+            if (bps > g->loss_bps) g->loss_bps = clamp(bps);
+            if (bps >= PROBE_CONTINUE * p->bps && bps > best) best = bps;
+        }
+        p->bps = 0;
+    }
+
+    if (best && !active && 2 * best <= GCC_MAX_BITRATE) probe_queue(g, 2 * best);
+}
+
+/**
+ * Fit slope to smoothed accumulated delay variation [^GCC 5.3]
+ *
+ * \param d_ms Delay variation between two packet groups.
+ * \param arrival_us Arrival of the later group.
+ */
+static void trendline(struct gcc *g, double d_ms, int64_t arrival_us) {
+    double xm = 0, ym = 0, num = 0, den = 0;
+
+    g->acc_delay_ms += d_ms;
+    g->smoothed_ms = SMOOTHING * g->smoothed_ms +
+        (1 - SMOOTHING) * g->acc_delay_ms;
+
+    if (!g->samples && !g->first_arrival_us) g->first_arrival_us = arrival_us;
+    if (GCC_TREND_WINDOW == g->samples) {
+        memmove(g->x, g->x + 1, sizeof(g->x) - sizeof(g->x[0]));
+        memmove(g->y, g->y + 1, sizeof(g->y) - sizeof(g->y[0]));
+        g->samples--;
+    }
+    g->x[g->samples] = (arrival_us - g->first_arrival_us) / 1000.0;
+    g->y[g->samples] = g->smoothed_ms;
+    g->samples++;
+    if (g->samples < GCC_TREND_WINDOW) return;
+
+    for (int i = 0; i < g->samples; i++) {
+        xm += g->x[i];
+        ym += g->y[i];
+    }
+    xm /= g->samples;
+    ym /= g->samples;
+    for (int i = 0; i < g->samples; i++) {
+        num += (g->x[i] - xm) * (g->y[i] - ym);
+        den += (g->x[i] - xm) * (g->x[i] - xm);
+    }
+    if (den > 0) g->trend = num / den;
+}
+
+/**
+ * Compare trend against adaptive threshold [^GCC 5.4]
+ */
+static void detect(struct gcc *g, int64_t arrival_us) {
+    double dt_ms = 0, t, k;
+
+    if (g->last_detect_us) dt_ms = (arrival_us - g->last_detect_us) / 1000.0;
+    if (dt_ms < 0) dt_ms = 0;
+    if (dt_ms > 100) dt_ms = 100;
+    g->last_detect_us = arrival_us;
+
+    t = (g->samples < 60 ? g->samples : 60) * g->trend * THRESHOLD_GAIN;
+    if (t > g->threshold_ms) {
+        g->overuse_ms = g->overuse_ms < 0 ? dt_ms / 2 : g->overuse_ms + dt_ms;
+        g->overuse_count++;
+        if (g->overuse_ms > OVERUSE_MS && g->overuse_count > 1 &&
+                g->trend >= g->prev_trend) {
+            g->usage = GCC_OVERUSE;
+            g->overuse_ms = 0;
+            g->overuse_count = 0;
+        }
+    } else if (t < -g->threshold_ms) {
+        g->usage = GCC_UNDERUSE;
+        g->overuse_ms = -1;
+        g->overuse_count = 0;
+    } else {
+        g->usage = GCC_NORMAL;
+        g->overuse_ms = -1;
+        g->overuse_count = 0;
+    }
+    g->prev_trend = g->trend;
+
+    // outliers (e.g. a route change) do not move the threshold
+    if (dabs(t) > g->threshold_ms + 15) return;
+    k = dabs(t) < g->threshold_ms ? K_DOWN : K_UP;
+    g->threshold_ms += k * (dabs(t) - g->threshold_ms) * dt_ms;
+    if (g->threshold_ms < THRESHOLD_MIN_MS) g->threshold_ms = THRESHOLD_MIN_MS;
+    if (g->threshold_ms > THRESHOLD_MAX_MS) g->threshold_ms = THRESHOLD_MAX_MS;
+}
+
+/**
+ * Group packets sent in a burst, and measure delay variation between
+ * consecutive groups [^GCC 5.2]
+ */
+static void arrived(struct gcc *g, uint64_t send_us, int64_t arrival_us) {
+    struct gcc_group *c = &g->group, *p = &g->prev;
+
+    if (!c->valid) goto _start;
+    if (send_us < c->first_send_us) return;     // reordered
+    if (send_us - c->first_send_us <= GCC_BURST_US) {
+        if (send_us > c->last_send_us) c->last_send_us = send_us;
+        if (arrival_us > c->last_arrival_us) c->last_arrival_us = arrival_us;
+        return;
+    }
+
+    if (p->valid) {
+        int64_t da = c->last_arrival_us - p->last_arrival_us;
+        int64_t ds = (int64_t)(c->last_send_us - p->last_send_us);
+        trendline(g, (da - ds) / 1000.0, c->last_arrival_us);
+        detect(g, c->last_arrival_us);
+    }
+    *p = *c;
+
+_start:
+    *c = (struct gcc_group){ send_us, send_us, arrival_us, true };
+}
+
+static void acked(struct gcc *g, size_t len, int64_t arrival_us) {
+    if (!g->acked_bytes) g->acked_start_us = arrival_us;
+    g->acked_bytes += len;
+    if (arrival_us - g->acked_start_us >= GCC_ACKED_WINDOW_US) {
+        g->acked_bps = g->acked_bytes * 8e6 /
+            (arrival_us - g->acked_start_us);
+        g->acked_bytes = 0;
+    }
+}
+
+/**
+ * Additive increase, multiplicative decrease of delay-based estimate
+ * [^GCC 5.5]
+ */
+static void rate_control(struct gcc *g, uint64_t now) {
+    double dt = g->last_update_us ? (now - g->last_update_us) / 1e6 : 0;
+    double bps = g->delay_bps;
+
+    if (dt > 1) dt = 1;
+    g->last_update_us = now;
+
+    switch (g->usage) {
+    case GCC_OVERUSE:
+        g->state = GCC_DECREASE;
+        break;
+    case GCC_UNDERUSE:
+        g->state = GCC_HOLD;
+        break;
+    default:
+        if (GCC_HOLD == g->state) g->state = GCC_INCREASE;
+        break;
+    }
+
+    switch (g->state) {
+    case GCC_INCREASE:
+        // well above the last capacity found, it has changed
+        if (g->link_bps && g->acked_bps > 1.15 * g->link_bps) g->link_bps = 0;
+        if (g->link_bps) {
+            bps += ADDITIVE_BPS * dt;
+        } else {
+            bps *= 1 + ETA * dt;
+        }
+        if (g->acked_bps && bps > 1.5 * g->acked_bps + 10000) {
+            bps = 1.5 * g->acked_bps + 10000;
+            if (bps < g->delay_bps) bps = g->delay_bps;
+        }
+        break;
+    case GCC_DECREASE:
+        if (!g->acked_bps && now - g->last_decrease_us < DECREASE_INTERVAL_US) {
+            break;
+        }
+        if (BETA * (g->acked_bps ? g->acked_bps : bps) < bps) {
+            bps = BETA * (g->acked_bps ? g->acked_bps : bps);
+        }
+        g->link_bps = g->acked_bps;
+        g->last_decrease_us = now;
+        g->state = GCC_HOLD;
+        break;
+    default:
+        break;
+    }
+
+    g->delay_bps = clamp(bps);
+}
+
+uint32_t gcc_on_feedback(
+    struct gcc *g,
+    const struct rtcp_twcc_status *st,
+    size_t count,
+    uint64_t now
+) {
+    for (size_t i = 0; i < count; i++) {
+        struct gcc_sent *s = &g->sent[st[i].seq & (GCC_HISTORY - 1)];
+
+        struct gcc_probe *p = s->cluster ? &g->probes[s->cluster - 1] : NULL;
+
+        if (p && !p->bps) p = NULL;
+
+        if (s->seq != st[i].seq || !s->len) continue;
+        g->reported++;
+        if (st[i].received) {
+            acked(g, s->len, st[i].arrival_us);
+            arrived(g, s->send_us, st[i].arrival_us);
+            if (p) probe_arrived(p, s->len, st[i].arrival_us);
+        } else {
+            g->lost++;
+            if (p) p->lost++;
+        }
+        s->len = 0;
+    }
+    probe_results(g, now);
+
+    // loss-based estimate, backing off at most once per interval [^GCC 6]
+    if (g->reported >= GCC_LOSS_PACKETS) {
+        g->loss = g->lost * 256 / g->reported > 255 ? 255 :
+            g->lost * 256 / g->reported;
+        g->lost = g->reported = 0;
+        if (g->loss > LOSS_HIGH) {
+            if (now - g->last_loss_decrease_us >= DECREASE_INTERVAL_US) {
+                g->loss_bps = clamp(g->target_bps *
+                    (1 - 0.5 * g->loss / 256));
+                g->last_loss_decrease_us = now;
+            }
+        } else if (g->loss < LOSS_LOW) {
+            g->loss_bps = clamp(g->loss_bps * 1.05);
+        }
+    }
+
+    rate_control(g, now);
+
+    g->target_bps = g->delay_bps < g->loss_bps ? g->delay_bps : g->loss_bps;
+
+    return g->target_bps;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_GCC_H
+#define _URTC_GCC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtcp.h"
+
+#define GCC_HISTORY                   1024  // sent packets kept, pow. of 2
+#define GCC_MIN_BITRATE             100000  // bits per second
+#define GCC_MAX_BITRATE           20000000
+#define GCC_BURST_US                  5000  // sent within, one packet group
+#define GCC_TREND_WINDOW                20  // delay samples in regression
+#define GCC_ACKED_WINDOW_US         500000  // received bitrate averaged over
+#define GCC_LOSS_PACKETS                20  // loss measured over at least
+#define GCC_PROBE_CLUSTERS               4  // probes in flight
+#define GCC_PROBE_DURATION_US        15000  // of each probe
+#define GCC_PROBE_MIN_PACKETS            5  // in each probe
+#define GCC_PROBE_TIMEOUT_US       1000000  // probe abandoned after
+
+enum gcc_usage {
+    GCC_NORMAL = 0,
+    GCC_OVERUSE,
+    GCC_UNDERUSE
+};
+
+enum gcc_rate_state {
+    GCC_HOLD = 0,
+    GCC_INCREASE,
+    GCC_DECREASE
+};
+
+struct gcc_sent {
+    uint64_t send_us;
+    uint16_t seq;
+    uint16_t len;                       // 0 once reported on
+    uint8_t cluster;                    // probe, 0 if none
+};
+
+/**
+ * Cluster of packets sent at a probing bitrate
+ */
+struct gcc_probe {
+    uint32_t bps;                       // probing bitrate, 0 if slot free
+    size_t bytes;                       // size of probe
+    bool started;                       // handed out by gcc_probe_next()
+
+    int sent, received, lost;           // packets
+    size_t sent_bytes, received_bytes;
+    size_t last_sent_len;
+    size_t first_received_len;
+    uint64_t first_send_us, last_send_us;
+    int64_t first_arrival_us, last_arrival_us;
+};
+
+/**
+ * Packets sent within GCC_BURST_US of each other, as received
+ */
+struct gcc_group {
+    uint64_t first_send_us;
+    uint64_t last_send_us;
+    int64_t last_arrival_us;
+    bool valid;
+};
+
+/**
+ * Send-side congestion controller [^GCC]
+ *
+ * Each packet carries a transport-wide sequence number, and the receiver
+ * reports back when each arrived. From these, a delay-based estimate
+ * follows the trend of queueing delay: a growing queue (overuse) cuts the
+ * bitrate to below what was received, otherwise it grows, multiplicatively
+ * until near the last link capacity found, then additively. A loss-based
+ * estimate backs off if more than 10% of packets are lost. The target is
+ * the lower of the two.
+ *
+ * At the start of a session, clusters of packets are sent at several
+ * times the target and the rate they are received at is measured, so the
+ * estimate jumps to the available bitrate within the first second rather
+ * than creeping up to it. Probing continues at double each successful
+ * result, until a probe is not carried in full.
+ *
+ * [^GCC]: draft-ietf-rmcat-gcc-02
+ *
+ * Times are monotonic microseconds (see timer_now_us()), passed in.
+ */
+struct gcc {
+    uint32_t target_bps;
+    uint32_t delay_bps;                 // delay-based estimate
+    uint32_t loss_bps;                  // loss-based estimate
+    uint8_t loss;                       // last fraction lost (of 256)
+    uint32_t lost;                      // since loss last measured
+    uint32_t reported;
+    uint64_t last_loss_decrease_us;
+
+    struct gcc_sent sent[GCC_HISTORY];
+
+    // arrival-time filter
+    struct gcc_group group, prev;
+    double acc_delay_ms;                // accumulated delay variation
+    double smoothed_ms;
+    double x[GCC_TREND_WINDOW];         // arrival time (in ms)
+    double y[GCC_TREND_WINDOW];         // smoothed accumulated delay
+    int samples;
+    int64_t first_arrival_us;
+    double trend;                       // slope of delay over time
+    double prev_trend;
+
+    // over-use detector
+    enum gcc_usage usage;
+    double threshold_ms;
+    int64_t last_detect_us;             // arrival of last delay sample
+    double overuse_ms;                  // time over threshold, -1 if under
+    int overuse_count;
+
+    // rate controller
+    enum gcc_rate_state state;
+    uint64_t last_update_us;
+    uint64_t last_decrease_us;
+    uint32_t link_bps;                  // received at last overuse, 0 if none
+
+    // received bitrate
+    uint32_t acked_bps;                 // 0 until measured
+    int64_t acked_start_us;
+    size_t acked_bytes;
+
+    struct gcc_probe probes[GCC_PROBE_CLUSTERS];
+};
+
+/**
+ * Initialize estimator
+ *
+ * \param g Estimator.
+ * \param start_bps Initial target bitrate (in bits per second).
+ */
+void gcc_init(struct gcc *g, uint32_t start_bps);
+
+/**
+ * Restart estimate from a bitrate, keeping sent packet history
+ */
+void gcc_set_bitrate(struct gcc *g, uint32_t bps);
+
+/**
+ * Probe at three and six times the target bitrate
+ */
+void gcc_probe_start(struct gcc *g);
+
+/**
+ * Next probe to send
+ *
+ * \param g Estimator.
+ * \param[out] bps Probing bitrate.
+ * \param[out] bytes Size of probe.
+ *
+ * \return Probe cluster (passed to gcc_on_sent() with its packets), or 0
+ *         if none is due.
+ */
+int gcc_probe_next(struct gcc *g, uint32_t *bps, size_t *bytes);
+
+/**
+ * Record packet sent
+ *
+ * \param g Estimator.
+ * \param seq Transport-wide sequence number.
+ * \param len Size of packet on the wire.
+ * \param now Send time.
+ * \param cluster Probe the packet belongs to, or 0 if none.
+ */
+void gcc_on_sent(
+    struct gcc *g,
+    uint16_t seq,
+    size_t len,
+    uint64_t now,
+    int cluster
+);
+
+/**
+ * Update estimate from transport-wide feedback
+ *
+ * \param g Estimator.
+ * \param st Reported packets, in sequence number order.
+ * \param count Number of reported packets.
+ * \param now Current time.
+ *
+ * \return Target bitrate (in bits per second).
+ */
+uint32_t gcc_on_feedback(
+    struct gcc *g,
+    const struct rtcp_twcc_status *st,
+    size_t count,
+    uint64_t now
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_GCC_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,590 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * H.264 RTP payload format [^RFC6184], packetization mode 1
+ *
+ * Payloads are scatter-gather lists referencing the encoder's buffer, so
+ * NAL unit bytes are first touched when they are encrypted into the
+ * outgoing datagram. Received NAL units are copied once, from the
+ * decrypted datagram into a pooled frame buffer.
+ */
+
+#include <stdbool.h>                    // bool
+#include <stdlib.h>                     // free, realloc
+#include <string.h>                     // memcpy, memset
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "err.h"
+#include "h264.h"
+
+// older sequence numbers are a restarted stream [^RFC3550 A.1]
+#define MAX_MISORDER                   100
+
+struct nal {
+    const uint8_t *p;
+    size_t n;
+};
+
+const uint8_t *h264_find_start_code_scalar(
+    const uint8_t *p,
+    const uint8_t *end
+) {
+    // a non-zero p[2] rules out a prefix starting at p + 1 or p + 2, and
+    // one other than 1 also at p
+    while (p + 3 <= end) {
+        if (0 == p[2]) {
+            p++;
+        } else if (1 == p[2] && 0 == p[0] && 0 == p[1]) {
+            return p;
+        } else {
+            p += 3;
+        }
+    }
+    return end;
+}
+
+/*
+ * Vector scanners compare each lane against the three prefix bytes at once,
+ * using loads offset by one and two bytes, and hand the unscanned tail (less
+ * than a vector plus two bytes) to the scalar scanner.
+ */
+#if defined(__AVX2__)
+
+const uint8_t *h264_find_start_code(const uint8_t *p, const uint8_t *end) {
+    const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi8(1);
+
+    for (; p + 32 + 2 <= end; p += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)p);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(p + 2));
+        __m256i m = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, zero),
+                             _mm256_cmpeq_epi8(b, zero)),
+            _mm256_cmpeq_epi8(c, one));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(m);
+        if (bits) return p + __builtin_ctz(bits);
+    }
+
+    return h264_find_start_code_scalar(p, end);
+}
+
+#elif defined(__SSE2__)
+
+const uint8_t *h264_find_start_code(const uint8_t *p, const uint8_t *end) {
+    const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi8(1);
+
+    for (; p + 16 + 2 <= end; p += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)p);
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + 1));
+        __m128i c = _mm_loadu_si128((const __m128i *)(p + 2));
+        __m128i m = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(b, zero)),
+            _mm_cmpeq_epi8(c, one));
+        int bits = _mm_movemask_epi8(m);
+        if (bits) return p + __builtin_ctz(bits);
+    }
+
+    return h264_find_start_code_scalar(p, end);
+}
+
+#elif defined(__ARM_NEON)
+
+const uint8_t *h264_find_start_code(const uint8_t *p, const uint8_t *end) {
+    const uint8x16_t zero = vdupq_n_u8(0), one = vdupq_n_u8(1);
+
+    for (; p + 16 + 2 <= end; p += 16) {
+        uint8x16_t m = vandq_u8(
+            vandq_u8(vceqq_u8(vld1q_u8(p), zero),
+                     vceqq_u8(vld1q_u8(p + 1), zero)),
+            vceqq_u8(vld1q_u8(p + 2), one));
+
+        // no movemask on neon (and no vmaxvq on armv7), fold to 64 bits and
+        // locate the match within the block with the scalar scanner
+        uint8x8_t f = vorr_u8(vget_low_u8(m), vget_high_u8(m));
+        if (vget_lane_u64(vreinterpret_u64_u8(f), 0)) {
+            return h264_find_start_code_scalar(p, p + 16 + 2);
+        }
+    }
+
+    return h264_find_start_code_scalar(p, end);
+}
+
+#else
+
+const uint8_t *h264_find_start_code(const uint8_t *p, const uint8_t *end) {
+    return h264_find_start_code_scalar(p, end);
+}
+
+#endif
+
+/**
+ * Next non-empty NAL unit
+ *
+ * \param[in,out] pos Scan position, just after a start code.
+ * \param end End of access unit.
+ * \param[out] nal NAL unit.
+ *
+ * \return True if a NAL unit was found.
+ */
+static bool next_nal(const uint8_t **pos, const uint8_t *end, struct nal *nal) {
+    const uint8_t *p = *pos, *next;
+    size_t n;
+
+    while (p < end) {
+        next = h264_find_start_code(p, end);
+
+        // nal units never end in a zero byte; trailing zeros are stuffing
+        n = next - p;
+        while (n && 0 == p[n - 1]) n--;
+
+        *pos = next == end ? end : next + 3;
+
+        if (n) {
+            nal->p = p;
+            nal->n = n;
+            return true;
+        }
+        p = *pos;
+    }
+
+    return false;
+}
+
+/**
+ * Emit single NAL unit packet [^RFC6184 5.6]
+ */
+static int emit_single(
+    const struct nal *nal,
+    bool last,
+    h264_emit_fn *emit,
+    void *arg
+) {
+    struct rtp_payload *p = rtp_payload_new();
+    if (!p) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    rtp_payload_append(p, nal->p, nal->n);
+    p->marker = last;
+
+    return emit(p, arg);
+}
+
+/**
+ * Emit aggregation packet [^RFC6184 5.7.1]
+ */
+static int emit_stap_a(
+    const struct nal *nals,
+    size_t count,
+    bool last,
+    h264_emit_fn *emit,
+    void *arg
+) {
+    struct rtp_payload *p = rtp_payload_new();
+    uint8_t hdr = H264_NAL_STAP_A, size[2];
+
+    if (!p) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    // forbidden bit if any, highest nri of aggregated units
+    for (size_t i = 0; i < count; i++) {
+        hdr |= nals[i].p[0] & 0x80;
+        if ((nals[i].p[0] & 0x60) > (hdr & 0x60)) {
+            hdr = (hdr & ~0x60) | (nals[i].p[0] & 0x60);
+        }
+    }
+    rtp_payload_append_hdr(p, &hdr, 1);
+
+    for (size_t i = 0; i < count; i++) {
+        size[0] = nals[i].n >> 8;
+        size[1] = nals[i].n;
+        rtp_payload_append_hdr(p, size, 2);
+        rtp_payload_append(p, nals[i].p, nals[i].n);
+    }
+    p->marker = last;
+
+    return emit(p, arg);
+}
+
+/**
+ * Emit NAL unit as single packet, or fragmented [^RFC6184 5.8]
+ *
+ * \return Number of payloads emitted, or negative on error.
+ */
+static int emit_nal(
+    const struct nal *nal,
+    size_t max_payload,
+    bool last,
+    h264_emit_fn *emit,
+    void *arg
+) {
+    struct rtp_payload *p;
+    const uint8_t *frag;
+    size_t remain, size, nfrags, n;
+    uint8_t fu[2];
+    int count = 0, rv;
+
+    if (nal->n <= max_payload) {
+        if (rv = emit_single(nal, last, emit, arg), rv < 0) return rv;
+        return 1;
+    }
+
+    // nal header is carried in fu bytes; fragments are equally sized so the
+    // last one is not a runt
+    frag = nal->p + 1;
+    remain = nal->n - 1;
+    nfrags = (remain + max_payload - 3) / (max_payload - 2);
+    size = (remain + nfrags - 1) / nfrags;
+
+    fu[0] = (nal->p[0] & 0xe0) | H264_NAL_FU_A;
+
+    while (remain) {
+        n = remain < size ? remain : size;
+
+        fu[1] = nal->p[0] & H264_NAL_TYPE_MASK;
+        if (frag == nal->p + 1) fu[1] |= 0x80;      // start
+        if (n == remain)        fu[1] |= 0x40;      // end
+
+        if (p = rtp_payload_new(), !p) return -URTC_ERR_INSUFFICIENT_MEMORY;
+        rtp_payload_append_hdr(p, fu, sizeof(fu));
+        rtp_payload_append(p, frag, n);
+        p->marker = last && n == remain;
+
+        if (rv = emit(p, arg), rv < 0) return rv;
+
+        frag += n;
+        remain -= n;
+        count++;
+    }
+
+    return count;
+}
+
+bool h264_is_keyframe(const uint8_t *au, size_t len) {
+    const uint8_t *end, *p;
+
+    if (!au) return false;
+
+    for (p = au, end = au + len;
+            p = h264_find_start_code(p, end), p + 3 < end; p += 3) {
+        uint8_t type = p[3] & H264_NAL_TYPE_MASK;
+
+        if (H264_NAL_IDR == type) return true;
+        if (type >= H264_NAL_SLICE && type < H264_NAL_IDR) return false;
+    }
+
+    return false;
+}
+
+bool h264_is_parameter_set(const uint8_t *au, size_t len) {
+    const uint8_t *end, *p;
+    bool params = false;
+
+    if (!au) return false;
+
+    for (p = au, end = au + len;
+            p = h264_find_start_code(p, end), p + 3 < end; p += 3) {
+        uint8_t type = p[3] & H264_NAL_TYPE_MASK;
+
+        if (H264_NAL_SPS == type || H264_NAL_PPS == type) params = true;
+        if (type >= H264_NAL_SLICE && type <= H264_NAL_IDR) return false;
+    }
+
+    return params;
+}
+
+int h264_packetize(
+    const uint8_t *au,
+    size_t len,
+    size_t max_payload,
+    h264_emit_fn *emit,
+    void *arg
+) {
+    const uint8_t *end = au + len, *pos;
+    struct nal cur, run[H264_MAX_STAP_NALS];
+    size_t k, size;
+    bool have;
+    int count = 0, rv;
+
+    if (!au || !emit || max_payload < 3) return -URTC_ERR_BAD_ARGUMENT;
+
+    pos = h264_find_start_code(au, end);
+    if (pos == end) return -URTC_ERR_MALFORMED;
+    pos += 3;
+
+    if (have = next_nal(&pos, end, &cur), !have) return -URTC_ERR_MALFORMED;
+
+    while (have) {
+        // gather run of nal units that fit together in one stap-a
+        for (k = 0, size = 1; have && k < H264_MAX_STAP_NALS &&
+                size + 2 + cur.n <= max_payload; k++) {
+            run[k] = cur;
+            size += 2 + cur.n;
+            have = next_nal(&pos, end, &cur);
+        }
+
+        if (k > 1) {
+            rv = emit_stap_a(run, k, !have, emit, arg);
+            if (rv < 0) return rv;
+            count++;
+        } else if (1 == k) {
+            rv = emit_single(&run[0], !have, emit, arg);
+            if (rv < 0) return rv;
+            count++;
+        } else {
+            run[0] = cur;
+            have = next_nal(&pos, end, &cur);
+            rv = emit_nal(&run[0], max_payload, !have, emit, arg);
+            if (rv < 0) return rv;
+            count += rv;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Depacketization
+ */
+
+/**
+ * Claim a free frame from the pool
+ *
+ * \return Frame, or NULL if all frames are assembling or delivered.
+ */
+static struct h264_frame *frame_acquire(struct h264_depkt *d) {
+    for (int i = 0; i < H264_FRAME_POOL_SIZE; i++) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&d->pool[i].busy, &expected, 1,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return &d->pool[i];
+        }
+    }
+    return NULL;
+}
+
+void h264_frame_release(struct h264_frame *f) {
+    if (f) __atomic_store_n(&f->busy, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Append bytes to frame, growing its buffer (once per pool slot, typically)
+ */
+static int frame_append(struct h264_frame *f, const uint8_t *data, size_t n) {
+    uint8_t *p;
+    size_t cap;
+
+    if (f->len + n > f->cap) {
+        if (f->len + n > H264_MAX_FRAME_SIZE) return -URTC_ERR_MALFORMED;
+
+        for (cap = f->cap ? f->cap : 64 << 10; cap < f->len + n; cap *= 2);
+        if (cap > H264_MAX_FRAME_SIZE) cap = H264_MAX_FRAME_SIZE;
+
+        if (p = realloc(f->data, cap), !p) {
+            return -URTC_ERR_INSUFFICIENT_MEMORY;
+        }
+        f->data = p;
+        f->cap = cap;
+    }
+
+    memcpy(f->data + f->len, data, n);
+    f->len += n;
+
+    return 0;
+}
+
+/**
+ * Append start code, NAL unit header and rest of NAL unit to frame
+ */
+static int frame_put_nal(
+    struct h264_frame *f,
+    uint8_t hdr,
+    const uint8_t *data,
+    size_t n
+) {
+    const uint8_t sc[5] = { 0x00, 0x00, 0x00, 0x01, hdr };
+    int rv;
+
+    if (rv = frame_append(f, sc, sizeof(sc)), rv < 0) return rv;
+    if (H264_NAL_IDR == (hdr & H264_NAL_TYPE_MASK)) f->keyframe = true;
+
+    return frame_append(f, data, n);
+}
+
+static void frame_begin(struct h264_depkt *d, uint32_t ts) {
+    d->assembling = true;
+    d->broken = false;
+    d->fu = false;
+    d->ts = ts;
+
+    if (d->cur = frame_acquire(d), d->cur) {
+        d->cur->len = 0;
+        d->cur->ts = ts;
+        d->cur->keyframe = false;
+    }
+}
+
+/**
+ * Deliver current frame if complete and decodable, else drop it
+ */
+static void frame_end(struct h264_depkt *d) {
+    struct h264_frame *f = d->cur;
+
+    d->assembling = false;
+    d->cur = NULL;
+
+    // an unterminated fu-a means the end of a nal unit was lost
+    if (!f || d->broken || d->fu) {
+        h264_frame_release(f);
+        d->dropped++;
+        d->need_keyframe = true;
+        return;
+    }
+
+    // e.g. padding only, or frames that reference a lost one
+    if (!f->len || (d->need_keyframe && !f->keyframe)) {
+        h264_frame_release(f);
+        return;
+    }
+
+    d->need_keyframe = false;
+    d->cb(f, d->arg);
+}
+
+/**
+ * Append NAL units of one RTP payload to current frame [^RFC6184 5.6-5.8]
+ */
+static int depacketize(struct h264_depkt *d, const uint8_t *p, size_t n) {
+    struct h264_frame *f = d->cur;
+    uint8_t type;
+    size_t size;
+    int rv;
+
+    if (!n) return 0;
+    type = p[0] & H264_NAL_TYPE_MASK;
+
+    // a fragmented nal unit must be continued by its next fragment
+    if (d->fu && H264_NAL_FU_A != type) return -URTC_ERR_MALFORMED;
+
+    // single nal unit packet
+    if (type >= 1 && type <= 23) return frame_put_nal(f, p[0], p + 1, n - 1);
+
+    switch (type) {
+    case H264_NAL_STAP_A:
+        for (p++, n--; n; p += size, n -= size) {
+            if (n < 2) return -URTC_ERR_MALFORMED;
+            size = (p[0] << 8) | p[1];
+            p += 2;
+            n -= 2;
+            if (!size || size > n) return -URTC_ERR_MALFORMED;
+            if (rv = frame_put_nal(f, p[0], p + 1, size - 1), rv < 0) {
+                return rv;
+            }
+        }
+        return 0;
+
+    case H264_NAL_FU_A:
+        if (n < 2) return -URTC_ERR_MALFORMED;
+        if (p[1] & 0x80) {
+            if (d->fu) return -URTC_ERR_MALFORMED;
+            rv = frame_put_nal(f, (p[0] & 0xe0) | (p[1] & H264_NAL_TYPE_MASK),
+                p + 2, n - 2);
+        } else {
+            if (!d->fu) return -URTC_ERR_MALFORMED;
+            rv = frame_append(f, p + 2, n - 2);
+        }
+        d->fu = !(p[1] & 0x40);
+        return rv;
+
+    default:
+        // stap-b, mtap and fu-b are not used in packetization mode 1
+        return -URTC_ERR_MALFORMED;
+    }
+}
+
+int h264_depkt_init(struct h264_depkt *d, h264_frame_fn *cb, void *arg) {
+    if (!d || !cb) return -URTC_ERR_BAD_ARGUMENT;
+
+    memset(d, 0, sizeof(*d));
+    d->need_keyframe = true;
+    d->cb = cb;
+    d->arg = arg;
+
+    return 0;
+}
+
+int h264_depkt_push(struct h264_depkt *d, const uint8_t *pkt, size_t n) {
+    struct rtp_header h;
+    bool gap = false;
+    int rv;
+
+    if (!d) return -URTC_ERR_BAD_ARGUMENT;
+    if (rv = rtp_header_read(pkt, n, &h), rv < 0) return rv;
+
+    if (d->started) {
+        int16_t delta = h.seq - d->next_seq;
+
+        // late or duplicate, unless far enough back to be a restart
+        if (delta < 0 && delta >= -MAX_MISORDER) return 0;
+        gap = 0 != delta;
+    }
+    d->started = true;
+    d->next_seq = h.seq + 1;
+
+    // new timestamp without a marker: the marker packet was lost
+    if (d->assembling && h.ts != d->ts) {
+        d->broken |= gap;
+        frame_end(d);
+    }
+    if (!d->assembling) frame_begin(d, h.ts);
+
+    // missing packets may belong to this frame
+    d->broken |= gap;
+
+    if (d->cur && !d->broken) {
+        rv = depacketize(d, pkt + h.payload, h.payload_len);
+        if (rv < 0) d->broken = true;
+    }
+
+    if (h.marker) frame_end(d);
+
+    return rv;
+}
+
+void h264_depkt_free(struct h264_depkt *d) {
+    if (!d) return;
+    for (int i = 0; i < H264_FRAME_POOL_SIZE; i++) {
+        free(d->pool[i].data);
+        d->pool[i].data = NULL;
+    }
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,239 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_H264_H
+#define _URTC_H264_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rtp.h"
+
+// NAL unit types [^RFC6184 5.2]
+#define H264_NAL_TYPE_MASK            0x1f
+#define H264_NAL_SLICE                   1  // non-idr
+#define H264_NAL_IDR                     5
+#define H264_NAL_SEI                     6
+#define H264_NAL_SPS                     7
+#define H264_NAL_PPS                     8
+#define H264_NAL_STAP_A                 24
+#define H264_NAL_FU_A                   28
+
+// NAL units per STAP-A: one fragment for the STAP-A header, then a size
+// and a NAL unit fragment each
+#define H264_MAX_STAP_NALS  ((RTP_MAX_IOV - 1) / 2)
+
+/**
+ * (callback) Receive one packetized RTP payload
+ *
+ * \param p Payload. The callee takes over the caller's reference.
+ * \param arg User argument.
+ *
+ * \return 0 on success, negative to abort packetization.
+ */
+typedef int (h264_emit_fn)(struct rtp_payload *p, void *arg);
+
+/**
+ * Find next start code prefix (00 00 01) in Annex-B byte stream
+ *
+ * Scans 16 or 32 bytes per step with SSE2, AVX2 or NEON where the compiler
+ * targets them, and falls back to h264_find_start_code_scalar() otherwise.
+ * A four-byte start code is found at its last three bytes.
+ *
+ * \param p Start of scan.
+ * \param end End of byte stream.
+ *
+ * \return Pointer to the first zero of the prefix, or \a end if none.
+ */
+const uint8_t *h264_find_start_code(const uint8_t *p, const uint8_t *end);
+
+/**
+ * Reference byte-at-a-time implementation of h264_find_start_code()
+ */
+const uint8_t *h264_find_start_code_scalar(
+    const uint8_t *p,
+    const uint8_t *end
+);
+
+/**
+ * Packetize Annex-B access unit into RTP payloads [^RFC6184]
+ *
+ * Runs of NAL units that fit together (typically SPS, PPS and SEI) are
+ * aggregated into STAP-A packets, other NAL units that fit are sent as
+ * single NAL unit packets, and larger ones are fragmented into equally
+ * sized FU-A packets. The last payload has its marker set.
+ *
+ * Payloads reference NAL unit bytes in \a au rather than copying them, so
+ * \a au must stay valid until the payloads are sent.
+ *
+ * \param au Access unit (Annex-B byte stream, start code delimited).
+ * \param len Size of access unit.
+ * \param max_payload Largest payload to emit (in bytes), i.e. path MTU less
+ *        IP, UDP, RTP and SRTP overhead.
+ * \param emit Payload callback.
+ * \param arg Argument passed to payload callback.
+ *
+ * \return Number of payloads emitted, or negative on error.
+ */
+int h264_packetize(
+    const uint8_t *au,
+    size_t len,
+    size_t max_payload,
+    h264_emit_fn *emit,
+    void *arg
+);
+
+/**
+ * Whether access unit is a keyframe, i.e. its slices are IDR slices
+ *
+ * Only NAL unit headers up to the first slice are looked at, so the cost
+ * does not grow with frame size.
+ *
+ * \param au Access unit (Annex-B byte stream).
+ * \param len Size of access unit.
+ *
+ * \return True if the first slice is an IDR slice.
+ */
+bool h264_is_keyframe(const uint8_t *au, size_t len);
+
+/**
+ * Whether access unit carries parameter sets (SPS, PPS) and no slice
+ *
+ * Some encoders emit parameter sets as an access unit of their own, ahead
+ * of the keyframe that needs them.
+ *
+ * \param au Access unit (Annex-B byte stream).
+ * \param len Size of access unit.
+ *
+ * \return True if an SPS or PPS is found before any slice.
+ */
+bool h264_is_parameter_set(const uint8_t *au, size_t len);
+
+#define H264_FRAME_POOL_SIZE             4  // frames assembling or delivered
+#define H264_MAX_FRAME_SIZE      (4 << 20)  // largest access unit accepted
+
+/**
+ * Reassembled access unit, in Annex-B format with four-byte start codes
+ *
+ * Frame buffers are pooled by the depacketizer and keep their capacity
+ * across frames, so steady-state reception does not allocate.
+ */
+struct h264_frame {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    uint32_t ts;                        // rtp timestamp
+    bool keyframe;                      // contains an idr slice
+    int busy;                           // atomic, assembling or delivered
+};
+
+/**
+ * (callback) Receive one complete access unit
+ *
+ * The callee owns \a f until it passes it to h264_frame_release(), which
+ * may be done later and from another thread (e.g. a decoder's).
+ *
+ * \param f Frame.
+ * \param arg User argument.
+ */
+typedef void (h264_frame_fn)(struct h264_frame *f, void *arg);
+
+/**
+ * Depacketizer of one received H.264 stream [^RFC6184]
+ *
+ * Packets must be pushed in sequence number order (e.g. from a jitter
+ * buffer). A missing sequence number drops the frames it may belong to,
+ * after which frames are withheld until the next IDR, since they could not
+ * be decoded.
+ */
+struct h264_depkt {
+    struct h264_frame pool[H264_FRAME_POOL_SIZE];
+    struct h264_frame *cur;             // being assembled, or NULL
+
+    bool assembling;                    // ts of current frame is valid
+    bool broken;                        // current frame lost data
+    bool fu;                            // inside fu-a fragmented nal unit
+    uint32_t ts;
+
+    bool started;                       // next_seq is valid
+    uint16_t next_seq;
+
+    bool need_keyframe;                 // withholding frames until idr
+    uint32_t dropped;                   // frames dropped (lost or no buffer)
+
+    h264_frame_fn *cb;
+    void *arg;
+};
+
+/**
+ * Initialize depacketizer
+ *
+ * \param d Depacketizer.
+ * \param cb Frame callback.
+ * \param arg Argument passed to frame callback.
+ *
+ * \return 0 on success, negative on error.
+ */
+int h264_depkt_init(struct h264_depkt *d, h264_frame_fn *cb, void *arg);
+
+/**
+ * Depacketize one (unprotected) RTP packet
+ *
+ * NAL units are copied from the packet straight into the frame buffer,
+ * once. The frame callback is called from within when a frame completes.
+ *
+ * \param d Depacketizer.
+ * \param pkt RTP packet.
+ * \param n Size of RTP packet.
+ *
+ * \return 0 on success, negative on error (e.g. malformed packet).
+ */
+int h264_depkt_push(struct h264_depkt *d, const uint8_t *pkt, size_t n);
+
+/**
+ * Return delivered frame to its pool
+ */
+void h264_frame_release(struct h264_frame *f);
+
+/**
+ * Free depacketizer resources
+ *
+ * Frames not yet released must not be used afterwards.
+ */
+void h264_depkt_free(struct h264_depkt *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_H264_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Sent RTP packet history
+ *
+ * Lookup is O(1): the slot of a sequence number is its low bits. Eviction
+ * is amortized O(1): packets are evicted in the order they were stored.
+ */
+
+#include <stdlib.h>                     // malloc, free
+#include <string.h>                     // memset
+
+#include "err.h"
+#include "hist.h"
+
+static struct hist_slot *slot(struct hist *h, uint16_t seq) {
+    return &h->slots[seq & (HIST_SLOTS - 1)];
+}
+
+static void evict_oldest(struct hist *h) {
+    slot(h, h->oldest)->used = false;
+    h->oldest++;
+    h->count--;
+}
+
+/**
+ * Evict packets older than the age bound
+ */
+static void expire(struct hist *h, uint64_t now) {
+    while (h->count && now - slot(h, h->oldest)->sent_us > h->max_age_us) {
+        evict_oldest(h);
+    }
+}
+
+int hist_init(struct hist *h, size_t bytes, uint32_t age_ms) {
+    if (!h || !bytes || bytes > UINT32_MAX) return -URTC_ERR_BAD_ARGUMENT;
+
+    memset(h, 0, sizeof(*h));
+    if (h->arena = malloc(bytes), !h->arena) {
+        return -URTC_ERR_INSUFFICIENT_MEMORY;
+    }
+    h->size = bytes;
+    h->max_age_us = age_ms * 1000;
+
+    return 0;
+}
+
+uint8_t *hist_store(struct hist *h, uint16_t seq, size_t len, uint64_t now) {
+    struct hist_slot *s;
+    size_t off;
+
+    if (!h || !h->arena || len > h->size) return NULL;
+
+    // out of order or far ahead: start over rather than index stale slots
+    if (h->count && (uint16_t)(seq - h->oldest) != h->count) {
+        while (h->count) evict_oldest(h);
+    }
+    if (!h->count) {
+        h->oldest = seq;
+        h->head = 0;
+    }
+
+    expire(h, now);
+
+    // slot reused by this sequence number
+    if (HIST_SLOTS == h->count) evict_oldest(h);
+
+    // log wraps to the start when the packet does not fit at the end; the
+    // tail left unused holds the oldest packets, which go first
+    if (h->head + len > h->size) {
+        while (h->count && slot(h, h->oldest)->off >= h->head) {
+            evict_oldest(h);
+        }
+        off = 0;
+    } else {
+        off = h->head;
+    }
+
+    // then packets whose bytes are overwritten
+    while (h->count) {
+        const struct hist_slot *o = slot(h, h->oldest);
+        if (off >= o->off + o->len || o->off >= off + len) break;
+        evict_oldest(h);
+    }
+    if (!h->count) h->oldest = seq;
+
+    s = slot(h, seq);
+    s->used = true;
+    s->seq = seq;
+    s->off = off;
+    s->len = len;
+    s->sent_us = now;
+
+    h->head = off + len;
+    h->count++;
+
+    return h->arena + off;
+}
+
+const uint8_t *hist_get(
+    struct hist *h,
+    uint16_t seq,
+    size_t *len,
+    uint64_t now
+) {
+    struct hist_slot *s;
+
+    if (!h || !len) return NULL;
+
+    expire(h, now);
+
+    s = slot(h, seq);
+    if (!s->used || s->seq != seq) return NULL;
+
+    *len = s->len;
+    return h->arena + s->off;
+}
+
+void hist_free(struct hist *h) {
+    if (!h) return;
+    free(h->arena);
+    h->arena = NULL;
+    h->count = 0;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_HIST_H
+#define _URTC_HIST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HIST_SLOTS                    1024  // packets indexed, power of two
+
+struct hist_slot {
+    bool used;
+    uint16_t seq;
+    uint32_t off;                       // offset of packet in arena
+    uint32_t len;
+    uint64_t sent_us;
+};
+
+/**
+ * History of sent RTP packets of one SSRC, for answering NACKs
+ *
+ * Packets are kept in a fixed arena, written as a circular log, and looked
+ * up in a ring indexed by sequence number. Packets are evicted oldest first
+ * when older than the age bound, when their bytes are needed for a newer
+ * packet, or when their slot is. Memory is allocated once, at init.
+ */
+struct hist {
+    uint8_t *arena;
+    size_t size;                        // byte bound
+    size_t head;                        // next write offset
+    uint32_t max_age_us;                // time bound
+
+    struct hist_slot slots[HIST_SLOTS];
+    uint16_t oldest;                    // valid if count
+    uint16_t count;
+};
+
+/**
+ * Initialize empty history
+ *
+ * \param h History.
+ * \param bytes Bound on bytes of packets kept.
+ * \param age_ms Bound on age of packets kept (in milliseconds).
+ *
+ * \return 0 on success, negative on error.
+ */
+int hist_init(struct hist *h, size_t bytes, uint32_t age_ms);
+
+/**
+ * Reserve space for a packet about to be sent
+ *
+ * Sequence numbers are expected in send order. The caller writes the
+ * (unprotected) packet into the returned space, which stays valid until the
+ * next call to hist_store().
+ *
+ * \param h History.
+ * \param seq Sequence number.
+ * \param len Size of packet.
+ * \param now Send time (in microseconds).
+ *
+ * \return Space for packet, or NULL if larger than the byte bound.
+ */
+uint8_t *hist_store(struct hist *h, uint16_t seq, size_t len, uint64_t now);
+
+/**
+ * Look up packet for retransmission
+ *
+ * \param h History.
+ * \param seq Sequence number.
+ * \param[out] len Size of packet.
+ * \param now Current time (in microseconds).
+ *
+ * \return Packet, or NULL if not (or no longer) held.
+ */
+const uint8_t *hist_get(
+    struct hist *h,
+    uint16_t seq,
+    size_t *len,
+    uint64_t now
+);
+
+/**
+ * Free history resources
+ */
+void hist_free(struct hist *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_HIST_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,370 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Adaptive receive jitter buffer
+ *
+ * Packets are held in a ring indexed by sequence number. The oldest frame
+ * is released at its playout time if complete; otherwise it waits for a
+ * retransmission if one could plausibly arrive in time, and is given up on
+ * after that.
+ */
+
+#include <stdlib.h>                     // malloc, free
+#include <string.h>                     // memcpy, memset
+
+#include "err.h"
+#include "jbuf.h"
+#include "rtp.h"                        // rtp_header_read
+
+#define BASE_WINDOW_US             2000000  // transit minimum window
+
+static const struct {
+    uint32_t min_delay_us;              // bounds on target delay
+    uint32_t max_delay_us;
+    uint32_t max_wait_us;               // wait for repair beyond playout
+    uint32_t jitter_mult;               // target delay per unit of jitter
+    bool rtt_in_target;                 // reserve a nack round trip
+} profiles[] = {
+    [JBUF_PROFILE_LOW_LATENCY] = {     0,   30000,  20000, 3, false },
+    [JBUF_PROFILE_SMOOTH]      = { 60000, 1000000, 250000, 4, true  },
+};
+
+static struct jbuf_slot *slot(struct jbuf *j, uint16_t seq) {
+    return &j->slots[seq & (JBUF_SLOTS - 1)];
+}
+
+static uint32_t rtt(const struct jbuf *j) {
+    return j->rtt_us ? j->rtt_us : JBUF_DEFAULT_RTT_US;
+}
+
+/**
+ * Media time of timestamp (in microseconds), unwrapped around newest frame
+ */
+static int64_t media_us(const struct jbuf *j, uint32_t ts) {
+    return j->last_ts_us +
+        (int64_t)(int32_t)(ts - j->last_ts) * 1000000 / RTP_VIDEO_CLOCK_HZ;
+}
+
+/**
+ * Local time at which frame with timestamp is due for playout
+ */
+static uint64_t playout(const struct jbuf *j, uint32_t ts) {
+    return media_us(j, ts) + j->base + j->target_us;
+}
+
+/**
+ * Update jitter, clock mapping and target delay on first packet of a frame
+ */
+static void update_timing(struct jbuf *j, uint32_t ts, uint64_t now) {
+    int64_t transit, d;
+    uint32_t target;
+
+    if ((int32_t)(ts - j->last_ts) <= 0) return;
+
+    j->last_ts_us = media_us(j, ts);
+    j->last_ts = ts;
+
+    // interarrival jitter of frames, rather than of packets, since packets
+    // of one frame share a timestamp but are paced out [^RFC3550 6.4.1]
+    transit = (int64_t)now - j->last_ts_us;
+    d = transit - j->last_transit;
+    if (d < 0) d = -d;
+    j->jitter_us += (d - (int64_t)j->jitter_us) / 16;
+    j->last_transit = transit;
+
+    // fastest transit over the last two windows, following clock drift
+    if (transit < j->win_min) j->win_min = transit;
+    if (transit < j->base) j->base = transit;
+    if (now - j->win_start >= BASE_WINDOW_US) {
+        j->base = j->win_min;
+        j->win_min = transit;
+        j->win_start = now;
+    }
+
+    target = profiles[j->profile].jitter_mult * j->jitter_us;
+    if (profiles[j->profile].rtt_in_target) target += rtt(j);
+    if (target < profiles[j->profile].min_delay_us) {
+        target = profiles[j->profile].min_delay_us;
+    }
+    if (target > profiles[j->profile].max_delay_us) {
+        target = profiles[j->profile].max_delay_us;
+    }
+
+    // grow at once to avoid late frames, shrink gradually to avoid skips
+    if (target > j->target_us) {
+        j->target_us = target;
+    } else {
+        j->target_us -= (j->target_us - target) / 16;
+    }
+}
+
+/**
+ * Examine oldest frame
+ *
+ * \param j Jitter buffer, not empty.
+ * \param[out] ts Timestamp of oldest frame.
+ * \param[out] complete Whether all its packets are present.
+ * \param[out] detect When its earliest missing packet was found missing, or
+ *             0 if none were (e.g. its tail is still arriving).
+ */
+static void frame_scan(
+    struct jbuf *j,
+    uint32_t *ts,
+    bool *complete,
+    uint64_t *detect
+) {
+    bool have_ts = false;
+
+    *complete = true;
+    *detect = 0;
+
+    for (uint16_t q = j->head; q != j->end; q++) {
+        struct jbuf_slot *s = slot(j, q);
+
+        if (!s->len) {
+            *complete = false;
+            if (!*detect || s->detect_us < *detect) *detect = s->detect_us;
+            continue;
+        }
+
+        if (!have_ts) {
+            *ts = s->ts;
+            have_ts = true;
+        } else if (s->ts != *ts) {
+            return;                     // next frame began without a marker
+        }
+
+        if (s->marker) return;
+    }
+
+    *complete = false;
+}
+
+/**
+ * Release packets of oldest frame, skipping missing ones
+ */
+static void release(struct jbuf *j, uint32_t ts) {
+    while (j->head != j->end) {
+        struct jbuf_slot *s = slot(j, j->head);
+
+        if (!s->len) {
+            j->lost++;
+        } else if (s->ts != ts) {
+            return;
+        } else {
+            j->emit(s->pkt, s->len, j->arg);
+            s->len = 0;
+            if (s->marker) {
+                j->head++;
+                return;
+            }
+        }
+        j->head++;
+    }
+}
+
+/**
+ * Release everything held, e.g. when the stream restarts
+ */
+static void flush(struct jbuf *j) {
+    uint32_t ts;
+    uint64_t detect;
+    bool complete;
+
+    while (j->head != j->end) {
+        frame_scan(j, &ts, &complete, &detect);
+        release(j, ts);
+    }
+    j->started = false;
+}
+
+/**
+ * Request missing packets that are due (again)
+ *
+ * \return Time of next request, or 0 if none.
+ */
+static uint64_t send_nacks(struct jbuf *j, uint64_t now) {
+    uint16_t seqs[JBUF_SLOTS];
+    uint64_t next = 0, due;
+    size_t count = 0;
+
+    for (uint16_t q = j->head; q != j->end; q++) {
+        struct jbuf_slot *s = slot(j, q);
+
+        if (s->len || s->nacks >= JBUF_MAX_NACKS) continue;
+
+        // first request after a jitter's worth of reordering tolerance
+        due = s->nacks ? s->nack_us + rtt(j) : s->detect_us + j->jitter_us;
+        if (now >= due) {
+            seqs[count++] = q;
+            s->nack_us = now;
+            if (++s->nacks >= JBUF_MAX_NACKS) continue;
+            due = now + rtt(j);
+        }
+        if (!next || due < next) next = due;
+    }
+
+    if (count) j->nack(j->ssrc, seqs, count, j->arg);
+
+    return next;
+}
+
+int jbuf_init(
+    struct jbuf *j,
+    enum jbuf_profile profile,
+    jbuf_emit_fn *emit,
+    jbuf_nack_fn *nack,
+    void *arg
+) {
+    if (!j || !emit) return -URTC_ERR_BAD_ARGUMENT;
+    if (profile > JBUF_PROFILE_SMOOTH) return -URTC_ERR_BAD_ARGUMENT;
+
+    memset(j, 0, sizeof(*j));
+    j->profile = profile;
+    j->emit = emit;
+    j->nack = nack;
+    j->arg = arg;
+
+    return 0;
+}
+
+int jbuf_put(struct jbuf *j, const uint8_t *pkt, size_t n, uint64_t now) {
+    struct rtp_header h;
+    struct jbuf_slot *s;
+    int rv;
+
+    if (!j) return -URTC_ERR_BAD_ARGUMENT;
+    if (rv = rtp_header_read(pkt, n, &h), rv < 0) return rv;
+    if (n > JBUF_MAX_PACKET_SIZE) return -URTC_ERR_MALFORMED;
+
+    if (j->started && h.ssrc != j->ssrc) flush(j);
+
+    if (j->started) {
+        int16_t delta = h.seq - j->head;
+
+        if (delta < 0 && delta >= -JBUF_SLOTS) {
+            j->late++;
+            return 0;
+        }
+
+        // far outside the window: restarted stream, or a long outage
+        if (delta < 0 || delta >= JBUF_SLOTS) flush(j);
+    }
+
+    if (!j->started) {
+        j->started = true;
+        j->ssrc = h.ssrc;
+        j->head = j->end = h.seq;
+
+        j->last_ts = h.ts;
+        j->last_ts_us = 0;
+        j->last_transit = j->base = j->win_min = now;
+        j->win_start = now;
+        j->target_us = profiles[j->profile].min_delay_us;
+    }
+
+    s = slot(j, h.seq);
+    if (s->len) return 0;               // duplicate
+
+    // sequence numbers skipped are missing until they arrive
+    if ((int16_t)(h.seq - j->end) >= 0) {
+        for (uint16_t q = j->end; q != h.seq; q++) {
+            struct jbuf_slot *m = slot(j, q);
+            m->len = 0;
+            m->detect_us = now;
+            m->nacks = 0;
+        }
+        j->end = h.seq + 1;
+    }
+
+    if (!s->pkt && !(s->pkt = malloc(JBUF_MAX_PACKET_SIZE))) {
+        return -URTC_ERR_INSUFFICIENT_MEMORY;
+    }
+    memcpy(s->pkt, pkt, n);
+    s->len = n;
+    s->ts = h.ts;
+    s->marker = h.marker;
+
+    j->last_arrival_us = now;
+    update_timing(j, h.ts, now);
+
+    return 0;
+}
+
+uint64_t jbuf_poll(struct jbuf *j, uint64_t now) {
+    uint64_t next = 0, due, detect, repair, cap;
+    uint32_t ts;
+    bool complete;
+
+    if (!j || !j->started) return 0;
+
+    while (j->head != j->end) {
+        frame_scan(j, &ts, &complete, &detect);
+        due = playout(j, ts);
+
+        if (!complete) {
+            cap = due + profiles[j->profile].max_wait_us;
+            if (!detect) {
+                // tail still arriving, e.g. a large idr frame
+                repair = j->last_arrival_us + profiles[j->profile].max_wait_us;
+            } else {
+                // first request goes out a jitter after detection, and the
+                // retransmission takes a round trip plus its own jitter
+                repair = detect + rtt(j) + 3 * j->jitter_us;
+                if (repair > cap) repair = 0;   // could not arrive in time
+            }
+            if (repair > due) due = repair;
+        }
+
+        if (now < due) {
+            next = due;
+            break;
+        }
+
+        release(j, ts);
+    }
+
+    if (j->nack && (due = send_nacks(j, now)) && (!next || due < next)) {
+        next = due;
+    }
+
+    return next;
+}
+
+void jbuf_set_rtt(struct jbuf *j, uint32_t rtt_us) {
+    if (j) j->rtt_us = rtt_us;
+}
+
+void jbuf_free(struct jbuf *j) {
+    if (!j) return;
+    for (int i = 0; i < JBUF_SLOTS; i++) {
+        free(j->slots[i].pkt);
+        j->slots[i].pkt = NULL;
+    }
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
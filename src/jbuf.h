@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_JBUF_H
+#define _URTC_JBUF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JBUF_SLOTS                     256  // packets held, power of two
+#define JBUF_MAX_PACKET_SIZE          1500
+#define JBUF_MAX_NACKS                   3  // requests per missing packet
+#define JBUF_DEFAULT_RTT_US          50000  // until first measurement
+
+/**
+ * Playout delay policy
+ *
+ * Low latency targets under 50 ms of playout delay on a LAN (e.g. two-way
+ * intercom): its target delay follows jitter alone, and an incomplete frame
+ * waits for a retransmission only if one could arrive within the budget.
+ * Smooth reserves a NACK round trip in its target delay, so repairs usually
+ * arrive before playout, at the cost of latency (e.g. WAN viewers).
+ */
+enum jbuf_profile {
+    JBUF_PROFILE_LOW_LATENCY = 0,
+    JBUF_PROFILE_SMOOTH
+};
+
+/**
+ * (callback) Release one packet, in sequence number order
+ *
+ * Packets of frames given up on are released with gaps in their sequence
+ * numbers, for the depacketizer to detect.
+ */
+typedef void (jbuf_emit_fn)(const uint8_t *pkt, size_t n, void *arg);
+
+/**
+ * (callback) Request retransmission of missing packets [^RFC4585 6.2.1]
+ *
+ * \param ssrc Media source.
+ * \param seqs Sequence numbers, ascending.
+ * \param count Number of sequence numbers.
+ * \param arg User argument.
+ */
+typedef void (jbuf_nack_fn)(
+    uint32_t ssrc,
+    const uint16_t *seqs,
+    size_t count,
+    void *arg
+);
+
+struct jbuf_slot {
+    uint8_t *pkt;                       // allocated on first use
+    size_t len;                         // zero if missing
+    uint32_t ts;
+    bool marker;
+    uint64_t detect_us;                 // when found missing
+    uint64_t nack_us;                   // when last requested
+    uint8_t nacks;
+};
+
+/**
+ * Receive jitter buffer of one RTP stream
+ *
+ * Orders packets by sequence number and releases them a frame at a time, at
+ * the frame's playout time: its RTP timestamp mapped to local time via the
+ * fastest transit seen, plus a target delay adapted from interarrival
+ * jitter (and round trip time, per profile). A frame still incomplete at
+ * playout is held only as long as a NACK round trip can plausibly repair
+ * it, then released with gaps.
+ *
+ * Times are monotonic microseconds (see timer_now_us()), passed in.
+ */
+struct jbuf {
+    enum jbuf_profile profile;
+    struct jbuf_slot slots[JBUF_SLOTS];
+
+    bool started;
+    uint32_t ssrc;
+    uint16_t head;                      // next sequence number to release
+    uint16_t end;                       // one past highest received
+
+    // media clock to local clock mapping
+    uint32_t last_ts;                   // newest frame timestamp
+    int64_t last_ts_us;                 // same, unwrapped (in microseconds)
+    int64_t last_transit;               // arrival less media time, newest
+    int64_t base;                       // fastest transit seen
+    int64_t win_min;                    // fastest transit in this window
+    uint64_t win_start;
+
+    uint32_t jitter_us;                 // interarrival jitter [^RFC3550 6.4.1]
+    uint32_t target_us;                 // target playout delay
+    uint32_t rtt_us;
+    uint64_t last_arrival_us;
+
+    uint32_t late;                      // packets arriving after release
+    uint32_t lost;                      // packets given up on
+
+    jbuf_emit_fn *emit;
+    jbuf_nack_fn *nack;
+    void *arg;
+};
+
+/**
+ * Initialize empty jitter buffer
+ *
+ * \param j Jitter buffer.
+ * \param profile Playout delay policy.
+ * \param emit Packet release callback.
+ * \param nack Retransmission request callback, or NULL for none.
+ * \param arg Argument passed to callbacks.
+ *
+ * \return 0 on success, negative on error.
+ */
+int jbuf_init(
+    struct jbuf *j,
+    enum jbuf_profile profile,
+    jbuf_emit_fn *emit,
+    jbuf_nack_fn *nack,
+    void *arg
+);
+
+/**
+ * Insert received RTP packet (copied)
+ *
+ * \param j Jitter buffer.
+ * \param pkt Unprotected RTP packet.
+ * \param n Size of packet.
+ * \param now Arrival time.
+ *
+ * \return 0 on success, negative on error. Late packets are not an error.
+ */
+int jbuf_put(struct jbuf *j, const uint8_t *pkt, size_t n, uint64_t now);
+
+/**
+ * Release frames due for playout and request missing packets
+ *
+ * Call after each jbuf_put(), and when the returned deadline passes.
+ *
+ * \param j Jitter buffer.
+ * \param now Current time.
+ *
+ * \return Time of next deadline, or 0 if none.
+ */
+uint64_t jbuf_poll(struct jbuf *j, uint64_t now);
+
+/**
+ * Update round trip time estimate, e.g. from RTCP
+ */
+void jbuf_set_rtt(struct jbuf *j, uint32_t rtt_us);
+
+/**
+ * Free jitter buffer resources
+ */
+void jbuf_free(struct jbuf *j);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_JBUF_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
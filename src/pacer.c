@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Token bucket pacer with strict priority queues.
+ */
+
+#include "err.h"
+#include "pacer.h"
+
+/**
+ * Sending rate (in bytes per second), raised to drain a long backlog
+ */
+static double rate(const struct pacer *p) {
+    double r = p->target_bps * p->factor / 8;
+    double drain = p->queued * 1e6 / PACER_MAX_DELAY_US;
+
+    if (p->probe_left && p->probe_bps / 8.0 > r) r = p->probe_bps / 8.0;
+
+    return drain > r ? drain : r;
+}
+
+static void refill(struct pacer *p, uint64_t now) {
+    double r = rate(p);
+    double burst = r * PACER_BURST_US / 1e6;
+
+    if (burst < PACER_MIN_BURST) burst = PACER_MIN_BURST;
+    if (now > p->last_us) {
+        p->budget += r * (now - p->last_us) / 1e6;
+        if (p->budget > burst) p->budget = burst;
+    }
+    p->last_us = now;
+}
+
+/**
+ * Debt (in bytes) the horizon allows packets to be released against
+ */
+static double ahead(const struct pacer *p) {
+    return rate(p) * p->horizon_us / 1e6;
+}
+
+void pacer_init(struct pacer *p, uint32_t target_bps, double factor) {
+    p->target_bps = target_bps;
+    p->factor = factor;
+    p->budget = PACER_MIN_BURST;
+    p->last_us = 0;
+    p->queued = 0;
+    p->horizon_us = 0;
+    p->probe_bps = 0;
+    p->probe_left = 0;
+    for (int i = 0; i < PACER_PRIOS; i++) {
+        p->queues[i].head = 0;
+        p->queues[i].count = 0;
+    }
+}
+
+void pacer_set_rate(struct pacer *p, uint32_t target_bps, double factor) {
+    p->target_bps = target_bps;
+    p->factor = factor;
+}
+
+void pacer_set_horizon(struct pacer *p, uint32_t horizon_us) {
+    if (horizon_us > PACER_MAX_HORIZON_US) horizon_us = PACER_MAX_HORIZON_US;
+    p->horizon_us = horizon_us;
+}
+
+void pacer_probe(struct pacer *p, uint32_t bps, size_t bytes) {
+    p->probe_bps = bps;
+    p->probe_left = bytes;
+}
+
+int pacer_push(struct pacer *p, enum pacer_prio prio, uint16_t seq,
+    size_t len) {
+    struct pacer_queue *q;
+
+    if (!p || prio < 0 || prio >= PACER_PRIOS) return -URTC_ERR_BAD_ARGUMENT;
+
+    q = &p->queues[prio];
+    if (q->count == PACER_QUEUE_SIZE) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    q->entries[(q->head + q->count++) & (PACER_QUEUE_SIZE - 1)] =
+        (struct pacer_entry){ seq, len };
+    p->queued += len;
+
+    return 0;
+}
+
+int pacer_pop(struct pacer *p, uint64_t now, enum pacer_prio *prio,
+    uint16_t *seq, uint64_t *at) {
+    struct pacer_queue *q = NULL;
+    struct pacer_entry e;
+    uint64_t t = now;
+    int i;
+
+    for (i = 0; i < PACER_PRIOS && !q; i++) {
+        if (p->queues[i].count) q = &p->queues[i];
+    }
+    if (!q) return 0;
+
+    if (p->target_bps) {
+        refill(p, now);
+        if (p->budget + ahead(p) <= 0) return 0;
+        // in debt, departs once the debt is paid off
+        if (p->budget < 0) t += (uint64_t)(-p->budget * 1e6 / rate(p));
+    }
+
+    e = q->entries[q->head];
+    q->head = (q->head + 1) & (PACER_QUEUE_SIZE - 1);
+    q->count--;
+    p->queued -= e.len;
+    if (p->target_bps) p->budget -= e.len;
+    p->probe_left -= e.len < p->probe_left ? e.len : p->probe_left;
+
+    *prio = (enum pacer_prio)(i - 1);
+    *seq = e.seq;
+    if (at) *at = t;
+
+    return 1;
+}
+
+void pacer_charge(struct pacer *p, uint64_t now, size_t len) {
+    if (!p->target_bps) return;
+    refill(p, now);
+    p->budget -= len;
+}
+
+uint64_t pacer_next(struct pacer *p, uint64_t now) {
+    if (!p->queued) {
+        for (int i = 0; i < PACER_PRIOS; i++) {
+            if (p->queues[i].count) return now;
+        }
+        return 0;
+    }
+    if (!p->target_bps) return now;
+
+    refill(p, now);
+    if (p->budget + ahead(p) > 0) return now;
+
+    return now + (uint64_t)(-(p->budget + ahead(p)) * 1e6 / rate(p)) + 1;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_PACER_H
+#define _URTC_PACER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PACER_QUEUE_SIZE              1024  // packets per priority, pow. of 2
+#define PACER_BURST_US                5000  // budget accrued while idle
+#define PACER_MIN_BURST               1200  // bytes, at least one packet
+#define PACER_MAX_DELAY_US          500000  // queue drained faster beyond
+#define PACER_MAX_HORIZON_US         50000  // released ahead of departure
+
+/**
+ * Queues, highest priority first
+ */
+enum pacer_prio {
+    PACER_PRIO_AUDIO = 0,
+    PACER_PRIO_RTX,                     // retransmissions
+    PACER_PRIO_VIDEO,
+    PACER_PRIO_PADDING,                 // bandwidth probing
+    PACER_PRIOS // must be last
+};
+
+struct pacer_entry {
+    uint16_t seq;                       // identifies packet to owner
+    uint16_t len;
+};
+
+struct pacer_queue {
+    struct pacer_entry entries[PACER_QUEUE_SIZE];
+    unsigned int head;
+    unsigned int count;
+};
+
+/**
+ * Token bucket packet pacer
+ *
+ * Packets are queued by reference (a sequence number meaningful to the
+ * owner) and released at a multiple of the target bitrate, highest
+ * priority queue first. Budget accrued while idle is capped to a few
+ * milliseconds worth, so a frame following a pause goes out paced too.
+ * A backlog that would take longer than PACER_MAX_DELAY_US to send at the
+ * pacing rate is sent faster, at the rate that would clear it in that
+ * time.
+ *
+ * A probe releases the next packets faster, at a given bitrate, so the
+ * owner can measure what the path carries beyond the current target.
+ *
+ * With a horizon set, packets are released up to that far ahead of their
+ * departure time, which is returned with each, for the kernel to hold them
+ * until due (earliest departure time). The owner then wakes once per
+ * horizon rather than once per packet.
+ *
+ * Times are monotonic microseconds (see timer_now_us()), passed in.
+ */
+struct pacer {
+    uint32_t target_bps;                // 0 if unpaced
+    double factor;                      // pacing multiplier
+
+    double budget;                      // bytes, negative when in debt
+    uint64_t last_us;                   // budget last refilled
+    size_t queued;                      // bytes in queues
+    uint32_t horizon_us;                // release ahead, 0 to release when due
+    uint32_t probe_bps;                 // probing bitrate
+    size_t probe_left;                  // bytes still to probe, 0 if none
+
+    struct pacer_queue queues[PACER_PRIOS];
+};
+
+/**
+ * Initialize empty pacer
+ *
+ * \param p Pacer.
+ * \param target_bps Target bitrate (in bits per second), 0 if unpaced.
+ * \param factor Pacing multiplier over target bitrate.
+ */
+void pacer_init(struct pacer *p, uint32_t target_bps, double factor);
+
+/**
+ * Change target bitrate and pacing multiplier
+ */
+void pacer_set_rate(struct pacer *p, uint32_t target_bps, double factor);
+
+/**
+ * Release packets up to \a horizon_us ahead of their departure time
+ *
+ * \param p Pacer.
+ * \param horizon_us Horizon, at most PACER_MAX_HORIZON_US, or 0 to release
+ *        packets only once due.
+ */
+void pacer_set_horizon(struct pacer *p, uint32_t horizon_us);
+
+/**
+ * Release the next \a bytes at \a bps, if faster than the pacing rate
+ *
+ * Packets released while pacer->probe_left is nonzero belong to the probe.
+ *
+ * \param p Pacer.
+ * \param bps Probing bitrate (in bits per second).
+ * \param bytes Size of probe.
+ */
+void pacer_probe(struct pacer *p, uint32_t bps, size_t bytes);
+
+/**
+ * Queue packet
+ *
+ * \param p Pacer.
+ * \param prio Queue.
+ * \param seq Packet reference.
+ * \param len Size of packet on the wire.
+ *
+ * \return 0 on success, negative if queue is full.
+ */
+int pacer_push(struct pacer *p, enum pacer_prio prio, uint16_t seq,
+    size_t len);
+
+/**
+ * Dequeue packet, if one may be sent now
+ *
+ * \param p Pacer.
+ * \param now Current time.
+ * \param[out] prio Queue of packet.
+ * \param[out] seq Packet reference.
+ * \param[out] at Departure time, later than \a now only if a horizon is
+ *        set. May be NULL.
+ *
+ * \return 1 if a packet is to be sent, 0 if none is (yet).
+ */
+int pacer_pop(struct pacer *p, uint64_t now, enum pacer_prio *prio,
+    uint16_t *seq, uint64_t *at);
+
+/**
+ * Account for packet sent without being queued
+ */
+void pacer_charge(struct pacer *p, uint64_t now, size_t len);
+
+/**
+ * Time the next queued packet may be released
+ *
+ * \return Deadline, or 0 if queues are empty.
+ */
+uint64_t pacer_next(struct pacer *p, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_PACER_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
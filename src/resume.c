@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Fast-reconnect cache for returning remote peers.
+ *
+ * A process-wide table remembering, per remote certificate fingerprint, the
+ * remote address that last carried media and the DTLS session that was
+ * negotiated over it. When the same viewer reconnects within the window, the
+ * peer connection starts out sending to the remembered address and offers
+ * the session for an abbreviated DTLS handshake.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>                     // memcmp, memcpy, memset
+
+#include "err.h"
+#include "resume.h"
+
+static struct resume_entry cache[RESUME_MAX_ENTRIES];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const uint8_t zero[32];
+
+/**
+ * Current monotonic time (in seconds)
+ */
+static time_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static bool is_vacant(const struct resume_entry *e) {
+    return 0 == memcmp(e->fingerprint, zero, sizeof(zero));
+}
+
+/**
+ * Find entry by fingerprint. Lock must be held.
+ *
+ * \return Matching entry, or NULL if none.
+ */
+static struct resume_entry * find(const uint8_t fingerprint[32]) {
+    for (int i = 0; i < RESUME_MAX_ENTRIES; i++) {
+        if (0 == memcmp(cache[i].fingerprint, fingerprint, 32)) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+int resume_store(const struct resume_entry *entry) {
+    if (!entry) return -URTC_ERR_BAD_ARGUMENT;
+    if (is_vacant(entry)) return -URTC_ERR_BAD_ARGUMENT;
+    if (entry->ticket_len > RESUME_MAX_TICKET_SIZE) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    // reuse existing entry for peer, else a vacant one, else the oldest
+    struct resume_entry *e = find(entry->fingerprint);
+    if (!e) {
+        e = &cache[0];
+        for (int i = 0; i < RESUME_MAX_ENTRIES; i++) {
+            if (is_vacant(&cache[i])) {
+                e = &cache[i];
+                break;
+            }
+            if (cache[i].stamp < e->stamp) {
+                e = &cache[i];
+            }
+        }
+    }
+
+    memcpy(e, entry, sizeof(*e));
+    e->stamp = now();
+
+    pthread_mutex_unlock(&lock);
+
+    return 0;
+}
+
+int resume_lookup(
+    struct resume_entry *dst,
+    const uint8_t fingerprint[32],
+    unsigned int window
+) {
+    if (!dst) return -URTC_ERR_BAD_ARGUMENT;
+    if (!fingerprint) return -URTC_ERR_BAD_ARGUMENT;
+    if (0 == memcmp(fingerprint, zero, sizeof(zero))) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+
+    int rv = -URTC_ERR;
+
+    pthread_mutex_lock(&lock);
+
+    struct resume_entry *e = find(fingerprint);
+    if (e) {
+        if (now() - e->stamp < (time_t)window) {
+            memcpy(dst, e, sizeof(*dst));
+            rv = 0;
+        } else {
+            memset(e, 0, sizeof(*e));
+        }
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return rv;
+}
+
+void resume_forget(const uint8_t fingerprint[32]) {
+    if (!fingerprint) return;
+
+    pthread_mutex_lock(&lock);
+
+    struct resume_entry *e = find(fingerprint);
+    if (e) {
+        memset(e, 0, sizeof(*e));
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_RESUME_H
+#define _URTC_RESUME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <netinet/in.h>                 // struct sockaddr_in
+
+#define RESUME_MAX_ENTRIES              16  // remembered remote peers
+#define RESUME_MAX_TICKET_SIZE        1024  // serialized DTLS session
+#define RESUME_WINDOW_S                300  // default reconnect window
+
+/**
+ * Connection state remembered for a returning remote peer
+ *
+ * Entries are keyed by the SHA-256 certificate fingerprint the remote peer
+ * advertises in its session description. Resumption only helps peers that
+ * reuse their certificate across connections, e.g. clients that persist
+ * one, or pages that pass their own to RTCPeerConnection; browsers
+ * otherwise generate a new certificate per connection.
+ */
+struct resume_entry {
+    uint8_t fingerprint[32];            // remote certificate fingerprint
+
+    struct sockaddr_in remote;          // address that last carried media
+
+    // serialized DTLS session for abbreviated handshake
+    uint8_t ticket[RESUME_MAX_TICKET_SIZE];
+    size_t  ticket_len;
+
+    time_t stamp;                       // monotonic time of last store
+};
+
+/**
+ * Remember (or refresh) state for a remote peer
+ *
+ * If the cache is full, the least recently stored entry is evicted. The
+ * entry's stamp is set to the current time.
+ *
+ * \param entry Entry to copy into cache.
+ *
+ * \return 0 on success, negative on error.
+ */
+int resume_store(const struct resume_entry *entry);
+
+/**
+ * Look up state for a returning remote peer
+ *
+ * \param[out] dst Destination for copy of cached entry.
+ * \param[in] fingerprint SHA-256 fingerprint of remote certificate.
+ * \param[in] window Maximum age (in seconds) of a usable entry.
+ *
+ * \return 0 on hit, negative on miss or error. Expired entries are evicted.
+ */
+int resume_lookup(
+    struct resume_entry *dst,
+    const uint8_t fingerprint[32],
+    unsigned int window
+);
+
+/**
+ * Forget state for a remote peer
+ *
+ * Used when cached state proves stale (e.g. resumption is rejected).
+ *
+ * \param fingerprint SHA-256 fingerprint of remote certificate.
+ */
+void resume_forget(const uint8_t fingerprint[32]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_RESUME_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,712 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * RTP control protocol packets [^RFC3550 6] and feedback [^RFC4585]
+ */
+
+#include <string.h>                     // memcmp, memcpy, memset
+
+#include "err.h"
+#include "rtcp.h"
+
+// sequence number gaps taken as loss, or as misordering [^RFC3550 A.1]
+#define MAX_DROPOUT                   3000
+#define MAX_MISORDER                   100
+
+#define NTP_UNIX_OFFSET        2208988800u  // seconds from 1900 to 1970
+
+static uint32_t get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/**
+ * Write common header of a feedback packet [^RFC4585 6.1]
+ *
+ * \param len Size of whole packet (a multiple of four bytes).
+ */
+static void put_fb_header(
+    uint8_t *pkt,
+    uint8_t fmt,
+    uint8_t type,
+    size_t len,
+    uint32_t sender,
+    uint32_t media
+) {
+    pkt[0] = 0x80 | fmt;
+    pkt[1] = type;
+    pkt[2] = (len / 4 - 1) >> 8;
+    pkt[3] = (len / 4 - 1);
+    put32(pkt + 4, sender);
+    put32(pkt + 8, media);
+}
+
+int rtcp_next(const uint8_t **pkt, size_t *n, struct rtcp_packet *p) {
+    const uint8_t *q;
+    size_t len;
+
+    if (!pkt || !n || !p) return -URTC_ERR_BAD_ARGUMENT;
+    if (!*n) return 0;
+
+    q = *pkt;
+    if (*n < RTCP_HEADER_SIZE || 2 != q[0] >> 6) return -URTC_ERR_MALFORMED;
+
+    // length is in 32-bit words, less one
+    len = 4 * (((q[2] << 8) | q[3]) + 1);
+    if (len > *n) return -URTC_ERR_MALFORMED;
+
+    p->fmt = q[0] & 0x1f;
+    p->type = q[1];
+    p->body = q + RTCP_HEADER_SIZE;
+    p->len = len - RTCP_HEADER_SIZE;
+
+    // last octet of padding counts padding octets, itself included
+    if (q[0] & 0x20) {
+        if (!p->len || !q[len - 1] || q[len - 1] > p->len) {
+            return -URTC_ERR_MALFORMED;
+        }
+        p->len -= q[len - 1];
+    }
+
+    *pkt += len;
+    *n -= len;
+
+    return 1;
+}
+
+int rtcp_read_report(
+    const struct rtcp_packet *p,
+    uint32_t *sender,
+    struct rtcp_sender_info *si,
+    struct rtcp_report_block *rb,
+    size_t cap
+) {
+    const uint8_t *b;
+    size_t off = 4, count;
+
+    if (!p || !sender || (cap && !rb)) return -URTC_ERR_BAD_ARGUMENT;
+    if (RTCP_SR != p->type && RTCP_RR != p->type) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    if (RTCP_SR == p->type) off += 20;
+    if (p->len < off + 24 * p->fmt) return -URTC_ERR_MALFORMED;
+
+    b = p->body;
+    *sender = get32(b);
+    if (RTCP_SR == p->type && si) {
+        si->ntp = (uint64_t)get32(b + 4) << 32 | get32(b + 8);
+        si->rtp_ts = get32(b + 12);
+        si->packets = get32(b + 16);
+        si->octets = get32(b + 20);
+    }
+
+    // profile-specific extensions may follow, and are ignored
+    count = p->fmt < cap ? p->fmt : cap;
+    for (size_t i = 0; i < count; i++, off += 24) {
+        rb[i].ssrc = get32(b + off);
+        rb[i].fraction_lost = b[off + 4];
+        rb[i].lost = (int32_t)(get32(b + off + 4) << 8) >> 8;
+        rb[i].highest_seq = get32(b + off + 8);
+        rb[i].jitter = get32(b + off + 12);
+        rb[i].lsr = get32(b + off + 16);
+        rb[i].dlsr = get32(b + off + 20);
+    }
+
+    return (int)count;
+}
+
+int rtcp_read_nack(
+    const struct rtcp_packet *p,
+    uint32_t *media,
+    uint16_t *seqs,
+    size_t cap
+) {
+    size_t count = 0;
+
+    if (!p || !media || !seqs) return -URTC_ERR_BAD_ARGUMENT;
+    if (RTCP_RTPFB != p->type || RTCP_RTPFB_NACK != p->fmt) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    if (p->len < 12 || p->len % 4) return -URTC_ERR_MALFORMED;
+
+    *media = get32(p->body + 4);
+
+    for (size_t i = 8; i < p->len; i += 4) {
+        uint16_t pid = (p->body[i] << 8) | p->body[i + 1];
+        uint16_t blp = (p->body[i + 2] << 8) | p->body[i + 3];
+
+        if (count < cap) seqs[count++] = pid;
+        for (int b = 0; b < 16; b++) {
+            if ((blp >> b & 1) && count < cap) seqs[count++] = pid + b + 1;
+        }
+    }
+
+    return (int)count;
+}
+
+int rtcp_read_twcc(
+    const struct rtcp_packet *p,
+    uint32_t *media,
+    struct rtcp_twcc_status *st,
+    size_t cap
+) {
+    const uint8_t *b;
+    size_t i = 0, off = 16, count;
+    int64_t t;
+
+    if (!p || !media || !st) return -URTC_ERR_BAD_ARGUMENT;
+    if (RTCP_RTPFB != p->type || RTCP_RTPFB_TWCC != p->fmt) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    if (p->len < 16) return -URTC_ERR_MALFORMED;
+
+    b = p->body;
+    *media = get32(b + 4);
+    count = (b[10] << 8) | b[11];
+    if (count > cap) count = cap;
+
+    // reference time is signed, in multiples of 64 ms
+    t = (int32_t)((uint32_t)get32(b + 12) & 0xffffff00) >> 8;
+    t *= 64000;
+
+    // packet status chunks: symbols are parked in arrival_us until the
+    // receive deltas that follow are read
+    for (size_t n = 0, total = (b[10] << 8) | b[11]; n < total; off += 2) {
+        uint16_t c;
+        if (off + 2 > p->len) return -URTC_ERR_MALFORMED;
+        c = (b[off] << 8) | b[off + 1];
+
+        if (!(c & 0x8000)) {
+            // run length chunk
+            for (size_t r = c & 0x1fff; r && n < total; r--, n++) {
+                if (n < count) st[n].arrival_us = c >> 13 & 3;
+            }
+        } else if (!(c & 0x4000)) {
+            // status vector chunk, one bit symbols
+            for (int s = 13; s >= 0 && n < total; s--, n++) {
+                if (n < count) st[n].arrival_us = c >> s & 1;
+            }
+        } else {
+            // status vector chunk, two bit symbols
+            for (int s = 12; s >= 0 && n < total; s -= 2, n++) {
+                if (n < count) st[n].arrival_us = c >> s & 3;
+            }
+        }
+    }
+
+    // receive deltas, in multiples of 250 us, one byte if small
+    for (i = 0; i < count; i++) {
+        int64_t sym = st[i].arrival_us;
+
+        st[i].seq = ((b[8] << 8) | b[9]) + i;
+        st[i].received = 1 == sym || 2 == sym;
+        if (1 == sym) {
+            if (off + 1 > p->len) return -URTC_ERR_MALFORMED;
+            t += 250 * b[off];
+            off += 1;
+        } else if (2 == sym) {
+            if (off + 2 > p->len) return -URTC_ERR_MALFORMED;
+            t += 250 * (int16_t)((b[off] << 8) | b[off + 1]);
+            off += 2;
+        }
+        st[i].arrival_us = st[i].received ? t : 0;
+    }
+
+    return (int)count;
+}
+
+int rtcp_read_remb(const struct rtcp_packet *p, uint64_t *bps) {
+    const uint8_t *b;
+    size_t count;
+
+    if (!p || !bps) return -URTC_ERR_BAD_ARGUMENT;
+    if (RTCP_PSFB != p->type || RTCP_PSFB_AFB != p->fmt) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    b = p->body;
+    if (p->len < 16 || memcmp(b + 8, "REMB", 4)) return -URTC_ERR_MALFORMED;
+
+    count = b[12];
+    if (p->len < 16 + 4 * count) return -URTC_ERR_MALFORMED;
+
+    // 6-bit exponent, 18-bit mantissa
+    *bps = (uint64_t)(((b[13] & 0x03) << 16) | (b[14] << 8) | b[15]) <<
+        (b[13] >> 2);
+
+    return (int)count;
+}
+
+int rtcp_read_pli(const struct rtcp_packet *p, uint32_t *media) {
+    if (!p || !media) return -URTC_ERR_BAD_ARGUMENT;
+    if (RTCP_PSFB != p->type || RTCP_PSFB_PLI != p->fmt) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    if (p->len < 8) return -URTC_ERR_MALFORMED;
+
+    *media = get32(p->body + 4);
+
+    return 0;
+}
+
+int rtcp_read_fir(const struct rtcp_packet *p, uint32_t media, uint8_t *seq) {
+    if (!p || !seq) return -URTC_ERR_BAD_ARGUMENT;
+    if (RTCP_PSFB != p->type || RTCP_PSFB_FIR != p->fmt) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    if (p->len < 8 || (p->len - 8) % 8) return -URTC_ERR_MALFORMED;
+
+    // media source of header is unused; each entry names its own
+    for (size_t off = 8; off < p->len; off += 8) {
+        if (get32(p->body + off) == media) {
+            *seq = p->body[off + 4];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int rtcp_write_nack(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    uint32_t media,
+    const uint16_t *seqs,
+    size_t count
+) {
+    size_t len = 12;
+
+    if (!pkt || !seqs || !count || cap < 12) return -URTC_ERR_BAD_ARGUMENT;
+
+    for (size_t i = 0; i < count; ) {
+        uint16_t pid = seqs[i++], blp = 0;
+
+        // following lost packets, as a bitmask relative to pid
+        while (i < count && (uint16_t)(seqs[i] - pid - 1) < 16) {
+            blp |= 1 << (uint16_t)(seqs[i] - pid - 1);
+            i++;
+        }
+
+        if (len + 4 > cap) return -URTC_ERR_BAD_ARGUMENT;
+        pkt[len++] = pid >> 8;
+        pkt[len++] = pid;
+        pkt[len++] = blp >> 8;
+        pkt[len++] = blp;
+    }
+
+    put_fb_header(pkt, RTCP_RTPFB_NACK, RTCP_RTPFB, len, sender, media);
+
+    return (int)len;
+}
+
+/**
+ * Floor of time over 250 us, the resolution of transport-wide feedback
+ */
+static int64_t twcc_ticks(int64_t us) {
+    return us >= 0 ? us / 250 : -((-us + 249) / 250);
+}
+
+/**
+ * Write packet status chunks [^TWCC 3.1.1]
+ *
+ * Long runs of one symbol are run length encoded, otherwise symbols are
+ * packed 14 (one bit each) or, if any packet needs a large delta, 7 (two
+ * bits each) to a chunk.
+ *
+ * \param dst Destination, or NULL to only measure.
+ * \param sym Status symbols: 0 not received, 1 small delta, 2 large delta.
+ * \param n Number of symbols.
+ *
+ * \return Size of chunks.
+ */
+static size_t twcc_chunks(uint8_t *dst, const uint8_t *sym, size_t n) {
+    size_t len = 0;
+
+    for (size_t i = 0; i < n; len += 2) {
+        size_t run = 1, k = n - i < 14 ? n - i : 14;
+        bool small = true;
+        uint16_t c;
+
+        while (i + run < n && run < 0x1fff && sym[i + run] == sym[i]) run++;
+        for (size_t j = 0; j < k; j++) small = small && sym[i + j] < 2;
+
+        if (run >= 14 || run == n - i || (run >= 7 && !small)) {
+            c = sym[i] << 13 | run;
+            i += run;
+        } else if (small) {
+            c = 0x8000;
+            for (size_t j = 0; j < k; j++) c |= sym[i + j] << (13 - j);
+            i += k;
+        } else {
+            k = n - i < 7 ? n - i : 7;
+            c = 0xc000;
+            for (size_t j = 0; j < k; j++) c |= sym[i + j] << (12 - 2 * j);
+            i += k;
+        }
+
+        if (dst) {
+            dst[len] = c >> 8;
+            dst[len + 1] = c;
+        }
+    }
+
+    return len;
+}
+
+int rtcp_write_twcc(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    uint32_t media,
+    uint8_t fb_count,
+    const struct rtcp_twcc_status *st,
+    size_t *count
+) {
+    uint8_t sym[RTCP_TWCC_MAX_STATUSES];
+    int64_t ref = 0, prev;
+    size_t n, i, len, deltas;
+
+    if (!pkt || !st || !count || !*count || cap < 24) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    n = *count < RTCP_TWCC_MAX_STATUSES ? *count : RTCP_TWCC_MAX_STATUSES;
+
+    // reference time, in multiples of 64 ms, is that of the first arrival
+    for (i = 0; i < n; i++) {
+        if (st[i].received) {
+            ref = twcc_ticks(st[i].arrival_us);
+            ref = ref >= 0 ? ref / 256 : -((-ref + 255) / 256);
+            break;
+        }
+    }
+
+    // symbols, stopping short of a delta too large to write
+    prev = ref * 256;
+    for (i = 0; i < n; i++) {
+        int64_t d;
+        sym[i] = 0;
+        if (!st[i].received) continue;
+        d = twcc_ticks(st[i].arrival_us) - prev;
+        if (d < INT16_MIN || d > INT16_MAX) break;
+        sym[i] = (d >= 0 && d <= 255) ? 1 : 2;
+        prev += d;
+    }
+    n = i;
+
+    // fewer statuses until packet (padded to 32 bits) fits
+    for (;;) {
+        deltas = 0;
+        for (i = 0; i < n; i++) deltas += sym[i];
+        len = (20 + twcc_chunks(NULL, sym, n) + deltas + 3) & ~3;
+        if (len <= cap || n <= 1) break;
+        n -= (n + 7) / 8;
+    }
+    if (len > cap) return -URTC_ERR_BAD_ARGUMENT;
+
+    pkt[12] = st[0].seq >> 8;
+    pkt[13] = st[0].seq;
+    pkt[14] = n >> 8;
+    pkt[15] = n;
+    pkt[16] = ref >> 16;
+    pkt[17] = ref >> 8;
+    pkt[18] = ref;
+    pkt[19] = fb_count;
+
+    i = 20 + twcc_chunks(pkt + 20, sym, n);
+    prev = ref * 256;
+    for (size_t j = 0; j < n; j++) {
+        int64_t d;
+        if (!sym[j]) continue;
+        d = twcc_ticks(st[j].arrival_us) - prev;
+        prev += d;
+        if (2 == sym[j]) pkt[i++] = (uint16_t)d >> 8;
+        pkt[i++] = d;
+    }
+    while (i < len) pkt[i++] = 0;
+
+    put_fb_header(pkt, RTCP_RTPFB_TWCC, RTCP_RTPFB, len, sender, media);
+    *count = n;
+
+    return (int)len;
+}
+
+int rtcp_write_remb(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    uint64_t bps,
+    const uint32_t *ssrcs,
+    size_t count
+) {
+    size_t len = 20 + 4 * count;
+    uint8_t exp = 0;
+
+    if (!pkt || (count && !ssrcs) || count > 255 || len > cap) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+
+    // 6-bit exponent, 18-bit mantissa
+    while (bps >> exp > 0x3ffff) exp++;
+
+    put_fb_header(pkt, RTCP_PSFB_AFB, RTCP_PSFB, len, sender, 0);
+    memcpy(pkt + 12, "REMB", 4);
+    pkt[16] = count;
+    pkt[17] = exp << 2 | (bps >> exp >> 16 & 0x03);
+    pkt[18] = bps >> exp >> 8;
+    pkt[19] = bps >> exp;
+    for (size_t i = 0; i < count; i++) put32(pkt + 20 + 4 * i, ssrcs[i]);
+
+    return (int)len;
+}
+
+int rtcp_write_report(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    const struct rtcp_sender_info *si,
+    const struct rtcp_report_block *rb,
+    size_t count
+) {
+    size_t len = 8 + (si ? 20 : 0) + 24 * count, off = 8;
+
+    if (!pkt || (count && !rb) || count > RTCP_MAX_REPORT_BLOCKS ||
+            len > cap) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+
+    pkt[0] = 0x80 | count;
+    pkt[1] = si ? RTCP_SR : RTCP_RR;
+    pkt[2] = (len / 4 - 1) >> 8;
+    pkt[3] = (len / 4 - 1);
+    put32(pkt + 4, sender);
+    if (si) {
+        put32(pkt + 8, si->ntp >> 32);
+        put32(pkt + 12, si->ntp);
+        put32(pkt + 16, si->rtp_ts);
+        put32(pkt + 20, si->packets);
+        put32(pkt + 24, si->octets);
+        off += 20;
+    }
+
+    for (size_t i = 0; i < count; i++, off += 24) {
+        // cumulative loss saturates at 24 bits signed
+        int32_t lost = rb[i].lost;
+        if (lost > 0x7fffff) lost = 0x7fffff;
+        if (lost < -0x800000) lost = -0x800000;
+
+        put32(pkt + off, rb[i].ssrc);
+        put32(pkt + off + 4,
+            (uint32_t)rb[i].fraction_lost << 24 | (lost & 0xffffff));
+        put32(pkt + off + 8, rb[i].highest_seq);
+        put32(pkt + off + 12, rb[i].jitter);
+        put32(pkt + off + 16, rb[i].lsr);
+        put32(pkt + off + 20, rb[i].dlsr);
+    }
+
+    return (int)len;
+}
+
+int rtcp_write_sdes(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t ssrc,
+    const char *cname
+) {
+    size_t n, len;
+
+    if (!pkt || !cname || (n = strlen(cname)) > 255) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+
+    // one chunk: item, then at least one null octet to end the item list
+    len = (8 + 2 + n + 1 + 3) & ~(size_t)3;
+    if (len > cap) return -URTC_ERR_BAD_ARGUMENT;
+
+    pkt[0] = 0x80 | 1;
+    pkt[1] = RTCP_SDES;
+    pkt[2] = (len / 4 - 1) >> 8;
+    pkt[3] = (len / 4 - 1);
+    put32(pkt + 4, ssrc);
+    pkt[8] = 1;                         // cname
+    pkt[9] = n;
+    memcpy(pkt + 10, cname, n);
+    memset(pkt + 10 + n, 0, len - 10 - n);
+
+    return (int)len;
+}
+
+void rtcp_rx_update(
+    struct rtcp_rx_stats *s,
+    uint32_t ssrc,
+    uint16_t seq,
+    uint32_t ts,
+    uint32_t arrival
+) {
+    uint16_t delta;
+    int32_t transit, d;
+
+    if (!s) return;
+
+    transit = (int32_t)(arrival - ts);
+
+    if (!s->started || ssrc != s->ssrc) {
+        *s = (struct rtcp_rx_stats){
+            .started = true,
+            .ssrc = ssrc,
+            .max_seq = seq,
+            .base_seq = seq,
+            .received = 1,
+            .transit = transit
+        };
+        return;
+    }
+
+    delta = seq - s->max_seq;
+    if (delta < MAX_DROPOUT) {
+        // in order, with permissible gap
+        if (seq < s->max_seq) s->cycles += 1 << 16;
+        s->max_seq = seq;
+    } else if (delta <= 65535 - MAX_MISORDER) {
+        // sender restarted, keeping the last report's source description
+        uint32_t lsr = s->lsr;
+        uint64_t lsr_us = s->lsr_us;
+        s->started = false;
+        rtcp_rx_update(s, ssrc, seq, ts, arrival);
+        s->lsr = lsr;
+        s->lsr_us = lsr_us;
+        return;
+    }
+    s->received++;
+
+    // interarrival jitter, in 1/16 units [^RFC3550 A.8]
+    d = transit - s->transit;
+    s->transit = transit;
+    if (d < 0) d = -d;
+    s->jitter += d - ((s->jitter + 8) >> 4);
+}
+
+void rtcp_rx_sr(struct rtcp_rx_stats *s, uint64_t ntp, uint64_t now) {
+    if (!s) return;
+
+    s->lsr = ntp >> 16;
+    s->lsr_us = now;
+}
+
+int rtcp_rx_block(
+    struct rtcp_rx_stats *s,
+    uint64_t now,
+    struct rtcp_report_block *rb
+) {
+    uint32_t ext, expected, interval, received;
+    int32_t lost;
+
+    if (!s || !rb) return -URTC_ERR_BAD_ARGUMENT;
+    if (!s->started) return -URTC_ERR;
+
+    ext = s->cycles + s->max_seq;
+    expected = ext - s->base_seq + 1;
+
+    interval = expected - s->expected_prior;
+    received = s->received - s->received_prior;
+    s->expected_prior = expected;
+    s->received_prior = s->received;
+    lost = (int32_t)(interval - received);
+
+    *rb = (struct rtcp_report_block){
+        .ssrc = s->ssrc,
+        .fraction_lost = interval && lost > 0 ?
+            ((uint64_t)lost << 8) / interval : 0,
+        .lost = (int32_t)(expected - s->received),
+        .highest_seq = ext,
+        .jitter = s->jitter >> 4,
+        .lsr = s->lsr,
+        .dlsr = s->lsr ? (now - s->lsr_us) * 65536 / 1000000 : 0
+    };
+
+    return 0;
+}
+
+uint64_t rtcp_ntp(uint64_t unix_us) {
+    uint64_t sec = unix_us / 1000000 + NTP_UNIX_OFFSET;
+
+    return sec << 32 | ((unix_us % 1000000) << 32) / 1000000;
+}
+
+uint32_t rtcp_rtt_us(const struct rtcp_report_block *rb, uint64_t ntp) {
+    uint32_t rtt;
+
+    if (!rb || !rb->lsr) return 0;
+
+    // in 1/65536 s; clocks are not synchronized, only differences matter
+    rtt = (uint32_t)(ntp >> 16) - rb->lsr - rb->dlsr;
+    if (rtt & 0x80000000) return 0;
+
+    return (uint64_t)rtt * 1000000 / 65536;
+}
+
+uint64_t rtcp_interval_us(
+    uint32_t bps,
+    double avg_size,
+    int members,
+    int senders,
+    bool we_sent,
+    bool initial,
+    double r
+) {
+    double bw = RTCP_BANDWIDTH_SHARE * bps / 8;     // bytes per second
+    double tmin = RTCP_MIN_INTERVAL_US / 1e6, t;
+    int n = members;
+
+    if (bps && 360e3 / bps < tmin) tmin = 360e3 / bps;
+    if (initial) tmin /= 2;
+
+    // senders share a quarter, if few
+    if (senders <= members * 0.25) {
+        if (we_sent) {
+            bw *= 0.25;
+            n = senders;
+        } else {
+            bw *= 0.75;
+            n -= senders;
+        }
+    }
+
+    t = bw > 0 ? avg_size * n / bw : 0;
+    if (t < tmin) t = tmin;
+
+    // randomized over [0.5, 1.5] times; with two participants, timer
+    // reconsideration (and its compensation) changes nothing
+    return t * (r + 0.5) * 1e6;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
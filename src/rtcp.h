@@ -0,0 +1,430 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_RTCP_H
+#define _URTC_RTCP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RTCP_HEADER_SIZE                 4
+#define RTCP_MAX_PACKET_SIZE          1200
+
+#define RTCP_MIN_INTERVAL_US       5000000  // between reports [^RFC3550 6.2]
+#define RTCP_BANDWIDTH_SHARE          0.05  // of session bandwidth for rtcp
+#define RTCP_MAX_REPORT_BLOCKS          31
+
+// packet types
+#define RTCP_SR                        200  // sender report
+#define RTCP_RR                        201  // receiver report
+#define RTCP_SDES                      202  // source description
+#define RTCP_RTPFB                     205  // transport layer feedback
+#define RTCP_PSFB                      206  // payload-specific feedback
+
+// feedback message types [^RFC4585 6.1]
+#define RTCP_RTPFB_NACK                  1
+#define RTCP_RTPFB_TWCC                 15  // transport-wide cc feedback
+#define RTCP_PSFB_PLI                    1  // picture loss indication
+#define RTCP_PSFB_FIR                    4  // full intra request
+#define RTCP_PSFB_AFB                   15  // application layer feedback
+
+#define RTCP_TWCC_MAX_STATUSES        1024  // packets per transport-wide fb.
+
+/**
+ * One packet of a compound RTCP packet
+ */
+struct rtcp_packet {
+    uint8_t fmt;                        // report count, or feedback type
+    uint8_t type;
+    const uint8_t *body;                // after the common header
+    size_t len;                         // of body, excluding padding
+};
+
+/**
+ * Read next packet of compound RTCP packet [^RFC3550 6.4]
+ *
+ * \param[in,out] pkt Position in compound packet, advanced past packet.
+ * \param[in,out] n Bytes remaining in compound packet.
+ * \param[out] p Packet read.
+ *
+ * \return 1 if a packet was read, 0 at end, negative if malformed.
+ */
+int rtcp_next(const uint8_t **pkt, size_t *n, struct rtcp_packet *p);
+
+/**
+ * Sender information of a sender report [^RFC3550 6.4.1]
+ */
+struct rtcp_sender_info {
+    uint64_t ntp;                       // wallclock, 32.32 fixed point
+    uint32_t rtp_ts;                    // same instant, media clock
+    uint32_t packets;                   // sent since starting
+    uint32_t octets;                    // of payload, sent since starting
+};
+
+/**
+ * Reception of one media source, as reported [^RFC3550 6.4.1]
+ */
+struct rtcp_report_block {
+    uint32_t ssrc;                      // media source reported on
+    uint8_t fraction_lost;              // since last report (in 1/256)
+    int32_t lost;                       // cumulative, 24 bits signed
+    uint32_t highest_seq;               // extended highest sequence number
+    uint32_t jitter;                    // interarrival, media clock units
+    uint32_t lsr;                       // middle 32 bits of last SR's ntp
+    uint32_t dlsr;                      // since last SR (in 1/65536 s)
+};
+
+/**
+ * Read sender or receiver report
+ *
+ * \param p Packet (RTCP_SR or RTCP_RR).
+ * \param[out] sender SSRC of packet sender.
+ * \param[out] si Sender information, if a sender report; may be NULL.
+ * \param[out] rb Report blocks.
+ * \param cap Capacity of \a rb; further blocks are ignored.
+ *
+ * \return Number of report blocks read, or negative if not a report or
+ *         malformed.
+ */
+int rtcp_read_report(
+    const struct rtcp_packet *p,
+    uint32_t *sender,
+    struct rtcp_sender_info *si,
+    struct rtcp_report_block *rb,
+    size_t cap
+);
+
+/**
+ * Read lost sequence numbers of Generic NACK [^RFC4585 6.2.1]
+ *
+ * \param p Packet (RTCP_RTPFB, RTCP_RTPFB_NACK).
+ * \param[out] media SSRC of media source.
+ * \param[out] seqs Lost sequence numbers, ascending.
+ * \param cap Capacity of \a seqs; further sequence numbers are ignored.
+ *
+ * \return Number of sequence numbers read, or negative if malformed.
+ */
+int rtcp_read_nack(
+    const struct rtcp_packet *p,
+    uint32_t *media,
+    uint16_t *seqs,
+    size_t cap
+);
+
+/**
+ * Reception of one packet reported by transport-wide feedback
+ */
+struct rtcp_twcc_status {
+    uint16_t seq;                       // transport-wide sequence number
+    bool received;
+    int64_t arrival_us;                 // on remote clock, if received
+};
+
+/**
+ * Read transport-wide congestion control feedback [^TWCC 3.1]
+ *
+ * [^TWCC]: draft-holmer-rmcat-transport-wide-cc-extensions-01
+ *
+ * \param p Packet (RTCP_RTPFB, RTCP_RTPFB_TWCC).
+ * \param[out] media SSRC of media source.
+ * \param[out] st Status of each packet, in sequence number order.
+ * \param cap Capacity of \a st; further packets are ignored.
+ *
+ * \return Number of statuses read, or negative if malformed.
+ */
+int rtcp_read_twcc(
+    const struct rtcp_packet *p,
+    uint32_t *media,
+    struct rtcp_twcc_status *st,
+    size_t cap
+);
+
+/**
+ * Read receiver estimated maximum bitrate [^REMB 2.2]
+ *
+ * [^REMB]: draft-alvestrand-rmcat-remb-03
+ *
+ * \param p Packet (RTCP_PSFB, RTCP_PSFB_AFB).
+ * \param[out] bps Estimated bitrate (in bits per second).
+ *
+ * \return Number of media sources the estimate applies to, or negative if
+ *         not a REMB packet or malformed.
+ */
+int rtcp_read_remb(const struct rtcp_packet *p, uint64_t *bps);
+
+/**
+ * Read picture loss indication [^RFC4585 6.3.1]
+ *
+ * \param p Packet (RTCP_PSFB, RTCP_PSFB_PLI).
+ * \param[out] media SSRC of media source that lost a picture.
+ *
+ * \return 0 on success, negative if not a PLI packet or malformed.
+ */
+int rtcp_read_pli(const struct rtcp_packet *p, uint32_t *media);
+
+/**
+ * Read full intra request addressed to a media source [^RFC5104 4.3.1]
+ *
+ * One request may address several media sources, each with its own command
+ * sequence number. Requests repeated with the same sequence number are
+ * retransmissions of one request, not new requests.
+ *
+ * \param p Packet (RTCP_PSFB, RTCP_PSFB_FIR).
+ * \param media SSRC of media source.
+ * \param[out] seq Command sequence number, if addressed.
+ *
+ * \return 1 if \a media is addressed, 0 if not, negative if not a FIR packet
+ *         or malformed.
+ */
+int rtcp_read_fir(const struct rtcp_packet *p, uint32_t media, uint8_t *seq);
+
+/**
+ * Write Generic NACK feedback packet [^RFC4585 6.2.1]
+ *
+ * Sequence numbers within 16 of each other share one FCI entry.
+ *
+ * \param pkt Destination.
+ * \param cap Capacity of destination.
+ * \param sender SSRC of packet sender.
+ * \param media SSRC of media source the packets are missing from.
+ * \param seqs Missing sequence numbers, ascending.
+ * \param count Number of sequence numbers.
+ *
+ * \return Size of packet, or negative on error (e.g. does not fit).
+ */
+int rtcp_write_nack(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    uint32_t media,
+    const uint16_t *seqs,
+    size_t count
+);
+
+/**
+ * Write transport-wide congestion control feedback packet [^TWCC 3.1]
+ *
+ * Statuses are of consecutive sequence numbers. Arrival times are kept to
+ * 250 us. As many statuses are reported as fit; the rest, if any, are left
+ * for the next packet. A status is also left over if its arrival is too far
+ * (more than about 8 s) from the previous one to be written as a delta.
+ *
+ * \param pkt Destination.
+ * \param cap Capacity of destination.
+ * \param sender SSRC of packet sender.
+ * \param media SSRC of a media source reported on.
+ * \param fb_count Feedback packet count, incremented with each packet.
+ * \param st Status of each packet, in sequence number order.
+ * \param[in,out] count Number of statuses; on return, number reported.
+ *
+ * \return Size of packet, or negative on error (e.g. does not fit).
+ */
+int rtcp_write_twcc(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    uint32_t media,
+    uint8_t fb_count,
+    const struct rtcp_twcc_status *st,
+    size_t *count
+);
+
+/**
+ * Write receiver estimated maximum bitrate packet [^REMB 2.2]
+ *
+ * \param pkt Destination.
+ * \param cap Capacity of destination.
+ * \param sender SSRC of packet sender.
+ * \param bps Estimated bitrate (in bits per second).
+ * \param ssrcs Media sources the estimate applies to.
+ * \param count Number of media sources (at most 255).
+ *
+ * \return Size of packet, or negative on error (e.g. does not fit).
+ */
+int rtcp_write_remb(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    uint64_t bps,
+    const uint32_t *ssrcs,
+    size_t count
+);
+
+/**
+ * Write sender or receiver report [^RFC3550 6.4]
+ *
+ * \param pkt Destination.
+ * \param cap Capacity of destination.
+ * \param sender SSRC of packet sender.
+ * \param si Sender information for a sender report, or NULL for a receiver
+ *        report.
+ * \param rb Report blocks.
+ * \param count Number of report blocks (at most RTCP_MAX_REPORT_BLOCKS).
+ *
+ * \return Size of packet, or negative on error (e.g. does not fit).
+ */
+int rtcp_write_report(
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    const struct rtcp_sender_info *si,
+    const struct rtcp_report_block *rb,
+    size_t count
+);
+
+/**
+ * Write source description with canonical name [^RFC3550 6.5.1]
+ *
+ * \param pkt Destination.
+ * \param cap Capacity of destination.
+ * \param ssrc SSRC of packet sender.
+ * \param cname Canonical name (at most 255 bytes).
+ *
+ * \return Size of packet, or negative on error (e.g. does not fit).
+ */
+int rtcp_write_sdes(uint8_t *pkt, size_t cap, uint32_t ssrc, const char *cname);
+
+/**
+ * Reception statistics of one media source [^RFC3550 A.1]
+ */
+struct rtcp_rx_stats {
+    bool started;
+    uint32_t ssrc;
+    uint16_t max_seq;                   // highest sequence number seen
+    uint32_t cycles;                    // of sequence number, shifted
+    uint32_t base_seq;
+    uint32_t received;
+    uint32_t expected_prior;            // at last report
+    uint32_t received_prior;            // at last report
+    int32_t transit;                    // of last packet, media clock
+    uint32_t jitter;                    // in 1/16 media clock units
+    uint32_t lsr;                       // middle 32 bits of last SR's ntp
+    uint64_t lsr_us;                    // and when it arrived, local clock
+};
+
+/**
+ * Account for arrival of one packet
+ *
+ * A new SSRC, or a jump in sequence numbers too large to be loss, restarts
+ * the statistics.
+ *
+ * \param s Statistics.
+ * \param ssrc SSRC of packet.
+ * \param seq Sequence number of packet.
+ * \param ts Timestamp of packet.
+ * \param arrival Arrival time, in media clock units.
+ */
+void rtcp_rx_update(
+    struct rtcp_rx_stats *s,
+    uint32_t ssrc,
+    uint16_t seq,
+    uint32_t ts,
+    uint32_t arrival
+);
+
+/**
+ * Account for arrival of a sender report from the media source
+ *
+ * \param s Statistics.
+ * \param ntp Wallclock of sender report.
+ * \param now Arrival time (in microseconds), local clock.
+ */
+void rtcp_rx_sr(struct rtcp_rx_stats *s, uint64_t ntp, uint64_t now);
+
+/**
+ * Fill report block, starting a new loss interval [^RFC3550 A.3]
+ *
+ * \param s Statistics.
+ * \param now Current time (in microseconds), local clock.
+ * \param[out] rb Report block.
+ *
+ * \return 0 on success, negative if nothing was received.
+ */
+int rtcp_rx_block(
+    struct rtcp_rx_stats *s,
+    uint64_t now,
+    struct rtcp_report_block *rb
+);
+
+/**
+ * Convert wallclock time to NTP format (32.32 fixed point)
+ *
+ * \param unix_us Microseconds since the Unix epoch.
+ */
+uint64_t rtcp_ntp(uint64_t unix_us);
+
+/**
+ * Round trip time from a report block on a stream sent [^RFC3550 6.4.1]
+ *
+ * \param rb Report block, echoing a sender report of ours.
+ * \param ntp Arrival time of report block, in NTP format.
+ *
+ * \return Round trip time (in microseconds), or 0 if unknown.
+ */
+uint32_t rtcp_rtt_us(const struct rtcp_report_block *rb, uint64_t ntp);
+
+/**
+ * Time until the next report [^RFC3550 6.3.1, A.7]
+ *
+ * Reports take RTCP_BANDWIDTH_SHARE of the session bandwidth, a quarter of
+ * that shared by senders, but go no longer than RTCP_MIN_INTERVAL_US apart.
+ * At high bitrates, the reduced minimum of 360 s over the bandwidth in kbps
+ * applies instead [^RFC3550 6.2]. The result is randomized, so that reports
+ * of many participants do not synchronize.
+ *
+ * \param bps Session bandwidth (in bits per second), or 0 if unknown.
+ * \param avg_size Average size of compound packets sent, with UDP and IP
+ *        headers (in bytes).
+ * \param members Number of participants.
+ * \param senders Number of participants sending media.
+ * \param we_sent Whether we sent media since the last report.
+ * \param initial Whether no report has been sent yet.
+ * \param r Random number, uniform in [0, 1).
+ *
+ * \return Interval (in microseconds).
+ */
+uint64_t rtcp_interval_us(
+    uint32_t bps,
+    double avg_size,
+    int members,
+    int senders,
+    bool we_sent,
+    bool initial,
+    double r
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_RTCP_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
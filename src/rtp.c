@@ -0,0 +1,288 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>                     // malloc, free
+#include <string.h>                     // memcpy, memmove
+
+#include "err.h"
+#include "rtp.h"
+
+struct rtp_payload *rtp_payload_new(void) {
+    struct rtp_payload *p = malloc(sizeof(*p));
+    if (!p) return NULL;
+
+    p->refs = 1;
+    p->marker = false;
+    p->len = 0;
+    p->iovcnt = 0;
+    p->hdr_len = 0;
+
+    return p;
+}
+
+int rtp_payload_append(struct rtp_payload *p, const uint8_t *data, size_t n) {
+    if (p->iovcnt == RTP_MAX_IOV) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    p->iov[p->iovcnt].iov_base = (void *)data;
+    p->iov[p->iovcnt].iov_len  = n;
+    p->iovcnt++;
+    p->len += n;
+
+    return 0;
+}
+
+int rtp_payload_append_hdr(
+    struct rtp_payload *p,
+    const uint8_t *data,
+    size_t n
+) {
+    uint8_t *dst = p->hdr + p->hdr_len;
+
+    if (p->hdr_len + n > sizeof(p->hdr)) return -URTC_ERR_INSUFFICIENT_MEMORY;
+    if (rtp_payload_append(p, dst, n) < 0) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    memcpy(dst, data, n);
+    p->hdr_len += n;
+
+    return 0;
+}
+
+size_t rtp_payload_copy(const struct rtp_payload *p, uint8_t *dst) {
+    for (int i = 0; i < p->iovcnt; i++) {
+        memcpy(dst, p->iov[i].iov_base, p->iov[i].iov_len);
+        dst += p->iov[i].iov_len;
+    }
+    return p->len;
+}
+
+struct rtp_payload *rtp_payload_dup(const struct rtp_payload *p) {
+    // bytes follow the payload, in the same allocation
+    struct rtp_payload *d = malloc(sizeof(*d) + p->len);
+    if (!d) return NULL;
+
+    d->refs = 1;
+    d->marker = p->marker;
+    d->iov[0].iov_base = d + 1;
+    d->iov[0].iov_len = rtp_payload_copy(p, (uint8_t *)(d + 1));
+    d->iovcnt = 1;
+    d->len = p->len;
+    d->hdr_len = 0;
+
+    return d;
+}
+
+struct rtp_payload *rtp_payload_ref(struct rtp_payload *p) {
+    __atomic_add_fetch(&p->refs, 1, __ATOMIC_RELAXED);
+    return p;
+}
+
+void rtp_payload_unref(struct rtp_payload *p) {
+    if (!p) return;
+    if (0 == __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL)) free(p);
+}
+
+void rtp_header_write(
+    uint8_t *hdr,
+    uint8_t pt,
+    bool marker,
+    uint16_t seq,
+    uint32_t ts,
+    uint32_t ssrc
+) {
+    hdr[0]  = RTP_VERSION << 6;
+    hdr[1]  = (marker ? 0x80 : 0) | (pt & 0x7f);
+    hdr[2]  = seq >> 8;
+    hdr[3]  = seq;
+    hdr[4]  = ts >> 24;
+    hdr[5]  = ts >> 16;
+    hdr[6]  = ts >> 8;
+    hdr[7]  = ts;
+    hdr[8]  = ssrc >> 24;
+    hdr[9]  = ssrc >> 16;
+    hdr[10] = ssrc >> 8;
+    hdr[11] = ssrc;
+}
+
+int rtp_header_read(const uint8_t *pkt, size_t n, struct rtp_header *h) {
+    size_t off, pad = 0;
+
+    if (!pkt || !h) return -URTC_ERR_BAD_ARGUMENT;
+    if (n < RTP_HEADER_SIZE || RTP_VERSION != pkt[0] >> 6) {
+        return -URTC_ERR_MALFORMED;
+    }
+
+    off = RTP_HEADER_SIZE + 4 * (pkt[0] & 0x0f);
+    if (pkt[0] & 0x10) {
+        if (n < off + 4) return -URTC_ERR_MALFORMED;
+        off += 4 + 4 * ((pkt[off + 2] << 8) | pkt[off + 3]);
+    }
+    if (off > n) return -URTC_ERR_MALFORMED;
+
+    // last octet of padding counts padding octets, itself included
+    if (pkt[0] & 0x20) {
+        if (off == n || 0 == (pad = pkt[n - 1]) || pad > n - off) {
+            return -URTC_ERR_MALFORMED;
+        }
+    }
+
+    h->marker = pkt[1] >> 7;
+    h->pt = pkt[1] & 0x7f;
+    h->seq = (pkt[2] << 8) | pkt[3];
+    h->ts = ((uint32_t)pkt[4] << 24) | (pkt[5] << 16) | (pkt[6] << 8) | pkt[7];
+    h->ssrc = ((uint32_t)pkt[8] << 24) | (pkt[9] << 16) | (pkt[10] << 8) |
+        pkt[11];
+    h->payload = off;
+    h->payload_len = n - off - pad;
+
+    return 0;
+}
+
+size_t rtp_twcc_write(uint8_t *hdr, size_t hdr_len, uint8_t id, uint16_t seq) {
+    uint8_t *ext = hdr + hdr_len;
+
+    hdr[0] |= 0x10;
+    ext[0] = 0xbe;                      // one-byte header profile
+    ext[1] = 0xde;
+    ext[2] = 0;
+    ext[3] = 1;                         // length, in 32-bit words
+    ext[4] = (id << 4) | 1;             // two bytes of data
+    ext[5] = seq >> 8;
+    ext[6] = seq;
+    ext[7] = 0;                         // padding
+
+    return hdr_len + RTP_TWCC_EXT_SIZE;
+}
+
+int rtp_twcc_read(const uint8_t *pkt, size_t n, uint8_t id, uint16_t *seq) {
+    size_t off, end;
+    uint16_t profile;
+
+    if (!pkt || !seq) return -URTC_ERR_BAD_ARGUMENT;
+    if (n < RTP_HEADER_SIZE || !(pkt[0] & 0x10)) return -URTC_ERR;
+
+    off = RTP_HEADER_SIZE + 4 * (pkt[0] & 0x0f);
+    if (n < off + 4) return -URTC_ERR_MALFORMED;
+    profile = (pkt[off] << 8) | pkt[off + 1];
+    end = off + 4 + 4 * ((pkt[off + 2] << 8) | pkt[off + 3]);
+    if (n < end) return -URTC_ERR_MALFORMED;
+
+    for (off += 4; off < end; ) {
+        uint8_t eid;
+        size_t len;
+
+        // zero bytes pad between elements
+        if (!pkt[off]) {
+            off++;
+            continue;
+        }
+
+        if (0xbede == profile) {
+            // one-byte header: id, then length less one [^RFC8285 4.2]
+            eid = pkt[off] >> 4;
+            if (15 == eid) break;
+            len = (pkt[off] & 0x0f) + 1;
+            off += 1;
+        } else if (0x100 == profile >> 4) {
+            // two-byte header: id, then length [^RFC8285 4.3]
+            if (off + 2 > end) break;
+            eid = pkt[off];
+            len = pkt[off + 1];
+            off += 2;
+        } else {
+            break;
+        }
+
+        if (off + len > end) return -URTC_ERR_MALFORMED;
+        if (eid == id && len >= 2) {
+            *seq = (pkt[off] << 8) | pkt[off + 1];
+            return 0;
+        }
+        off += len;
+    }
+
+    return -URTC_ERR;
+}
+
+uint8_t *rtp_ext_strip(uint8_t *pkt, size_t *n) {
+    size_t off, len;
+
+    if (!pkt || !n || *n < RTP_HEADER_SIZE) return NULL;
+    if (!(pkt[0] & 0x10)) return pkt;
+
+    off = RTP_HEADER_SIZE + 4 * (pkt[0] & 0x0f);
+    if (*n < off + 4) return NULL;
+    len = 4 + 4 * ((pkt[off + 2] << 8) | pkt[off + 3]);
+    if (*n < off + len) return NULL;
+
+    memmove(pkt + len, pkt, off);
+    pkt += len;
+    pkt[0] &= ~0x10;
+    *n -= len;
+
+    return pkt;
+}
+
+void rtp_rtx_write(
+    uint8_t *hdr,
+    const uint8_t *orig,
+    uint8_t pt,
+    uint16_t seq,
+    uint32_t ssrc
+) {
+    uint32_t ts = ((uint32_t)orig[4] << 24) | (orig[5] << 16) |
+        (orig[6] << 8) | orig[7];
+
+    rtp_header_write(hdr, pt, orig[1] >> 7, seq, ts, ssrc);
+    hdr[RTP_HEADER_SIZE]     = orig[2];
+    hdr[RTP_HEADER_SIZE + 1] = orig[3];
+}
+
+int rtp_rtx_unwrap(uint8_t *pkt, size_t *n, uint8_t pt, uint32_t ssrc) {
+    struct rtp_header h;
+    int rv;
+
+    if (!n) return -URTC_ERR_BAD_ARGUMENT;
+    if (rv = rtp_header_read(pkt, *n, &h), rv < 0) return rv;
+    if (h.payload_len < RTP_RTX_OSN_SIZE) return -URTC_ERR_MALFORMED;
+
+    // original sequence number replaces retransmission's, and padding
+    // (meant for the retransmission stream) is dropped
+    memcpy(pkt + 2, pkt + h.payload, RTP_RTX_OSN_SIZE);
+    memmove(pkt + h.payload, pkt + h.payload + RTP_RTX_OSN_SIZE,
+        h.payload_len - RTP_RTX_OSN_SIZE);
+    *n = h.payload + h.payload_len - RTP_RTX_OSN_SIZE;
+
+    pkt[0] &= ~0x20;
+    pkt[1] = (pkt[1] & 0x80) | (pt & 0x7f);
+    pkt[8]  = ssrc >> 24;
+    pkt[9]  = ssrc >> 16;
+    pkt[10] = ssrc >> 8;
+    pkt[11] = ssrc;
+
+    return 0;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,262 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_RTP_H
+#define _URTC_RTP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/uio.h>
+
+#define RTP_VERSION                      2
+#define RTP_HEADER_SIZE                 12  // fixed header, no csrcs
+#define RTP_RTX_OSN_SIZE                 2  // original sequence number
+#define RTP_TWCC_EXT_SIZE                8  // transport-wide seq. extension
+
+// Largest payload sent, leaving room within DTLS_MTU for the RTP header,
+// header extensions and the longest SRTP tag.
+#define RTP_MAX_PAYLOAD_SIZE          1100
+#define RTP_MAX_PACKET_SIZE           1200
+
+#define RTP_VIDEO_CLOCK_HZ           90000
+
+#define RTP_MAX_IOV                     17  // payload fragments per packet
+#define RTP_MAX_PAYLOAD_HDR             17  // payload format header bytes
+
+/**
+ * Reference-counted, scatter-gather RTP payload
+ *
+ * Built once per encoded frame and shared, read-only, by every stream that
+ * sends it. Each stream writes its own header (SSRC, sequence number,
+ * timestamp) in front of the payload as it protects the packet.
+ *
+ * Fragments point either into the encoder's buffer (valid only while the
+ * frame is being sent) or at payload format header bytes held in \a hdr
+ * (e.g. FU-A indicator and header, or STAP-A NAL unit sizes).
+ */
+struct rtp_payload {
+    int refs;                           // atomic
+    bool marker;                        // last packet of access unit
+    size_t len;                         // total of fragment lengths
+
+    struct iovec iov[RTP_MAX_IOV];
+    int iovcnt;
+
+    uint8_t hdr[RTP_MAX_PAYLOAD_HDR];
+    size_t hdr_len;
+};
+
+/**
+ * Allocate empty payload with one reference
+ *
+ * \return Payload, or NULL on allocation failure.
+ */
+struct rtp_payload *rtp_payload_new(void);
+
+/**
+ * Append fragment referencing external bytes
+ *
+ * \return 0 on success, negative if fragments are exhausted.
+ */
+int rtp_payload_append(struct rtp_payload *p, const uint8_t *data, size_t n);
+
+/**
+ * Append fragment of payload format header bytes, copied into \a p->hdr
+ *
+ * \return 0 on success, negative if fragments or header space are exhausted.
+ */
+int rtp_payload_append_hdr(
+    struct rtp_payload *p,
+    const uint8_t *data,
+    size_t n
+);
+
+/**
+ * Gather payload into contiguous buffer
+ *
+ * \param p Payload.
+ * \param dst Destination, at least \a p->len bytes.
+ *
+ * \return Payload length.
+ */
+size_t rtp_payload_copy(const struct rtp_payload *p, uint8_t *dst);
+
+/**
+ * Copy payload into a new one holding its own bytes, with one reference
+ *
+ * The copy stays valid after the encoder's buffer is reused, e.g. to keep
+ * frames for replay. It is freed with rtp_payload_unref(), like others.
+ *
+ * \return Copy, or NULL on allocation failure.
+ */
+struct rtp_payload *rtp_payload_dup(const struct rtp_payload *p);
+
+/**
+ * Take another reference
+ *
+ * \return \a p, for convenience.
+ */
+struct rtp_payload *rtp_payload_ref(struct rtp_payload *p);
+
+/**
+ * Drop a reference, freeing the payload with the last one
+ */
+void rtp_payload_unref(struct rtp_payload *p);
+
+/**
+ * Fields of a received RTP packet
+ */
+struct rtp_header {
+    uint8_t pt;
+    bool marker;
+    uint16_t seq;
+    uint32_t ts;
+    uint32_t ssrc;
+    size_t payload;                     // offset of payload
+    size_t payload_len;                 // excluding padding
+};
+
+/**
+ * Parse RTP header [^RFC3550 5.1]
+ *
+ * Skips CSRCs and header extension, and strips padding.
+ *
+ * \param pkt Packet.
+ * \param n Size of packet.
+ * \param[out] h Header fields.
+ *
+ * \return 0 on success, negative on error.
+ */
+int rtp_header_read(const uint8_t *pkt, size_t n, struct rtp_header *h);
+
+/**
+ * Write fixed RTP header [^RFC3550 5.1]
+ *
+ * \param hdr Destination (RTP_HEADER_SIZE bytes).
+ * \param pt Payload type.
+ * \param marker Marker bit.
+ * \param seq Sequence number.
+ * \param ts Timestamp.
+ * \param ssrc Synchronization source.
+ */
+void rtp_header_write(
+    uint8_t *hdr,
+    uint8_t pt,
+    bool marker,
+    uint16_t seq,
+    uint32_t ts,
+    uint32_t ssrc
+);
+
+/**
+ * Append transport-wide sequence number header extension
+ *
+ * Written as the only element of a one-byte header extension block
+ * [^RFC8285 4.2], and the header's extension bit is set.
+ *
+ * \param hdr Header without extension, with RTP_TWCC_EXT_SIZE bytes spare.
+ * \param hdr_len Size of header (including CSRCs).
+ * \param id Negotiated extension id (1-14).
+ * \param seq Transport-wide sequence number.
+ *
+ * \return Size of header with extension.
+ */
+size_t rtp_twcc_write(uint8_t *hdr, size_t hdr_len, uint8_t id, uint16_t seq);
+
+/**
+ * Read transport-wide sequence number header extension
+ *
+ * Elements of both one-byte and two-byte header extension blocks are
+ * searched [^RFC8285 4].
+ *
+ * \param pkt Packet.
+ * \param n Size of packet.
+ * \param id Negotiated extension id.
+ * \param[out] seq Transport-wide sequence number.
+ *
+ * \return 0 if found, negative if absent or malformed.
+ */
+int rtp_twcc_read(const uint8_t *pkt, size_t n, uint8_t id, uint16_t *seq);
+
+/**
+ * Remove header extension, in place
+ *
+ * The fixed header and CSRCs are moved up over the extension, so the
+ * packet then starts later in its buffer.
+ *
+ * \param pkt Packet.
+ * \param[in,out] n Size of packet.
+ *
+ * \return Start of packet, or NULL if malformed.
+ */
+uint8_t *rtp_ext_strip(uint8_t *pkt, size_t *n);
+
+/**
+ * Write header of retransmission packet [^RFC4588 4]
+ *
+ * Marker and timestamp are those of the original packet. The original
+ * sequence number follows the header, as the first two payload bytes.
+ *
+ * \param hdr Destination (RTP_HEADER_SIZE + RTP_RTX_OSN_SIZE bytes).
+ * \param orig Fixed header of original packet.
+ * \param pt Retransmission payload type.
+ * \param seq Retransmission sequence number.
+ * \param ssrc Retransmission synchronization source.
+ */
+void rtp_rtx_write(
+    uint8_t *hdr,
+    const uint8_t *orig,
+    uint8_t pt,
+    uint16_t seq,
+    uint32_t ssrc
+);
+
+/**
+ * Restore original packet from retransmission packet, in place [^RFC4588 4]
+ *
+ * \param pkt Retransmission packet, rewritten as the original.
+ * \param[in,out] n Size of packet.
+ * \param pt Original payload type.
+ * \param ssrc Original synchronization source.
+ *
+ * \return 0 on success, negative on error or if the packet carries no
+ *         original payload (e.g. padding for bandwidth probing).
+ */
+int rtp_rtx_unwrap(uint8_t *pkt, size_t *n, uint8_t pt, uint32_t ssrc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_RTP_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
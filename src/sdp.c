@@ -30,6 +30,7 @@
 #include <string.h>
 
 #include "err.h"
+#include "fec.h"
 #include "log.h"
 #include "sdp.h"
 
@@ -145,8 +146,30 @@ static int sdp_parse_attr_fingerprint(struct sdp *sdp, char *val) {
     return 0;
 }
 
+/**
+ * Parse setup attribute
+ *
+ * Format is:
+ *
+ *     a=setup:<actpass|active|passive>
+ *
+ * The "holdconn" value is not supported.
+ *
+ * \param[out] sdp SDP structure updated with DTLS role.
+ * \param[in]  val NULL-terminated string.
+ *
+ * \return 0 on success. Negative on error.
+ */
 static int sdp_parse_attr_setup(struct sdp *sdp, const char *val) {
-    /* not implemented */
+    if (0 == strcmp("actpass", val)) {
+        sdp->setup = SDP_SETUP_ACTPASS;
+    } else if (0 == strcmp("active", val)) {
+        sdp->setup = SDP_SETUP_ACTIVE;
+    } else if (0 == strcmp("passive", val)) {
+        sdp->setup = SDP_SETUP_PASSIVE;
+    } else {
+        return -URTC_ERR_SDP_MALFORMED_ATTRIBUTE;
+    }
     return 0;
 }
 
@@ -155,8 +178,36 @@ static int sdp_parse_attr_mid(struct sdp *sdp, const char *val) {
     return 0;
 }
 
+/**
+ * Parse RTP header extension map [^RFC8285 8]
+ *
+ * Format is:
+ *
+ *     <id>[/<direction>] <uri> [<attributes>]
+ *
+ * Only the transport-wide sequence number extension is recognized.
+ *
+ * \param[out] sdp SDP structure updated with parsed content.
+ * \param[in]  val NULL-terminated string.
+ *
+ * \return 0 on success. Negative on error.
+ */
 static int sdp_parse_attr_extmap(struct sdp *sdp, const char *val) {
-    /* not implemented */
+    if (!val) return -URTC_ERR_SDP_MALFORMED;
+
+    unsigned int id;
+    char uri[128];
+
+    if (2 != sscanf(val, "%3u%*[^ ] %127s", &id, uri) &&
+            2 != sscanf(val, "%3u %127s", &id, uri)) {
+        return -URTC_ERR_SDP_MALFORMED_ATTRIBUTE;
+    }
+
+    // one-byte header form only, ids 1-14 [^RFC8285 4.2]
+    if (0 == strcmp(SDP_EXTMAP_TWCC, uri) && id >= 1 && id <= 14) {
+        sdp->video.twcc_ext = id;
+    }
+
     return 0;
 }
 
@@ -190,18 +241,98 @@ static int sdp_parse_attr_rtpmap(struct sdp *sdp, char *val) {
                 sdp->video.params[i].codec = SDP_CODEC_H264;
             }
         }
+    } else if (0 == strcmp("rtx", en)) {
+        for (int i = 0; i < sdp->video.count; i++) {
+            if (sdp->video.params[i].type == pt) {
+                sdp->video.params[i].clock = cr;
+                sdp->video.params[i].codec = SDP_CODEC_RTX;
+            }
+        }
+    } else if (0 == strcmp("flexfec", en)) {
+        for (int i = 0; i < sdp->video.count; i++) {
+            if (sdp->video.params[i].type == pt) {
+                sdp->video.params[i].clock = cr;
+                sdp->video.params[i].codec = SDP_CODEC_FLEXFEC;
+            }
+        }
     }
 
     return 0;
 }
 
+/**
+ * Parse RTCP feedback capability [^RFC4585 4.2]
+ *
+ * Format is:
+ *
+ *     <payload type or *> <feedback type> [<parameters>]
+ *
+ * Only receiver estimated maximum bitrate and keyframe request feedback is
+ * recorded, for the media section as a whole. Other feedback types are
+ * implied by the codecs and header extensions offered, and are ignored.
+ *
+ * \param[out] sdp SDP structure updated with parsed content.
+ * \param[in]  val NULL-terminated string.
+ *
+ * \return 0 on success. Negative on error.
+ */
 static int sdp_parse_attr_rtcp_feedback(struct sdp *sdp, const char *val) {
-    /* not implemented */
+    if (!val) return -URTC_ERR_SDP_MALFORMED;
+
+    char type[32], param[32] = "";
+
+    if (1 > sscanf(val, "%*s %31s %31s", type, param)) {
+        return -URTC_ERR_SDP_MALFORMED_ATTRIBUTE;
+    }
+
+    if (0 == strcmp("goog-remb", type)) {
+        sdp->video.remb = true;
+    } else if (0 == strcmp("nack", type) && 0 == strcmp("pli", param)) {
+        sdp->video.pli = true;
+    } else if (0 == strcmp("ccm", type) && 0 == strcmp("fir", param)) {
+        sdp->video.fir = true;
+    }
+
     return 0;
 }
 
+/**
+ * Parse format specific parameters attribute
+ *
+ * Format is:
+ *
+ *     <payload type> <parameter>=<value>[;<parameter>=<value>...]
+ *
+ * Only the associated payload type of retransmission streams is recognized
+ * [^RFC4588 8.6]. Other parameters are ignored.
+ *
+ * \param[out] sdp SDP structure updated with parsed content.
+ * \param[in]  val NULL-terminated string.
+ *
+ * \return 0 on success. Negative on error.
+ */
 static int sdp_parse_attr_fmtp(struct sdp *sdp, const char *val) {
-    /* not implemented */
+    if (!val) return -URTC_ERR_SDP_MALFORMED;
+
+    unsigned int pt;                    // payload type
+    unsigned int apt;                   // associated payload type
+    int n;
+
+    if (1 != sscanf(val, "%3u %n", &pt, &n)) {
+        return -URTC_ERR_SDP_MALFORMED_ATTRIBUTE;
+    }
+
+    for (const char *p = val + n; p; p = strchr(p, ';')) {
+        p += strspn(p, "; ");
+        if (1 == sscanf(p, "apt=%3u", &apt)) {
+            for (int i = 0; i < sdp->video.count; i++) {
+                if (sdp->video.params[i].type == pt) {
+                    sdp->video.params[i].apt = apt;
+                }
+            }
+        }
+    }
+
     return 0;
 }
 
@@ -310,6 +441,8 @@ static int sdp_parse_media_description(struct sdp *sdp, char *value) {
             value && sdp->video.count < SDP_MAX_RTP_PAYLOAD_TYPES;
             value = strsep(&next, " ")
         ) {
+            // codec and parameters follow in rtpmap and fmtp attributes
+            sdp->video.params[sdp->video.count] = (struct sdp_rtpmap){ 0 };
             unsigned int *v = &sdp->video.params[sdp->video.count].type;
             if (1 != sscanf(value, "%3d", v)) {
                 return -URTC_ERR_SDP_MALFORMED_MEDIA;
@@ -559,7 +692,9 @@ int sdp_serialize(char *dst, size_t len, const struct sdp *src) {
         dst += n;
         len -= n;
         for (int i = 0; i < src->video.count; i++) {
-            if (src->video.params[i].codec == SDP_CODEC_H264) {
+            if (src->video.params[i].codec == SDP_CODEC_H264 ||
+                    src->video.params[i].codec == SDP_CODEC_RTX ||
+                    src->video.params[i].codec == SDP_CODEC_FLEXFEC) {
                 n = snprintf(dst, len, " %d", src->video.params[i].type);
                 if (n < 0) return -URTC_ERR_SDP_MALFORMED;
                 if (n > len) return -URTC_ERR_SDP_MALFORMED;
@@ -635,7 +770,16 @@ int sdp_serialize(char *dst, size_t len, const struct sdp *src) {
     dst += n;
     len -= n;
 
-    // TODO write setup, mid
+    // write media attribute: setup
+    if (SDP_SETUP_NULL != src->setup) {
+        n = snprintf(dst, len, "a=setup:%s\n",
+            SDP_SETUP_ACTPASS == src->setup ? "actpass" :
+            SDP_SETUP_ACTIVE == src->setup ? "active" : "passive");
+        if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+        if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+        dst += n;
+        len -= n;
+    }
 
     // write media attribute: mode
     switch (src->mode) {
@@ -672,7 +816,7 @@ int sdp_serialize(char *dst, size_t len, const struct sdp *src) {
         if (n < 0) return -URTC_ERR_SDP_MALFORMED;
         if (n >= len) return -URTC_ERR_SDP_MALFORMED;
         dst += n;
-        n -= n;
+        len -= n;
     }
 
     // write dynamic profiles
@@ -686,6 +830,102 @@ int sdp_serialize(char *dst, size_t len, const struct sdp *src) {
             if (n >= len) return -URTC_ERR_SDP_MALFORMED;
             dst += n;
             len -= n;
+        } else if (src->video.params[i].codec == SDP_CODEC_RTX) {
+            n = snprintf(dst, len, "a=rtpmap:%d rtx/%d\na=fmtp:%d apt=%d\n",
+                src->video.params[i].type,
+                src->video.params[i].clock,
+                src->video.params[i].type,
+                src->video.params[i].apt
+            );
+            if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+            if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+            dst += n;
+            len -= n;
+        } else if (src->video.params[i].codec == SDP_CODEC_FLEXFEC) {
+            n = snprintf(dst, len,
+                "a=rtpmap:%d flexfec/%d\na=fmtp:%d repair-window=%d\n",
+                src->video.params[i].type,
+                src->video.params[i].clock,
+                src->video.params[i].type,
+                FEC_REPAIR_WINDOW_US
+            );
+            if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+            if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+            dst += n;
+            len -= n;
+        }
+    }
+
+    // write transport-wide congestion control extension and feedback
+    if (src->video.twcc_ext) {
+        n = snprintf(dst, len, "a=extmap:%d %s\n", src->video.twcc_ext,
+            SDP_EXTMAP_TWCC);
+        if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+        if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+        dst += n;
+        len -= n;
+
+        for (int i = 0; i < src->video.count; i++) {
+            if (src->video.params[i].codec != SDP_CODEC_H264) continue;
+            n = snprintf(dst, len, "a=rtcp-fb:%d transport-cc\n",
+                src->video.params[i].type);
+            if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+            if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+            dst += n;
+            len -= n;
+        }
+    }
+
+    // write receiver estimated maximum bitrate and keyframe request feedback
+    for (int i = 0; i < src->video.count; i++) {
+        const struct { bool on; const char *type; } fb[] = {
+            { src->video.remb, "goog-remb" },
+            { src->video.pli, "nack pli" },
+            { src->video.fir, "ccm fir" }
+        };
+        if (src->video.params[i].codec != SDP_CODEC_H264) continue;
+        for (size_t j = 0; j < sizeof(fb) / sizeof(fb[0]); j++) {
+            if (!fb[j].on) continue;
+            n = snprintf(dst, len, "a=rtcp-fb:%d %s\n",
+                src->video.params[i].type, fb[j].type);
+            if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+            if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+            dst += n;
+            len -= n;
+        }
+    }
+
+    // write sources, pairing retransmission and repair streams with media
+    // [^RFC5576 4.2] [^RFC8627 5.1.2]
+    if (src->video.ssrc && src->video.rtx_ssrc) {
+        n = snprintf(dst, len, "a=ssrc-group:FID %" PRIu32 " %" PRIu32 "\n",
+            src->video.ssrc, src->video.rtx_ssrc);
+        if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+        if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+        dst += n;
+        len -= n;
+    }
+    if (src->video.ssrc && src->video.fec_ssrc) {
+        n = snprintf(dst, len,
+            "a=ssrc-group:FEC-FR %" PRIu32 " %" PRIu32 "\n",
+            src->video.ssrc, src->video.fec_ssrc);
+        if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+        if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+        dst += n;
+        len -= n;
+    }
+    if (src->video.ssrc) {
+        uint32_t ssrcs[] = {
+            src->video.ssrc, src->video.rtx_ssrc, src->video.fec_ssrc
+        };
+        for (int i = 0; i < 3; i++) {
+            if (!ssrcs[i]) continue;
+            n = snprintf(dst, len, "a=ssrc:%" PRIu32 " cname:%s\n",
+                ssrcs[i], src->video.cname);
+            if (n < 0) return -URTC_ERR_SDP_MALFORMED;
+            if (n >= len) return -URTC_ERR_SDP_MALFORMED;
+            dst += n;
+            len -= n;
         }
     }
 
@@ -46,6 +46,11 @@ extern "C" {
 #define SDP_MAX_BUNDLE_IDS              5
 #define SDP_MAX_BUNDLE_ID_SIZE          32
 #define SDP_MAX_RTP_PAYLOAD_TYPES       32
+#define SDP_MAX_CNAME_SIZE              64
+
+// Transport-wide sequence number header extension
+#define SDP_EXTMAP_TWCC \
+    "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01"
 
 
 typedef enum sdp_mode {
@@ -63,11 +68,21 @@ typedef enum sdp_media {
     SDP_MEDIA_TYPE_MESSAGE
 } sdp_media_type_t;
 
+// DTLS role negotiation (RFC 4145 / RFC 5763)
+typedef enum sdp_setup {
+    SDP_SETUP_NULL = 0,
+    SDP_SETUP_ACTPASS,
+    SDP_SETUP_ACTIVE,
+    SDP_SETUP_PASSIVE
+} sdp_setup_t;
+
 // Codecs recognized by SDP parser
 typedef enum sdp_codec {
     SDP_CODEC_NULL = 0,
     SDP_CODEC_H264,
-    SDP_CODEC_VP9
+    SDP_CODEC_VP9,
+    SDP_CODEC_RTX,                      // retransmission [^RFC4588 8.6]
+    SDP_CODEC_FLEXFEC                   // forward error correction [^RFC8627]
 } sdp_codec_t;
 
 // Dynamic payload type
@@ -76,6 +91,7 @@ typedef struct sdp_rtpmap {
     enum sdp_codec    codec;            // H264, VP9, etc.
     unsigned int      clock;            // Typically 90kHz for video
     unsigned int      flags;
+    unsigned int      apt;              // Associated payload type (RTX only)
 } sdp_rtpmap_t;
 
 typedef struct sdp {
@@ -111,6 +127,24 @@ typedef struct sdp {
         uint16_t port;
         struct sdp_rtpmap params[SDP_MAX_RTP_PAYLOAD_TYPES];
         int count;
+
+        // sent media source and its retransmission and repair streams,
+        // if any
+        uint32_t ssrc;
+        uint32_t rtx_ssrc;
+        uint32_t fec_ssrc;
+        char cname[SDP_MAX_CNAME_SIZE+1];
+
+        // transport-wide congestion control header extension id, 0 if none
+        uint8_t twcc_ext;
+
+        // receiver estimated maximum bitrate feedback
+        bool remb;
+
+        // keyframe request feedback: picture loss indication, full intra
+        // request
+        bool pli;
+        bool fir;
     } video;
 
     // audio media
@@ -129,6 +163,8 @@ typedef struct sdp {
         uint8_t sha256[32];             // certificate fingerprint
     } fingerprint;
 
+    sdp_setup_t setup;                  // dtls client (active) or server
+
 } sdp_t;
 
 
@@ -0,0 +1,963 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Secure Real-time Transport Protocol [^RFC3711]
+ *
+ * AES counter mode encryption with HMAC-SHA1 authentication, or AES-GCM
+ * authenticated encryption [^RFC7714]. All OpenSSL contexts are created and
+ * keyed when the session is created (i.e. at DTLS-SRTP key export); per
+ * packet, only the IV is reset and the MAC re-initialized, so protection
+ * runs in place without heap allocation.
+ */
+
+#include <string.h>                     // memcpy, memset
+
+#include <sys/uio.h>                    // struct iovec
+
+#include <openssl/core_names.h>         // OSSL_MAC_PARAM_DIGEST
+#include <openssl/crypto.h>             // CRYPTO_memcmp, OPENSSL_cleanse
+#include <openssl/evp.h>                // EVP_CipherUpdate, EVP_MAC_update
+
+#include "err.h"
+#include "srtp.h"
+
+#define SRTP_IV_SIZE                    16
+#define SRTP_GCM_IV_SIZE                12
+#define SRTCP_INDEX_SIZE                 4
+
+#define SRTCP_E_FLAG            0x80000000
+#define SRTCP_INDEX_MASK        0x7fffffff
+
+// key derivation labels [^RFC3711 4.3.1]
+enum srtp_label {
+    LABEL_RTP_ENCRYPTION = 0,
+    LABEL_RTP_AUTH,
+    LABEL_RTP_SALT,
+    LABEL_RTCP_ENCRYPTION,
+    LABEL_RTCP_AUTH,
+    LABEL_RTCP_SALT
+};
+
+static const struct {
+    enum srtp_profile id;
+    bool aead;
+    size_t key_len;
+    size_t salt_len;
+    size_t tag_len;
+    size_t rtcp_tag_len;
+} profiles[] = {
+    { SRTP_PROFILE_AES128_CM_SHA1_80, false, 16, 14, 10, 10 },
+    { SRTP_PROFILE_AES128_CM_SHA1_32, false, 16, 14,  4, 10 },
+    { SRTP_PROFILE_AEAD_AES_128_GCM,  true,  16, 12, 16, 16 },
+    { SRTP_PROFILE_AEAD_AES_256_GCM,  true,  32, 12, 16, 16 },
+};
+
+static const EVP_CIPHER *ctr_cipher(size_t key_len) {
+    switch (key_len) {
+    case 16: return EVP_aes_128_ctr();
+    case 32: return EVP_aes_256_ctr();
+    default: return NULL;
+    }
+}
+
+static const EVP_CIPHER *gcm_cipher(size_t key_len) {
+    switch (key_len) {
+    case 16: return EVP_aes_128_gcm();
+    case 32: return EVP_aes_256_gcm();
+    default: return NULL;
+    }
+}
+
+static inline uint32_t load32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static inline void store32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+int srtp_derive(
+    const uint8_t *key,
+    size_t key_len,
+    const uint8_t *salt,
+    uint8_t label,
+    uint8_t *out,
+    size_t n
+) {
+    const EVP_CIPHER *cipher = ctr_cipher(key_len);
+    uint8_t iv[SRTP_IV_SIZE] = { 0 };
+    EVP_CIPHER_CTX *ctx;
+    int outl, rv = -URTC_ERR;
+
+    if (!key || !salt || !out || !cipher) return -URTC_ERR_BAD_ARGUMENT;
+
+    // x = (label * 2^48) XOR master salt, padded to iv = x * 2^16
+    memcpy(iv, salt, SRTP_MAX_SALT_SIZE);
+    iv[7] ^= label;
+
+    if (ctx = EVP_CIPHER_CTX_new(), !ctx) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    // keystream is the key material
+    memset(out, 0, n);
+    if (1 == EVP_EncryptInit_ex(ctx, cipher, NULL, key, iv) &&
+        1 == EVP_EncryptUpdate(ctx, out, &outl, out, n)) {
+        rv = 0;
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    return rv;
+}
+
+/**
+ * Create keyed cipher context
+ */
+static EVP_CIPHER_CTX *cipher_new(
+    const EVP_CIPHER *cipher,
+    const uint8_t *key
+) {
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+
+    if (ctx && 1 != EVP_EncryptInit_ex(ctx, cipher, NULL, key, NULL)) {
+        EVP_CIPHER_CTX_free(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+/**
+ * Create keyed HMAC-SHA1 context
+ */
+static EVP_MAC_CTX *mac_new(const uint8_t *key) {
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "SHA1", 0),
+        OSSL_PARAM_construct_end()
+    };
+    EVP_MAC_CTX *ctx = NULL;
+    EVP_MAC *mac;
+
+    if (mac = EVP_MAC_fetch(NULL, "HMAC", NULL), !mac) return NULL;
+
+    ctx = EVP_MAC_CTX_new(mac);
+    if (ctx && 1 != EVP_MAC_init(ctx, key, SRTP_AUTH_KEY_SIZE, params)) {
+        EVP_MAC_CTX_free(ctx);
+        ctx = NULL;
+    }
+
+    // context holds its own reference
+    EVP_MAC_free(mac);
+
+    return ctx;
+}
+
+/**
+ * Form counter mode IV [^RFC3711 4.1.1]
+ *
+ * IV = (k_s * 2^16) XOR (SSRC * 2^64) XOR (i * 2^16)
+ */
+static void make_iv(
+    uint8_t iv[SRTP_IV_SIZE],
+    const uint8_t *salt,
+    uint32_t ssrc,
+    uint64_t index
+) {
+    memcpy(iv, salt, SRTP_MAX_SALT_SIZE);
+    iv[14] = iv[15] = 0;
+
+    iv[4] ^= ssrc >> 24;
+    iv[5] ^= ssrc >> 16;
+    iv[6] ^= ssrc >> 8;
+    iv[7] ^= ssrc;
+
+    for (int i = 0; i < 6; i++) {
+        iv[13 - i] ^= index >> (8 * i);
+    }
+}
+
+/**
+ * Form GCM IV [^RFC7714 8.1, 9.1]
+ *
+ * IV = (00 00 || SSRC || ROC || SEQ) XOR k_s for SRTP, and
+ * IV = (00 00 || SSRC || 00 00 || SRTCP index) XOR k_s for SRTCP, i.e. the
+ * 48-bit packet index in the low bytes in both cases.
+ */
+static void make_gcm_iv(
+    uint8_t iv[SRTP_GCM_IV_SIZE],
+    const uint8_t *salt,
+    uint32_t ssrc,
+    uint64_t index
+) {
+    memcpy(iv, salt, SRTP_GCM_IV_SIZE);
+
+    iv[2] ^= ssrc >> 24;
+    iv[3] ^= ssrc >> 16;
+    iv[4] ^= ssrc >> 8;
+    iv[5] ^= ssrc;
+
+    for (int i = 0; i < 6; i++) {
+        iv[11 - i] ^= index >> (8 * i);
+    }
+}
+
+/**
+ * Apply keystream to gathered input, writing contiguous output
+ *
+ * Output may alias input.
+ */
+static int apply_keystream_iov(
+    EVP_CIPHER_CTX *ctx,
+    const uint8_t iv[SRTP_IV_SIZE],
+    const struct iovec *in,
+    int incnt,
+    uint8_t *out
+) {
+    int outl;
+
+    if (1 != EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv)) return -URTC_ERR;
+
+    for (int i = 0; i < incnt; i++) {
+        if (!in[i].iov_len) continue;
+        if (1 != EVP_EncryptUpdate(ctx, out, &outl, in[i].iov_base,
+                in[i].iov_len)) {
+            return -URTC_ERR;
+        }
+        out += in[i].iov_len;
+    }
+
+    return 0;
+}
+
+/**
+ * Apply keystream to buffer in place
+ */
+static int apply_keystream(
+    EVP_CIPHER_CTX *ctx,
+    const uint8_t iv[SRTP_IV_SIZE],
+    uint8_t *buf,
+    size_t n
+) {
+    struct iovec v = { buf, n };
+    return apply_keystream_iov(ctx, iv, &v, 1, buf);
+}
+
+/**
+ * Compute full-length HMAC-SHA1 over buffer followed by optional trailer
+ */
+static int authenticate(
+    EVP_MAC_CTX *ctx,
+    const uint8_t *buf,
+    size_t n,
+    const uint8_t *trailer,
+    size_t trailer_len,
+    uint8_t tag[SRTP_AUTH_KEY_SIZE]
+) {
+    size_t outl;
+
+    // re-initialize, keeping the key
+    if (1 != EVP_MAC_init(ctx, NULL, 0, NULL)) return -URTC_ERR;
+    if (1 != EVP_MAC_update(ctx, buf, n)) return -URTC_ERR;
+    if (trailer_len && 1 != EVP_MAC_update(ctx, trailer, trailer_len)) {
+        return -URTC_ERR;
+    }
+    if (1 != EVP_MAC_final(ctx, tag, &outl, SRTP_AUTH_KEY_SIZE)) {
+        return -URTC_ERR;
+    }
+
+    return 0;
+}
+
+/**
+ * AES-GCM encrypt (enc) or decrypt and verify (!enc) gathered input
+ *
+ * Output is contiguous and may alias input. Additional authenticated data
+ * is the concatenation of \a aad and \a aad2. On encryption, the tag is
+ * written to \a tag; on decryption, it is read from there.
+ */
+static int aead_crypt_iov(
+    EVP_CIPHER_CTX *ctx,
+    int enc,
+    const uint8_t iv[SRTP_GCM_IV_SIZE],
+    const uint8_t *aad,
+    size_t aad_len,
+    const uint8_t *aad2,
+    size_t aad2_len,
+    const struct iovec *in,
+    int incnt,
+    uint8_t *out,
+    uint8_t *tag,
+    size_t tag_len
+) {
+    uint8_t tail[16];
+    int outl;
+
+    if (1 != EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, enc)) {
+        return -URTC_ERR;
+    }
+    if (1 != EVP_CipherUpdate(ctx, NULL, &outl, aad, aad_len)) {
+        return -URTC_ERR;
+    }
+    if (aad2_len && 1 != EVP_CipherUpdate(ctx, NULL, &outl, aad2, aad2_len)) {
+        return -URTC_ERR;
+    }
+    for (int i = 0; i < incnt; i++) {
+        if (!in[i].iov_len) continue;
+        if (1 != EVP_CipherUpdate(ctx, out, &outl, in[i].iov_base,
+                in[i].iov_len)) {
+            return -URTC_ERR;
+        }
+        out += in[i].iov_len;
+    }
+    if (!enc && 1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, tag_len,
+            tag)) {
+        return -URTC_ERR;
+    }
+
+    // tag mismatch fails here
+    if (1 != EVP_CipherFinal_ex(ctx, tail, &outl)) return -URTC_ERR;
+
+    if (enc && 1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, tag_len,
+            tag)) {
+        return -URTC_ERR;
+    }
+
+    return 0;
+}
+
+/**
+ * AES-GCM encrypt (enc) or decrypt and verify (!enc) buffer in place
+ */
+static int aead_crypt(
+    EVP_CIPHER_CTX *ctx,
+    int enc,
+    const uint8_t iv[SRTP_GCM_IV_SIZE],
+    const uint8_t *aad,
+    size_t aad_len,
+    const uint8_t *aad2,
+    size_t aad2_len,
+    uint8_t *buf,
+    size_t n,
+    uint8_t *tag,
+    size_t tag_len
+) {
+    struct iovec v = { buf, n };
+    return aead_crypt_iov(ctx, enc, iv, aad, aad_len, aad2, aad2_len, &v, 1,
+        buf, tag, tag_len);
+}
+
+/**
+ * Find stream by SSRC, or an unused slot for it
+ *
+ * Slots are claimed by the caller (by setting used) only once a packet has
+ * been protected or authenticated, so forged packets cannot exhaust them.
+ */
+static struct srtp_stream *stream_find(struct srtp *s, uint32_t ssrc) {
+    struct srtp_stream *unused = NULL;
+
+    for (int i = 0; i < SRTP_MAX_STREAMS; i++) {
+        struct srtp_stream *st = &s->streams[i];
+        if (st->used && st->ssrc == ssrc) return st;
+        if (!st->used && !unused) unused = st;
+    }
+
+    return unused;
+}
+
+/**
+ * Length of RTP header, including CSRCs and header extension
+ *
+ * \return Header length, or negative if packet is malformed.
+ */
+static int rtp_header_len(const uint8_t *pkt, size_t len) {
+    size_t n;
+
+    if (len < 12 || 2 != (pkt[0] >> 6)) return -URTC_ERR_MALFORMED;
+
+    n = 12 + 4 * (pkt[0] & 0x0f);
+    if (pkt[0] & 0x10) {
+        if (len < n + 4) return -URTC_ERR_MALFORMED;
+        n += 4 + 4 * ((pkt[n + 2] << 8) | pkt[n + 3]);
+    }
+
+    return n <= len ? (int)n : -URTC_ERR_MALFORMED;
+}
+
+/**
+ * Estimate rollover counter of received sequence number [^RFC3711 3.3.1]
+ */
+static uint32_t estimate_roc(const struct srtp_stream *st, uint16_t seq) {
+    if (!st->seq_init) return st->roc;
+
+    if (st->s_l < 32768) {
+        if ((int32_t)seq - st->s_l > 32768) return st->roc - 1;
+    } else {
+        if ((int32_t)st->s_l - 32768 > seq) return st->roc + 1;
+    }
+
+    return st->roc;
+}
+
+/**
+ * Update rollover counter and highest sequence number [^RFC3711 3.3.1]
+ */
+static void update_roc(struct srtp_stream *st, uint16_t seq, uint32_t v) {
+    if (!st->seq_init) {
+        st->seq_init = true;
+        st->roc = v;
+        st->s_l = seq;
+    } else if (v == st->roc + 1) {
+        st->roc = v;
+        st->s_l = seq;
+    } else if (v == st->roc && seq > st->s_l) {
+        st->s_l = seq;
+    }
+}
+
+/**
+ * Age replay bitmap by n packets
+ *
+ * The bitmap is shifted a whole 64-bit word at a time, carrying bits across
+ * word boundaries, rather than bit by bit.
+ */
+static void replay_shift(uint64_t w[SRTP_REPLAY_WORDS], uint64_t n) {
+    unsigned words, bits;
+
+    if (n >= SRTP_REPLAY_WINDOW) {
+        memset(w, 0, SRTP_REPLAY_WORDS * sizeof(w[0]));
+        return;
+    }
+
+    words = n / 64;
+    bits  = n % 64;
+
+    for (int i = SRTP_REPLAY_WORDS - 1; i >= 0; i--) {
+        uint64_t v = 0;
+        if (i >= (int)words) {
+            v = w[i - words] << bits;
+            if (bits && i > (int)words) v |= w[i - words - 1] >> (64 - bits);
+        }
+        w[i] = v;
+    }
+}
+
+/**
+ * Check packet index against replay window [^RFC3711 3.3.2]
+ *
+ * \param w Replay bitmap.
+ * \param init Whether any packet has been received.
+ * \param highest Highest index received.
+ * \param index Index of packet to check.
+ *
+ * \return 0 if index is new, negative if replayed or too old.
+ */
+static int replay_check(
+    const uint64_t w[SRTP_REPLAY_WORDS],
+    bool init,
+    uint64_t highest,
+    uint64_t index
+) {
+    uint64_t delta;
+
+    if (!init || index > highest) return 0;
+
+    delta = highest - index;
+    if (delta >= SRTP_REPLAY_WINDOW) return -URTC_ERR_SRTP_REPLAYED;
+    if (w[delta / 64] >> (delta % 64) & 1) return -URTC_ERR_SRTP_REPLAYED;
+
+    return 0;
+}
+
+/**
+ * Record authenticated packet index in replay window
+ */
+static void replay_update(
+    uint64_t w[SRTP_REPLAY_WORDS],
+    bool init,
+    uint64_t highest,
+    uint64_t index
+) {
+    uint64_t delta;
+
+    if (!init) {
+        memset(w, 0, SRTP_REPLAY_WORDS * sizeof(w[0]));
+        w[0] = 1;
+    } else if (index > highest) {
+        replay_shift(w, index - highest);
+        w[0] |= 1;
+    } else {
+        delta = highest - index;
+        w[delta / 64] |= (uint64_t)1 << (delta % 64);
+    }
+}
+
+int srtp_init(
+    struct srtp *s,
+    enum srtp_profile profile,
+    const uint8_t *key,
+    const uint8_t *salt
+) {
+    uint8_t rtp_key[SRTP_MAX_KEY_SIZE], rtcp_key[SRTP_MAX_KEY_SIZE];
+    uint8_t rtp_auth[SRTP_AUTH_KEY_SIZE], rtcp_auth[SRTP_AUTH_KEY_SIZE];
+    uint8_t master_salt[SRTP_MAX_SALT_SIZE] = { 0 };
+    const EVP_CIPHER *cipher;
+    size_t key_len = 0;
+    int rv = -URTC_ERR;
+
+    if (!s || !key || !salt) return -URTC_ERR_BAD_ARGUMENT;
+
+    memset(s, 0, sizeof(*s));
+
+    for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        if (profiles[i].id == profile) {
+            key_len         = profiles[i].key_len;
+            s->aead         = profiles[i].aead;
+            s->salt_len     = profiles[i].salt_len;
+            s->tag_len      = profiles[i].tag_len;
+            s->rtcp_tag_len = profiles[i].rtcp_tag_len;
+        }
+    }
+    if (!key_len) return -URTC_ERR_NOT_IMPLEMENTED;
+    s->profile = profile;
+
+    cipher = s->aead ? gcm_cipher(key_len) : ctr_cipher(key_len);
+
+    // 96-bit aead master salt is zero-padded for the prf [^RFC7714 11]
+    memcpy(master_salt, salt, s->salt_len);
+
+    // session keys [^RFC3711 4.3.2]
+    if (srtp_derive(key, key_len, master_salt, LABEL_RTP_ENCRYPTION, rtp_key,
+            key_len) < 0 ||
+        srtp_derive(key, key_len, master_salt, LABEL_RTP_AUTH, rtp_auth,
+            sizeof(rtp_auth)) < 0 ||
+        srtp_derive(key, key_len, master_salt, LABEL_RTP_SALT, s->rtp_salt,
+            s->salt_len) < 0 ||
+        srtp_derive(key, key_len, master_salt, LABEL_RTCP_ENCRYPTION,
+            rtcp_key, key_len) < 0 ||
+        srtp_derive(key, key_len, master_salt, LABEL_RTCP_AUTH, rtcp_auth,
+            sizeof(rtcp_auth)) < 0 ||
+        srtp_derive(key, key_len, master_salt, LABEL_RTCP_SALT, s->rtcp_salt,
+            s->salt_len) < 0) {
+        goto _fail_derive;
+    }
+
+    // preallocate contexts for every stream
+    for (int i = 0; i < SRTP_MAX_STREAMS; i++) {
+        struct srtp_stream *st = &s->streams[i];
+        st->rtp_cipher  = cipher_new(cipher, rtp_key);
+        st->rtcp_cipher = cipher_new(cipher, rtcp_key);
+        if (!st->rtp_cipher || !st->rtcp_cipher) {
+            rv = -URTC_ERR_INSUFFICIENT_MEMORY;
+            goto _fail_contexts;
+        }
+        if (s->aead) continue;
+
+        st->rtp_mac     = mac_new(rtp_auth);
+        st->rtcp_mac    = mac_new(rtcp_auth);
+        if (!st->rtp_mac || !st->rtcp_mac) {
+            rv = -URTC_ERR_INSUFFICIENT_MEMORY;
+            goto _fail_contexts;
+        }
+    }
+
+    rv = 0;
+    goto _done;
+
+_fail_contexts:
+_fail_derive:
+    srtp_free(s);
+_done:
+    OPENSSL_cleanse(rtp_key, sizeof(rtp_key));
+    OPENSSL_cleanse(rtcp_key, sizeof(rtcp_key));
+    OPENSSL_cleanse(rtp_auth, sizeof(rtp_auth));
+    OPENSSL_cleanse(rtcp_auth, sizeof(rtcp_auth));
+
+    return rv;
+}
+
+void srtp_free(struct srtp *s) {
+    if (!s) return;
+
+    for (int i = 0; i < SRTP_MAX_STREAMS; i++) {
+        struct srtp_stream *st = &s->streams[i];
+        EVP_CIPHER_CTX_free(st->rtp_cipher);
+        EVP_MAC_CTX_free(st->rtp_mac);
+        EVP_CIPHER_CTX_free(st->rtcp_cipher);
+        EVP_MAC_CTX_free(st->rtcp_mac);
+    }
+
+    OPENSSL_cleanse(s, sizeof(*s));
+}
+
+/**
+ * Protect RTP packet of a known stream
+ *
+ * The header and encrypted payload are written to \a out, which may alias
+ * \a hdr and the payload (for in-place protection).
+ */
+static int protect(
+    struct srtp *s,
+    struct srtp_stream *st,
+    const uint8_t *hdr,
+    size_t hl,
+    const struct iovec *iov,
+    int iovcnt,
+    uint8_t *out,
+    size_t *len,
+    size_t cap
+) {
+    uint8_t iv[SRTP_IV_SIZE], roc[4], tag[SRTP_AUTH_KEY_SIZE];
+    uint32_t ssrc, v;
+    uint64_t index;
+    uint16_t seq;
+    size_t n = hl;
+
+    for (int i = 0; i < iovcnt; i++) n += iov[i].iov_len;
+    if (n + s->tag_len > cap) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    seq  = (hdr[2] << 8) | hdr[3];
+    ssrc = load32(hdr + 8);
+
+    // sender tracks its own rollovers like a receiver would
+    v = estimate_roc(st, seq);
+    update_roc(st, seq, v);
+    index = ((uint64_t)v << 16) | seq;
+
+    if (out != hdr) memcpy(out, hdr, hl);
+
+    // header is additional authenticated data, tag follows payload
+    if (s->aead) {
+        make_gcm_iv(iv, s->rtp_salt, ssrc, index);
+        if (aead_crypt_iov(st->rtp_cipher, 1, iv, hdr, hl, NULL, 0, iov,
+                iovcnt, out + hl, out + n, s->tag_len) < 0) {
+            return -URTC_ERR;
+        }
+        *len = n + s->tag_len;
+        return 0;
+    }
+
+    // encrypt payload
+    make_iv(iv, s->rtp_salt, ssrc, index);
+    if (apply_keystream_iov(st->rtp_cipher, iv, iov, iovcnt, out + hl) < 0) {
+        return -URTC_ERR;
+    }
+
+    // authenticate header and encrypted payload, followed by roc
+    store32(roc, v);
+    if (authenticate(st->rtp_mac, out, n, roc, sizeof(roc), tag) < 0) {
+        return -URTC_ERR;
+    }
+    memcpy(out + n, tag, s->tag_len);
+    *len = n + s->tag_len;
+
+    return 0;
+}
+
+/**
+ * Protect RTP packet of a known stream in place
+ */
+static int protect_inplace(
+    struct srtp *s,
+    struct srtp_stream *st,
+    uint8_t *pkt,
+    size_t *len,
+    size_t cap
+) {
+    struct iovec payload;
+    int hl;
+
+    if (hl = rtp_header_len(pkt, *len), hl < 0) return hl;
+
+    payload.iov_base = pkt + hl;
+    payload.iov_len  = *len - hl;
+
+    return protect(s, st, pkt, hl, &payload, 1, pkt, len, cap);
+}
+
+int srtp_protect(struct srtp *s, uint8_t *pkt, size_t *len, size_t cap) {
+    struct srtp_stream *st;
+    uint32_t ssrc;
+
+    if (!s || !pkt || !len || !s->profile) return -URTC_ERR_BAD_ARGUMENT;
+    if (*len < 12) return -URTC_ERR_MALFORMED;
+
+    ssrc = load32(pkt + 8);
+
+    if (st = stream_find(s, ssrc), !st) return -URTC_ERR_INSUFFICIENT_MEMORY;
+    st->used = true;
+    st->ssrc = ssrc;
+
+    return protect_inplace(s, st, pkt, len, cap);
+}
+
+int srtp_protect_iov(
+    struct srtp *s,
+    const uint8_t *hdr,
+    size_t hdr_len,
+    const struct iovec *iov,
+    int iovcnt,
+    uint8_t *out,
+    size_t *len,
+    size_t cap
+) {
+    struct srtp_stream *st;
+    uint32_t ssrc;
+    int hl;
+
+    if (!s || !hdr || !out || !len || !s->profile) {
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    if (iovcnt < 0 || (iovcnt && !iov)) return -URTC_ERR_BAD_ARGUMENT;
+
+    // header must be complete, including csrcs and extension
+    hl = rtp_header_len(hdr, hdr_len);
+    if (hl < 0 || (size_t)hl != hdr_len) return -URTC_ERR_MALFORMED;
+
+    ssrc = load32(hdr + 8);
+
+    if (st = stream_find(s, ssrc), !st) return -URTC_ERR_INSUFFICIENT_MEMORY;
+    st->used = true;
+    st->ssrc = ssrc;
+
+    return protect(s, st, hdr, hdr_len, iov, iovcnt, out, len, cap);
+}
+
+int srtp_protect_batch(struct srtp *s, struct srtp_packet *pkts, size_t count) {
+    struct srtp_stream *st = NULL;
+    uint32_t ssrc;
+    int rv;
+
+    if (!s || !pkts || !s->profile) return -URTC_ERR_BAD_ARGUMENT;
+
+    for (size_t i = 0; i < count; i++) {
+        struct srtp_packet *p = &pkts[i];
+
+        if (!p->data || p->len < 12) return -URTC_ERR_MALFORMED;
+
+        // packets of a frame share an ssrc; look it up once
+        ssrc = load32(p->data + 8);
+        if (!st || st->ssrc != ssrc) {
+            st = stream_find(s, ssrc);
+            if (!st) return -URTC_ERR_INSUFFICIENT_MEMORY;
+            st->used = true;
+            st->ssrc = ssrc;
+        }
+
+        rv = protect_inplace(s, st, p->data, &p->len, p->cap);
+        if (rv < 0) return rv;
+    }
+
+    return 0;
+}
+
+int srtp_unprotect(struct srtp *s, uint8_t *pkt, size_t *len) {
+    uint8_t iv[SRTP_IV_SIZE], roc[4], tag[SRTP_AUTH_KEY_SIZE];
+    struct srtp_stream *st;
+    uint32_t ssrc, v;
+    uint64_t index;
+    uint16_t seq;
+    size_t n;
+    int hl, rv;
+
+    if (!s || !pkt || !len || !s->profile) return -URTC_ERR_BAD_ARGUMENT;
+    if (*len < s->tag_len) return -URTC_ERR_MALFORMED;
+
+    n = *len - s->tag_len;
+    if (hl = rtp_header_len(pkt, n), hl < 0) return hl;
+
+    seq  = (pkt[2] << 8) | pkt[3];
+    ssrc = load32(pkt + 8);
+
+    if (st = stream_find(s, ssrc), !st) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    v = estimate_roc(st, seq);
+    index = ((uint64_t)v << 16) | seq;
+
+    // duplicates (e.g. nack retransmissions) cost no cipher work
+    rv = replay_check(st->replay, st->seq_init,
+        ((uint64_t)st->roc << 16) | st->s_l, index);
+    if (rv < 0) return rv;
+
+    if (s->aead) {
+        // decrypts and verifies in one pass
+        make_gcm_iv(iv, s->rtp_salt, ssrc, index);
+        if (aead_crypt(st->rtp_cipher, 0, iv, pkt, hl, NULL, 0, pkt + hl,
+                n - hl, pkt + n, s->tag_len) < 0) {
+            return -URTC_ERR;
+        }
+    } else {
+        // authenticate before decrypting
+        store32(roc, v);
+        if (authenticate(st->rtp_mac, pkt, n, roc, sizeof(roc), tag) < 0) {
+            return -URTC_ERR;
+        }
+        if (CRYPTO_memcmp(tag, pkt + n, s->tag_len)) return -URTC_ERR;
+
+        make_iv(iv, s->rtp_salt, ssrc, index);
+        if (apply_keystream(st->rtp_cipher, iv, pkt + hl, n - hl) < 0) {
+            return -URTC_ERR;
+        }
+    }
+
+    st->used = true;
+    st->ssrc = ssrc;
+    replay_update(st->replay, st->seq_init,
+        ((uint64_t)st->roc << 16) | st->s_l, index);
+    update_roc(st, seq, v);
+
+    *len = n;
+
+    return 0;
+}
+
+int srtcp_protect(struct srtp *s, uint8_t *pkt, size_t *len, size_t cap) {
+    uint8_t iv[SRTP_IV_SIZE], tag[SRTP_AUTH_KEY_SIZE], trailer[4];
+    struct srtp_stream *st;
+    uint32_t ssrc, index;
+
+    if (!s || !pkt || !len || !s->profile) return -URTC_ERR_BAD_ARGUMENT;
+    if (*len < 8 || 2 != (pkt[0] >> 6)) return -URTC_ERR_MALFORMED;
+    if (*len + SRTCP_INDEX_SIZE + s->rtcp_tag_len > cap) {
+        return -URTC_ERR_INSUFFICIENT_MEMORY;
+    }
+
+    // streams are keyed by the ssrc of the first packet's sender
+    ssrc = load32(pkt + 4);
+
+    if (st = stream_find(s, ssrc), !st) return -URTC_ERR_INSUFFICIENT_MEMORY;
+    st->used = true;
+    st->ssrc = ssrc;
+
+    index = st->rtcp_index;
+    st->rtcp_index = (st->rtcp_index + 1) & SRTCP_INDEX_MASK;
+    store32(trailer, SRTCP_E_FLAG | index);
+
+    // first header and e-flag/index are aad; tag precedes e-flag/index
+    if (s->aead) {
+        make_gcm_iv(iv, s->rtcp_salt, ssrc, index);
+        if (aead_crypt(st->rtcp_cipher, 1, iv, pkt, 8, trailer,
+                sizeof(trailer), pkt + 8, *len - 8, pkt + *len,
+                s->rtcp_tag_len) < 0) {
+            return -URTC_ERR;
+        }
+        *len += s->rtcp_tag_len;
+        memcpy(pkt + *len, trailer, sizeof(trailer));
+        *len += sizeof(trailer);
+        return 0;
+    }
+
+    // encrypt all but the first header [^RFC3711 3.4]
+    make_iv(iv, s->rtcp_salt, ssrc, index);
+    if (apply_keystream(st->rtcp_cipher, iv, pkt + 8, *len - 8) < 0) {
+        return -URTC_ERR;
+    }
+
+    // e-flag and index are authenticated, tag is appended after
+    memcpy(pkt + *len, trailer, sizeof(trailer));
+    *len += sizeof(trailer);
+
+    if (authenticate(st->rtcp_mac, pkt, *len, NULL, 0, tag) < 0) {
+        return -URTC_ERR;
+    }
+    memcpy(pkt + *len, tag, s->rtcp_tag_len);
+    *len += s->rtcp_tag_len;
+
+    return 0;
+}
+
+int srtcp_unprotect(struct srtp *s, uint8_t *pkt, size_t *len) {
+    uint8_t iv[SRTP_IV_SIZE], tag[SRTP_AUTH_KEY_SIZE];
+    struct srtp_stream *st;
+    uint32_t ssrc, e_index, index;
+    const uint8_t *trailer;
+    size_t n;
+    int rv;
+
+    if (!s || !pkt || !len || !s->profile) return -URTC_ERR_BAD_ARGUMENT;
+    if (*len < 8 + SRTCP_INDEX_SIZE + s->rtcp_tag_len) {
+        return -URTC_ERR_MALFORMED;
+    }
+    if (2 != (pkt[0] >> 6)) return -URTC_ERR_MALFORMED;
+
+    // n covers the first header and (encrypted) body
+    n = *len - SRTCP_INDEX_SIZE - s->rtcp_tag_len;
+    ssrc = load32(pkt + 4);
+
+    if (st = stream_find(s, ssrc), !st) return -URTC_ERR_INSUFFICIENT_MEMORY;
+
+    // aead tag precedes e-flag/index, hmac tag follows it
+    trailer = s->aead ? pkt + n + s->rtcp_tag_len : pkt + n;
+    e_index = load32(trailer);
+    index = e_index & SRTCP_INDEX_MASK;
+
+    rv = replay_check(st->rtcp_replay, st->rtcp_init, st->rtcp_index, index);
+    if (rv < 0) return rv;
+
+    if (s->aead) {
+        // unencrypted packets are authenticated in full [^RFC7714 9.3]
+        make_gcm_iv(iv, s->rtcp_salt, ssrc, index);
+        if (e_index & SRTCP_E_FLAG) {
+            if (aead_crypt(st->rtcp_cipher, 0, iv, pkt, 8, trailer,
+                    SRTCP_INDEX_SIZE, pkt + 8, n - 8, pkt + n,
+                    s->rtcp_tag_len) < 0) {
+                return -URTC_ERR;
+            }
+        } else {
+            if (aead_crypt(st->rtcp_cipher, 0, iv, pkt, n, trailer,
+                    SRTCP_INDEX_SIZE, NULL, 0, pkt + n,
+                    s->rtcp_tag_len) < 0) {
+                return -URTC_ERR;
+            }
+        }
+    } else {
+        if (authenticate(st->rtcp_mac, pkt, n + SRTCP_INDEX_SIZE, NULL, 0,
+                tag) < 0) {
+            return -URTC_ERR;
+        }
+        if (CRYPTO_memcmp(tag, trailer + SRTCP_INDEX_SIZE, s->rtcp_tag_len)) {
+            return -URTC_ERR;
+        }
+
+        if (e_index & SRTCP_E_FLAG) {
+            make_iv(iv, s->rtcp_salt, ssrc, index);
+            if (apply_keystream(st->rtcp_cipher, iv, pkt + 8, n - 8) < 0) {
+                return -URTC_ERR;
+            }
+        }
+    }
+
+    st->used = true;
+    st->ssrc = ssrc;
+    replay_update(st->rtcp_replay, st->rtcp_init, st->rtcp_index, index);
+    if (!st->rtcp_init || index > st->rtcp_index) st->rtcp_index = index;
+    st->rtcp_init = true;
+
+    *len = n;
+
+    return 0;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,269 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_SRTP_H
+#define _URTC_SRTP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/uio.h>
+
+#include <openssl/evp.h>
+
+#define SRTP_MAX_STREAMS                 8  // ssrcs per direction
+#define SRTP_MAX_KEY_SIZE               32
+#define SRTP_MAX_SALT_SIZE              14
+#define SRTP_AUTH_KEY_SIZE              20  // hmac-sha1 session auth key
+#define SRTP_MAX_TRAILER_SIZE           20  // srtcp index + longest tag
+
+#define SRTP_REPLAY_WINDOW             128  // replay window (in packets)
+#define SRTP_REPLAY_WORDS   (SRTP_REPLAY_WINDOW / 64)
+
+// Protection profiles, numbered as in DTLS-SRTP [^RFC5764 4.1.2]
+enum srtp_profile {
+    SRTP_PROFILE_NULL = 0,
+    SRTP_PROFILE_AES128_CM_SHA1_80 = 0x0001,
+    SRTP_PROFILE_AES128_CM_SHA1_32 = 0x0002,
+    SRTP_PROFILE_AEAD_AES_128_GCM  = 0x0007,  // [^RFC7714]
+    SRTP_PROFILE_AEAD_AES_256_GCM  = 0x0008
+};
+
+/**
+ * Per-SSRC cryptographic context
+ *
+ * Cipher and MAC contexts are keyed once, when the session is created, and
+ * reused for every packet of the stream. AEAD profiles authenticate within
+ * the cipher and have no MAC contexts.
+ */
+struct srtp_stream {
+    uint32_t ssrc;
+    bool     used;
+
+    // rtp
+    EVP_CIPHER_CTX *rtp_cipher;
+    EVP_MAC_CTX    *rtp_mac;
+    uint32_t roc;                       // rollover counter
+    uint16_t s_l;                       // highest sequence number seen
+    bool     seq_init;
+    uint64_t replay[SRTP_REPLAY_WORDS]; // bit n set: index (highest - n) seen
+
+    // rtcp
+    EVP_CIPHER_CTX *rtcp_cipher;
+    EVP_MAC_CTX    *rtcp_mac;
+    uint32_t rtcp_index;                // next (or highest seen) index
+    bool     rtcp_init;
+    uint64_t rtcp_replay[SRTP_REPLAY_WORDS];
+};
+
+/**
+ * SRTP session for one direction of one peer connection
+ */
+struct srtp {
+    enum srtp_profile profile;
+    bool aead;                          // aes-gcm, else aes-cm + hmac-sha1
+    size_t salt_len;                    // session salt length
+    size_t tag_len;                     // srtp auth tag length
+    size_t rtcp_tag_len;                // srtcp auth tag length
+
+    // session salts (session keys live only inside the contexts)
+    uint8_t rtp_salt[SRTP_MAX_SALT_SIZE];
+    uint8_t rtcp_salt[SRTP_MAX_SALT_SIZE];
+
+    struct srtp_stream streams[SRTP_MAX_STREAMS];
+};
+
+/**
+ * SRTP key derivation function [^RFC3711 4.3.1], key derivation rate zero
+ *
+ * \param key Master key.
+ * \param key_len Master key length (in bytes).
+ * \param salt Master salt (14 bytes, zero-padded if shorter).
+ * \param label Key label (0-5).
+ * \param[out] out Derived session key material.
+ * \param n Bytes of key material to derive.
+ *
+ * \return 0 on success, negative on error.
+ */
+int srtp_derive(
+    const uint8_t *key,
+    size_t key_len,
+    const uint8_t *salt,
+    uint8_t label,
+    uint8_t *out,
+    size_t n
+);
+
+/**
+ * Create session from DTLS-SRTP master key and salt
+ *
+ * Derives session keys and allocates and keys contexts for all
+ * SRTP_MAX_STREAMS streams up front. Nothing is allocated per packet.
+ *
+ * \param s Session (zero-initialized).
+ * \param profile Negotiated protection profile.
+ * \param key Master key (16 or 32 bytes, per profile).
+ * \param salt Master salt (14 bytes, or 12 for AEAD profiles).
+ *
+ * \return 0 on success, negative on error.
+ */
+int srtp_init(
+    struct srtp *s,
+    enum srtp_profile profile,
+    const uint8_t *key,
+    const uint8_t *salt
+);
+
+/**
+ * Free session contexts and wipe keys
+ */
+void srtp_free(struct srtp *s);
+
+/**
+ * Protect RTP packet in place
+ *
+ * Encrypts payload and appends authentication tag.
+ *
+ * \param s Outbound session.
+ * \param pkt RTP packet.
+ * \param[in,out] len Packet length before and after protection.
+ * \param cap Capacity of packet buffer (at least *len + tag length).
+ *
+ * \return 0 on success, negative on error.
+ */
+int srtp_protect(struct srtp *s, uint8_t *pkt, size_t *len, size_t cap);
+
+/**
+ * Protect RTP packet gathered from header and payload fragments
+ *
+ * The payload is encrypted straight from its fragments (e.g. in the
+ * encoder's output buffer) into \a out, so it is never copied beforehand.
+ *
+ * \param s Outbound session.
+ * \param hdr Complete RTP header.
+ * \param hdr_len Header length.
+ * \param iov Payload fragments, in order.
+ * \param iovcnt Number of payload fragments.
+ * \param[out] out Protected packet.
+ * \param[out] len Protected packet length.
+ * \param cap Capacity of \a out.
+ *
+ * \return 0 on success, negative on error.
+ */
+int srtp_protect_iov(
+    struct srtp *s,
+    const uint8_t *hdr,
+    size_t hdr_len,
+    const struct iovec *iov,
+    int iovcnt,
+    uint8_t *out,
+    size_t *len,
+    size_t cap
+);
+
+/**
+ * Packet of a protection batch
+ */
+struct srtp_packet {
+    uint8_t *data;
+    size_t len;                         // in: plaintext, out: protected
+    size_t cap;                         // capacity of data
+};
+
+/**
+ * Protect a batch of RTP packets in place, e.g. all packets of one frame
+ *
+ * Equivalent to calling srtp_protect() on each packet in order, but the
+ * stream is looked up once per run of packets with the same SSRC and the
+ * same cipher context is driven back to back without interleaving other
+ * work, keeping its key schedule and the AES pipeline warm.
+ *
+ * \param s Outbound session.
+ * \param pkts Packets.
+ * \param count Number of packets.
+ *
+ * \return 0 on success, negative on error. On error, packets before the
+ *         failing one have been protected.
+ */
+int srtp_protect_batch(struct srtp *s, struct srtp_packet *pkts, size_t count);
+
+/**
+ * Unprotect SRTP packet in place
+ *
+ * Rejects replayed and too old packets before spending any cipher work,
+ * then authenticates, decrypts payload and strips authentication tag. AEAD
+ * profiles verify while decrypting, so on failure the payload is undefined.
+ *
+ * \param s Inbound session.
+ * \param pkt SRTP packet.
+ * \param[in,out] len Packet length before and after unprotection.
+ *
+ * \return 0 on success, -URTC_ERR_SRTP_REPLAYED on replay, other negative
+ *         values on error (e.g. authentication failure).
+ */
+int srtp_unprotect(struct srtp *s, uint8_t *pkt, size_t *len);
+
+/**
+ * Protect RTCP (compound) packet in place
+ *
+ * Encrypts all but the first eight bytes, appends SRTCP index and
+ * authentication tag (in the order required by the profile).
+ *
+ * \param s Outbound session.
+ * \param pkt RTCP packet.
+ * \param[in,out] len Packet length before and after protection.
+ * \param cap Capacity of packet buffer.
+ *
+ * \return 0 on success, negative on error.
+ */
+int srtcp_protect(struct srtp *s, uint8_t *pkt, size_t *len, size_t cap);
+
+/**
+ * Unprotect SRTCP packet in place
+ *
+ * Replay protection is the same as for SRTP, keyed by SRTCP index.
+ *
+ * \param s Inbound session.
+ * \param pkt SRTCP packet.
+ * \param[in,out] len Packet length before and after unprotection.
+ *
+ * \return 0 on success, -URTC_ERR_SRTP_REPLAYED on replay, other negative
+ *         values on error.
+ */
+int srtcp_unprotect(struct srtp *s, uint8_t *pkt, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_SRTP_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
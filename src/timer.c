@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * One-shot timers for the peer connection runloop.
+ *
+ * The runloop blocks in poll() with a timeout derived from the earliest
+ * deadline, then services expired timers. There is no timer thread and no
+ * timer file descriptor, keeping the implementation portable.
+ */
+
+#include <time.h>                       // clock_gettime
+
+#include "timer.h"
+
+uint64_t timer_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void timer_arm(struct timers *t, int id, uint64_t us) {
+    if (id < 0 || id >= TIMERS_MAX) return;
+    t->deadline[id] = timer_now_us() + us;
+    // zero is reserved for disarmed
+    if (0 == t->deadline[id]) t->deadline[id] = 1;
+}
+
+void timer_disarm(struct timers *t, int id) {
+    if (id < 0 || id >= TIMERS_MAX) return;
+    t->deadline[id] = 0;
+}
+
+int timer_poll_timeout(const struct timers *t, int cap) {
+    uint64_t earliest = 0;
+
+    for (int i = 0; i < TIMERS_MAX; i++) {
+        if (t->deadline[i] && (!earliest || t->deadline[i] < earliest)) {
+            earliest = t->deadline[i];
+        }
+    }
+    if (!earliest) return cap;
+
+    uint64_t now = timer_now_us();
+    if (earliest <= now) return 0;
+
+    uint64_t ms = (earliest - now + 999) / 1000;
+    if (cap >= 0 && ms > (uint64_t)cap) return cap;
+
+    return (int)ms;
+}
+
+int timer_expired(struct timers *t) {
+    uint64_t now = timer_now_us();
+
+    for (int i = 0; i < TIMERS_MAX; i++) {
+        if (t->deadline[i] && t->deadline[i] <= now) {
+            t->deadline[i] = 0;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_TIMER_H
+#define _URTC_TIMER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define TIMERS_MAX                      16  // timers per runloop
+
+/**
+ * One-shot timers serviced by a runloop
+ *
+ * Timers are identified by a small integer chosen by the runloop owner. A
+ * deadline of zero means the timer is disarmed. Deadlines are in
+ * microseconds on the monotonic clock.
+ */
+struct timers {
+    uint64_t deadline[TIMERS_MAX];
+};
+
+/**
+ * Current monotonic time (in microseconds)
+ */
+uint64_t timer_now_us(void);
+
+/**
+ * Arm (or re-arm) a timer
+ *
+ * \param t Timer set.
+ * \param id Timer identifier, less than TIMERS_MAX.
+ * \param us Microseconds from now until expiry.
+ */
+void timer_arm(struct timers *t, int id, uint64_t us);
+
+/**
+ * Disarm a timer
+ *
+ * \param t Timer set.
+ * \param id Timer identifier, less than TIMERS_MAX.
+ */
+void timer_disarm(struct timers *t, int id);
+
+/**
+ * Milliseconds until the earliest armed timer expires, suitable for poll()
+ *
+ * \param t Timer set.
+ * \param cap Upper bound on returned value, or negative for none.
+ *
+ * \return Timeout in milliseconds (rounded up), or \a cap if no timer is
+ *         armed.
+ */
+int timer_poll_timeout(const struct timers *t, int cap);
+
+/**
+ * Pop one expired timer
+ *
+ * The returned timer is disarmed before returning. Call repeatedly until
+ * negative to service all expired timers.
+ *
+ * \param t Timer set.
+ *
+ * \return Identifier of an expired timer, or negative if none expired.
+ */
+int timer_expired(struct timers *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_TIMER_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
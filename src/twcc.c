@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Receive side of transport-wide congestion control [^TWCC]
+ */
+
+#include <string.h>                     // memset
+
+#include "err.h"
+#include "rtcp.h"                       // rtcp_write_twcc
+#include "twcc.h"
+
+void twcc_init(struct twcc *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+void twcc_put(struct twcc *t, uint16_t seq, int64_t arrival_us) {
+    uint16_t ahead = seq - t->base;
+
+    if (!t->started) {
+        t->started = true;
+        t->base = seq;
+        t->end = seq + 1;
+        t->first_us = arrival_us;
+    } else if (ahead >= 0x8000) {
+        // already reported, unless the sender jumped far back
+        if ((uint16_t)(t->base - seq) <= TWCC_WINDOW) return;
+        t->base = seq;
+        t->end = seq + 1;
+    } else {
+        // packets falling out of the window are not reported
+        if (ahead >= TWCC_WINDOW) t->base = seq - TWCC_WINDOW + 1;
+        if ((uint16_t)(seq - t->end) < 0x8000) t->end = seq + 1;
+    }
+
+    t->slot[seq & (TWCC_WINDOW - 1)].seq = seq;
+    t->slot[seq & (TWCC_WINDOW - 1)].received = true;
+    t->slot[seq & (TWCC_WINDOW - 1)].arrival_us = arrival_us - t->first_us;
+}
+
+int twcc_write(
+    struct twcc *t,
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    uint32_t media
+) {
+    struct rtcp_twcc_status st[RTCP_TWCC_MAX_STATUSES];
+    size_t n;
+    int rv;
+
+    if (!t || !pkt) return -URTC_ERR_BAD_ARGUMENT;
+    if (!t->started || t->base == t->end) return 0;
+
+    n = (uint16_t)(t->end - t->base);
+    if (n > RTCP_TWCC_MAX_STATUSES) n = RTCP_TWCC_MAX_STATUSES;
+
+    for (size_t i = 0; i < n; i++) {
+        uint16_t seq = t->base + i;
+        st[i].seq = seq;
+        st[i].received = t->slot[seq & (TWCC_WINDOW - 1)].seq == seq &&
+            t->slot[seq & (TWCC_WINDOW - 1)].received;
+        st[i].arrival_us = t->slot[seq & (TWCC_WINDOW - 1)].arrival_us;
+    }
+
+    rv = rtcp_write_twcc(pkt, cap, sender, media, t->fb_count, st, &n);
+    if (rv < 0) return rv;
+
+    for (size_t i = 0; i < n; i++) {
+        t->slot[(uint16_t)(t->base + i) & (TWCC_WINDOW - 1)].received = false;
+    }
+    t->base += n;
+    t->fb_count++;
+
+    return rv;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_TWCC_H
+#define _URTC_TWCC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TWCC_WINDOW                   1024  // packets tracked, pow. of 2
+
+/**
+ * Arrivals to report in transport-wide feedback [^TWCC 3.1]
+ *
+ * The receiver notes when each packet carrying a transport-wide sequence
+ * number arrived, and from time to time reports every packet since the last
+ * report, up to the highest received, as received or lost. A packet
+ * arriving after it was reported lost is not reported again.
+ *
+ * Arrival times are kept relative to the first arrival, so the feedback's
+ * 24-bit reference time does not wrap within a session.
+ *
+ * [^TWCC]: draft-holmer-rmcat-transport-wide-cc-extensions-01
+ */
+struct twcc {
+    bool started;
+    uint16_t base;                      // first sequence number not reported
+    uint16_t end;                       // one past highest received
+    int64_t first_us;                   // arrival of first packet
+    uint8_t fb_count;                   // feedback packets written
+
+    struct {
+        int64_t arrival_us;             // since first arrival
+        uint16_t seq;
+        bool received;
+    } slot[TWCC_WINDOW];
+};
+
+/**
+ * Initialize arrival record
+ */
+void twcc_init(struct twcc *t);
+
+/**
+ * Record arrival of packet
+ *
+ * \param t Arrival record.
+ * \param seq Transport-wide sequence number.
+ * \param arrival_us Arrival time (in microseconds), on any clock.
+ */
+void twcc_put(struct twcc *t, uint16_t seq, int64_t arrival_us);
+
+/**
+ * Write feedback on arrivals since the last feedback
+ *
+ * If more arrived than fit in one packet, call again for the rest.
+ *
+ * \param t Arrival record.
+ * \param pkt Destination.
+ * \param cap Capacity of destination.
+ * \param sender SSRC of packet sender.
+ * \param media SSRC of a media source reported on.
+ *
+ * \return Size of packet, 0 if nothing to report, or negative on error.
+ */
+int twcc_write(
+    struct twcc *t,
+    uint8_t *pkt,
+    size_t cap,
+    uint32_t sender,
+    uint32_t media
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_TWCC_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Batched datagram transmission, with optional kernel pacing.
+ *
+ * On Linux, a batch is sent with one sendmmsg() call and, if enabled,
+ * each datagram is stamped with its departure time in an SCM_TXTIME
+ * control message. Elsewhere, datagrams are sent one sendmsg() at a time.
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE                     // sendmmsg
+#endif
+
+#include <errno.h>                      // errno
+#include <string.h>                     // memset, strerror
+#include <time.h>                       // CLOCK_MONOTONIC
+
+#include <sys/socket.h>                 // sendmsg, sendmmsg
+
+#if defined(SO_TXTIME)
+#include <linux/net_tstamp.h>           // struct sock_txtime
+#endif
+
+#include "err.h"
+#include "log.h"
+#include "txq.h"
+
+void txq_init(struct txq *q, int fd) {
+    q->fd = fd;
+    q->txtime = false;
+    q->count = 0;
+}
+
+int txq_enable_txtime(struct txq *q) {
+#if defined(SO_TXTIME)
+    struct sock_txtime cfg = { .clockid = CLOCK_MONOTONIC, .flags = 0 };
+
+    if (0 != setsockopt(q->fd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg))) {
+        urtc_log(URTC_WARN, "[txq] SO_TXTIME: %s", strerror(errno));
+        return -URTC_ERR_NOT_IMPLEMENTED;
+    }
+    q->txtime = true;
+
+    return 0;
+#else
+    return -URTC_ERR_NOT_IMPLEMENTED;
+#endif
+}
+
+uint8_t *txq_next(struct txq *q) {
+    return q->count < TXQ_BATCH ? q->bufs[q->count] : NULL;
+}
+
+void txq_commit(struct txq *q, size_t len, uint64_t at) {
+    if (q->count >= TXQ_BATCH) return;
+    q->iov[q->count].iov_base = q->bufs[q->count];
+    q->iov[q->count].iov_len = len;
+    q->at[q->count] = at;
+    q->count++;
+}
+
+int txq_flush(struct txq *q, const struct sockaddr_in *to) {
+    struct msghdr msgs[TXQ_BATCH];
+#if defined(SO_TXTIME)
+    union {
+        char buf[CMSG_SPACE(sizeof(uint64_t))];
+        struct cmsghdr align;
+    } ctl[TXQ_BATCH];
+#endif
+    int n = q->count, sent = 0;
+
+    q->count = 0;
+    if (!n) return 0;
+
+    for (int i = 0; i < n; i++) {
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_name = (void *)to;
+        msgs[i].msg_namelen = sizeof(*to);
+        msgs[i].msg_iov = &q->iov[i];
+        msgs[i].msg_iovlen = 1;
+#if defined(SO_TXTIME)
+        if (q->txtime) {
+            uint64_t ns = q->at[i] * 1000;
+            struct cmsghdr *c;
+            msgs[i].msg_control = ctl[i].buf;
+            msgs[i].msg_controllen = sizeof(ctl[i].buf);
+            c = CMSG_FIRSTHDR(&msgs[i]);
+            c->cmsg_level = SOL_SOCKET;
+            c->cmsg_type = SCM_TXTIME;
+            c->cmsg_len = CMSG_LEN(sizeof(ns));
+            memcpy(CMSG_DATA(c), &ns, sizeof(ns));
+        }
+#endif
+    }
+
+#if defined(__linux__)
+    struct mmsghdr mmsgs[TXQ_BATCH];
+    for (int i = 0; i < n; i++) {
+        mmsgs[i].msg_hdr = msgs[i];
+        mmsgs[i].msg_len = 0;
+    }
+    while (sent < n) {
+        int rv = sendmmsg(q->fd, mmsgs + sent, n - sent, 0);
+        if (rv < 0 && EINTR == errno) continue;
+        if (rv <= 0) break;
+        sent += rv;
+    }
+#else
+    for (; sent < n; sent++) {
+        if (sendmsg(q->fd, &msgs[sent], 0) < 0) break;
+    }
+#endif
+
+    if (sent < n) {
+        urtc_log(URTC_ERROR, "[txq] %s", strerror(errno));
+        return -URTC_ERR;
+    }
+
+    return sent;
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
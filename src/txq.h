@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_TXQ_H
+#define _URTC_TXQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define TXQ_BATCH                       32  // datagrams per system call
+#define TXQ_MAX_PACKET_SIZE           1200  // largest datagram
+
+/**
+ * Batch of outgoing datagrams to one destination
+ *
+ * Datagrams are written in place into the batch and handed to the kernel
+ * together, with one system call where available (sendmmsg). With
+ * departure times enabled, each datagram carries its earliest departure
+ * time (SCM_TXTIME), and the fq queueing discipline holds it until then,
+ * so a caller can pace packets ahead of time without waking for each one.
+ */
+struct txq {
+    int fd;
+    bool txtime;                        // stamp departure times
+    int count;
+
+    struct iovec iov[TXQ_BATCH];
+    uint64_t at[TXQ_BATCH];             // departure times (microseconds)
+    uint8_t bufs[TXQ_BATCH][TXQ_MAX_PACKET_SIZE];
+};
+
+/**
+ * Initialize empty batch
+ *
+ * \param q Batch.
+ * \param fd UDP socket.
+ */
+void txq_init(struct txq *q, int fd);
+
+/**
+ * Enable departure times on socket [^SO_TXTIME]
+ *
+ * Times are on the monotonic clock (see timer_now_us()). Requires the fq
+ * queueing discipline on the outgoing interface to take effect; without
+ * it, datagrams are sent as soon as they are flushed.
+ *
+ * \return 0 on success, negative if not supported by the platform.
+ */
+int txq_enable_txtime(struct txq *q);
+
+/**
+ * Buffer for the next datagram, TXQ_MAX_PACKET_SIZE bytes
+ *
+ * \return Buffer, or NULL if batch is full (flush first).
+ */
+uint8_t *txq_next(struct txq *q);
+
+/**
+ * Add datagram written into buffer returned by txq_next() to batch
+ *
+ * \param q Batch.
+ * \param len Size of datagram.
+ * \param at Earliest departure time (ignored unless enabled).
+ */
+void txq_commit(struct txq *q, size_t len, uint64_t at);
+
+/**
+ * Send and empty batch
+ *
+ * \param q Batch.
+ * \param to Destination.
+ *
+ * \return Number of datagrams sent, or negative on error. Datagrams not
+ *         sent are dropped.
+ */
+int txq_flush(struct txq *q, const struct sockaddr_in *to);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_TXQ_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
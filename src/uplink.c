@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Device-wide uplink budget
+ *
+ * A camera's uplink is shared by every viewer of every stream it encodes.
+ * Left to per-connection congestion control, viewers compete for it and a
+ * single slow viewer holds the encoder back for all. Instead, the uplink is
+ * divided up front, and the slowest viewers lose frames first.
+ */
+
+#include <stdbool.h>
+
+#include "uplink.h"
+
+/**
+ * Viewers in order of path estimate, fastest first
+ */
+static void rank(const struct uplink_stream *s, uint32_t unknown, int *order,
+        uint32_t *est) {
+    for (int i = 0; i < s->count; i++) {
+        uint32_t e = s->estimate_bps[i] ? s->estimate_bps[i] : unknown;
+        int j = i;
+
+        // insertion sort, as there are few viewers
+        for (; j > 0 && est[j - 1] < e; j--) {
+            est[j] = est[j - 1];
+            order[j] = order[j - 1];
+        }
+        est[j] = e;
+        order[j] = i;
+    }
+}
+
+/**
+ * Bitrate a stream could use without a budget: the most it can deliver in
+ * full, and the floor for each viewer left to thin
+ */
+static uint64_t demand(const uint32_t *est, int count, uint32_t floor_bps) {
+    uint64_t most = 0;
+
+    for (int k = 1; k <= count; k++) {
+        uint64_t b = (uint64_t)k * est[k - 1] +
+            (uint64_t)(count - k) * floor_bps;
+        if (b > most) most = b;
+    }
+
+    return most;
+}
+
+/**
+ * Choose encoder target and viewer modes within a stream's share
+ */
+static void serve(struct uplink_stream *s, uint64_t share, const int *order,
+        const uint32_t *est) {
+    uint64_t best = 0, left;
+    uint32_t target = 0;
+    int served = 0;
+
+    // from all viewers down, thin the slowest only for a real gain
+    for (int k = s->count; k >= 1; k--) {
+        uint64_t r = share / k < est[k - 1] ? share / k : est[k - 1];
+        if (r < s->floor_bps) continue;
+        if (!served || k * r > best * UPLINK_THIN_GAIN) {
+            best = k * r;
+            target = r;
+            served = k;
+        }
+    }
+
+    s->target_bps = served ? target : s->floor_bps;
+    left = share - best;
+    for (int k = 0; k < s->count; k++) {
+        if (k < served) {
+            s->mode[order[k]] = UPLINK_FULL;
+        } else if (left >= s->floor_bps) {
+            s->mode[order[k]] = UPLINK_THIN;
+            left -= s->floor_bps;
+        } else {
+            s->mode[order[k]] = UPLINK_DROP;
+        }
+    }
+}
+
+void uplink_allocate(uint32_t budget_bps, struct uplink_stream *s, int count) {
+    int order[UPLINK_MAX_STREAMS][UPLINK_MAX_VIEWERS];
+    uint32_t est[UPLINK_MAX_STREAMS][UPLINK_MAX_VIEWERS];
+    uint64_t want[UPLINK_MAX_STREAMS], share[UPLINK_MAX_STREAMS];
+    bool done[UPLINK_MAX_STREAMS];
+    uint64_t left = budget_bps;
+    bool again = true;
+
+    if (!s || count < 0) return;
+    if (count > UPLINK_MAX_STREAMS) count = UPLINK_MAX_STREAMS;
+
+    for (int i = 0; i < count; i++) {
+        if (s[i].count > UPLINK_MAX_VIEWERS) s[i].count = UPLINK_MAX_VIEWERS;
+        if (s[i].count < 0) s[i].count = 0;
+        rank(&s[i], budget_bps, order[i], est[i]);
+        want[i] = demand(est[i], s[i].count, s[i].floor_bps);
+        share[i] = 0;
+        done[i] = !want[i];
+    }
+
+    // weighted fair shares, passing on what a stream cannot use
+    while (again) {
+        uint64_t weights = 0;
+
+        again = false;
+        for (int i = 0; i < count; i++) {
+            if (!done[i]) weights += s[i].weight ? s[i].weight : 1;
+        }
+        if (!weights) break;
+
+        for (int i = 0; i < count; i++) {
+            uint64_t fair;
+            if (done[i]) continue;
+            fair = left * (s[i].weight ? s[i].weight : 1) / weights;
+            if (want[i] <= fair) {
+                share[i] = want[i];
+                left -= want[i];
+                done[i] = again = true;
+            }
+        }
+        if (again) continue;
+
+        for (int i = 0; i < count; i++) {
+            if (!done[i]) share[i] = left * (s[i].weight ? s[i].weight : 1) /
+                weights;
+        }
+    }
+
+    for (int i = 0; i < count; i++) serve(&s[i], share[i], order[i], est[i]);
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
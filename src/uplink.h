@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_UPLINK_H
+#define _URTC_UPLINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UPLINK_MAX_STREAMS              16  // encoder streams sharing uplink
+#define UPLINK_MAX_VIEWERS              32  // per stream
+#define UPLINK_DEFAULT_FLOOR        150000  // least bitrate worth watching
+#define UPLINK_THIN_GAIN              1.05  // bitrate gained to thin a viewer
+
+/**
+ * What a viewer is sent of its stream
+ */
+enum uplink_mode {
+    UPLINK_FULL = 0,                    // every frame
+    UPLINK_THIN,                        // keyframes only
+    UPLINK_DROP                         // nothing
+};
+
+/**
+ * One encoded stream and its viewers, as allocated by uplink_allocate()
+ */
+struct uplink_stream {
+    // in
+    unsigned weight;                    // relative share of uplink
+    uint32_t floor_bps;                 // least bitrate a viewer is sent
+    uint32_t estimate_bps[UPLINK_MAX_VIEWERS];  // of each path, 0 if unknown
+    int count;                          // viewers
+
+    // out
+    uint32_t target_bps;                // encoder target
+    enum uplink_mode mode[UPLINK_MAX_VIEWERS];
+};
+
+/**
+ * Share uplink between streams, and choose each stream's encoder target
+ *
+ * Every viewer of a stream is sent its own copy, so a stream costs its
+ * bitrate once per viewer served in full. The budget is divided between
+ * streams in proportion to weight, with any share a stream cannot use (as
+ * its viewers' paths are slower) passed on to the others.
+ *
+ * Within a stream, the encoder target is limited by the share split between
+ * the viewers served in full, and by the slowest of their paths. Viewers
+ * are served in full from the fastest path down, as many as keep the target
+ * at or above the floor. Slower viewers are thinned only if that raises
+ * the bitrate delivered by more than UPLINK_THIN_GAIN, so one slow path
+ * does not hold back all the others. Viewers not served in full are sent
+ * keyframes only while the share left over allows the floor for each,
+ * fastest first, and are dropped after that.
+ *
+ * \param budget_bps Uplink bitrate (in bits per second).
+ * \param s Streams.
+ * \param count Number of streams.
+ */
+void uplink_allocate(uint32_t budget_bps, struct uplink_stream *s, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_UPLINK_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -41,23 +41,73 @@
 #include <sys/types.h>
 
 #include "b64.h"                        // b64_encode
+#include "bcast.h"                      // bcast_join, bcast_send_frame
+#include "cert.h"                       // cert_acquire
+#include "dtls.h"                       // dtls_start, dtls_recv
 #include "err.h"
+#include "fec.h"                        // fec_enc_add, fec_dec_put_source
+#include "gcc.h"                        // gcc_on_sent, gcc_on_feedback
+#include "h264.h"                       // h264_depkt_push
+#include "hist.h"                       // hist_store, hist_get
+#include "jbuf.h"                       // jbuf_put, jbuf_poll
 #include "log.h"
 #include "mdns.h"                       // mdns_subscribe, mdns_unsubscribe
+#include "pacer.h"                      // pacer_push, pacer_pop
 #include "prng.h"                       // prng_init
+#include "resume.h"                     // resume_lookup, resume_store
+#include "rtcp.h"                       // rtcp_next, rtcp_write_nack
+#include "rtp.h"                        // rtp_header_write
 #include "sdp.h"
+#include "srtp.h"                       // srtp_unprotect, srtcp_unprotect
+#include "timer.h"                      // timer_arm, timer_expired
+#include "twcc.h"                       // twcc_put, twcc_write
+#include "txq.h"                        // txq_commit, txq_flush
 #include "urtc.h"
+#include "uplink.h"                     // uplink_allocate
 #include "uuid.h"                       // uuid_create_str
+#include "workq.h"                      // workq_submit
 
 #define RX_BUF_CAP               2048   // receive buffer capacity
 
 #define POLL_TIMEOUT_MS            50   // poll() timeout (in milliseconds)
 
+#define DTLS_BACKLOG_MAX            8   // datagrams queued during handshake
+
+#define VIDEO_DEFAULT_PT           96   // if remote offers no h264 rtpmap
+#define VIDEO_HISTORY_BYTES (512 << 10)  // sent packets kept for pacing, nack
+#define VIDEO_HISTORY_MS         1000
+#define VIDEO_REPLAY_SLOTS PACER_QUEUE_SIZE  // group's packets held, by seq
+#define VIDEO_MAX_NACKS           256   // sequence numbers per nack handled
+#define VIDEO_DEFAULT_BITRATE 2000000   // until set by application
+#define VIDEO_DEFAULT_PACING      2.5   // pacing rate over target bitrate
+#define VIDEO_TXTIME_HORIZON_US 10000   // paced ahead when kernel holds packets
+#define VIDEO_BITRATE_STEP       0.05   // estimate change reported to app
+#define VIDEO_FEEDBACK_SHARE     0.02   // of received bitrate, at most
+#define VIDEO_FEEDBACK_MIN_US   50000   // between congestion feedback packets
+#define VIDEO_FEEDBACK_MAX_US  250000
+#define VIDEO_REMB_INTERVAL_US 1000000  // estimate resent, unless it drops
+#define VIDEO_REMB_DROP          0.03   // drop sent at once
+
+#define UPLINK_INTERVAL_US     200000   // between uplink budget allocations
+
+#define RTCP_IP_UDP_SIZE           28   // headers counted in average size
+#define RTCP_INITIAL_SIZE         128   // average size assumed at first
+#define RTCP_REPORT_ROOM          128   // report and cname leading feedback
+
 const static char *default_stun_servers[] = {
     "stun.liburtc.org",
     NULL
 };
 
+// device uplink shared by all broadcast groups, see urtc_set_uplink_budget()
+static struct {
+    pthread_mutex_t lock;
+    uint32_t budget_bps;                // 0 if not budgeted
+    uint64_t last_us;                   // of last allocation
+    struct bcast *groups[UPLINK_MAX_STREAMS];
+    int count;
+} uplink = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
 enum signaling_state {
     SIGNALING_STATE_STABLE = 0,
     SIGNALING_STATE_HAVE_LOCAL_OFFER,
@@ -90,22 +140,65 @@ enum rtc_event {
     EVENT_SOCKET = 0,
     EVENT_TIMER,
     EVENT_MDNS,
+    EVENT_WORK,
+    EVENT_WAKE,
     NUM_EVENTS, // must be last
 };
 
+enum rtc_timer {
+    TIMER_DTLS = 0,                     // dtls flight retransmission
+    TIMER_JBUF,                         // video playout and nack deadline
+    TIMER_PACER,                        // next paced video packet
+    TIMER_FEEDBACK,                     // video congestion feedback
+    TIMER_REPORT,                       // sender or receiver report
+    NUM_TIMERS // must be last
+};
+
+// dtls input for one handshake step
+struct handshake_batch {
+    uint8_t pkt[DTLS_BACKLOG_MAX][DTLS_MTU];
+    size_t len[DTLS_BACKLOG_MAX];
+    int count;
+    bool timeout;                       // retransmission timer expired
+};
+
+// dtls handshake crypto offloaded to worker pool
+struct handshake {
+    struct workq_job job;               // must be first
+    struct peerconn *pc;
+    int pipe[2];                        // completion notification
+    bool busy;                          // association owned by worker
+    struct handshake_batch running;     // input of job in progress
+    struct handshake_batch backlog;     // input arriving meanwhile
+};
+
+// group's payload replayed, held by reference rather than in history
+struct video_replay {
+    struct rtp_payload *p;
+    uint16_t seq;
+    uint32_t ts;                        // offset applied
+    uint64_t us;                        // when queued
+};
+
 struct peerconn {
     // socket file descriptor
     int sockfd;
 
-    // execution thread
+    // execution thread, exits at next wakeup once stop is set (under lock)
     pthread_t thread;
+    bool stop;
 
     // poll file descriptors
     struct pollfd fds[NUM_EVENTS];
 
+    // runloop timers, indexed by enum rtc_timer
+    struct timers timers;
+
+    // guards descriptions, which are set from application threads
+    pthread_mutex_t lock;
+
     // callbacks
     urtc_on_ice_candidate *on_ice_candidate;
-    urtc_force_idr *force_idr;
 
     // stun servers
     const char **stun;
@@ -116,71 +209,1599 @@ struct peerconn {
     // local and remote descriptions
     struct sdp ldesc, rdesc;
 
-    // mDNS related state
-    struct {
-        char hostname[UUID_STR_LEN];    // .local hostname
-        int  sockfd;                    // port 5353 listener
-    } mdns;
-};
+    // remote transport address (source of last peer packet)
+    struct sockaddr_in remote;
+
+    // fast-reconnect state, valid if remote peer is returning
+    struct resume_entry resume;
+    bool resuming;
+
+    // local certificate
+    X509 *cert;
+    EVP_PKEY *key;
+    uint8_t fingerprint[32];
+
+    // dtls-srtp association
+    struct dtls dtls;
+    struct handshake hs;
+    bool have_rdesc;                    // remote description set
+
+    // srtp sessions, keyed at dtls-srtp key export
+    struct srtp srtp_tx;                // protects outgoing packets
+    struct srtp srtp_rx;                // unprotects incoming packets
+
+    // outgoing video stream, sent from application threads
+    struct {
+        pthread_mutex_t lock;           // guards stream state and srtp_tx
+        bool ready;                     // srtp_tx keyed
+        uint8_t pt;                     // negotiated h264 payload type
+        uint32_t ssrc;
+        uint16_t seq;
+        uint32_t ts_offset;             // random initial timestamp
+        uint8_t rtx_pt;                 // retransmission type, 0 if none
+        uint32_t rtx_ssrc;
+        uint16_t rtx_seq;
+        uint8_t fec_pt;                 // flexfec type, 0 if none
+        uint32_t fec_ssrc;
+        uint16_t fec_seq;
+        struct fec_enc fec;
+        uint8_t twcc_ext;               // transport-wide cc id, 0 if none
+        uint16_t twcc_seq;
+        struct gcc gcc;                 // bitrate estimate, if twcc
+        int probe;                      // probe cluster being released
+        int cluster;                    // probe of packet being sent, or 0
+        uint32_t reported_bps;          // estimate last reported to app
+        uint32_t estimate_bps;          // of path, 0 until estimated
+        urtc_on_target_bitrate *bitrate_cb;
+        void *bitrate_arg;
+        struct pacer pacer;
+        int wake[2];                    // pipe, runloop paces once written
+        bool wake_pending;
+        bool txtime;                    // kernel holds packets until due
+        uint64_t at;                    // departure time of packet being sent
+        struct txq txq;                 // batch handed to kernel, if txtime
+        struct bcast *group;            // broadcast group, if joined
+        int group_users;                // runloop calls into group
+        pthread_cond_t group_idle;      // signaled when users drop to 0
+        enum uplink_mode mode;          // of group's frames, sent
+        bool resync;                    // frames skipped, wait for keyframe
+        uint32_t packets;               // sent, for sender reports
+        uint32_t octets;                // of payload sent
+        uint32_t last_ts;               // of last frame sent
+        uint64_t last_us;               // and when
+        bool fir;                       // full intra request seen
+        uint8_t fir_seq;                // of last full intra request
+        struct hist hist;               // sent packets, for retransmission
+        struct video_replay replay[VIDEO_REPLAY_SLOTS];
+        uint8_t buf[RTP_MAX_PACKET_SIZE];  // protected packet being sent
+    } video;
+
+    // incoming video stream, depacketized on the runloop
+    struct {
+        uint8_t pt;                     // negotiated h264 payload type
+        uint8_t rtx_pt;                 // retransmission type, 0 if none
+        uint8_t fec_pt;                 // flexfec type, 0 if none
+        struct fec_dec fec;
+        struct jbuf jbuf;
+        enum jbuf_profile playout;      // requested, set under lock
+        struct h264_depkt depkt;
+        urtc_on_video_frame *cb;
+        void *arg;
+        uint8_t twcc_ext;               // transport-wide cc id, 0 if none
+        struct twcc twcc;               // arrivals to report, if twcc
+        bool remb;                      // estimate sent, if not twcc
+        struct gcc gcc;                 // receive-side estimate
+        uint64_t ts_ext;                // extended rtp timestamp, 0 until set
+        uint32_t remb_bps;              // estimate last sent
+        uint64_t remb_us;               // and when
+        uint64_t feedback_us;           // interval between feedback packets
+    } video_rx;
+
+    // compound rtcp packet being built, and reports, on the runloop
+    struct {
+        uint8_t buf[RTCP_MAX_PACKET_SIZE + SRTP_MAX_TRAILER_SIZE];
+        size_t len;
+        bool rsize;                     // reduced-size packets negotiated
+        bool initial;                   // no report sent yet
+        bool we_sent;                   // video sent since last report
+        int senders;                    // sending video, of both of us
+        double avg_size;                // of compound packets sent
+        uint32_t packets;               // video packets sent at last report
+        struct rtcp_rx_stats rx;        // on incoming video
+    } rtcp;
+
+    // mDNS related state
+    struct {
+        char hostname[UUID_STR_LEN];    // .local hostname
+        int  sockfd;                    // port 5353 listener
+    } mdns;
+};
+
+
+typedef int (*event_handler)(struct peerconn *pc);
+
+static void remember_peer(struct peerconn *pc);
+static void rtcp_schedule(struct peerconn *pc);
+
+const enum rtc_state state_table[NUM_STATES][NUM_EVENTS] = {
+    { STATE_NEW, STATE_NEW },
+    { STATE_NEW, STATE_NEW },
+    { STATE_NEW, STATE_NEW },
+    { STATE_NEW, STATE_NEW },
+    { STATE_NEW, STATE_NEW },
+    { STATE_NEW, STATE_NEW },
+    { STATE_NEW, STATE_NEW },
+    { STATE_NEW, STATE_NEW },
+    { STATE_NEW, STATE_NEW }
+};
+
+/**
+ * Transmit datagram to remote peer
+ *
+ * \param pkt Datagram.
+ * \param n Size of datagram.
+ * \param arg Peer connection.
+ *
+ * \return 0 on success, negative on error.
+ */
+static int send_to_remote(const uint8_t *pkt, size_t n, void *arg) {
+    struct peerconn *pc = (struct peerconn *)arg;
+    struct sockaddr_in ra;
+
+    // may run on a worker thread during the dtls handshake
+    pthread_mutex_lock(&pc->lock);
+    ra = pc->remote;
+    pthread_mutex_unlock(&pc->lock);
+
+    if (-1 == sendto(
+        pc->sockfd,
+        pkt,
+        n,
+        0,
+        (const struct sockaddr *)&ra,
+        sizeof(ra)
+    )) {
+        urtc_log(URTC_ERROR, "%s", strerror(errno));
+        return -URTC_ERR;
+    }
+
+    return 0;
+}
+
+/**
+ * (Re)arm DTLS retransmission timer from association state
+ *
+ * \param pc Peer connection.
+ */
+static void dtls_arm_timer(struct peerconn *pc) {
+    uint64_t us;
+
+    if (0 == dtls_timeout(&pc->dtls, &us)) {
+        timer_arm(&pc->timers, TIMER_DTLS, us);
+    } else {
+        timer_disarm(&pc->timers, TIMER_DTLS);
+    }
+}
+
+/**
+ * Start DTLS association in role negotiated by local description
+ *
+ * Answerers take the active (client) role unless the remote offer is active.
+ *
+ * \param pc Peer connection.
+ *
+ * \return 0 on success, negative on error.
+ */
+static int dtls_begin(struct peerconn *pc) {
+    bool client;
+    uint8_t fingerprint[32];
+    int rv;
+
+    pthread_mutex_lock(&pc->lock);
+    client = SDP_SETUP_PASSIVE != pc->ldesc.setup &&
+             SDP_SETUP_ACTIVE != pc->rdesc.setup;
+    memcpy(fingerprint, pc->rdesc.fingerprint.sha256, sizeof(fingerprint));
+    pthread_mutex_unlock(&pc->lock);
+
+    rv = dtls_start(
+        &pc->dtls,
+        client,
+        fingerprint,
+        pc->cert,
+        pc->key,
+        pc->resuming ? pc->resume.ticket : NULL,
+        pc->resuming ? pc->resume.ticket_len : 0,
+        send_to_remote,
+        pc
+    );
+    if (rv < 0) {
+        urtc_log(URTC_ERROR, "[dtls] failed to start (%d)", rv);
+        return rv;
+    }
+
+    dtls_arm_timer(pc);
+
+    return 0;
+}
+
+/**
+ * Ask the encoder of the broadcast group, if any, for a keyframe
+ *
+ * \param pc Peer connection.
+ */
+static void video_request_idr(struct peerconn *pc) {
+    struct bcast *g;
+
+    // the group outlives the call, see urtc_bcast_leave()
+    pthread_mutex_lock(&pc->video.lock);
+    if (g = pc->video.group, g) pc->video.group_users++;
+    pthread_mutex_unlock(&pc->video.lock);
+    if (!g) return;
+
+    bcast_request_idr(g, true, timer_now_us());
+
+    pthread_mutex_lock(&pc->video.lock);
+    if (0 == --pc->video.group_users) {
+        pthread_cond_broadcast(&pc->video.group_idle);
+    }
+    pthread_mutex_unlock(&pc->video.lock);
+}
+
+/**
+ * React to DTLS association state transition
+ *
+ * \param pc Peer connection.
+ */
+static void dtls_state_change(struct peerconn *pc) {
+    struct dtls_srtp_keys *k = &pc->dtls.keys;
+    int n;
+
+    switch (pc->dtls.state) {
+    case DTLS_STATE_CONNECTED:
+        // create per-ssrc contexts once, reused for every packet
+        pthread_mutex_lock(&pc->video.lock);
+        if (srtp_init(&pc->srtp_tx, k->profile, k->local_key,
+                k->local_salt) < 0 ||
+            srtp_init(&pc->srtp_rx, k->profile, k->remote_key,
+                k->remote_salt) < 0 ||
+            hist_init(&pc->video.hist, VIDEO_HISTORY_BYTES,
+                VIDEO_HISTORY_MS) < 0) {
+            urtc_log(URTC_ERROR, "[srtp] session setup failed");
+        } else {
+            pc->video.ready = true;
+            // nothing decodes before a keyframe: start from the group's
+            // last one, or ask for one (see bcast_send_frame())
+            pc->video.resync = true;
+            // find the available bitrate quickly, from the first frames
+            if (pc->video.twcc_ext) gcc_probe_start(&pc->video.gcc);
+        }
+        pthread_mutex_unlock(&pc->video.lock);
+
+        // remember pair and session for a fast reconnect
+        n = dtls_get_session(
+            &pc->dtls,
+            pc->resume.ticket,
+            sizeof(pc->resume.ticket)
+        );
+        pc->resume.ticket_len = n > 0 ? n : 0;
+        remember_peer(pc);
+
+        // first report goes out in half the usual interval
+        pc->rtcp.initial = true;
+        pc->rtcp.avg_size = RTCP_INITIAL_SIZE;
+        rtcp_schedule(pc);
+        break;
+
+    case DTLS_STATE_FAILED:
+        // stale cached state must not slow down the next attempt
+        if (pc->resuming) {
+            resume_forget(pc->rdesc.fingerprint.sha256);
+            pc->resuming = false;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Run one handshake step (on a worker thread)
+ *
+ * Handshake messages carry ECDHE key exchange and ECDSA signatures, costing
+ * milliseconds each on embedded processors. The association is owned by the
+ * worker until completion is posted back to the runloop.
+ *
+ * \param job Handshake job.
+ */
+static void handshake_run(struct workq_job *job) {
+    struct handshake *hs = (struct handshake *)job;
+    struct peerconn *pc = hs->pc;
+
+    if (hs->running.timeout) {
+        dtls_handle_timeout(&pc->dtls);
+    }
+    for (int i = 0; i < hs->running.count; i++) {
+        dtls_recv(&pc->dtls, hs->running.pkt[i], hs->running.len[i]);
+    }
+}
+
+/**
+ * Hand pending handshake input to the worker pool
+ *
+ * \param pc Peer connection.
+ */
+static void handshake_kick(struct peerconn *pc) {
+    struct handshake *hs = &pc->hs;
+
+    if (hs->busy) return;
+    if (0 == hs->backlog.count && !hs->backlog.timeout) return;
+
+    hs->running.timeout = hs->backlog.timeout;
+    hs->running.count = hs->backlog.count;
+    for (int i = 0; i < hs->backlog.count; i++) {
+        memcpy(hs->running.pkt[i], hs->backlog.pkt[i], hs->backlog.len[i]);
+        hs->running.len[i] = hs->backlog.len[i];
+    }
+    hs->backlog.count = 0;
+    hs->backlog.timeout = false;
+
+    // worker owns the association (and its timer) until completion
+    timer_disarm(&pc->timers, TIMER_DTLS);
+    hs->busy = true;
+
+    if (workq_submit(&hs->job) < 0) {
+        // no pool: do the work inline and post completion ourselves
+        handshake_run(&hs->job);
+        struct workq_job *job = &hs->job;
+        if (sizeof(job) != write(hs->pipe[1], &job, sizeof(job))) {
+            hs->busy = false;
+        }
+    }
+}
+
+/**
+ * Handle handshake step completion posted by the worker pool
+ *
+ * \param pc Peer connection.
+ *
+ * \return 0 on success, negative on error.
+ */
+static int handshake_done(struct peerconn *pc) {
+    struct handshake *hs = &pc->hs;
+    struct workq_job *job;
+
+    if (workq_complete(hs->pipe[0], &job) < 0) return -URTC_ERR;
+
+    hs->busy = false;
+    dtls_arm_timer(pc);
+
+    if (DTLS_STATE_CONNECTING != pc->dtls.state) {
+        dtls_state_change(pc);
+
+        // e.g. peer retransmitted its final flight; cheap once connected
+        if (DTLS_STATE_CONNECTED == pc->dtls.state) {
+            for (int i = 0; i < hs->backlog.count; i++) {
+                dtls_recv(&pc->dtls, hs->backlog.pkt[i], hs->backlog.len[i]);
+            }
+        }
+        hs->backlog.count = 0;
+        hs->backlog.timeout = false;
+
+        return 0;
+    }
+
+    handshake_kick(pc);
+
+    return 0;
+}
+
+/**
+ * Hand batched video packets to the kernel
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ */
+static void video_flush(struct peerconn *pc) {
+    struct sockaddr_in ra;
+
+    if (!pc->video.txq.count) return;
+
+    pthread_mutex_lock(&pc->lock);
+    ra = pc->remote;
+    pthread_mutex_unlock(&pc->lock);
+
+    txq_flush(&pc->video.txq, &ra);
+}
+
+/**
+ * Buffer to protect the next outgoing video packet into
+ *
+ * With kernel pacing, packets are protected straight into the batch, else
+ * into a single buffer and sent one at a time.
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ *
+ * \return Buffer, sizeof(pc->video.buf) bytes.
+ */
+static uint8_t *video_out(struct peerconn *pc) {
+    uint8_t *buf;
+
+    if (!pc->video.txtime) return pc->video.buf;
+    if (buf = txq_next(&pc->video.txq), !buf) {
+        video_flush(pc);
+        buf = txq_next(&pc->video.txq);
+    }
+
+    return buf;
+}
+
+/**
+ * Copy header of outgoing packet, adding transport-wide sequence number
+ *
+ * The sequence number is that of the next packet video_emit() sends, so
+ * numbers are consumed only by packets actually sent.
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ * \param dst Destination, with RTP_TWCC_EXT_SIZE bytes spare (may be
+ *        \a hdr).
+ * \param hdr Header.
+ * \param hdr_len Size of header.
+ *
+ * \return Size of header written.
+ */
+static size_t video_hdr(
+    struct peerconn *pc,
+    uint8_t *dst,
+    const uint8_t *hdr,
+    size_t hdr_len
+) {
+    if (dst != hdr) memcpy(dst, hdr, hdr_len);
+    if (!pc->video.twcc_ext) return hdr_len;
+
+    return rtp_twcc_write(dst, hdr_len, pc->video.twcc_ext,
+        pc->video.twcc_seq);
+}
+
+/**
+ * Send packet protected into buffer returned by video_out()
+ *
+ * With kernel pacing, the packet departs at pc->video.at.
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ * \param len Size of packet.
+ */
+static void video_emit(struct peerconn *pc, size_t len) {
+    if (pc->video.twcc_ext) {
+        gcc_on_sent(&pc->video.gcc, pc->video.twcc_seq++, len, pc->video.at,
+            pc->video.cluster);
+    }
+
+    if (pc->video.txtime) {
+        txq_commit(&pc->video.txq, len, pc->video.at);
+    } else {
+        send_to_remote(pc->video.buf, len, pc);
+    }
+}
+
+/**
+ * Protect and send plaintext packet from history
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ * \param pkt Packet (plaintext).
+ * \param len Size of packet.
+ *
+ * \return 0 on success, negative on error.
+ */
+static int video_send_plain(
+    struct peerconn *pc,
+    const uint8_t *pkt,
+    size_t len
+) {
+    uint8_t hdr[RTP_HEADER_SIZE + RTP_TWCC_EXT_SIZE], *out = video_out(pc);
+    size_t hdr_len = video_hdr(pc, hdr, pkt, RTP_HEADER_SIZE);
+    struct iovec iov;
+    int rv;
+
+    iov.iov_base = (uint8_t *)pkt + RTP_HEADER_SIZE;
+    iov.iov_len = len - RTP_HEADER_SIZE;
+    rv = srtp_protect_iov(&pc->srtp_tx, hdr, hdr_len, &iov, 1,
+        out, &len, sizeof(pc->video.buf));
+    if (rv < 0) return rv;
+
+    video_emit(pc, len);
+
+    return 0;
+}
+
+/**
+ * Look up video packet sent, for pacing or retransmission
+ *
+ * Packets replayed from the group's cache are not held in history; their
+ * header is written into buf, ahead of a copy of the shared payload.
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ * \param seq Sequence number.
+ * \param now Current time.
+ * \param[out] len Size of packet.
+ * \param buf Buffer of RTP_MAX_PACKET_SIZE bytes, for replayed packet.
+ *
+ * \return Packet (plaintext), or NULL if not (or no longer) held.
+ */
+static const uint8_t *video_packet(
+    struct peerconn *pc,
+    uint16_t seq,
+    uint64_t now,
+    size_t *len,
+    uint8_t *buf
+) {
+    struct video_replay *r =
+        &pc->video.replay[seq & (VIDEO_REPLAY_SLOTS - 1)];
+    const uint8_t *pkt = hist_get(&pc->video.hist, seq, len, now);
+
+    if (pkt || !r->p || r->seq != seq ||
+            now - r->us >= VIDEO_HISTORY_MS * 1000ULL) {
+        return pkt;
+    }
+
+    rtp_header_write(buf, pc->video.pt, r->p->marker, seq, r->ts,
+        pc->video.ssrc);
+    *len = RTP_HEADER_SIZE + rtp_payload_copy(r->p, buf + RTP_HEADER_SIZE);
+
+    return buf;
+}
+
+/**
+ * Send repair packet of the group just completed
+ *
+ * Repair packets are not queued, but are charged to the pacer.
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ */
+static void video_send_fec(struct peerconn *pc) {
+    uint8_t pkt[RTP_MAX_PACKET_SIZE], *out;
+    uint8_t hdr[RTP_HEADER_SIZE + 4 + RTP_TWCC_EXT_SIZE];
+    struct iovec iov;
+    size_t hdr_len = RTP_HEADER_SIZE + 4, len;
+    int n;
+
+    n = fec_enc_write(&pc->video.fec, pkt, sizeof(pkt), pc->video.fec_pt,
+        pc->video.fec_seq++, pc->video.fec_ssrc, pc->video.ssrc);
+    if (n < 0) return;
+
+    out = video_out(pc);
+    iov.iov_base = pkt + hdr_len;
+    iov.iov_len = n - hdr_len;
+    hdr_len = video_hdr(pc, hdr, pkt, hdr_len);
+    if (0 == srtp_protect_iov(&pc->srtp_tx, hdr, hdr_len, &iov, 1,
+            out, &len, sizeof(pc->video.buf))) {
+        video_emit(pc, len);
+        pacer_charge(&pc->video.pacer, timer_now_us(), len);
+    }
+}
+
+/**
+ * Send packet from history again, on the retransmission stream
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ * \param pkt Original packet (plaintext).
+ * \param len Size of original packet.
+ *
+ * \return Size of packet sent, or negative on error.
+ */
+static int video_send_rtx(
+    struct peerconn *pc,
+    const uint8_t *pkt,
+    size_t len
+) {
+    uint8_t rtx[RTP_HEADER_SIZE + RTP_RTX_OSN_SIZE], *out = video_out(pc);
+    uint8_t hdr[RTP_HEADER_SIZE + RTP_TWCC_EXT_SIZE];
+    struct iovec iov[2];
+    size_t hdr_len;
+    int rv;
+
+    rtp_rtx_write(rtx, pkt, pc->video.rtx_pt, pc->video.rtx_seq++,
+        pc->video.rtx_ssrc);
+    hdr_len = video_hdr(pc, hdr, rtx, RTP_HEADER_SIZE);
+
+    iov[0].iov_base = rtx + RTP_HEADER_SIZE;
+    iov[0].iov_len = RTP_RTX_OSN_SIZE;
+    iov[1].iov_base = (uint8_t *)pkt + RTP_HEADER_SIZE;
+    iov[1].iov_len = len - RTP_HEADER_SIZE;
+    rv = srtp_protect_iov(&pc->srtp_tx, hdr, hdr_len, iov, 2,
+        out, &len, sizeof(pc->video.buf));
+    if (rv < 0) return rv;
+
+    video_emit(pc, len);
+
+    return (int)len;
+}
+
+/**
+ * Queue recently sent video again, as padding
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ * \param bytes Amount of padding.
+ * \param now Current time.
+ *
+ * \return Bytes queued.
+ */
+static size_t video_pad(struct peerconn *pc, size_t bytes, uint64_t now) {
+    uint8_t buf[RTP_MAX_PACKET_SIZE];
+    uint16_t seq = pc->video.seq;
+    size_t len, queued = 0;
+
+    if (!pc->video.rtx_pt) return 0;
+
+    for (int i = 0; i < HIST_SLOTS && queued < bytes; i++) {
+        if (!video_packet(pc, --seq, now, &len, buf)) break;
+        len += RTP_RTX_OSN_SIZE + SRTP_MAX_TRAILER_SIZE;
+        if (pacer_push(&pc->video.pacer, PACER_PRIO_PADDING, seq, len) < 0) {
+            break;
+        }
+        queued += len;
+    }
+
+    return queued;
+}
+
+/**
+ * Start the next bandwidth probe, if one is due
+ *
+ * A probe is whatever video is queued, topped up with padding, released
+ * at the probing bitrate. With nothing to send, it waits for video.
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ * \param now Current time.
+ */
+static void video_probe(struct peerconn *pc, uint64_t now) {
+    uint32_t bps;
+    size_t bytes;
+
+    if (!pc->video.twcc_ext || pc->video.pacer.probe_left) return;
+
+    pc->video.probe = gcc_probe_next(&pc->video.gcc, &bps, &bytes);
+    if (!pc->video.probe) return;
+
+    pacer_probe(&pc->video.pacer, bps, bytes);
+    if (pc->video.pacer.queued < bytes) {
+        video_pad(pc, bytes - pc->video.pacer.queued, now);
+    }
+}
+
+/**
+ * Send queued video packets the pacer releases now
+ *
+ * Packets are queued by sequence number and sent from history, or from the
+ * group's payloads if replayed, so queueing costs no copy. Media packets
+ * feed FEC as they are sent. Retransmissions go on the RTX stream if
+ * negotiated, else are sent again with the same sequence number (see
+ * video_resend()), and pass SRTP replay protection only if the original
+ * was lost. Parity is computed over packets as stored, before the
+ * transport-wide sequence number extension is added. With kernel
+ * pacing, packets are released ahead of time, stamped with when they are
+ * due, and handed to the kernel in batches. Bandwidth probes are started
+ * from here, and packets released during one are reported as part of it.
+ *
+ * Call with video lock held.
+ *
+ * \param pc Peer connection.
+ *
+ * \return Time the next queued packet is due, or 0 if none are queued.
+ */
+static uint64_t video_pace(struct peerconn *pc) {
+    uint64_t now = timer_now_us();
+    uint8_t buf[RTP_MAX_PACKET_SIZE];
+    enum pacer_prio prio;
+    const uint8_t *pkt;
+    uint16_t seq;
+    size_t len;
+
+    video_probe(pc, now);
+
+    for (;;) {
+        pc->video.cluster = pc->video.pacer.probe_left ? pc->video.probe : 0;
+        if (1 != pacer_pop(&pc->video.pacer, now, &prio, &seq,
+                &pc->video.at)) {
+            break;
+        }
+        if (pkt = video_packet(pc, seq, now, &len, buf), !pkt) {
+            continue;
+        }
+
+        switch (prio) {
+        case PACER_PRIO_VIDEO:
+            // parity over the plaintext copy, repair sent after its group
+            if (0 == video_send_plain(pc, pkt, len) && pc->video.fec_pt &&
+                    1 == fec_enc_add(&pc->video.fec, pkt, len)) {
+                video_send_fec(pc);
+            }
+            break;
+        case PACER_PRIO_RTX:
+            if (pc->video.rtx_pt) {
+                video_send_rtx(pc, pkt, len);
+            } else {
+                video_send_plain(pc, pkt, len);
+            }
+            break;
+        case PACER_PRIO_PADDING:
+            video_send_rtx(pc, pkt, len);
+            break;
+        default:
+            break;
+        }
+    }
+    pc->video.cluster = 0;
+    video_flush(pc);
+
+    return pacer_next(&pc->video.pacer, now);
+}
+
+/**
+ * Have the runloop pace queued video from now on
+ *
+ * Call with video lock held, from threads other than the runloop.
+ *
+ * \param pc Peer connection.
+ */
+static void video_wake(struct peerconn *pc) {
+    uint8_t b = 0;
+
+    if (pc->video.wake_pending) return;
+    if (1 == write(pc->video.wake[1], &b, 1)) pc->video.wake_pending = true;
+}
+
+/**
+ * Send video due, and (re)arm timer for the next deadline
+ *
+ * \param pc Peer connection.
+ */
+static void video_tx_poll(struct peerconn *pc) {
+    uint64_t now = timer_now_us(), next;
+
+    pthread_mutex_lock(&pc->video.lock);
+    pc->video.wake_pending = false;
+    next = video_pace(pc);
+    pthread_mutex_unlock(&pc->video.lock);
+
+    if (next) {
+        timer_arm(&pc->timers, TIMER_PACER, next > now ? next - now : 0);
+    } else {
+        timer_disarm(&pc->timers, TIMER_PACER);
+    }
+}
+
+/**
+ * Send one access unit on the local video stream
+ *
+ * (bcast_send_fn) Writes this connection's header in front of each shared
+ * payload into the retransmission history, and queues the packets for the
+ * pacer. Payloads replayed from the group's cache are instead held by
+ * reference, sparing each viewer a copy of the GOP. Packets the pacer
+ * releases at once are sent before returning, the rest from the runloop.
+ * Frames are skipped until the DTLS-SRTP handshake completes.
+ *
+ * \param member Peer connection.
+ * \param pkts Payloads of access unit.
+ * \param count Number of payloads.
+ * \param ts Timestamp of access unit (90 kHz clock).
+ * \param keyframe Whether decoding can start at access unit.
+ * \param replay Whether payloads are the group's copies.
+ *
+ * \return BCAST_SENT, BCAST_WAITING if skipped to wait for a keyframe,
+ *         BCAST_SKIPPED if skipped otherwise, negative on error.
+ */
+static int video_send(
+    void *member,
+    struct rtp_payload *const *pkts,
+    size_t count,
+    uint32_t ts,
+    bool keyframe,
+    bool replay
+) {
+    struct peerconn *pc = (struct peerconn *)member;
+    uint8_t hdr[RTP_HEADER_SIZE + RTP_TWCC_EXT_SIZE], *pkt;
+    uint64_t now = timer_now_us();
+    size_t len;
+    int rv = BCAST_SKIPPED;
+
+    pthread_mutex_lock(&pc->video.lock);
+
+    if (!pc->video.ready) goto _unlock;
+
+    // thinned by the uplink budget to keyframes only, or to nothing; the
+    // decoder can only pick up again at a keyframe
+    if (UPLINK_DROP == pc->video.mode || (!keyframe &&
+            (UPLINK_THIN == pc->video.mode || pc->video.resync))) {
+        if (UPLINK_FULL == pc->video.mode && pc->video.resync) {
+            rv = BCAST_WAITING;
+        }
+        pc->video.resync = true;
+        goto _unlock;
+    }
+    rv = BCAST_SENT;
+    pc->video.resync = false;
+
+    // for sender reports
+    pc->video.packets += count;
+    pc->video.last_ts = ts + pc->video.ts_offset;
+    pc->video.last_us = now;
+
+    pc->video.at = now;
+    for (size_t i = 0; i < count; i++) {
+        struct rtp_payload *p = pkts[i];
+        uint16_t seq = pc->video.seq++;
+        struct video_replay *r =
+            &pc->video.replay[seq & (VIDEO_REPLAY_SLOTS - 1)];
+
+        pc->video.octets += p->len;
+
+        rtp_payload_unref(r->p);
+        r->p = NULL;
+
+        if (replay) {
+            // the group's copy outlives the call: hold it for pacing and
+            // retransmission, else send now
+            *r = (struct video_replay){
+                .p = rtp_payload_ref(p),
+                .seq = seq,
+                .ts = ts + pc->video.ts_offset,
+                .us = now
+            };
+            len = RTP_HEADER_SIZE + p->len;
+            if (0 == pacer_push(&pc->video.pacer, PACER_PRIO_VIDEO, seq,
+                    len + SRTP_MAX_TRAILER_SIZE)) {
+                continue;
+            }
+            pkt = NULL;
+        } else {
+            // keep a plaintext copy for pacing and retransmission, else
+            // send now, encrypting straight from the encoder's buffer
+            pkt = hist_store(&pc->video.hist, seq, RTP_HEADER_SIZE + p->len,
+                now);
+        }
+        rtp_header_write(pkt ? pkt : hdr, pc->video.pt, p->marker, seq,
+            ts + pc->video.ts_offset, pc->video.ssrc);
+
+        if (pkt) {
+            len = RTP_HEADER_SIZE + rtp_payload_copy(p, pkt + RTP_HEADER_SIZE);
+            if (0 == pacer_push(&pc->video.pacer, PACER_PRIO_VIDEO, seq,
+                    len + SRTP_MAX_TRAILER_SIZE)) {
+                continue;
+            }
+            rv = video_send_plain(pc, pkt, len);
+        } else {
+            rv = srtp_protect_iov(&pc->srtp_tx, hdr,
+                video_hdr(pc, hdr, hdr, RTP_HEADER_SIZE), p->iov, p->iovcnt,
+                video_out(pc), &len, sizeof(pc->video.buf));
+            if (0 == rv) video_emit(pc, len);
+        }
+        if (rv < 0) goto _unlock;
+        pacer_charge(&pc->video.pacer, now, len);
+    }
+
+    if (video_pace(pc)) video_wake(pc);
+
+_unlock:
+    video_flush(pc);
+    pthread_mutex_unlock(&pc->video.lock);
+
+    return rv;
+}
+
+/**
+ * Retransmit video packets from history, as requested by NACK
+ *
+ * Retransmissions are queued ahead of video. If negotiated, they are sent
+ * on their own SSRC and payload type [^RFC4588], so the receiver can tell
+ * repairs from originals.
+ *
+ * Otherwise the packet is protected again under its original SRTP index.
+ * With an AEAD profile that reuses the AES-GCM nonce, which is only safe
+ * if the packet is byte-identical. A new transport-wide sequence number
+ * would change the authenticated header, so with one negotiated, NACKs go
+ * unanswered.
+ *
+ * \param pc Peer connection.
+ * \param seqs Sequence numbers.
+ * \param count Number of sequence numbers.
+ */
+static void video_resend(
+    struct peerconn *pc,
+    const uint16_t *seqs,
+    size_t count
+) {
+    uint64_t now = timer_now_us();
+    uint8_t buf[RTP_MAX_PACKET_SIZE];
+    size_t len, extra;
+
+    pthread_mutex_lock(&pc->video.lock);
+
+    fec_enc_nack(&pc->video.fec, count);
+
+    if (!pc->video.rtx_pt && pc->video.twcc_ext && pc->srtp_tx.aead) {
+        pthread_mutex_unlock(&pc->video.lock);
+        return;
+    }
+
+    extra = SRTP_MAX_TRAILER_SIZE + (pc->video.rtx_pt ? RTP_RTX_OSN_SIZE : 0);
+    for (size_t i = 0; pc->video.ready && i < count; i++) {
+        if (video_packet(pc, seqs[i], now, &len, buf)) {
+            pacer_push(&pc->video.pacer, PACER_PRIO_RTX, seqs[i], len + extra);
+        }
+    }
+
+    pthread_mutex_unlock(&pc->video.lock);
+
+    video_tx_poll(pc);
+}
+
+/**
+ * Handle incoming STUN packet
+ *
+ * \param pc Peer connection.
+ *
+ * \return 0 on success, negative on error.
+ */
+static int stun_handler(
+    struct peerconn *pc,
+    const uint8_t *pkt,
+    size_t n
+) {
+    return 0;
+}
+
+/**
+ * Handle incoming DTLS packet
+ *
+ * \param pc Peer connection.
+ *
+ * \return 0 on success, negative on error.
+ */
+static int dtls_handler(
+    struct peerconn *pc,
+    const uint8_t *pkt,
+    size_t n
+) {
+    struct handshake *hs = &pc->hs;
+    enum dtls_state prev;
+    int rv;
+
+    if (n > DTLS_MTU) return -URTC_ERR_MALFORMED;
+
+    // as server, the remote ClientHello may arrive before the runloop tick
+    if (DTLS_STATE_NEW == pc->dtls.state) {
+        if (rv = dtls_begin(pc), rv < 0) return rv;
+    }
+
+    // handshake in progress: queue for the worker pool
+    if (hs->busy || DTLS_STATE_CONNECTING == pc->dtls.state) {
+        if (hs->backlog.count == DTLS_BACKLOG_MAX) {
+            urtc_log(URTC_WARN, "[dtls] backlog full, dropping datagram");
+            return -URTC_ERR;
+        }
+        memcpy(hs->backlog.pkt[hs->backlog.count], pkt, n);
+        hs->backlog.len[hs->backlog.count++] = n;
+        handshake_kick(pc);
+        return 0;
+    }
+
+    prev = pc->dtls.state;
+    rv = dtls_recv(&pc->dtls, pkt, n);
+    if (prev != pc->dtls.state) {
+        dtls_state_change(pc);
+    }
+
+    return rv;
+}
+
+/**
+ * Hand reassembled access unit to application
+ */
+static void video_frame_ready(struct h264_frame *f, void *arg) {
+    struct peerconn *pc = (struct peerconn *)arg;
+    urtc_on_video_frame *cb = pc->video_rx.cb;
+
+    if (cb) cb(f->data, f->len, f->ts, f->keyframe, pc->video_rx.arg);
+    h264_frame_release(f);
+}
+
+/**
+ * Depacketize packet released by jitter buffer
+ */
+static void video_rx_emit(const uint8_t *pkt, size_t n, void *arg) {
+    struct peerconn *pc = (struct peerconn *)arg;
+
+    h264_depkt_push(&pc->video_rx.depkt, pkt, n);
+}
+
+/**
+ * Queue video packet recovered from repair packet for playout
+ */
+static void video_rx_recovered(const uint8_t *pkt, size_t n, void *arg) {
+    struct peerconn *pc = (struct peerconn *)arg;
+
+    jbuf_put(&pc->video_rx.jbuf, pkt, n, timer_now_us());
+}
+
+/**
+ * Current wallclock time, in NTP format
+ */
+static uint64_t ntp_now(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return rtcp_ntp((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+/**
+ * Protect and send compound RTCP packet built by rtcp_queue()
+ *
+ * \param pc Peer connection.
+ */
+static void rtcp_flush(struct peerconn *pc) {
+    size_t len = pc->rtcp.len;
+
+    if (!len) return;
+    pc->rtcp.len = 0;
+
+    pthread_mutex_lock(&pc->video.lock);
+    if (!pc->video.ready ||
+            0 != srtcp_protect(&pc->srtp_tx, pc->rtcp.buf, &len,
+                sizeof(pc->rtcp.buf))) {
+        len = 0;
+    }
+    if (len) send_to_remote(pc->rtcp.buf, len, pc);
+    pthread_mutex_unlock(&pc->video.lock);
+
+    // for the report interval [^RFC3550 6.3.3]
+    if (len) {
+        pc->rtcp.avg_size +=
+            (len + RTCP_IP_UDP_SIZE - pc->rtcp.avg_size) / 16;
+    }
+}
+
+/**
+ * Append sender or receiver report, and source description
+ *
+ * A sender report if video was sent since the last report. A report block
+ * on incoming video, if any arrived.
+ *
+ * \param pc Peer connection.
+ */
+static void rtcp_report(struct peerconn *pc) {
+    struct rtcp_sender_info si, *psi = NULL;
+    struct rtcp_report_block rb;
+    struct rtcp_rx_stats *rx = &pc->rtcp.rx;
+    uint64_t now = timer_now_us(), ntp = ntp_now();
+    bool they_sent = rx->started && rx->received != rx->received_prior;
+    uint8_t *pkt;
+    size_t cap;
+    int n, m;
+
+    if (pc->rtcp.len + RTCP_REPORT_ROOM > RTCP_MAX_PACKET_SIZE) {
+        rtcp_flush(pc);
+    }
+    pkt = pc->rtcp.buf + pc->rtcp.len;
+    cap = RTCP_MAX_PACKET_SIZE - pc->rtcp.len;
+
+    // rtp timestamp of now, extrapolated from the last frame sent
+    pthread_mutex_lock(&pc->video.lock);
+    if (pc->video.packets != pc->rtcp.packets) {
+        si = (struct rtcp_sender_info){
+            .ntp = ntp,
+            .rtp_ts = pc->video.last_ts +
+                (timer_now_us() - pc->video.last_us) *
+                RTP_VIDEO_CLOCK_HZ / 1000000,
+            .packets = pc->video.packets,
+            .octets = pc->video.octets
+        };
+        pc->rtcp.packets = pc->video.packets;
+        psi = &si;
+    }
+    pthread_mutex_unlock(&pc->video.lock);
+
+    n = rtcp_write_report(pkt, cap, pc->video.ssrc, psi, &rb,
+        0 == rtcp_rx_block(rx, now, &rb));
+    if (n < 0) return;
+    m = rtcp_write_sdes(pkt + n, cap - n, pc->video.ssrc, pc->mdns.hostname);
+    if (m < 0) return;
+
+    pc->rtcp.len += n + m;
+    pc->rtcp.we_sent = NULL != psi;
+    pc->rtcp.senders = !!psi + they_sent;
+}
+
+/**
+ * Append packet to the compound RTCP packet sent by rtcp_flush()
+ *
+ * Feedback generated while handling one wakeup of the runloop leaves in one
+ * SRTCP packet. Unless reduced-size RTCP was negotiated [^RFC5506], each
+ * compound packet leads with a report and source description.
+ *
+ * \param pc Peer connection.
+ * \param pkt RTCP packet.
+ * \param n Size of packet.
+ *
+ * \return Size of packet queued, or 0 if not queued.
+ */
+static size_t rtcp_queue(struct peerconn *pc, const uint8_t *pkt, size_t n) {
+    if (pc->rtcp.len + n > RTCP_MAX_PACKET_SIZE) rtcp_flush(pc);
+    if (!pc->rtcp.len && !pc->rtcp.rsize) rtcp_report(pc);
+    if (pc->rtcp.len + n > RTCP_MAX_PACKET_SIZE) return 0;
+
+    memcpy(pc->rtcp.buf + pc->rtcp.len, pkt, n);
+    pc->rtcp.len += n;
+
+    return n;
+}
+
+/**
+ * Time the next report [^RFC3550 6.2]
+ *
+ * The session bandwidth is that of video sent and received, as estimated.
+ *
+ * \param pc Peer connection.
+ */
+static void rtcp_schedule(struct peerconn *pc) {
+    uint32_t bps, r;
+    uint64_t us;
+
+    pthread_mutex_lock(&pc->video.lock);
+    bps = pc->video.estimate_bps;
+    pthread_mutex_unlock(&pc->video.lock);
+    bps += pc->video_rx.gcc.acked_bps;
+
+    prng(&r, sizeof(r));
+    us = rtcp_interval_us(bps, pc->rtcp.avg_size, 2, pc->rtcp.senders,
+        pc->rtcp.we_sent, pc->rtcp.initial, r / 4294967296.0);
+    pc->rtcp.initial = false;
+
+    timer_arm(&pc->timers, TIMER_REPORT, us);
+}
+
+/**
+ * Send report, and time the next one
+ *
+ * \param pc Peer connection.
+ */
+static void rtcp_report_due(struct peerconn *pc) {
+    // feedback already queued leads with a report, if not reduced-size
+    if (!pc->rtcp.len || pc->rtcp.rsize) rtcp_report(pc);
+
+    rtcp_schedule(pc);
+}
+
+/**
+ * Request retransmission of missing video packets
+ */
+static void video_rx_nack(
+    uint32_t ssrc,
+    const uint16_t *seqs,
+    size_t count,
+    void *arg
+) {
+    struct peerconn *pc = (struct peerconn *)arg;
+    uint8_t pkt[RTCP_MAX_PACKET_SIZE - RTCP_REPORT_ROOM];
+    int n;
+
+    // sender ssrc of feedback is that of the outgoing stream
+    n = rtcp_write_nack(pkt, sizeof(pkt), pc->video.ssrc, ssrc, seqs, count);
+    if (n > 0) rtcp_queue(pc, pkt, n);
+}
+
+/**
+ * Note arrival of video, or its repair, for congestion feedback
+ *
+ * Packets numbered with a transport-wide sequence number are reported back
+ * to the sender. Media packets also feed the receive-side estimate, sent to
+ * senders without transport-wide feedback. Lacking an abs-send-time
+ * extension, the RTP timestamp stands in for the send time, so frames
+ * stretched out by the sender's pacer look a little like queueing.
+ *
+ * \param pc Peer connection.
+ * \param pkt Unprotected packet.
+ * \param n Size of packet.
+ * \param arrival_us Arrival time, on the real time clock.
+ */
+static void video_rx_arrived(
+    struct peerconn *pc,
+    const uint8_t *pkt,
+    size_t n,
+    int64_t arrival_us
+) {
+    struct rtcp_twcc_status st = { .received = true };
+    uint16_t seq;
+    uint32_t ts;
+
+    // reception statistics for receiver reports, arrival on the media clock
+    if (n >= RTP_HEADER_SIZE && (pkt[1] & 0x7f) == pc->video_rx.pt) {
+        ts = ((uint32_t)pkt[4] << 24) | (pkt[5] << 16) | (pkt[6] << 8) |
+            pkt[7];
+        rtcp_rx_update(&pc->rtcp.rx, ((uint32_t)pkt[8] << 24) |
+            (pkt[9] << 16) | (pkt[10] << 8) | pkt[11], (pkt[2] << 8) | pkt[3],
+            ts, arrival_us * (RTP_VIDEO_CLOCK_HZ / 1000) / 1000);
+    }
+
+    if (!pc->video_rx.twcc_ext && !pc->video_rx.remb) return;
+
+    if (pc->video_rx.twcc_ext &&
+            0 == rtp_twcc_read(pkt, n, pc->video_rx.twcc_ext, &seq)) {
+        twcc_put(&pc->video_rx.twcc, seq, arrival_us);
+    }
+
+    if (n >= RTP_HEADER_SIZE && (pkt[1] & 0x7f) == pc->video_rx.pt) {
+        // extend timestamp, starting one wrap up so it cannot go below zero
+        ts = ((uint32_t)pkt[4] << 24) | (pkt[5] << 16) | (pkt[6] << 8) |
+            pkt[7];
+        if (!pc->video_rx.ts_ext) pc->video_rx.ts_ext = 1ULL << 32 | ts;
+        pc->video_rx.ts_ext += (int32_t)(ts - (uint32_t)pc->video_rx.ts_ext);
+
+        st.seq = (pkt[2] << 8) | pkt[3];
+        st.arrival_us = arrival_us;
+        gcc_on_sent(&pc->video_rx.gcc, st.seq, n,
+            pc->video_rx.ts_ext * 1000000 / RTP_VIDEO_CLOCK_HZ, 0);
+        gcc_on_feedback(&pc->video_rx.gcc, &st, 1, timer_now_us());
+    }
+
+    // feedback batches arrivals until the timer expires
+    if (!pc->timers.deadline[TIMER_FEEDBACK]) {
+        timer_arm(&pc->timers, TIMER_FEEDBACK, pc->video_rx.feedback_us);
+    }
+}
+
+/**
+ * Send congestion feedback on video received since the last feedback
+ *
+ * Transport-wide feedback is sent if negotiated. Otherwise, the receive-side
+ * estimate is sent every VIDEO_REMB_INTERVAL_US, or at once if it drops. The
+ * next feedback is then timed for it to take no more than
+ * VIDEO_FEEDBACK_SHARE of the received bitrate, within bounds. The timer is
+ * rearmed by the next arrival, so an idle stream sends nothing.
+ *
+ * \param pc Peer connection.
+ */
+static void video_rx_feedback(struct peerconn *pc) {
+    uint8_t pkt[RTCP_MAX_PACKET_SIZE - RTCP_REPORT_ROOM];
+    uint32_t ssrc = pc->video_rx.jbuf.ssrc;
+    uint32_t bps = pc->video_rx.gcc.target_bps;
+    uint32_t rx_bps = pc->video_rx.gcc.acked_bps;
+    uint64_t now = timer_now_us(), us;
+    size_t sent = 0;
+    int n;
+
+    if (pc->video_rx.twcc_ext) {
+        while (n = twcc_write(&pc->video_rx.twcc, pkt, sizeof(pkt),
+                pc->video.ssrc, ssrc), n > 0) {
+            sent += rtcp_queue(pc, pkt, n);
+        }
+    } else if (pc->video_rx.remb && rx_bps && pc->video_rx.jbuf.started &&
+            (now - pc->video_rx.remb_us >= VIDEO_REMB_INTERVAL_US ||
+             bps < pc->video_rx.remb_bps * (1 - VIDEO_REMB_DROP))) {
+        n = rtcp_write_remb(pkt, sizeof(pkt), pc->video.ssrc, bps, &ssrc, 1);
+        if (n > 0 && (sent = rtcp_queue(pc, pkt, n))) {
+            pc->video_rx.remb_bps = bps;
+            pc->video_rx.remb_us = now;
+        }
+    }
+
+    if (!sent || !rx_bps) return;
+    us = 8e6 * sent / (VIDEO_FEEDBACK_SHARE * rx_bps);
+    if (us < VIDEO_FEEDBACK_MIN_US) us = VIDEO_FEEDBACK_MIN_US;
+    if (us > VIDEO_FEEDBACK_MAX_US) us = VIDEO_FEEDBACK_MAX_US;
+    pc->video_rx.feedback_us = us;
+}
+
+/**
+ * Release video due for playout, and (re)arm timer for the next deadline
+ */
+static void video_rx_poll(struct peerconn *pc) {
+    uint64_t now = timer_now_us();
+    uint64_t next = jbuf_poll(&pc->video_rx.jbuf, now);
+
+    if (next) {
+        timer_arm(&pc->timers, TIMER_JBUF, next > now ? next - now : 0);
+    } else {
+        timer_disarm(&pc->timers, TIMER_JBUF);
+    }
+}
+
+/**
+ * Follow new estimate of available bitrate, with video lock held
+ *
+ * The pacer follows the estimate if the application paces video.
+ *
+ * \param pc Peer connection.
+ * \param bps Estimate (in bits per second).
+ *
+ * \return Estimate to report to the application, or 0 if it has not moved
+ *         enough since last reported.
+ */
+static uint32_t video_retarget(struct peerconn *pc, uint32_t bps) {
+    pc->video.estimate_bps = bps;
+    if (pc->video.pacer.target_bps) {
+        pacer_set_rate(&pc->video.pacer, bps, pc->video.pacer.factor);
+    }
+    if (bps > pc->video.reported_bps * (1 + VIDEO_BITRATE_STEP) ||
+            bps < pc->video.reported_bps * (1 - VIDEO_BITRATE_STEP)) {
+        return pc->video.reported_bps = bps;
+    }
+
+    return 0;
+}
+
+/**
+ * Update bitrate estimate from transport-wide feedback
+ *
+ * Video is then paced at the estimate, FEC adapts to the loss seen, and the
+ * application is told if the estimate moved.
+ *
+ * \param pc Peer connection.
+ * \param p Feedback packet.
+ */
+static void video_feedback(struct peerconn *pc, const struct rtcp_packet *p) {
+    struct rtcp_twcc_status st[GCC_HISTORY];
+    urtc_on_target_bitrate *cb;
+    uint32_t media, bps, report;
+    void *arg;
+    int n;
+
+    if (n = rtcp_read_twcc(p, &media, st, GCC_HISTORY), n <= 0) return;
+
+    pthread_mutex_lock(&pc->video.lock);
+    bps = gcc_on_feedback(&pc->video.gcc, st, n, timer_now_us());
+    if (pc->video.fec_pt) fec_enc_set_loss(&pc->video.fec, pc->video.gcc.loss);
+    report = video_retarget(pc, bps);
+    cb = pc->video.bitrate_cb;
+    arg = pc->video.bitrate_arg;
+    pthread_mutex_unlock(&pc->video.lock);
+
+    if (report && cb) cb(report, arg);
+}
+
+/**
+ * Handle receiver estimated maximum bitrate
+ *
+ * Followed only if transport-wide feedback was not negotiated, as then the
+ * estimate is made here instead.
+ *
+ * \param pc Peer connection.
+ * \param bps Estimate (in bits per second).
+ */
+static void video_remb(struct peerconn *pc, uint64_t bps) {
+    urtc_on_target_bitrate *cb;
+    uint32_t report = 0;
+    void *arg;
+
+    if (bps < GCC_MIN_BITRATE) bps = GCC_MIN_BITRATE;
+    if (bps > GCC_MAX_BITRATE) bps = GCC_MAX_BITRATE;
+
+    pthread_mutex_lock(&pc->video.lock);
+    if (!pc->video.twcc_ext) report = video_retarget(pc, bps);
+    cb = pc->video.bitrate_cb;
+    arg = pc->video.bitrate_arg;
+    pthread_mutex_unlock(&pc->video.lock);
+
+    if (report && cb) cb(report, arg);
+}
+
+/**
+ * Handle picture loss indication or full intra request
+ *
+ * \param pc Peer connection.
+ * \param p Packet (RTCP_PSFB_PLI or RTCP_PSFB_FIR).
+ */
+static void video_picture_loss(struct peerconn *pc, struct rtcp_packet *p) {
+    uint32_t media;
+    uint8_t seq;
+
+    if (RTCP_PSFB_PLI == p->fmt) {
+        if (rtcp_read_pli(p, &media) < 0 || media != pc->video.ssrc) return;
+    } else {
+        if (rtcp_read_fir(p, pc->video.ssrc, &seq) <= 0) return;
+        // retransmission of a request already handled [^RFC5104 4.3.1.1]
+        if (pc->video.fir && seq == pc->video.fir_seq) return;
+        pc->video.fir = true;
+        pc->video.fir_seq = seq;
+    }
+
+    video_request_idr(pc);
+}
+
+/**
+ * Handle sender or receiver report
+ *
+ * A sender report from the source of incoming video is echoed back in our
+ * next report. Report blocks on outgoing video give the round trip time,
+ * which times retransmission requests, and, lacking transport-wide
+ * feedback, the loss that FEC protects against.
+ *
+ * \param pc Peer connection.
+ * \param p Packet (RTCP_SR or RTCP_RR).
+ */
+static void video_report(struct peerconn *pc, const struct rtcp_packet *p) {
+    struct rtcp_report_block rb[RTCP_MAX_REPORT_BLOCKS];
+    struct rtcp_sender_info si;
+    uint32_t sender, rtt;
+    int n;
+
+    n = rtcp_read_report(p, &sender, &si, rb, RTCP_MAX_REPORT_BLOCKS);
+    if (n < 0) return;
+
+    if (RTCP_SR == p->type && pc->rtcp.rx.started &&
+            sender == pc->rtcp.rx.ssrc) {
+        rtcp_rx_sr(&pc->rtcp.rx, si.ntp, timer_now_us());
+    }
 
+    for (int i = 0; i < n; i++) {
+        if (rb[i].ssrc != pc->video.ssrc) continue;
 
-typedef int (*event_handler)(struct peerconn *pc);
+        if (rtt = rtcp_rtt_us(&rb[i], ntp_now()), rtt) {
+            jbuf_set_rtt(&pc->video_rx.jbuf, rtt);
+        }
 
-const enum rtc_state state_table[NUM_STATES][NUM_EVENTS] = {
-    { STATE_NEW, STATE_NEW },
-    { STATE_NEW, STATE_NEW },
-    { STATE_NEW, STATE_NEW },
-    { STATE_NEW, STATE_NEW },
-    { STATE_NEW, STATE_NEW },
-    { STATE_NEW, STATE_NEW },
-    { STATE_NEW, STATE_NEW },
-    { STATE_NEW, STATE_NEW },
-    { STATE_NEW, STATE_NEW }
-};
+        pthread_mutex_lock(&pc->video.lock);
+        if (pc->video.fec_pt && !pc->video.twcc_ext) {
+            fec_enc_set_loss(&pc->video.fec, rb[i].fraction_lost);
+        }
+        pthread_mutex_unlock(&pc->video.lock);
+    }
+}
 
 /**
- * Handle incoming STUN packet
+ * Handle incoming (unprotected) compound RTCP packet
  *
  * \param pc Peer connection.
+ * \param pkt RTCP packet.
+ * \param n Size of RTCP packet.
  *
  * \return 0 on success, negative on error.
  */
-static int stun_handler(
-    struct peerconn *pc,
-    const uint8_t *pkt,
-    size_t n
-) {
-    return 0;
+static int rtcp_handler(struct peerconn *pc, const uint8_t *pkt, size_t n) {
+    uint16_t seqs[VIDEO_MAX_NACKS];
+    struct rtcp_packet p;
+    uint32_t media;
+    uint64_t bps;
+    int rv;
+
+    while (rv = rtcp_next(&pkt, &n, &p), rv > 0) {
+        if (RTCP_RTPFB == p.type && RTCP_RTPFB_NACK == p.fmt) {
+            rv = rtcp_read_nack(&p, &media, seqs, VIDEO_MAX_NACKS);
+            if (rv > 0 && media == pc->video.ssrc) {
+                video_resend(pc, seqs, rv);
+            }
+        } else if (RTCP_RTPFB == p.type && RTCP_RTPFB_TWCC == p.fmt) {
+            video_feedback(pc, &p);
+        } else if (RTCP_PSFB == p.type && RTCP_PSFB_AFB == p.fmt) {
+            if (rtcp_read_remb(&p, &bps) >= 0) video_remb(pc, bps);
+        } else if (RTCP_PSFB == p.type &&
+                (RTCP_PSFB_PLI == p.fmt || RTCP_PSFB_FIR == p.fmt)) {
+            video_picture_loss(pc, &p);
+        } else if (RTCP_SR == p.type || RTCP_RR == p.type) {
+            video_report(pc, &p);
+        }
+    }
+
+    return rv;
 }
 
 /**
- * Handle incoming DTLS packet
+ * Handle incoming SRTP (or SRTCP) packet
+ *
+ * Packet is unprotected in place, in the receive buffer. Video is copied
+ * into the jitter buffer from there.
  *
  * \param pc Peer connection.
+ * \param pkt Packet.
+ * \param n Size of packet.
+ * \param arrival_us Arrival time, on the real time clock.
  *
  * \return 0 on success, negative on error.
  */
-static int dtls_handler(
+static int rtp_handler(
     struct peerconn *pc,
-    const uint8_t *pkt,
-    size_t n
+    uint8_t *pkt,
+    size_t n,
+    int64_t arrival_us
 ) {
-    return 0;
+    int rv;
+
+    if (n < 2) return -URTC_ERR_MALFORMED;
+
+    // rtcp payload types 192-223 are multiplexed on the same port [^RFC5761]
+    if ((191 < pkt[1]) && (pkt[1] < 224)) {
+        rv = srtcp_unprotect(&pc->srtp_rx, pkt, &n);
+        if (0 == rv) rv = rtcp_handler(pc, pkt, n);
+    } else {
+        rv = srtp_unprotect(&pc->srtp_rx, pkt, &n);
+        if (0 != rv || !pc->video_rx.cb) return rv;
+
+        video_rx_arrived(pc, pkt, n, arrival_us);
+
+        if (pc->video_rx.fec_pt && (pkt[1] & 0x7f) == pc->video_rx.fec_pt) {
+            fec_dec_put_repair(&pc->video_rx.fec, pkt, n);
+            video_rx_poll(pc);
+            return 0;
+        }
+
+        // repairs rejoin the stream they repair, padding is dropped
+        if (pc->video_rx.rtx_pt &&
+                (pkt[1] & 0x7f) == pc->video_rx.rtx_pt) {
+            if (!pc->video_rx.jbuf.started) return 0;
+            rv = rtp_rtx_unwrap(pkt, &n, pc->video_rx.pt,
+                pc->video_rx.jbuf.ssrc);
+            if (rv < 0) return 0;
+        }
+
+        if ((pkt[1] & 0x7f) == pc->video_rx.pt) {
+            // parity covers packets without header extensions (see
+            // video_pace())
+            if (pc->video_rx.fec_pt && !(pkt = rtp_ext_strip(pkt, &n))) {
+                return 0;
+            }
+            rv = jbuf_put(&pc->video_rx.jbuf, pkt, n, timer_now_us());
+            if (pc->video_rx.fec_pt) {
+                fec_dec_put_source(&pc->video_rx.fec, pkt, n);
+            }
+            video_rx_poll(pc);
+        }
+    }
+
+    return rv;
 }
 
 /**
- * Handle incoming SRTP (or SRTCP) packet
+ * Time a datagram arrived, as stamped by the kernel
  *
- * \param pc Peer connection.
+ * Stamped as the packet came in off the network, so not skewed by time spent
+ * queued on the socket while the runloop was busy. If the kernel did not
+ * stamp it, the time now is taken instead, on the same clock.
  *
- * \return 0 on success, negative on error.
+ * \param msg Received datagram.
+ *
+ * \return Microseconds since the epoch.
  */
-static int rtp_handler(
-    struct peerconn *pc,
-    const uint8_t *pkt,
-    size_t n
-) {
-    return 0;
+static int64_t arrival_us(struct msghdr *msg) {
+    struct cmsghdr *c;
+    struct timeval tv;
+
+    for (c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c)) {
+        if (SOL_SOCKET != c->cmsg_level) continue;
+#ifdef SO_TIMESTAMPNS
+        if (SCM_TIMESTAMPNS == c->cmsg_type) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+        }
+#else
+        if (SCM_TIMESTAMP == c->cmsg_type) {
+            memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+            return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+        }
+#endif
+    }
+
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
 /**
@@ -195,29 +1816,35 @@ static int rtp_handler(
  */
 static int socket_event_handler(struct peerconn *pc) {
     uint8_t buffer[RX_BUF_CAP];
+    uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
     struct sockaddr_in ra;
-    socklen_t ralen;
+    struct iovec iov = { buffer, sizeof(buffer) };
+    struct msghdr msg = {
+        .msg_name = &ra,
+        .msg_namelen = sizeof(ra),
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control)
+    };
     ssize_t n;
 
-    // read packet
-    ralen = sizeof(ra);
-    n = recvfrom(
-        pc->sockfd,
-        buffer,
-        sizeof(buffer),
-        0,
-        (struct sockaddr *)(&ra),
-        &ralen
-    );
+    // read packet, with its arrival time if the kernel stamped it
+    n = recvmsg(pc->sockfd, &msg, 0);
+
+    if (n <= 0) return -URTC_ERR;
 
     // rtp
     if ((127 < buffer[0]) && (buffer[0] < 192)) {
         urtc_log(URTC_INFO, "[rtp] %s", inet_ntoa(ra.sin_addr));
-        rtp_handler(pc, buffer, n);
+        rtp_handler(pc, buffer, n, arrival_us(&msg));
     } else
     // dtls
     if ((19 < buffer[0]) && (buffer[0] < 64)) {
         urtc_log(URTC_INFO, "[dtls] %s", inet_ntoa(ra.sin_addr));
+        pthread_mutex_lock(&pc->lock);
+        pc->remote = ra;
+        pthread_mutex_unlock(&pc->lock);
         dtls_handler(pc, buffer, n);
     } else
     // stun
@@ -242,6 +1869,39 @@ static int socket_event_handler(struct peerconn *pc) {
  * \return 0 on success, negative on error.
  */
 static int timer_event_handler(struct peerconn *pc) {
+    int id;
+
+    // as client, begin handshake once the remote peer is known
+    if (DTLS_STATE_NEW == pc->dtls.state) {
+        pthread_mutex_lock(&pc->lock);
+        bool ready = pc->have_rdesc && AF_INET == pc->remote.sin_family;
+        pthread_mutex_unlock(&pc->lock);
+        if (ready) dtls_begin(pc);
+    }
+
+    while (id = timer_expired(&pc->timers), id >= 0) {
+        switch (id) {
+        case TIMER_DTLS:
+            pc->hs.backlog.timeout = true;
+            handshake_kick(pc);
+            break;
+        case TIMER_JBUF:
+            video_rx_poll(pc);
+            break;
+        case TIMER_PACER:
+            video_tx_poll(pc);
+            break;
+        case TIMER_FEEDBACK:
+            video_rx_feedback(pc);
+            break;
+        case TIMER_REPORT:
+            rtcp_report_due(pc);
+            break;
+        default:
+            break;
+        }
+    }
+
     return 0;
 }
 
@@ -300,6 +1960,22 @@ const event_handler action_table[NUM_STATES][NUM_EVENTS] = {
     { NULL, NULL, NULL }
 };
 
+/**
+ * Remember state of a connected remote peer for fast reconnect
+ *
+ * \param pc Peer connection.
+ */
+static void remember_peer(struct peerconn *pc) {
+    struct resume_entry *e = &pc->resume;
+
+    if (AF_INET != pc->remote.sin_family) return;
+
+    memcpy(e->fingerprint, pc->rdesc.fingerprint.sha256, sizeof(e->fingerprint));
+    e->remote = pc->remote;
+
+    resume_store(e);
+}
+
 /**
  * Runloop finite state machine (mealy) for handling timer and receive events
  */
@@ -336,26 +2012,53 @@ const event_handler action_table[NUM_STATES][NUM_EVENTS] = {
 static void * runloop(void *arg) {
     struct peerconn *pc;
     enum rtc_event event;
+    bool stop;
     int n;
 
     pc = (struct peerconn *)arg;
     assert(pc);
 
 _loop:
-    // block indefinitely (-1 timeout) until i/o event
-    n = poll(pc->fds, NUM_EVENTS, -1);
-    assert(n > 0);
+    // block until i/o event or earliest timer
+    n = poll(
+        pc->fds,
+        NUM_EVENTS,
+        timer_poll_timeout(&pc->timers, POLL_TIMEOUT_MS)
+    );
+    if (-1 == n && EINTR != errno) {
+        urtc_log(URTC_ERROR, "%s", strerror(errno));
+        return NULL;
+    }
+
+    // stopped by urtc_peerconn_destroy(), never while holding a lock; and
+    // playout policy set by urtc_set_video_playout() takes effect
+    pthread_mutex_lock(&pc->lock);
+    stop = pc->stop;
+    pc->video_rx.jbuf.profile = pc->video_rx.playout;
+    pthread_mutex_unlock(&pc->lock);
+    if (stop) return NULL;
 
     // which event(s) occurred?
-    if (pc->fds[EVENT_SOCKET].revents & POLLIN) {
+    if (n > 0 && pc->fds[EVENT_SOCKET].revents & POLLIN) {
         event = EVENT_SOCKET;
-    } else
-    if (pc->fds[EVENT_MDNS].revents & POLLIN) {
+        socket_event_handler(pc);
+    }
+    if (n > 0 && pc->fds[EVENT_MDNS].revents & POLLIN) {
         mdns_handler(pc);
-    } else
-    if (pc->fds[EVENT_TIMER].revents & POLLIN) {
-        event = EVENT_TIMER;
     }
+    if (n > 0 && pc->fds[EVENT_WORK].revents & POLLIN) {
+        handshake_done(pc);
+    }
+    if (n > 0 && pc->fds[EVENT_WAKE].revents & POLLIN) {
+        uint8_t b[16];
+        if (read(pc->video.wake[0], b, sizeof(b)) > 0) video_tx_poll(pc);
+    }
+
+    event = EVENT_TIMER;
+    timer_event_handler(pc);
+
+    // feedback queued while handling events leaves together
+    rtcp_flush(pc);
 
     goto _loop;
 
@@ -382,6 +2085,64 @@ urtc_peerconn_t * urtc_peerconn_create(const char *stun[]) {
     pc->sockfd = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (-1 == pc->sockfd) goto _fail_socket;
     pc->fds[EVENT_SOCKET] = (struct pollfd){ pc->sockfd, POLLIN };
+    txq_init(&pc->video.txq, pc->sockfd);
+
+    // kernel stamps arrivals, for congestion feedback (best effort)
+#ifdef SO_TIMESTAMPNS
+    setsockopt(pc->sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &(int){ 1 },
+        sizeof(int));
+#else
+    setsockopt(pc->sockfd, SOL_SOCKET, SO_TIMESTAMP, &(int){ 1 },
+        sizeof(int));
+#endif
+
+    // timers are serviced via the poll() timeout, not a descriptor
+    pc->fds[EVENT_TIMER] = (struct pollfd){ -1, 0 };
+
+    pthread_mutex_init(&pc->lock, NULL);
+
+    // outgoing video stream identity
+    pthread_mutex_init(&pc->video.lock, NULL);
+    pthread_cond_init(&pc->video.group_idle, NULL);
+    pc->video.pt = VIDEO_DEFAULT_PT;
+    prng(&pc->video.ssrc, sizeof(pc->video.ssrc));
+    prng(&pc->video.seq, sizeof(pc->video.seq));
+    prng(&pc->video.ts_offset, sizeof(pc->video.ts_offset));
+    prng(&pc->video.rtx_ssrc, sizeof(pc->video.rtx_ssrc));
+    prng(&pc->video.rtx_seq, sizeof(pc->video.rtx_seq));
+    prng(&pc->video.fec_ssrc, sizeof(pc->video.fec_ssrc));
+    prng(&pc->video.fec_seq, sizeof(pc->video.fec_seq));
+    fec_enc_init(&pc->video.fec);
+    pacer_init(&pc->video.pacer, VIDEO_DEFAULT_BITRATE, VIDEO_DEFAULT_PACING);
+    gcc_init(&pc->video.gcc, VIDEO_DEFAULT_BITRATE);
+    pc->video.reported_bps = VIDEO_DEFAULT_BITRATE;
+    prng(&pc->video.twcc_seq, sizeof(pc->video.twcc_seq));
+
+    pc->video_rx.pt = VIDEO_DEFAULT_PT;
+    pc->video_rx.playout = JBUF_PROFILE_LOW_LATENCY;
+    jbuf_init(&pc->video_rx.jbuf, pc->video_rx.playout, video_rx_emit,
+        video_rx_nack, pc);
+    h264_depkt_init(&pc->video_rx.depkt, video_frame_ready, pc);
+    fec_dec_init(&pc->video_rx.fec, video_rx_recovered, pc);
+    twcc_init(&pc->video_rx.twcc);
+    gcc_init(&pc->video_rx.gcc, VIDEO_DEFAULT_BITRATE);
+    pc->video_rx.feedback_us = VIDEO_FEEDBACK_MIN_US;
+
+    // completions of handshake work offloaded to the worker pool
+    if (-1 == pipe(pc->hs.pipe)) goto _fail_pipe;
+    pc->hs.pc = pc;
+    pc->hs.job.run = handshake_run;
+    pc->hs.job.fd = pc->hs.pipe[1];
+    pc->fds[EVENT_WORK] = (struct pollfd){ pc->hs.pipe[0], POLLIN };
+
+    // wakes runloop to pace video queued by application threads
+    if (-1 == pipe(pc->video.wake)) goto _fail_wake;
+    pc->fds[EVENT_WAKE] = (struct pollfd){ pc->video.wake[0], POLLIN };
+
+    // share process-wide certificate (fingerprint is precomputed)
+    if (cert_acquire(&pc->cert, &pc->key, pc->fingerprint) < 0) {
+        goto _fail_certificate;
+    }
 
     // generate a unique local mDNS hostname
     uuid_create_str(pc->mdns.hostname);
@@ -408,6 +2169,17 @@ urtc_peerconn_t * urtc_peerconn_create(const char *stun[]) {
 _fail_pthread_create:
     mdns_unsubscribe(pc->mdns.sockfd);
 _fail_mdns_subscribe:
+    X509_free(pc->cert);
+    EVP_PKEY_free(pc->key);
+_fail_certificate:
+    close(pc->video.wake[0]);
+    close(pc->video.wake[1]);
+_fail_wake:
+    close(pc->hs.pipe[0]);
+    close(pc->hs.pipe[1]);
+_fail_pipe:
+    pthread_mutex_destroy(&pc->video.lock);
+    pthread_mutex_destroy(&pc->lock);
     close(pc->sockfd);
 _fail_socket:
     free(pc);
@@ -423,10 +2195,122 @@ int urtc_set_on_ice_candidate(struct peerconn *pc, urtc_on_ice_candidate *cb) {
     return -URTC_ERR_NOT_IMPLEMENTED;
 }
 
+int urtc_set_on_video_frame(
+    struct peerconn *pc,
+    urtc_on_video_frame *cb,
+    void *arg
+) {
+    if (!pc) return -URTC_ERR_BAD_ARGUMENT;
+
+    pc->video_rx.cb = cb;
+    pc->video_rx.arg = arg;
+
+    return 0;
+}
+
+int urtc_set_on_target_bitrate(
+    struct peerconn *pc,
+    urtc_on_target_bitrate *cb,
+    void *arg
+) {
+    if (!pc) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&pc->video.lock);
+    pc->video.bitrate_cb = cb;
+    pc->video.bitrate_arg = arg;
+    pthread_mutex_unlock(&pc->video.lock);
+
+    return 0;
+}
+
+int urtc_set_video_playout(struct peerconn *pc, enum urtc_playout playout) {
+    enum jbuf_profile profile;
+
+    if (!pc) return -URTC_ERR_BAD_ARGUMENT;
+
+    switch (playout) {
+    case URTC_PLAYOUT_LOW_LATENCY:
+        profile = JBUF_PROFILE_LOW_LATENCY;
+        break;
+    case URTC_PLAYOUT_SMOOTH:
+        profile = JBUF_PROFILE_SMOOTH;
+        break;
+    default:
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+
+    // the jitter buffer belongs to the runloop, which applies it on waking
+    pthread_mutex_lock(&pc->lock);
+    pc->video_rx.playout = profile;
+    pthread_mutex_unlock(&pc->lock);
+
+    return 0;
+}
+
+int urtc_send_padding(struct peerconn *pc, size_t bytes) {
+    size_t queued = 0;
+
+    if (!pc) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&pc->video.lock);
+
+    if (!pc->video.ready) goto _unlock;
+
+    queued = video_pad(pc, bytes, timer_now_us());
+    if (video_pace(pc)) video_wake(pc);
+
+_unlock:
+    pthread_mutex_unlock(&pc->video.lock);
+
+    return (int)queued;
+}
+
+int urtc_set_video_pacing(
+    struct peerconn *pc,
+    uint32_t bitrate,
+    double factor
+) {
+    if (!pc || factor < 1.0) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&pc->video.lock);
+    pacer_set_rate(&pc->video.pacer, bitrate, factor);
+    if (bitrate) {
+        gcc_set_bitrate(&pc->video.gcc, bitrate);
+        pc->video.reported_bps = pc->video.gcc.target_bps;
+    }
+    pthread_mutex_unlock(&pc->video.lock);
+
+    return 0;
+}
+
+int urtc_set_video_txtime(struct peerconn *pc, bool enable) {
+    int rv = 0;
+
+    if (!pc) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&pc->video.lock);
+    if (enable && !pc->video.txq.txtime) {
+        rv = txq_enable_txtime(&pc->video.txq);
+    }
+    if (0 == rv) {
+        video_flush(pc);
+        pc->video.txtime = enable;
+        pacer_set_horizon(&pc->video.pacer,
+            enable ? VIDEO_TXTIME_HORIZON_US : 0);
+    }
+    pthread_mutex_unlock(&pc->video.lock);
+
+    return rv;
+}
+
 int urtc_add_ice_candidate(struct peerconn *pc, const char *cand) {
     return -URTC_ERR_NOT_IMPLEMENTED;
 }
 
+int urtc_certificate_init(const char *path, unsigned int rotate) {
+    return cert_init(path, rotate);
+}
+
 int urtc_create_answer(struct peerconn *pc, char *answer, size_t size) {
     // write unique session id
     {
@@ -451,7 +2335,57 @@ int urtc_create_answer(struct peerconn *pc, char *answer, size_t size) {
     }
 
     pc->ldesc.ice_options.trickle = true;
-    pc->ldesc.mode = SDP_MODE_SEND_ONLY;
+
+    // video: the negotiated h264 payload type and its retransmissions
+    pthread_mutex_lock(&pc->video.lock);
+    pc->ldesc.video.port = 9;
+    pc->ldesc.video.params[0] = (struct sdp_rtpmap){
+        .type = pc->video.pt,
+        .codec = SDP_CODEC_H264,
+        .clock = RTP_VIDEO_CLOCK_HZ
+    };
+    pc->ldesc.video.count = 1;
+    pc->ldesc.video.ssrc = pc->video.ssrc;
+    pc->ldesc.video.rtx_ssrc = 0;
+    if (pc->video.rtx_pt) {
+        pc->ldesc.video.params[1] = (struct sdp_rtpmap){
+            .type = pc->video.rtx_pt,
+            .codec = SDP_CODEC_RTX,
+            .clock = RTP_VIDEO_CLOCK_HZ,
+            .apt = pc->video.pt
+        };
+        pc->ldesc.video.rtx_ssrc = pc->video.rtx_ssrc;
+        pc->ldesc.video.count++;
+    }
+    pc->ldesc.video.fec_ssrc = 0;
+    if (pc->video.fec_pt) {
+        pc->ldesc.video.params[pc->ldesc.video.count++] = (struct sdp_rtpmap){
+            .type = pc->video.fec_pt,
+            .codec = SDP_CODEC_FLEXFEC,
+            .clock = RTP_VIDEO_CLOCK_HZ
+        };
+        pc->ldesc.video.fec_ssrc = pc->video.fec_ssrc;
+    }
+    pc->ldesc.video.twcc_ext = pc->video.twcc_ext;
+    pc->ldesc.video.remb = pc->rdesc.video.remb;
+    pc->ldesc.video.pli = pc->rdesc.video.pli;
+    pc->ldesc.video.fir = pc->rdesc.video.fir;
+    pthread_mutex_unlock(&pc->video.lock);
+    pc->ldesc.rtcp_mux = true;
+    pc->ldesc.rtcp_rsize = pc->rdesc.rtcp_rsize;
+    snprintf(pc->ldesc.video.cname, sizeof(pc->ldesc.video.cname), "%s",
+        pc->mdns.hostname);
+
+    pc->ldesc.mode = pc->video_rx.cb ?
+        SDP_MODE_SEND_AND_RECEIVE : SDP_MODE_SEND_ONLY;
+
+    // dtls: advertise certificate, and be client unless remote insists
+    memcpy(pc->ldesc.fingerprint.sha256, pc->fingerprint,
+        sizeof(pc->ldesc.fingerprint.sha256));
+    pthread_mutex_lock(&pc->lock);
+    pc->ldesc.setup = SDP_SETUP_ACTIVE == pc->rdesc.setup ?
+        SDP_SETUP_PASSIVE : SDP_SETUP_ACTIVE;
+    pthread_mutex_unlock(&pc->lock);
 
     return sdp_serialize(answer, size, &pc->ldesc);
 }
@@ -461,17 +2395,417 @@ int urtc_create_offer(struct peerconn *pc, char *offer, size_t size) {
 }
 
 int urtc_set_remote_description(struct peerconn *pc, const char *desc) {
-    return sdp_parse(&pc->rdesc, desc);
+    pthread_mutex_lock(&pc->lock);
+
+    int rv = sdp_parse(&pc->rdesc, desc);
+    if (rv < 0) goto _unlock;
+
+    // returning peer? send to its last address until it is heard from.
+    if (0 == resume_lookup(
+        &pc->resume,
+        pc->rdesc.fingerprint.sha256,
+        RESUME_WINDOW_S
+    )) {
+        urtc_log(URTC_INFO, "returning peer, last seen at %s",
+            inet_ntoa(pc->resume.remote.sin_addr));
+        pc->remote = pc->resume.remote;
+        pc->resuming = true;
+    }
+
+    // send and receive on the first h264 payload type offered, and
+    // retransmit on the payload type associated with it, if any
+    for (int i = 0; i < pc->rdesc.video.count; i++) {
+        if (SDP_CODEC_H264 == pc->rdesc.video.params[i].codec) {
+            uint8_t pt = pc->rdesc.video.params[i].type, rtx_pt = 0;
+            for (int j = 0; j < pc->rdesc.video.count; j++) {
+                if (SDP_CODEC_RTX == pc->rdesc.video.params[j].codec &&
+                        pt == pc->rdesc.video.params[j].apt) {
+                    rtx_pt = pc->rdesc.video.params[j].type;
+                    break;
+                }
+            }
+            pthread_mutex_lock(&pc->video.lock);
+            pc->video.pt = pt;
+            pc->video.rtx_pt = rtx_pt;
+            pthread_mutex_unlock(&pc->video.lock);
+            pc->video_rx.pt = pt;
+            pc->video_rx.rtx_pt = rtx_pt;
+            break;
+        }
+    }
+
+    // number packets for transport-wide feedback, if offered
+    pthread_mutex_lock(&pc->video.lock);
+    pc->video.twcc_ext = pc->rdesc.video.twcc_ext;
+    pthread_mutex_unlock(&pc->video.lock);
+
+    // and report arrivals back, or else an estimate of bitrate received
+    pc->video_rx.twcc_ext = pc->rdesc.video.twcc_ext;
+    pc->video_rx.remb = pc->rdesc.video.remb;
+
+    // feedback without reports, if offered
+    pc->rtcp.rsize = pc->rdesc.rtcp_rsize;
+
+    // protect with flexfec, if offered
+    for (int i = 0; i < pc->rdesc.video.count; i++) {
+        if (SDP_CODEC_FLEXFEC == pc->rdesc.video.params[i].codec) {
+            pthread_mutex_lock(&pc->video.lock);
+            pc->video.fec_pt = pc->rdesc.video.params[i].type;
+            pthread_mutex_unlock(&pc->video.lock);
+            pc->video_rx.fec_pt = pc->rdesc.video.params[i].type;
+            break;
+        }
+    }
+
+    pc->have_rdesc = true;
+
+_unlock:
+    pthread_mutex_unlock(&pc->lock);
+
+    return rv;
 }
 
 int urtc_set_local_description(struct peerconn *pc, const char *desc) {
-    return sdp_parse(&pc->ldesc, desc);
+    pthread_mutex_lock(&pc->lock);
+    int rv = sdp_parse(&pc->ldesc, desc);
+    pthread_mutex_unlock(&pc->lock);
+
+    return rv;
+}
+
+/**
+ * Share device uplink between broadcast groups, if budgeted
+ *
+ * Runs every UPLINK_INTERVAL_US, from the sending thread of whichever group
+ * sends a frame then. Each member's path estimate is read, and the mode
+ * chosen for it applied, under its video lock. Members joining or leaving
+ * meanwhile wait for the next allocation. Encoder targets that moved are
+ * reported after all locks are released.
+ *
+ * \param now Current time.
+ */
+static void uplink_update(uint64_t now) {
+    struct uplink_stream s[UPLINK_MAX_STREAMS];
+    struct peerconn *pcs[UPLINK_MAX_STREAMS][UPLINK_MAX_VIEWERS];
+    struct {
+        void (*cb)(uint32_t bps, void *arg);
+        void *arg;
+        uint32_t bps;
+    } report[UPLINK_MAX_STREAMS];
+    int n;
+
+    pthread_mutex_lock(&uplink.lock);
+    if (!uplink.budget_bps || now - uplink.last_us < UPLINK_INTERVAL_US) {
+        pthread_mutex_unlock(&uplink.lock);
+        return;
+    }
+    uplink.last_us = now;
+    n = uplink.count;
+
+    for (int i = 0; i < n; i++) {
+        struct bcast *g = uplink.groups[i];
+
+        pthread_mutex_lock(&g->lock);
+        s[i] = (struct uplink_stream){
+            .weight = g->weight,
+            .floor_bps = g->floor_bps,
+            .count = g->count < UPLINK_MAX_VIEWERS ?
+                g->count : UPLINK_MAX_VIEWERS
+        };
+        for (int j = 0; j < s[i].count; j++) {
+            pcs[i][j] = g->members[j];
+            pthread_mutex_lock(&pcs[i][j]->video.lock);
+            s[i].estimate_bps[j] = pcs[i][j]->video.estimate_bps;
+            pthread_mutex_unlock(&pcs[i][j]->video.lock);
+        }
+        pthread_mutex_unlock(&g->lock);
+    }
+
+    uplink_allocate(uplink.budget_bps, s, n);
+
+    for (int i = 0; i < n; i++) {
+        struct bcast *g = uplink.groups[i];
+
+        pthread_mutex_lock(&g->lock);
+        for (int j = 0; j < s[i].count; j++) {
+            struct peerconn *pc = pcs[i][j];
+            if (j >= g->count || g->members[j] != pc) continue;
+            pthread_mutex_lock(&pc->video.lock);
+            if (pc->video.mode != s[i].mode[j]) {
+                urtc_log(URTC_INFO, "[uplink] member %d of group %d: %s", j,
+                    i, UPLINK_FULL == s[i].mode[j] ? "full" :
+                    UPLINK_THIN == s[i].mode[j] ? "keyframes only" :
+                    "dropped");
+            }
+            pc->video.mode = s[i].mode[j];
+            pthread_mutex_unlock(&pc->video.lock);
+        }
+        report[i].cb = NULL;
+        if (s[i].target_bps > g->target_bps * (1 + VIDEO_BITRATE_STEP) ||
+                s[i].target_bps < g->target_bps * (1 - VIDEO_BITRATE_STEP)) {
+            g->target_bps = s[i].target_bps;
+            report[i].cb = g->on_target;
+            report[i].arg = g->on_target_arg;
+            report[i].bps = g->target_bps;
+        }
+        pthread_mutex_unlock(&g->lock);
+    }
+    pthread_mutex_unlock(&uplink.lock);
+
+    for (int i = 0; i < n; i++) {
+        if (report[i].cb) report[i].cb(report[i].bps, report[i].arg);
+    }
+}
+
+int urtc_set_uplink_budget(uint32_t bitrate) {
+    pthread_mutex_lock(&uplink.lock);
+    uplink.budget_bps = bitrate;
+    uplink.last_us = 0;
+
+    // members are sent every frame again once not budgeted
+    for (int i = 0; !bitrate && i < uplink.count; i++) {
+        struct bcast *g = uplink.groups[i];
+        pthread_mutex_lock(&g->lock);
+        for (int j = 0; j < g->count; j++) {
+            struct peerconn *pc = g->members[j];
+            pthread_mutex_lock(&pc->video.lock);
+            pc->video.mode = UPLINK_FULL;
+            pthread_mutex_unlock(&pc->video.lock);
+        }
+        pthread_mutex_unlock(&g->lock);
+    }
+    pthread_mutex_unlock(&uplink.lock);
+
+    return 0;
+}
+
+urtc_bcast_t *urtc_bcast_create(void) {
+    struct bcast *g = (struct bcast *)calloc(1, sizeof(struct bcast));
+    if (!g) return NULL;
+
+    if (bcast_init(g, video_send) < 0) {
+        free(g);
+        return NULL;
+    }
+    g->weight = 1;
+    g->floor_bps = UPLINK_DEFAULT_FLOOR;
+
+    pthread_mutex_lock(&uplink.lock);
+    if (uplink.count < UPLINK_MAX_STREAMS) {
+        uplink.groups[uplink.count++] = g;
+    } else {
+        urtc_log(URTC_WARN, "[uplink] too many groups, not budgeted");
+    }
+    pthread_mutex_unlock(&uplink.lock);
+
+    return g;
+}
+
+int urtc_bcast_join(struct bcast *g, struct peerconn *pc) {
+    bool other, reserved;
+    int rv;
+
+    if (!g || !pc) return -URTC_ERR_BAD_ARGUMENT;
+
+    // reserve the connection's one group, so a concurrent join fails
+    pthread_mutex_lock(&pc->video.lock);
+    other = pc->video.group && pc->video.group != g;
+    reserved = !pc->video.group;
+    if (reserved) pc->video.group = g;
+    pthread_mutex_unlock(&pc->video.lock);
+    if (other) return -URTC_ERR_BAD_ARGUMENT;
+
+    if (rv = bcast_join(g, pc), rv < 0) {
+        pthread_mutex_lock(&pc->video.lock);
+        if (reserved) pc->video.group = NULL;
+        pthread_mutex_unlock(&pc->video.lock);
+        return rv;
+    }
+
+    pthread_mutex_lock(&g->lock);
+    if (g->pacing >= 1.0) urtc_set_video_pacing(pc, g->bitrate, g->pacing);
+    pthread_mutex_unlock(&g->lock);
+
+    return 0;
+}
+
+int urtc_bcast_leave(struct bcast *g, struct peerconn *pc) {
+    if (!g || !pc) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&pc->video.lock);
+    if (pc->video.group != g) {
+        pthread_mutex_unlock(&pc->video.lock);
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    pc->video.group = NULL;
+    pc->video.mode = UPLINK_FULL;
+
+    // the runloop may be asking the group for a keyframe; wait it out, so
+    // the group can be destroyed on return
+    while (pc->video.group_users) {
+        pthread_cond_wait(&pc->video.group_idle, &pc->video.lock);
+    }
+    pthread_mutex_unlock(&pc->video.lock);
+
+    bcast_leave(g, pc);
+
+    return 0;
+}
+
+int urtc_bcast_set_video_pacing(
+    struct bcast *g,
+    uint32_t bitrate,
+    double factor
+) {
+    if (!g || factor < 1.0) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&g->lock);
+    g->bitrate = bitrate;
+    g->pacing = factor;
+    for (int i = 0; i < g->count; i++) {
+        urtc_set_video_pacing(g->members[i], bitrate, factor);
+    }
+    pthread_mutex_unlock(&g->lock);
+
+    return 0;
+}
+
+int urtc_bcast_set_weight(
+    struct bcast *g,
+    unsigned weight,
+    uint32_t floor
+) {
+    if (!g || !weight) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&g->lock);
+    g->weight = weight;
+    g->floor_bps = floor;
+    pthread_mutex_unlock(&g->lock);
+
+    return 0;
+}
+
+int urtc_bcast_set_on_target_bitrate(
+    struct bcast *g,
+    urtc_on_target_bitrate *cb,
+    void *arg
+) {
+    if (!g) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&g->lock);
+    g->on_target = cb;
+    g->on_target_arg = arg;
+    pthread_mutex_unlock(&g->lock);
+
+    return 0;
+}
+
+int urtc_bcast_set_on_force_idr(
+    struct bcast *g,
+    urtc_force_idr *cb,
+    void *arg
+) {
+    if (!g) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&g->lock);
+    g->force_idr = cb;
+    g->force_idr_arg = arg;
+    pthread_mutex_unlock(&g->lock);
+
+    return 0;
+}
+
+int urtc_bcast_set_idr_coalescing(
+    struct bcast *g,
+    uint64_t window_us,
+    uint64_t interval_us
+) {
+    if (!g) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_mutex_lock(&g->lock);
+    g->idr_window_us = window_us;
+    g->idr_interval_us = interval_us;
+    pthread_mutex_unlock(&g->lock);
+
+    return 0;
+}
+
+int urtc_bcast_send_frame(
+    struct bcast *g,
+    const uint8_t *au,
+    size_t len,
+    uint64_t pts_us
+) {
+    uint32_t ts = pts_us * RTP_VIDEO_CLOCK_HZ / 1000000;
+    uint64_t now = timer_now_us();
+    int rv;
+
+    uplink_update(now);
+
+    // members with no keyframe kept to start from need a new one
+    rv = bcast_send_frame(g, au, len, ts);
+    bcast_request_idr(g, rv > 0, now);
+
+    return rv < 0 ? rv : 0;
+}
+
+void urtc_bcast_destroy(struct bcast *g) {
+    if (g) {
+        pthread_mutex_lock(&uplink.lock);
+        for (int i = 0; i < uplink.count; i++) {
+            if (uplink.groups[i] == g) {
+                uplink.groups[i] = uplink.groups[--uplink.count];
+                break;
+            }
+        }
+        pthread_mutex_unlock(&uplink.lock);
+
+        bcast_destroy(g);
+        free(g);
+    }
 }
 
 void urtc_peerconn_destroy(struct peerconn *pc) {
+    struct bcast *g;
+    uint8_t b = 0;
+
     if (pc) {
-        pthread_cancel(pc->thread);
+        pthread_mutex_lock(&pc->video.lock);
+        g = pc->video.group;
+        pthread_mutex_unlock(&pc->video.lock);
+        if (g) urtc_bcast_leave(g, pc);
+
+        // wake runloop to stop, else it stops within POLL_TIMEOUT_MS.
+        // cancelling it instead could leave a lock held.
+        pthread_mutex_lock(&pc->lock);
+        pc->stop = true;
+        pthread_mutex_unlock(&pc->lock);
+        if (1 != write(pc->video.wake[1], &b, 1)) {
+            urtc_log(URTC_WARN, "runloop not woken, waiting for timeout");
+        }
         pthread_join(pc->thread, NULL);
+        workq_cancel(&pc->hs.job);
+        close(pc->hs.pipe[0]);
+        close(pc->hs.pipe[1]);
+        close(pc->video.wake[0]);
+        close(pc->video.wake[1]);
+        if (DTLS_STATE_CONNECTED == pc->dtls.state) {
+            remember_peer(pc);
+        }
+        dtls_stop(&pc->dtls);
+        srtp_free(&pc->srtp_tx);
+        srtp_free(&pc->srtp_rx);
+        hist_free(&pc->video.hist);
+        for (int i = 0; i < VIDEO_REPLAY_SLOTS; i++) {
+            rtp_payload_unref(pc->video.replay[i].p);
+        }
+        jbuf_free(&pc->video_rx.jbuf);
+        h264_depkt_free(&pc->video_rx.depkt);
+        X509_free(pc->cert);
+        EVP_PKEY_free(pc->key);
+        pthread_cond_destroy(&pc->video.group_idle);
+        pthread_mutex_destroy(&pc->video.lock);
+        pthread_mutex_destroy(&pc->lock);
         mdns_unsubscribe(pc->mdns.sockfd);
         shutdown(pc->sockfd, SHUT_RDWR);
         close(pc->sockfd);
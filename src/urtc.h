@@ -55,6 +55,10 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * Opque peer connection structure.
  *
@@ -89,10 +93,83 @@ typedef int (urtc_on_ice_candidate)(const char *cand, void *arg);
  * re-establish picture.
  *
  * This is an optional callback. If set, it improves the TTFF and picture
- * recovery time from loss of picture.
+ * recovery time from loss of picture. Requests from viewers of a broadcast
+ * group (picture loss indications and full intra requests) are coalesced
+ * into one, see urtc_bcast_set_idr_coalescing(). Note that callback may
+ * execute on any viewer's event loop, or on the sending thread.
+ *
+ * \param arg User specified argument, see urtc_bcast_set_on_force_idr().
  */
-typedef void (urtc_force_idr)();
+typedef void (urtc_force_idr)(void *arg);
 
+/**
+ * (callback) Called when the estimated bitrate to the remote peer changes
+ *
+ * With transport-wide congestion control negotiated, the remote peer
+ * reports when each packet arrived, and the bitrate the path can carry is
+ * estimated from growth in queueing delay and from loss. Outgoing video is
+ * paced at the estimate; set the encoder's bitrate to it, so that frames
+ * are not queued for seconds on a congested link. Note that callback
+ * executes on peer connection event loop.
+ *
+ * \param bitrate Target bitrate (in bits per second).
+ * \param arg User specified argument, see urtc_set_on_target_bitrate().
+ */
+typedef void (urtc_on_target_bitrate)(uint32_t bitrate, void *arg);
+
+/**
+ * (callback) Called for each complete H.264 access unit received
+ *
+ * Frames with missing packets are dropped, and frames following a drop are
+ * withheld until the next IDR frame. Note that callback executes on peer
+ * connection event loop -- hand the frame to a decoder, do not decode
+ * within the callback.
+ *
+ * Akin to the `ontrack` event handler in `RTCPeerConnection`, for the
+ * video track.
+ *
+ * \param au Access unit (Annex-B byte stream), valid only during callback.
+ * \param len Size of access unit.
+ * \param ts RTP timestamp (90 kHz clock).
+ * \param keyframe Whether access unit contains an IDR slice.
+ * \param arg User specified argument, see urtc_set_on_video_frame().
+ */
+typedef void (urtc_on_video_frame)(
+    const uint8_t *au,
+    size_t len,
+    uint32_t ts,
+    bool keyframe,
+    void *arg
+);
+
+
+/**
+ * Playout delay policy for received video
+ */
+enum urtc_playout {
+    URTC_PLAYOUT_LOW_LATENCY = 0,       // under 50 ms on a LAN, e.g. intercom
+    URTC_PLAYOUT_SMOOTH                 // rides out WAN jitter and loss
+};
+
+/**
+ * Initializes the process-wide DTLS certificate
+ *
+ * All peer connections share one ECDSA P-256 certificate, so its key pair is
+ * generated once rather than per connection. Call once at startup, before
+ * creating peer connections. If \a path holds a certificate younger than
+ * \a rotate seconds, it is reused across restarts; otherwise a new one is
+ * generated and saved there. The certificate is replaced every \a rotate
+ * seconds; established connections keep the one they started with.
+ *
+ * Optional. If never called, a certificate is generated on first use and
+ * rotated weekly.
+ *
+ * \param path PEM file for key and certificate, or NULL for none.
+ * \param rotate Rotation period (in seconds), or 0 for the default (7 days).
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_certificate_init(const char *path, unsigned int rotate);
 
 /**
  * Create a new peer connection
@@ -122,6 +199,115 @@ urtc_peerconn_t * urtc_peerconn_create(const char *stun[]);
  */
 int urtc_set_on_ice_candidate(urtc_peerconn_t *pc, urtc_on_ice_candidate *cb);
 
+/**
+ * Sets onVideoFrame callback function
+ *
+ * Callback function will be called with each received H.264 access unit.
+ * Set before the remote description, as frames are received from then on.
+ *
+ * \param pc Peer connection.
+ * \param cb Callback, or NULL to discard received video.
+ * \param arg User specified argument passed to callback.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_set_on_video_frame(
+    urtc_peerconn_t *pc,
+    urtc_on_video_frame *cb,
+    void *arg
+);
+
+/**
+ * Sets onTargetBitrate callback function
+ *
+ * Callback function will be called when the bitrate estimate moves by more
+ * than 5%.
+ *
+ * \param pc Peer connection.
+ * \param cb Callback, or NULL for none.
+ * \param arg User specified argument passed to callback.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_set_on_target_bitrate(
+    urtc_peerconn_t *pc,
+    urtc_on_target_bitrate *cb,
+    void *arg
+);
+
+/**
+ * Sets playout delay policy for received video
+ *
+ * Received packets are held in a jitter buffer for a target delay adapted
+ * from measured jitter, and missing packets are requested again (NACK).
+ * Low latency (the default) keeps playout delay under 50 ms on a LAN, and
+ * waits for a retransmission only if it can arrive within that budget.
+ * Smooth also reserves a round trip for retransmissions in its delay, for
+ * viewers on lossy WAN paths.
+ *
+ * \param pc Peer connection.
+ * \param playout Policy.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_set_video_playout(urtc_peerconn_t *pc, enum urtc_playout playout);
+
+/**
+ * Sends padding for bandwidth probing
+ *
+ * Recently sent video packets are queued again for the retransmission
+ * stream [^RFC4588], newest first, until at least \a bytes are queued or
+ * history is exhausted. They are paced behind video. Receivers discard them as duplicates, and unlike
+ * empty padding packets they are useful if an original was lost.
+ *
+ * \param pc Peer connection.
+ * \param bytes Amount of padding (in bytes).
+ *
+ * \return Bytes queued (zero if retransmission was not negotiated), or
+ *         negative on error.
+ */
+int urtc_send_padding(urtc_peerconn_t *pc, size_t bytes);
+
+/**
+ * Sets target bitrate and pacing of outgoing video
+ *
+ * Rather than a whole frame at once, packets are sent at \a factor times
+ * the target bitrate, so keyframe bursts do not overflow router queues.
+ * Retransmissions are sent ahead of queued video, and video ahead of
+ * padding. A backlog that would take longer than half a second to send is
+ * sent faster. Defaults to 2 Mbps and a factor of 2.5. With transport-wide
+ * congestion control negotiated, the target bitrate then follows the
+ * estimate (see urtc_set_on_target_bitrate()).
+ *
+ * \param pc Peer connection.
+ * \param bitrate Target bitrate (in bits per second), or 0 to not pace.
+ * \param factor Pacing multiplier over target bitrate, at least 1.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_set_video_pacing(
+    urtc_peerconn_t *pc,
+    uint32_t bitrate,
+    double factor
+);
+
+/**
+ * Hands paced video to the kernel ahead of time
+ *
+ * Instead of waking for each packet, packets are released up to 10 ms
+ * ahead, stamped with their departure time (SO_TXTIME), and sent in
+ * batches. The kernel holds each packet until due, which costs less CPU
+ * at high bitrates. Requires Linux and the fq queueing discipline on the
+ * outgoing interface (tc qdisc replace dev eth0 root fq); without it,
+ * packets are sent in bursts as they are released. Disabled by default.
+ *
+ * \param pc Peer connection.
+ * \param enable True to enable, false to pace in userspace.
+ *
+ * \return 0 on success, negative if not supported.
+ */
+int urtc_set_video_txtime(urtc_peerconn_t *pc, bool enable);
+
 /**
  * Adds received remote ICE candidate to peer connection
  *
@@ -216,10 +402,191 @@ int urtc_set_remote_description(urtc_peerconn_t *pc, const char *desc);
 /**
  * Tears down peer connection, closing and freeing all resources
  *
+ * A peer connection in a broadcast group leaves it first.
+ *
  * \param pc Peer connection.
  */
 void urtc_peerconn_destroy(urtc_peerconn_t *pc);
 
+/**
+ * Opaque broadcast group structure.
+ *
+ * Sends one H.264 stream to many peer connections, e.g. one camera to many
+ * viewers. Each frame is packetized once; members only write their own RTP
+ * headers and apply their own SRTP.
+ */
+typedef struct bcast urtc_bcast_t;
+
+/**
+ * Create an empty broadcast group
+ *
+ * \return New group, or NULL on error. Destroy with urtc_bcast_destroy().
+ */
+urtc_bcast_t * urtc_bcast_create(void);
+
+/**
+ * Add peer connection to broadcast group
+ *
+ * May be called at any time; the peer connection receives frames from the
+ * next one sent. Frames sent before its DTLS handshake completes are
+ * skipped for that member. A peer connection can be in at most one group.
+ *
+ * \param g Broadcast group.
+ * \param pc Peer connection.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_bcast_join(urtc_bcast_t *g, urtc_peerconn_t *pc);
+
+/**
+ * Remove peer connection from broadcast group
+ *
+ * On return, the peer connection no longer uses the group, which may then
+ * be destroyed. Not to be called from the group's callbacks.
+ *
+ * \param g Broadcast group.
+ * \param pc Peer connection.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_bcast_leave(urtc_bcast_t *g, urtc_peerconn_t *pc);
+
+/**
+ * Sets target bitrate and pacing of all members' video
+ *
+ * Applies to current members and those joining later, see
+ * urtc_set_video_pacing().
+ *
+ * \param g Broadcast group.
+ * \param bitrate Target bitrate (in bits per second), or 0 to not pace.
+ * \param factor Pacing multiplier over target bitrate, at least 1.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_bcast_set_video_pacing(
+    urtc_bcast_t *g,
+    uint32_t bitrate,
+    double factor
+);
+
+/**
+ * Sets share of the device uplink taken by a broadcast group
+ *
+ * See urtc_set_uplink_budget(). Defaults to a weight of 1 and a floor of
+ * 150 kbps.
+ *
+ * \param g Broadcast group.
+ * \param weight Share relative to other groups, at least 1.
+ * \param floor Least bitrate (in bits per second) worth sending a member
+ *        every frame at; members whose path is slower get keyframes only.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_bcast_set_weight(urtc_bcast_t *g, unsigned weight, uint32_t floor);
+
+/**
+ * Sets callback for the group's encoder target bitrate
+ *
+ * With an uplink budget set, called from the sending thread when the
+ * target chosen for the group moves by more than 5%.
+ *
+ * \param g Broadcast group.
+ * \param cb Callback, or NULL for none.
+ * \param arg User specified argument passed to callback.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_bcast_set_on_target_bitrate(
+    urtc_bcast_t *g,
+    urtc_on_target_bitrate *cb,
+    void *arg
+);
+
+/**
+ * Sets callback for keyframe requests to the group's encoder
+ *
+ * \param g Broadcast group.
+ * \param cb Callback, or NULL for none.
+ * \param arg User specified argument passed to callback.
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_bcast_set_on_force_idr(urtc_bcast_t *g, urtc_force_idr *cb, void *arg);
+
+/**
+ * Sets how keyframe requests from members are coalesced
+ *
+ * Members losing the same packets ask for a keyframe at about the same time.
+ * The first request is held for \a window, so that others join it, and
+ * requests are forwarded no more often than every \a interval; requests
+ * made while a keyframe is on its way are served by it. Defaults to a
+ * 20 ms window and a 500 ms interval.
+ *
+ * \param g Broadcast group.
+ * \param window_us Time a request is held (in microseconds).
+ * \param interval_us Least time between requests forwarded (in
+ *        microseconds).
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_bcast_set_idr_coalescing(
+    urtc_bcast_t *g,
+    uint64_t window_us,
+    uint64_t interval_us
+);
+
+/**
+ * Send an encoded H.264 access unit to all members
+ *
+ * Call from the encoder thread for each access unit. Frames since the last
+ * keyframe are copied and kept (up to 768 KiB), so that viewers joining
+ * mid-GOP are sent them, paced, and start at once instead of waiting for
+ * the next keyframe. Only if the GOP is longer is the encoder asked for one.
+ *
+ * \param g Broadcast group.
+ * \param au Access unit in Annex-B format (start code delimited NALs).
+ * \param len Size of access unit (in bytes).
+ * \param pts_us Presentation timestamp (in microseconds).
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_bcast_send_frame(
+    urtc_bcast_t *g,
+    const uint8_t *au,
+    size_t len,
+    uint64_t pts_us
+);
+
+/**
+ * Sets uplink bitrate shared by all broadcast groups on the device
+ *
+ * Left to congestion control per peer connection, viewers of a camera
+ * compete for its uplink, and the encoder can only follow one of them. With
+ * a budget, the uplink is divided between groups by weight (see
+ * urtc_bcast_set_weight()), and each group's encoder target is chosen to
+ * send as many members as possible every frame, at no less than the floor
+ * and at no more than their paths carry. Members that cannot keep up are
+ * sent keyframes only, or nothing, slowest first, rather than hold back
+ * the others; they pick up again at a keyframe. The target is reported
+ * through urtc_bcast_set_on_target_bitrate(). Reallocated every 200 ms, as
+ * frames are sent.
+ *
+ * \param bitrate Uplink budget (in bits per second), or 0 for none (the
+ *        default).
+ *
+ * \return 0 on success, negative on error.
+ */
+int urtc_set_uplink_budget(uint32_t bitrate);
+
+/**
+ * Destroy broadcast group
+ *
+ * All members must have left (or been destroyed) first.
+ *
+ * \param g Broadcast group.
+ */
+void urtc_bcast_destroy(urtc_bcast_t *g);
+
 #ifdef __cplusplus
 }
 #endif
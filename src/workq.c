@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+/**
+ * Small shared worker pool for expensive, latency-tolerant work.
+ *
+ * Used for DTLS handshake crypto (ECDHE and ECDSA), which takes
+ * milliseconds on embedded processors. Bounding the number of concurrent
+ * handshakes to the pool size keeps a burst of connecting viewers from
+ * starving the threads that are already streaming media.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>                     // read, write
+
+#include "err.h"
+#include "log.h"
+#include "workq.h"
+
+static struct {
+    struct workq_job *head, *tail;      // fifo of queued jobs
+    pthread_mutex_t lock;
+    pthread_cond_t ready;               // job queued
+    pthread_cond_t done;                // job finished running
+    pthread_t threads[WORKQ_THREADS];
+    int nthreads;
+} pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .ready = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER
+};
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void * worker(void *arg) {
+    struct workq_job *job;
+
+    for (;;) {
+        pthread_mutex_lock(&pool.lock);
+        while (!pool.head) {
+            pthread_cond_wait(&pool.ready, &pool.lock);
+        }
+        job = pool.head;
+        pool.head = job->next;
+        if (!pool.head) pool.tail = NULL;
+        job->next = NULL;
+        job->state = WORKQ_RUNNING;
+        pthread_mutex_unlock(&pool.lock);
+
+        job->run(job);
+
+        // notify under lock: once the owner sees the completion, the job
+        // is idle and may be resubmitted; once cancel returns, no more
+        // notifications are written.
+        pthread_mutex_lock(&pool.lock);
+        job->state = WORKQ_IDLE;
+        if (sizeof(job) != write(job->fd, &job, sizeof(job))) {
+            urtc_log(URTC_ERROR, "[workq] lost completion");
+        }
+        pthread_cond_broadcast(&pool.done);
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    return NULL;
+}
+
+static void start(void) {
+    for (int i = 0; i < WORKQ_THREADS; i++) {
+        if (0 != pthread_create(&pool.threads[i], NULL, worker, NULL)) {
+            urtc_log(URTC_ERROR, "[workq] could not start worker");
+            break;
+        }
+        pthread_detach(pool.threads[i]);
+        pool.nthreads++;
+    }
+}
+
+int workq_submit(struct workq_job *job) {
+    if (!job || !job->run) return -URTC_ERR_BAD_ARGUMENT;
+
+    pthread_once(&once, start);
+    if (0 == pool.nthreads) return -URTC_ERR;
+
+    pthread_mutex_lock(&pool.lock);
+    if (WORKQ_IDLE != job->state) {
+        pthread_mutex_unlock(&pool.lock);
+        return -URTC_ERR_BAD_ARGUMENT;
+    }
+    job->state = WORKQ_QUEUED;
+    job->next = NULL;
+    if (pool.tail) {
+        pool.tail->next = job;
+    } else {
+        pool.head = job;
+    }
+    pool.tail = job;
+    pthread_cond_signal(&pool.ready);
+    pthread_mutex_unlock(&pool.lock);
+
+    return 0;
+}
+
+int workq_complete(int fd, struct workq_job **job) {
+    ssize_t n;
+
+    if (!job) return -URTC_ERR_BAD_ARGUMENT;
+
+    do {
+        n = read(fd, job, sizeof(*job));
+    } while (-1 == n && EINTR == errno);
+
+    return sizeof(*job) == n ? 0 : -URTC_ERR;
+}
+
+void workq_cancel(struct workq_job *job) {
+    if (!job) return;
+
+    pthread_mutex_lock(&pool.lock);
+
+    if (WORKQ_QUEUED == job->state) {
+        struct workq_job **pp = &pool.head, *prev = NULL;
+        while (*pp && *pp != job) {
+            prev = *pp;
+            pp = &(*pp)->next;
+        }
+        if (*pp) {
+            *pp = job->next;
+            if (pool.tail == job) pool.tail = prev;
+        }
+        job->next = NULL;
+        job->state = WORKQ_IDLE;
+    }
+
+    while (WORKQ_RUNNING == job->state) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+
+    pthread_mutex_unlock(&pool.lock);
+}
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
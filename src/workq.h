@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2019-2021 Chris Hiszpanski. All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT
+ * SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef _URTC_WORKQ_H
+#define _URTC_WORKQ_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WORKQ_THREADS                    2  // worker threads in pool
+
+enum workq_state {
+    WORKQ_IDLE = 0,
+    WORKQ_QUEUED,
+    WORKQ_RUNNING
+};
+
+/**
+ * Unit of work executed by the shared worker pool
+ *
+ * Embed in the owner's state. When run() returns, a pointer to the job is
+ * written to \a fd, typically the write end of a pipe polled by the owning
+ * runloop, which then picks up results with workq_complete().
+ */
+struct workq_job {
+    void (*run)(struct workq_job *job); // executes on a worker thread
+    int fd;                             // completion notification
+
+    // private to work queue
+    enum workq_state state;
+    struct workq_job *next;
+};
+
+/**
+ * Queue job for execution on the worker pool
+ *
+ * The pool is started on first use. A job must not be resubmitted until its
+ * completion has been read.
+ *
+ * \param job Job with \a run and \a fd set.
+ *
+ * \return 0 on success, negative on error.
+ */
+int workq_submit(struct workq_job *job);
+
+/**
+ * Read one job completion notification
+ *
+ * \param fd Descriptor jobs notify on (e.g. read end of pipe).
+ * \param[out] job Completed job.
+ *
+ * \return 0 on success, negative on error.
+ */
+int workq_complete(int fd, struct workq_job **job);
+
+/**
+ * Withdraw job, or wait for it to finish if already running
+ *
+ * On return the job is no longer referenced by the pool. A completion
+ * notification may still be pending on its descriptor.
+ *
+ * \param job Job.
+ */
+void workq_cancel(struct workq_job *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _URTC_WORKQ_H
+
+/* vim: set expandtab ts=8 sw=4 tw=0 : */
@@ -0,0 +1,269 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "bcast.h"
+#include "err.h"
+
+struct member {
+	bool waiting;				// for a keyframe
+	bool idle;				// not connected, skips frames
+	bool replay;
+	int frames;
+	size_t count;
+	uint32_t ts;
+	bool keyframe;
+	struct rtp_payload *first;
+	struct rtp_payload *kept;
+};
+
+static void force_idr(void *arg) {
+	(*(int *)arg)++;
+}
+
+static int send(
+	void *member,
+	struct rtp_payload *const *pkts,
+	size_t count,
+	uint32_t ts,
+	bool keyframe,
+	bool replay
+) {
+	struct member *m = member;
+	if (m->idle) return BCAST_SKIPPED;
+	if (m->waiting && !keyframe) return BCAST_WAITING;
+	m->waiting = false;
+	m->replay = replay;
+	m->frames++;
+	m->keyframe = keyframe;
+	m->count = count;
+	m->ts = ts;
+	m->first = pkts[0];
+	if (!m->kept) m->kept = rtp_payload_ref(pkts[0]);
+	return BCAST_SENT;
+}
+
+int main(int argc, char **argv) {
+	const uint8_t au[] = {
+		0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1f,
+		0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x21
+	};
+
+	// Test rtp header
+	{
+		uint8_t hdr[RTP_HEADER_SIZE];
+		const uint8_t expect[RTP_HEADER_SIZE] = {
+			0x80, 0xe0, 0x12, 0x34, 0x00, 0x01, 0x5f, 0x90,
+			0xde, 0xad, 0xbe, 0xef
+		};
+		rtp_header_write(hdr, 96, true, 0x1234, 90000, 0xdeadbeef);
+		assert(0 == memcmp(expect, hdr, sizeof(hdr)));
+	}
+
+	// Test fan-out shares payloads, members join and leave at runtime
+	{
+		struct bcast g;
+		struct member a = { 0 }, b = { 0 };
+
+		assert(0 == bcast_init(&g, send));
+
+		// no members, nothing to do
+		assert(0 == bcast_send_frame(&g, au, sizeof(au), 0));
+
+		assert(0 == bcast_join(&g, &a));
+		assert(0 == bcast_join(&g, &a));    // idempotent
+		assert(0 == bcast_send_frame(&g, au, sizeof(au), 3000));
+		assert(1 == a.frames && 1 == a.count && 3000 == a.ts);  // stap-a
+		assert(a.keyframe);
+
+		assert(0 == bcast_join(&g, &b));
+		assert(0 == bcast_send_frame(&g, au, sizeof(au), 6000));
+		assert(2 == a.frames && 1 == b.frames);
+		assert(a.first == b.first);         // packetized once
+
+		assert(0 == bcast_leave(&g, &a));
+		assert(0 > bcast_leave(&g, &a));
+		assert(0 == bcast_send_frame(&g, au, sizeof(au), 9000));
+		assert(2 == a.frames && 2 == b.frames);
+
+		// references taken by members outlive the frame
+		uint8_t buf[16];
+		assert(a.kept->len == rtp_payload_copy(a.kept, buf));
+		assert(0x78 == buf[0] && 0x67 == buf[3]);
+		assert(1 == a.kept->refs);
+		rtp_payload_unref(a.kept);
+		rtp_payload_unref(b.kept);
+
+		// malformed frame is not sent
+		assert(0 > bcast_send_frame(&g, au + 4, 4, 0));
+		assert(2 == b.frames);
+
+		bcast_destroy(&g);
+	}
+
+	// Test group capacity
+	{
+		struct bcast g;
+		struct member m[BCAST_MAX_MEMBERS + 1];
+
+		assert(0 == bcast_init(&g, send));
+		for (int i = 0; i < BCAST_MAX_MEMBERS; i++) {
+			assert(0 == bcast_join(&g, &m[i]));
+		}
+		assert(-URTC_ERR_INSUFFICIENT_MEMORY ==
+			bcast_join(&g, &m[BCAST_MAX_MEMBERS]));
+		bcast_destroy(&g);
+	}
+
+	// Test keyframe requests are coalesced and rate limited
+	{
+		struct bcast g;
+		struct member a = { 0 };
+		int idrs = 0;
+
+		assert(0 == bcast_init(&g, send));
+		g.force_idr = force_idr;
+		g.force_idr_arg = &idrs;
+		assert(0 == bcast_join(&g, &a));
+
+		// held for the window, then forwarded once for all
+		assert(0 == bcast_request_idr(&g, true, 1000000));
+		assert(0 == bcast_request_idr(&g, true, 1010000));
+		assert(0 == bcast_request_idr(&g, false, 1015000));
+		assert(1 == bcast_request_idr(&g, false, 1020000));
+		assert(1 == idrs);
+
+		// served by the keyframe on its way
+		assert(0 == bcast_request_idr(&g, true, 1030000));
+		assert(0 == bcast_request_idr(&g, false, 1100000));
+		assert(0 == bcast_send_frame(&g, au, sizeof(au), 0));
+		assert(a.keyframe);
+		assert(0 == bcast_request_idr(&g, false, 1150000));
+		assert(1 == idrs);
+
+		// asked again once sent, but not before the interval
+		assert(0 == bcast_request_idr(&g, true, 1200000));
+		assert(0 == bcast_request_idr(&g, false, 1300000));
+		assert(1 == bcast_request_idr(&g, false, 1520000));
+		assert(2 == idrs);
+
+		assert(-URTC_ERR_BAD_ARGUMENT == bcast_request_idr(NULL, true, 0));
+		rtp_payload_unref(a.kept);
+		bcast_destroy(&g);
+	}
+
+	// Test members waiting for a keyframe are sent frames since the last
+	{
+		const uint8_t params[] = {
+			0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80
+		};
+		const uint8_t p[] = {
+			0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x00, 0x21
+		};
+		struct bcast g;
+		struct member a = { 0 }, b = { .waiting = true };
+
+		assert(0 == bcast_init(&g, send));
+
+		// nothing kept without a keyframe
+		assert(0 == bcast_send_frame(&g, p, sizeof(p), 0));
+		assert(0 == g.frames);
+
+		// kept from parameter sets ahead of keyframe, nobody watching
+		assert(0 == bcast_send_frame(&g, params, sizeof(params), 3000));
+		assert(0 == bcast_send_frame(&g, au, sizeof(au), 3000));
+		assert(0 == bcast_send_frame(&g, p, sizeof(p), 6000));
+		assert(3 == g.frames);
+
+		// live frame, then kept frames to the member waiting
+		assert(0 == bcast_join(&g, &a));
+		assert(0 == bcast_join(&g, &b));
+		assert(0 == bcast_send_frame(&g, p, sizeof(p), 9000));
+		assert(1 == a.frames && 9000 == a.ts);
+		assert(4 == b.frames && 9000 == b.ts && !b.waiting);
+		assert(!a.replay && b.replay);
+
+		// kept payloads are copies, shared by the members replayed to
+		assert(b.first != a.first && b.first == g.gop[3].pkts[0]);
+		assert(b.first->len == a.first->len);
+
+		// not replayed to a member already sent frames of the GOP, which
+		// would take its timestamps back
+		a.waiting = true;
+		assert(1 == bcast_send_frame(&g, p, sizeof(p), 12000));
+		assert(1 == a.frames && 12000 == b.ts);
+		a.waiting = false;
+
+		// next keyframe starts over
+		assert(0 == bcast_send_frame(&g, au, sizeof(au), 15000));
+		assert(1 == g.frames && 15000 == a.ts);
+
+		// member skipping frames until connected, then waiting, is
+		// replayed to mid-GOP
+		struct member c = { .idle = true, .waiting = true };
+		assert(0 == bcast_join(&g, &c));
+		assert(0 == bcast_send_frame(&g, p, sizeof(p), 18000));
+		assert(0 == bcast_send_frame(&g, p, sizeof(p), 21000));
+		assert(0 == c.frames);
+		c.idle = false;
+		assert(0 == bcast_send_frame(&g, p, sizeof(p), 24000));
+		assert(4 == c.frames && 24000 == c.ts && c.replay);
+
+		// GOP too long is dropped, members wait for a new keyframe
+		for (int i = 4; i < BCAST_GOP_MAX_FRAMES; i++) {
+			assert(0 == bcast_send_frame(&g, p, sizeof(p), 27000));
+		}
+		assert(BCAST_GOP_MAX_FRAMES == g.frames);
+		assert(0 == bcast_send_frame(&g, p, sizeof(p), 30000));
+		assert(0 == g.frames && !g.gop_key);
+		assert(0 == bcast_send_frame(&g, p, sizeof(p), 33000));
+		assert(0 == g.frames);
+		struct member d = { .waiting = true };
+		assert(0 == bcast_join(&g, &d));
+		assert(1 == bcast_send_frame(&g, p, sizeof(p), 36000));
+		assert(0 == d.frames);
+
+		// and too many bytes
+		static uint8_t big[64 << 10];
+		memset(big, 0xaa, sizeof(big));
+		memcpy(big, p, 5);
+		assert(0 == bcast_send_frame(&g, au, sizeof(au), 39000));
+		int frames = 1;
+		while (frames == g.frames) {
+			assert(0 == bcast_send_frame(&g, big, sizeof(big), 42000));
+			frames++;
+		}
+		assert(0 == g.frames && !g.gop_key);
+		assert(BCAST_GOP_MAX_BYTES / sizeof(big) + 1 == frames);
+
+		rtp_payload_unref(a.kept);
+		rtp_payload_unref(b.kept);
+		rtp_payload_unref(c.kept);
+		rtp_payload_unref(d.kept);
+		bcast_destroy(&g);
+	}
+
+	return 0;
+}
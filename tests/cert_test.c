@@ -0,0 +1,101 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cert.h"
+
+int main(int argc, char **argv) {
+	X509 *cert;
+	EVP_PKEY *key;
+	uint8_t fp[32], fp2[32];
+	char path[] = "/tmp/cert_test.XXXXXX";
+
+	// Test lazy generation and shared fingerprint
+	{
+		assert(0 == cert_acquire(&cert, &key, fp));
+		X509_free(cert);
+		EVP_PKEY_free(key);
+		assert(0 == cert_acquire(&cert, &key, fp2));
+		X509_free(cert);
+		EVP_PKEY_free(key);
+		assert(0 == memcmp(fp, fp2, 32));
+	}
+
+	// Test validity starts before issue, for peers with slow clocks
+	{
+		time_t t = time(NULL) - 3600;
+		assert(0 == cert_generate(&cert, &key, fp));
+		assert(0 > X509_cmp_time(X509_get0_notBefore(cert), &t));
+		X509_free(cert);
+		EVP_PKEY_free(key);
+	}
+
+	// Test save and reload across restarts
+	{
+		int fd = mkstemp(path);
+		assert(-1 != fd);
+		close(fd);
+		unlink(path);
+
+		assert(0 == cert_init(path, 0));
+		assert(0 == access(path, R_OK));
+		assert(0 == cert_acquire(&cert, &key, fp));
+		X509_free(cert);
+		EVP_PKEY_free(key);
+
+		cert_cleanup();
+		assert(0 == cert_init(path, 0));
+		assert(0 == cert_acquire(&cert, &key, fp2));
+		assert(0 == memcmp(fp, fp2, 32));
+
+		// reference outlives store
+		cert_cleanup();
+		assert(1 == X509_check_private_key(cert, key));
+		X509_free(cert);
+		EVP_PKEY_free(key);
+
+		unlink(path);
+	}
+
+	// Test rotation
+	{
+		assert(0 == cert_init(NULL, 1));
+		assert(0 == cert_acquire(&cert, &key, fp));
+		X509_free(cert);
+		EVP_PKEY_free(key);
+		sleep(2);
+		assert(0 == cert_acquire(&cert, &key, fp2));
+		X509_free(cert);
+		EVP_PKEY_free(key);
+		assert(0 != memcmp(fp, fp2, 32));
+	}
+
+	cert_cleanup();
+
+	return 0;
+}
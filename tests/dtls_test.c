@@ -0,0 +1,198 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "cert.h"
+#include "dtls.h"
+#include "err.h"
+
+// datagrams in flight towards one endpoint
+struct wire {
+	uint8_t pkt[16][DTLS_MTU];
+	size_t len[16];
+	int count;
+};
+
+static int deliver(const uint8_t *pkt, size_t n, void *arg) {
+	struct wire *w = (struct wire *)arg;
+	assert(n <= DTLS_MTU);
+	assert(w->count < 16);
+	memcpy(w->pkt[w->count], pkt, n);
+	w->len[w->count++] = n;
+	return 0;
+}
+
+static void pump(struct dtls *d, struct wire *w) {
+	for (int i = 0; i < w->count; i++) {
+		dtls_recv(d, w->pkt[i], w->len[i]);
+	}
+	w->count = 0;
+}
+
+/**
+ * Handshake client against server entirely in memory
+ */
+static void handshake(
+	struct dtls *c, struct dtls *s,
+	X509 *ccert, EVP_PKEY *ckey, const uint8_t cfp[32],
+	X509 *scert, EVP_PKEY *skey, const uint8_t sfp[32],
+	const uint8_t *session, size_t session_len
+) {
+	static struct wire to_client, to_server;
+	to_client.count = to_server.count = 0;
+
+	assert(0 == dtls_start(s, false, cfp, scert, skey, NULL, 0,
+		deliver, &to_client));
+	assert(0 == dtls_start(c, true, sfp, ccert, ckey, session, session_len,
+		deliver, &to_server));
+
+	for (int i = 0; i < 10 && (to_client.count || to_server.count); i++) {
+		pump(s, &to_server);
+		pump(c, &to_client);
+	}
+}
+
+int main(int argc, char **argv) {
+	X509 *ccert, *scert;
+	EVP_PKEY *ckey, *skey;
+	uint8_t cfp[32], sfp[32];
+
+	assert(0 == cert_generate(&ccert, &ckey, cfp));
+	assert(0 == cert_generate(&scert, &skey, sfp));
+	assert(0 != memcmp(cfp, sfp, 32));
+
+	uint8_t session[2048];
+	int session_len;
+
+	// Test full handshake and key export
+	{
+		struct dtls c, s;
+		handshake(&c, &s, ccert, ckey, cfp, scert, skey, sfp, NULL, 0);
+		assert(DTLS_STATE_CONNECTED == c.state);
+		assert(DTLS_STATE_CONNECTED == s.state);
+		assert(!dtls_resumed(&c));
+
+		// highest version both ends support is negotiated
+#ifdef DTLS1_3_VERSION
+		assert(DTLS1_3_VERSION == dtls_version(&c));
+#else
+		assert(DTLS1_2_VERSION == dtls_version(&c));
+#endif
+
+		// aead profile preferred
+		assert(SRTP_AEAD_AES_128_GCM == c.keys.profile);
+		assert(12 == c.keys.salt_len);
+		assert(c.keys.profile == s.keys.profile);
+		assert(0 == memcmp(c.keys.local_key, s.keys.remote_key, c.keys.key_len));
+		assert(0 == memcmp(c.keys.remote_key, s.keys.local_key, c.keys.key_len));
+		assert(0 == memcmp(c.keys.local_salt, s.keys.remote_salt, c.keys.salt_len));
+		assert(0 != memcmp(c.keys.local_key, c.keys.remote_key, c.keys.key_len));
+
+		session_len = dtls_get_session(&c, session, sizeof(session));
+		assert(session_len > 0);
+
+		dtls_stop(&c);
+		dtls_stop(&s);
+	}
+
+	// Test abbreviated handshake with remembered session
+	{
+		struct dtls c, s;
+		handshake(&c, &s, ccert, ckey, cfp, scert, skey, sfp,
+			session, session_len);
+		assert(DTLS_STATE_CONNECTED == c.state);
+		assert(DTLS_STATE_CONNECTED == s.state);
+		assert(dtls_resumed(&c));
+		assert(0 == memcmp(c.keys.local_key, s.keys.remote_key, c.keys.key_len));
+		dtls_stop(&c);
+		dtls_stop(&s);
+	}
+
+	// Test resumed session fails against a different pinned certificate
+	{
+		struct dtls c, s;
+		X509 *other;
+		EVP_PKEY *okey;
+		uint8_t ofp[32];
+		assert(0 == cert_generate(&other, &okey, ofp));
+		handshake(&c, &s, ccert, ckey, cfp, scert, skey, ofp,
+			session, session_len);
+		assert(DTLS_STATE_CONNECTED != c.state);
+		dtls_stop(&c);
+		dtls_stop(&s);
+		X509_free(other);
+		EVP_PKEY_free(okey);
+	}
+
+	// Test fallback to DTLS 1.2 when peer supports nothing newer
+	{
+		struct dtls c, s;
+		static struct wire to_client, to_server;
+		assert(0 == dtls_start(&s, false, cfp, scert, skey, NULL, 0,
+			deliver, &to_client));
+		assert(1 == SSL_set_max_proto_version(s.ssl, DTLS1_2_VERSION));
+		assert(0 == dtls_start(&c, true, sfp, ccert, ckey, NULL, 0,
+			deliver, &to_server));
+		for (int i = 0; i < 10 && (to_client.count || to_server.count); i++) {
+			pump(&s, &to_server);
+			pump(&c, &to_client);
+		}
+		assert(DTLS_STATE_CONNECTED == c.state);
+		assert(DTLS1_2_VERSION == dtls_version(&c));
+		dtls_stop(&c);
+		dtls_stop(&s);
+	}
+
+	// Test fingerprint mismatch fails handshake
+	{
+		struct dtls c, s;
+		uint8_t wrong[32] = { 0 };
+		handshake(&c, &s, ccert, ckey, cfp, scert, skey, wrong, NULL, 0);
+		assert(DTLS_STATE_CONNECTED != c.state);
+		assert(DTLS_STATE_CONNECTED != s.state);
+		dtls_stop(&c);
+		dtls_stop(&s);
+	}
+
+	// Test retransmission timer runs while waiting for a flight
+	{
+		struct dtls c;
+		struct wire w = { .count = 0 };
+		uint64_t us;
+		assert(0 == dtls_start(&c, true, sfp, ccert, ckey, NULL, 0,
+			deliver, &w));
+		assert(1 == w.count);
+		assert(0 == dtls_timeout(&c, &us));
+		assert(us <= DTLS_INITIAL_TIMEOUT_US);
+		dtls_stop(&c);
+	}
+
+	X509_free(ccert);
+	X509_free(scert);
+	EVP_PKEY_free(ckey);
+	EVP_PKEY_free(skey);
+
+	return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * FEC parity (XOR) throughput
+ *
+ * Build and run with 'make fec_bench && ./fec_bench'. Accumulates parity
+ * over payload-sized buffers, as the encoder does for every sent packet
+ * while protection is on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "fec.h"
+
+#define PAYLOAD         1100            // bytes per packet
+#define XOR_BYTES       (1ull << 32)    // bytes processed per measurement
+
+typedef void (xor_fn)(uint8_t *dst, const uint8_t *src, size_t n);
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+	static const struct {
+		xor_fn *fn;
+		const char *name;
+	} kernels[] = {
+		{ fec_xor_scalar, "scalar" },
+		{ fec_xor,        "vector" },
+	};
+	static uint8_t parity[PAYLOAD], payload[PAYLOAD];
+	uint8_t check = 0;
+
+	for (size_t i = 0; i < PAYLOAD; i++) payload[i] = rand();
+
+	for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+		size_t passes = XOR_BYTES / PAYLOAD / (i ? 1 : 8);
+		double t = now();
+
+		for (size_t k = 0; k < passes; k++) {
+			kernels[i].fn(parity, payload, PAYLOAD);
+		}
+		t = now() - t;
+		check ^= parity[0];
+
+		printf("%-7s %8.1f MB/s\n", kernels[i].name,
+			passes * PAYLOAD / t / 1e6);
+	}
+
+	return check == 0x5a;
+}
@@ -0,0 +1,192 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "err.h"
+#include "fec.h"
+#include "rtp.h"
+
+struct sink {
+	int count;
+	size_t n;
+	uint8_t pkt[FEC_MAX_PACKET_SIZE];
+};
+
+static void recovered(const uint8_t *pkt, size_t n, void *arg) {
+	struct sink *s = (struct sink *)arg;
+	s->count++;
+	s->n = n;
+	memcpy(s->pkt, pkt, n);
+}
+
+/**
+ * Source packet of distinct length and content
+ */
+static size_t source(uint8_t *pkt, uint16_t seq, bool marker) {
+	size_t n = RTP_HEADER_SIZE + 100 + 37 * (seq % 5);
+	rtp_header_write(pkt, 96, marker, seq, 9000, 0x11223344);
+	for (size_t i = RTP_HEADER_SIZE; i < n; i++) pkt[i] = seq * 7 + i;
+	return n;
+}
+
+int main(int argc, char **argv) {
+
+	// Test vector XOR against scalar, at all alignments and tail lengths
+	{
+		uint8_t a[300], b[300], c[300];
+		for (int i = 0; i < 300; i++) {
+			a[i] = i * 13;
+			b[i] = i * 29 + 7;
+		}
+		for (int off = 0; off < 4; off++) {
+			for (size_t n = 0; n < 200; n++) {
+				memcpy(c, a, sizeof(c));
+				fec_xor(c + off, b + off, n);
+				fec_xor_scalar(c + off, b + off, n);
+				assert(0 == memcmp(a, c, sizeof(c)));
+			}
+		}
+	}
+
+	// Test protection follows loss
+	{
+		struct fec_enc e;
+		fec_enc_init(&e);
+		assert(0 == e.group);
+		fec_enc_set_loss(&e, 2);
+		assert(0 == e.group);
+		fec_enc_set_loss(&e, 13);
+		assert(6 == e.group);
+		fec_enc_set_loss(&e, 128);
+		assert(2 == e.group);
+
+		// decreases are smoothed
+		fec_enc_set_loss(&e, 0);
+		assert(0 < e.group);
+
+		// nacks count as loss once a window has been sent
+		uint8_t pkt[FEC_MAX_PACKET_SIZE];
+		fec_enc_init(&e);
+		fec_enc_nack(&e, 13);
+		for (int i = 0; i < FEC_LOSS_WINDOW; i++) {
+			assert(0 <= fec_enc_add(&e, pkt, source(pkt, i, false)));
+		}
+		assert(0 < e.group);
+	}
+
+	// Test any one lost packet of a group is recovered
+	{
+		uint8_t pkts[5][FEC_MAX_PACKET_SIZE], repair[FEC_MAX_PACKET_SIZE];
+		size_t lens[5];
+
+		for (int lost = 0; lost < 5; lost++) {
+			struct fec_enc e;
+			struct fec_dec d;
+			struct sink s = { 0 };
+			int n;
+
+			fec_enc_init(&e);
+			fec_dec_init(&d, recovered, &s);
+			fec_enc_set_loss(&e, 17);
+			assert(5 == e.group);
+
+			for (int i = 0; i < 5; i++) {
+				lens[i] = source(pkts[i], 65533 + i, false);
+				assert((4 == i) == fec_enc_add(&e, pkts[i], lens[i]));
+			}
+			n = fec_enc_write(&e, repair, sizeof(repair), 100, 1, 0xaabbccdd,
+				0x11223344);
+			assert(RTP_HEADER_SIZE + 4 + FEC_HEADER_SIZE + 100 + 37 * 4 ==
+				n);
+
+			for (int i = 0; i < 5; i++) {
+				if (i != lost) {
+					assert(0 == fec_dec_put_source(&d, pkts[i], lens[i]));
+				}
+			}
+			assert(0 == s.count);
+			assert(0 == fec_dec_put_repair(&d, repair, n));
+			assert(1 == s.count);
+			assert(lens[lost] == s.n);
+			assert(0 == memcmp(pkts[lost], s.pkt, s.n));
+		}
+	}
+
+	// Test repair arriving first, frame end closing group, and two losses
+	{
+		uint8_t pkts[3][FEC_MAX_PACKET_SIZE], repair[FEC_MAX_PACKET_SIZE];
+		size_t lens[3];
+		struct fec_enc e;
+		struct fec_dec d;
+		struct sink s = { 0 };
+		int n;
+
+		fec_enc_init(&e);
+		fec_dec_init(&d, recovered, &s);
+		fec_enc_set_loss(&e, 4);
+		assert(FEC_MAX_GROUP == e.group);
+
+		for (int i = 0; i < 3; i++) {
+			lens[i] = source(pkts[i], 100 + i, 2 == i);
+			assert((2 == i) == fec_enc_add(&e, pkts[i], lens[i]));
+		}
+		n = fec_enc_write(&e, repair, sizeof(repair), 100, 1, 0xaabbccdd,
+			0x11223344);
+		assert(0 < n);
+
+		assert(0 == fec_dec_put_repair(&d, repair, n));
+		assert(0 == fec_dec_put_source(&d, pkts[0], lens[0]));
+		assert(0 == s.count);
+		assert(0 == fec_dec_put_source(&d, pkts[2], lens[2]));
+		assert(1 == s.count);
+		assert(0 == memcmp(pkts[1], s.pkt, s.n));
+		assert(pkts[1][1] == s.pkt[1]);
+
+		// nothing more to recover, recovered packet is not a duplicate
+		assert(0 == fec_dec_put_source(&d, pkts[1], lens[1]));
+		assert(1 == s.count);
+
+		// two losses in a group are not recoverable
+		fec_dec_init(&d, recovered, &s);
+		s.count = 0;
+		assert(0 == fec_dec_put_source(&d, pkts[0], lens[0]));
+		assert(0 == fec_dec_put_repair(&d, repair, n));
+		assert(0 == s.count);
+	}
+
+	// Test malformed and unsupported repair packets
+	{
+		uint8_t pkt[64] = { 0 };
+		struct fec_dec d;
+		fec_dec_init(&d, recovered, NULL);
+		rtp_header_write(pkt, 100, false, 1, 0, 1);
+		assert(-URTC_ERR_NOT_IMPLEMENTED == fec_dec_put_repair(&d, pkt, 32));
+		pkt[0] |= 1;
+		assert(-URTC_ERR_MALFORMED == fec_dec_put_repair(&d, pkt, 20));
+		assert(-URTC_ERR_MALFORMED == fec_dec_put_source(&d, pkt, 11));
+	}
+
+	return 0;
+}
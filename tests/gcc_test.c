@@ -0,0 +1,166 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "gcc.h"
+
+#define PKT                     1200    // bytes
+#define PROPAGATION_US         20000
+#define FEEDBACK_US           100000
+#define MAX_QUEUE_US          300000    // drop tail beyond
+
+/**
+ * Send at the target bitrate over a bottleneck link for \a seconds
+ *
+ * \param capacity Bottleneck bitrate.
+ * \param loss Every loss-th packet is lost, 0 for none.
+ * \param[out] queue_us Queueing delay at end.
+ *
+ * \return Target bitrate at end.
+ */
+static uint32_t simulate(struct gcc *g, uint32_t capacity, int loss,
+		int seconds, int64_t *queue_us) {
+	static struct rtcp_twcc_status st[GCC_HISTORY];
+	static int64_t arrival[65536];
+	uint64_t t = 1000000, end = t + seconds * 1000000ULL, fb = t;
+	uint64_t link_free = 0;
+	uint16_t seq = 0, reported = 0;
+	uint32_t target = g->target_bps, probe_bps = 0;
+	size_t probe_left = 0;
+	int cluster = 0;
+
+	while (t < end) {
+		// send one packet, as part of a probe if one is due
+		uint64_t depart = t > link_free ? t : link_free;
+		if (!probe_left) cluster = gcc_probe_next(g, &probe_bps, &probe_left);
+		gcc_on_sent(g, seq, PKT, t, probe_left ? cluster : 0);
+		if ((loss && 0 == seq % loss) || depart - t > MAX_QUEUE_US) {
+			arrival[seq] = -1;
+		} else {
+			link_free = depart + PKT * 8000000ULL / capacity;
+			arrival[seq] = link_free + PROPAGATION_US;
+		}
+		*queue_us = depart - t;
+		seq++;
+		if (probe_left) {
+			probe_left -= PKT < probe_left ? PKT : probe_left;
+			t += PKT * 8000000ULL / probe_bps;
+		} else {
+			t += PKT * 8000000ULL / target;
+		}
+
+		// report packets arrived (or lost) by now
+		if (t - fb < FEEDBACK_US) continue;
+		fb = t;
+		size_t n = 0;
+		while (reported != seq && n < GCC_HISTORY) {
+			int64_t a = arrival[reported];
+			if (a > (int64_t)t) break;
+			st[n].seq = reported++;
+			st[n].received = a >= 0;
+			st[n].arrival_us = a;
+			n++;
+		}
+		target = gcc_on_feedback(g, st, n, t);
+	}
+
+	return target;
+}
+
+int main(int argc, char **argv) {
+	int64_t queue_us;
+
+	// Test overshooting a bottleneck backs off below its capacity, and
+	// drains the queue
+	{
+		static struct gcc g;
+		gcc_init(&g, 2000000);
+		uint32_t bps = simulate(&g, 1000000, 0, 30, &queue_us);
+		assert(500000 <= bps && bps <= 1100000);
+		assert(queue_us < 100000);
+	}
+
+	// Test ramping up on a fast link
+	{
+		static struct gcc g;
+		gcc_init(&g, 300000);
+		uint32_t bps = simulate(&g, 10000000, 0, 20, &queue_us);
+		assert(bps >= 900000);
+		assert(queue_us < 10000);
+	}
+
+	// Test heavy loss backs off, light loss does not
+	{
+		static struct gcc g;
+		gcc_init(&g, 2000000);
+		assert(simulate(&g, 10000000, 5, 5, &queue_us) < 1000000);
+		assert(g.loss > 40 && g.loss < 60);
+
+		gcc_init(&g, 2000000);
+		assert(simulate(&g, 10000000, 100, 5, &queue_us) >= 2000000);
+	}
+
+	// Test probing finds the available bitrate within a second, without
+	// overshooting it
+	{
+		static struct gcc g;
+		gcc_init(&g, 300000);
+		gcc_probe_start(&g);
+		uint32_t bps = simulate(&g, 5000000, 0, 1, &queue_us);
+		assert(3000000 <= bps && bps <= 5500000);
+
+		// and holds it
+		bps = simulate(&g, 5000000, 0, 10, &queue_us);
+		assert(3000000 <= bps && bps <= 5500000);
+		assert(queue_us < 100000);
+	}
+
+	// Test probe beyond a slow link does not raise the estimate
+	{
+		static struct gcc g;
+		uint32_t bps;
+		size_t bytes;
+		gcc_init(&g, 1000000);
+		gcc_probe_start(&g);
+		assert(1 == gcc_probe_next(&g, &bps, &bytes));
+		assert(3000000 == bps);
+		assert(bytes >= GCC_PROBE_MIN_PACKETS * PKT);
+		assert(2 == gcc_probe_next(&g, &bps, &bytes));
+		assert(6000000 == bps);
+		assert(0 == gcc_probe_next(&g, &bps, &bytes));
+		assert(simulate(&g, 800000, 0, 1, &queue_us) <= 1000000);
+	}
+
+	// Test bounds
+	{
+		static struct gcc g;
+		gcc_init(&g, 1);
+		assert(GCC_MIN_BITRATE == g.target_bps);
+		gcc_set_bitrate(&g, UINT32_MAX);
+		assert(GCC_MAX_BITRATE == g.target_bps);
+	}
+
+	return 0;
+}
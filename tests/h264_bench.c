@@ -0,0 +1,155 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Annex-B start code scanning throughput
+ *
+ * Build and run with 'make h264_bench && ./h264_bench [file.h264 ...]'.
+ * Each file is an Annex-B elementary stream, e.g. as recorded from a
+ * camera's encoder. Without files, a synthetic stream of large IDR slices
+ * is scanned instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "h264.h"
+
+#define SYNTH_SIZE      (4 << 20)       // bytes of synthetic stream
+#define SYNTH_SLICE     (256 << 10)     // bytes per synthetic slice
+#define SCAN_BYTES      (1ull << 30)    // bytes scanned per measurement
+
+typedef const uint8_t *(scan_fn)(const uint8_t *p, const uint8_t *end);
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Random slice data with emulation prevention applied, as an encoder would
+ */
+static uint8_t *synthesize(size_t *len) {
+	uint8_t *buf = malloc(SYNTH_SIZE);
+	uint32_t x = 1;
+	size_t n = 0, zeros = 0, slice = 0;
+
+	if (!buf) return NULL;
+
+	while (n + 5 <= SYNTH_SIZE) {
+		if (n >= slice) {
+			memcpy(buf + n, "\x00\x00\x00\x01\x65", 5);
+			n += 5;
+			slice += SYNTH_SLICE;
+			zeros = 0;
+			continue;
+		}
+
+		// entropy coded data is skewed towards small values
+		x = x * 1103515245 + 12345;
+		uint8_t b = (x >> 16) % 4 ? x >> 24 : (x >> 24) % 4;
+
+		if (2 == zeros && b <= 3) {
+			buf[n++] = 0x03;
+			zeros = 0;
+		}
+		buf[n++] = b;
+		zeros = b ? 0 : zeros + 1;
+	}
+
+	*len = n;
+	return buf;
+}
+
+static uint8_t *load(const char *path, size_t *len) {
+	FILE *f = fopen(path, "rb");
+	uint8_t *buf = NULL;
+	long n;
+
+	if (!f) return NULL;
+	if (0 == fseek(f, 0, SEEK_END) && (n = ftell(f)) > 0) {
+		rewind(f);
+		if ((buf = malloc(n)) && fread(buf, 1, n, f) != (size_t)n) {
+			free(buf);
+			buf = NULL;
+		}
+		*len = n;
+	}
+	fclose(f);
+
+	return buf;
+}
+
+static void bench(const char *name, const uint8_t *buf, size_t len) {
+	static const struct {
+		scan_fn *fn;
+		const char *name;
+	} scanners[] = {
+		{ h264_find_start_code_scalar, "scalar" },
+		{ h264_find_start_code,        "vector" },
+	};
+
+	for (size_t i = 0; i < sizeof(scanners) / sizeof(scanners[0]); i++) {
+		const uint8_t *end = buf + len;
+		size_t passes = SCAN_BYTES / len + 1, nals = 0;
+		double t = now();
+
+		for (size_t k = 0; k < passes; k++) {
+			const uint8_t *p = buf;
+			while ((p = scanners[i].fn(p, end)) < end) {
+				p += 3;
+				nals++;
+			}
+		}
+		t = now() - t;
+
+		printf("%-24.24s %-7s %6zu nal %8.1f MB/s\n", name,
+			scanners[i].name, nals / passes, passes * len / t / 1e6);
+	}
+}
+
+int main(int argc, char **argv) {
+	uint8_t *buf;
+	size_t len;
+
+	if (argc < 2) {
+		if (!(buf = synthesize(&len))) return 1;
+		bench("(synthetic)", buf, len);
+		free(buf);
+		return 0;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (!(buf = load(argv[i], &len))) {
+			fprintf(stderr, "%s: cannot read\n", argv[i]);
+			return 1;
+		}
+		bench(argv[i], buf, len);
+		free(buf);
+	}
+
+	return 0;
+}
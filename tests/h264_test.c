@@ -0,0 +1,337 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "err.h"
+#include "h264.h"
+
+#define MAX_PKTS 64
+
+struct sink {
+	struct rtp_payload *pkts[MAX_PKTS];
+	int count;
+};
+
+static int collect(struct rtp_payload *p, void *arg) {
+	struct sink *s = arg;
+	assert(s->count < MAX_PKTS);
+	s->pkts[s->count++] = p;
+	return 0;
+}
+
+static void release(struct sink *s) {
+	for (int i = 0; i < s->count; i++) rtp_payload_unref(s->pkts[i]);
+	s->count = 0;
+}
+
+struct frames {
+	struct h264_frame *last;
+	int count;
+};
+
+static void deliver(struct h264_frame *f, void *arg) {
+	struct frames *fr = arg;
+	fr->last = f;
+	fr->count++;
+}
+
+static size_t to_rtp(
+	uint8_t *pkt,
+	const struct rtp_payload *p,
+	uint16_t seq,
+	uint32_t ts
+) {
+	rtp_header_write(pkt, 96, p->marker, seq, ts, 0x1234);
+	return RTP_HEADER_SIZE + rtp_payload_copy(p, pkt + RTP_HEADER_SIZE);
+}
+
+int main(int argc, char **argv) {
+
+	// Test vector start code scanner agrees with scalar one
+	{
+		uint8_t buf[256];
+		uint32_t x = 1;
+
+		// prefixes at every offset relative to vector blocks, and near
+		// misses (00 00 02, 00 01, lone zeros)
+		for (int trial = 0; trial < 2000; trial++) {
+			for (size_t i = 0; i < sizeof(buf); i++) {
+				x = x * 1103515245 + 12345;
+				buf[i] = (x >> 16) % 2 ? (x >> 8) | 0x04 : (x >> 24) % 3;
+			}
+			for (size_t off = 0; off < 70; off += 1 + trial % 5) {
+				const uint8_t *end = buf + sizeof(buf) - trial % 40;
+				assert(h264_find_start_code_scalar(buf + off, end) ==
+					h264_find_start_code(buf + off, end));
+			}
+		}
+
+		// four-byte start code found at its last three bytes, prefix
+		// straddling end is not a match
+		memset(buf, 0xff, sizeof(buf));
+		buf[59] = buf[60] = buf[61] = 0;
+		buf[62] = 1;
+		assert(buf + 60 == h264_find_start_code(buf, buf + 63));
+		assert(buf + 62 == h264_find_start_code(buf, buf + 62));
+	}
+
+	// Test single NAL unit packets, 3- and 4-byte start codes
+	{
+		const uint8_t au[] = {
+			0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1f,   // sps
+			0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,         // pps
+			0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00    // idr
+		};
+		struct sink s = { 0 };
+		uint8_t out[8];
+
+		// too small to aggregate
+		assert(3 == h264_packetize(au, sizeof(au), 8, collect, &s));
+		assert(3 == s.count);
+
+		assert(4 == rtp_payload_copy(s.pkts[0], out));
+		assert(0 == memcmp(au + 4, out, 4));
+		assert(!s.pkts[0]->marker);
+
+		assert(4 == rtp_payload_copy(s.pkts[1], out));
+		assert(0 == memcmp(au + 11, out, 4));
+
+		// nal units never end in a zero byte; trailing zeros are stuffing
+		assert(3 == rtp_payload_copy(s.pkts[2], out));
+		assert(0 == memcmp(au + 19, out, 3));
+		assert(s.pkts[2]->marker);
+
+		// payloads reference the access unit rather than copying it
+		assert(au + 4 == s.pkts[0]->iov[0].iov_base);
+
+		release(&s);
+	}
+
+	// Test keyframe detection stops at the first slice
+	{
+		const uint8_t idr[] = {
+			0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1f,   // sps
+			0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,         // pps
+			0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00    // idr
+		};
+		const uint8_t p[] = {
+			0x00, 0x00, 0x00, 0x01, 0x06, 0x05, 0x01, 0x80,   // sei
+			0x00, 0x00, 0x01, 0x41, 0x9a, 0x00, 0x00, 0x01,   // slice
+			0x65, 0x88                                        // (idr)
+		};
+		assert(h264_is_keyframe(idr, sizeof(idr)));
+		assert(!h264_is_keyframe(p, sizeof(p)));
+		assert(!h264_is_keyframe(idr, 15));
+		assert(!h264_is_keyframe(NULL, 0));
+	}
+
+	// Test parameter sets sent ahead of keyframe
+	{
+		const uint8_t params[] = {
+			0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1f,   // sps
+			0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80          // pps
+		};
+		const uint8_t idr[] = {
+			0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1f,   // sps
+			0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00    // idr
+		};
+		const uint8_t sei[] = {
+			0x00, 0x00, 0x00, 0x01, 0x06, 0x05, 0x01, 0x80    // sei
+		};
+		assert(h264_is_parameter_set(params, sizeof(params)));
+		assert(!h264_is_parameter_set(idr, sizeof(idr)));
+		assert(!h264_is_parameter_set(sei, sizeof(sei)));
+		assert(!h264_is_parameter_set(NULL, 0));
+	}
+
+	// Test STAP-A aggregation
+	{
+		const uint8_t au[] = {
+			0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1f,   // sps
+			0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,         // pps
+			0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84          // idr
+		};
+		const uint8_t expect[] = {
+			0x78,                                   // nri | stap-a
+			0x00, 0x04, 0x67, 0x42, 0x00, 0x1f,
+			0x00, 0x04, 0x68, 0xce, 0x3c, 0x80,
+			0x00, 0x03, 0x65, 0x88, 0x84
+		};
+		struct sink s = { 0 };
+		uint8_t out[sizeof(expect)];
+
+		assert(1 == h264_packetize(au, sizeof(au), 1100, collect, &s));
+		assert(sizeof(expect) == s.pkts[0]->len);
+		assert(sizeof(expect) == rtp_payload_copy(s.pkts[0], out));
+		assert(0 == memcmp(expect, out, sizeof(out)));
+		assert(s.pkts[0]->marker);
+		release(&s);
+
+		// aggregate runs up to what fits, rest sent on their own
+		assert(2 == h264_packetize(au, sizeof(au), 13, collect, &s));
+		assert(13 == s.pkts[0]->len);
+		assert(3 == s.pkts[1]->len);
+		assert(!s.pkts[0]->marker && s.pkts[1]->marker);
+		release(&s);
+	}
+
+	// Test FU-A fragmentation
+	{
+		uint8_t au[4 + 1 + 250];
+		struct sink s = { 0 };
+		uint8_t pkt[100];
+
+		memcpy(au, "\x00\x00\x00\x01", 4);
+		au[4] = 0x65;
+		for (int i = 0; i < 250; i++) au[5 + i] = 1 + i % 200;
+
+		// 250 bytes of nal payload split evenly rather than 98, 98, 54
+		assert(3 == h264_packetize(au, sizeof(au), 100, collect, &s));
+
+		// reassembles to original nal payload
+		uint8_t out[250];
+		size_t n = 0;
+		for (int i = 0; i < 3; i++) {
+			assert(2 + (2 == i ? 82 : 84) == rtp_payload_copy(s.pkts[i], pkt));
+			assert(0x7c == pkt[0]);             // nri | fu-a
+			assert((0 == i ? 0x85 : 2 == i ? 0x45 : 0x05) == pkt[1]);
+			memcpy(out + n, pkt + 2, s.pkts[i]->len - 2);
+			n += s.pkts[i]->len - 2;
+		}
+		assert(250 == n);
+		assert(0 == memcmp(au + 5, out, n));
+		assert(!s.pkts[1]->marker && s.pkts[2]->marker);
+
+		release(&s);
+	}
+
+	// Test depacketizer reassembles packetized access units
+	{
+		uint8_t au[8 + 8 + 5 + 3000];
+		uint8_t pkt[RTP_HEADER_SIZE + 1100];
+		struct sink s = { 0 };
+		struct frames fr = { 0 };
+		struct h264_depkt d;
+
+		// sps, pps, idr (fragmented), then a p frame
+		memcpy(au, "\x00\x00\x00\x01\x67\x42\x00\x1f", 8);
+		memcpy(au + 8, "\x00\x00\x00\x01\x68\xce\x3c\x80", 8);
+		memcpy(au + 16, "\x00\x00\x00\x01\x65", 5);
+		for (int i = 0; i < 3000; i++) au[21 + i] = 1 + i % 200;
+
+		assert(0 == h264_depkt_init(&d, deliver, &fr));
+		assert(0 < h264_packetize(au, 3021, 1100, collect, &s));
+		for (int i = 0; i < s.count; i++) {
+			size_t n = to_rtp(pkt, s.pkts[i], 100 + i, 3000);
+			assert(0 == h264_depkt_push(&d, pkt, n));
+		}
+		assert(1 == fr.count);
+		assert(3021 == fr.last->len);
+		assert(0 == memcmp(au, fr.last->data, 3021));
+		assert(fr.last->keyframe && 3000 == fr.last->ts);
+		h264_frame_release(fr.last);
+		int next = 100 + s.count;
+		release(&s);
+
+		// p frame after a lost packet is withheld until the next idr
+		const uint8_t p[] = { 0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x02 };
+		assert(1 == h264_packetize(p, sizeof(p), 1100, collect, &s));
+		size_t n = to_rtp(pkt, s.pkts[0], next + 1, 6000);
+		assert(0 == h264_depkt_push(&d, pkt, n));
+		n = to_rtp(pkt, s.pkts[0], next + 2, 9000);
+		assert(0 == h264_depkt_push(&d, pkt, n));
+		assert(1 == fr.count);
+		assert(1 == d.dropped && d.need_keyframe);
+
+		// late packet is ignored
+		n = to_rtp(pkt, s.pkts[0], next, 9000);
+		assert(0 == h264_depkt_push(&d, pkt, n));
+		assert(1 == fr.count);
+		release(&s);
+
+		assert(0 < h264_packetize(au, 3021, 1100, collect, &s));
+		for (int i = 0; i < s.count; i++) {
+			n = to_rtp(pkt, s.pkts[i], next + 3 + i, 12000);
+			assert(0 == h264_depkt_push(&d, pkt, n));
+		}
+		assert(2 == fr.count && fr.last->keyframe);
+		h264_frame_release(fr.last);
+		next += 3 + s.count;
+		release(&s);
+
+		// p frames are delivered again; frames held by the callee take
+		// pool slots until released
+		assert(1 == h264_packetize(p, sizeof(p), 1100, collect, &s));
+		for (int i = 0; i < H264_FRAME_POOL_SIZE + 1; i++) {
+			n = to_rtp(pkt, s.pkts[0], next + i, 15000 + i);
+			assert(0 == h264_depkt_push(&d, pkt, n));
+		}
+		assert(2 + H264_FRAME_POOL_SIZE == fr.count);
+		assert(sizeof(p) == fr.last->len && !fr.last->keyframe);
+		assert(0 == memcmp(p, fr.last->data, sizeof(p)));
+		assert(2 == d.dropped);
+		release(&s);
+
+		h264_depkt_free(&d);
+	}
+
+	// Test depacketizer rejects malformed payloads
+	{
+		struct frames fr = { 0 };
+		struct h264_depkt d;
+		uint8_t pkt[RTP_HEADER_SIZE + 8];
+
+		assert(0 == h264_depkt_init(&d, deliver, &fr));
+
+		// fu-a continuation without start
+		rtp_header_write(pkt, 96, true, 1, 0, 1);
+		memcpy(pkt + RTP_HEADER_SIZE, "\x7c\x45\x01\x02", 4);
+		assert(-URTC_ERR_MALFORMED ==
+			h264_depkt_push(&d, pkt, RTP_HEADER_SIZE + 4));
+
+		// stap-a size overruns payload
+		rtp_header_write(pkt, 96, true, 2, 3000, 1);
+		memcpy(pkt + RTP_HEADER_SIZE, "\x78\x00\x09\x65\x88", 5);
+		assert(-URTC_ERR_MALFORMED ==
+			h264_depkt_push(&d, pkt, RTP_HEADER_SIZE + 5));
+
+		assert(0 > h264_depkt_push(&d, pkt, 8));
+		assert(0 == fr.count);
+
+		h264_depkt_free(&d);
+	}
+
+	// Test malformed input
+	{
+		const uint8_t junk[] = { 0x65, 0x88, 0x84 };
+		struct sink s = { 0 };
+		assert(-URTC_ERR_MALFORMED ==
+			h264_packetize(junk, sizeof(junk), 1100, collect, &s));
+		assert(-URTC_ERR_BAD_ARGUMENT ==
+			h264_packetize(junk, sizeof(junk), 2, collect, &s));
+	}
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "err.h"
+#include "hist.h"
+
+#define T0 1000000                      // arbitrary start time (us)
+
+static void store(struct hist *h, uint16_t seq, size_t len, uint64_t now) {
+	uint8_t *p = hist_store(h, seq, len, now);
+	assert(p);
+	memset(p, seq, len);
+}
+
+static bool held(struct hist *h, uint16_t seq, size_t len, uint64_t now) {
+	size_t n;
+	const uint8_t *p = hist_get(h, seq, &n, now);
+	if (!p) return false;
+	assert(len == n);
+	for (size_t i = 0; i < n; i++) assert((uint8_t)seq == p[i]);
+	return true;
+}
+
+int main(int argc, char **argv) {
+
+	// Test lookup, across sequence number wrap
+	{
+		struct hist h;
+		assert(0 == hist_init(&h, 64 << 10, 1000));
+
+		for (uint16_t seq = 65530; seq != 10; seq++) store(&h, seq, 100, T0);
+		assert(held(&h, 65530, 100, T0));
+		assert(held(&h, 0, 100, T0));
+		assert(held(&h, 9, 100, T0));
+		assert(!held(&h, 10, 100, T0));
+		assert(!held(&h, 65529, 100, T0));
+
+		hist_free(&h);
+	}
+
+	// Test byte bound evicts oldest first, log wraps intact
+	{
+		struct hist h;
+		assert(0 == hist_init(&h, 1000, 1000));
+
+		for (int i = 0; i < 9; i++) store(&h, i, 300, T0);
+		// 1000 bytes hold three 300-byte packets
+		assert(!held(&h, 5, 300, T0));
+		for (int i = 6; i < 9; i++) assert(held(&h, i, 300, T0));
+
+		// varying sizes
+		store(&h, 9, 50, T0);
+		store(&h, 10, 900, T0);
+		assert(!held(&h, 8, 300, T0));
+		assert(held(&h, 9, 50, T0) && held(&h, 10, 900, T0));
+		store(&h, 11, 90, T0);
+		assert(!held(&h, 9, 50, T0));
+		assert(held(&h, 10, 900, T0) && held(&h, 11, 90, T0));
+
+		assert(NULL == hist_store(&h, 12, 1001, T0));
+		hist_free(&h);
+	}
+
+	// Test time bound, and slot reuse
+	{
+		struct hist h;
+		assert(0 == hist_init(&h, 1 << 20, 100));
+
+		store(&h, 1, 10, T0);
+		store(&h, 2, 10, T0 + 50000);
+		assert(held(&h, 1, 10, T0 + 100000));
+		assert(!held(&h, 1, 10, T0 + 100001));
+		assert(held(&h, 2, 10, T0 + 100001));
+
+		for (int i = 3; i < 3 + HIST_SLOTS; i++) store(&h, i, 10, T0 + 100001);
+		assert(!held(&h, 2, 10, T0 + 100001));
+		assert(held(&h, 3, 10, T0 + 100001));
+
+		// gap in sequence numbers starts over
+		store(&h, 5000, 10, T0 + 100001);
+		assert(!held(&h, 3, 10, T0 + 100001));
+		assert(held(&h, 5000, 10, T0 + 100001));
+
+		hist_free(&h);
+	}
+
+	assert(-URTC_ERR_BAD_ARGUMENT == hist_init(NULL, 1, 1));
+
+	return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "err.h"
+#include "jbuf.h"
+#include "rtp.h"
+
+#define T0 1000000                      // arbitrary start time (us)
+
+struct sink {
+	uint16_t seqs[128];
+	int count;
+	uint16_t nacked[64];
+	int nacks;
+};
+
+static void emit(const uint8_t *pkt, size_t n, void *arg) {
+	struct sink *s = arg;
+	assert(n == RTP_HEADER_SIZE + 4);
+	s->seqs[s->count++] = (pkt[2] << 8) | pkt[3];
+}
+
+static void nack(uint32_t ssrc, const uint16_t *seqs, size_t count, void *arg) {
+	struct sink *s = arg;
+	assert(0x1234 == ssrc);
+	for (size_t i = 0; i < count; i++) s->nacked[s->nacks++] = seqs[i];
+}
+
+static void put(struct jbuf *j, uint16_t seq, uint32_t ts, bool m, uint64_t t) {
+	uint8_t pkt[RTP_HEADER_SIZE + 4] = { 0 };
+	rtp_header_write(pkt, 96, m, seq, ts, 0x1234);
+	assert(0 == jbuf_put(j, pkt, sizeof(pkt), t));
+}
+
+int main(int argc, char **argv) {
+
+	// Test ordering, and release of complete frames at playout
+	{
+		struct sink s = { 0 };
+		struct jbuf j;
+
+		assert(0 == jbuf_init(&j, JBUF_PROFILE_LOW_LATENCY, emit, nack, &s));
+		jbuf_set_rtt(&j, 5000);
+
+		put(&j, 100, 0, false, T0);
+		put(&j, 101, 0, true, T0);
+		assert(0 == jbuf_poll(&j, T0));
+		assert(2 == s.count && 100 == s.seqs[0] && 101 == s.seqs[1]);
+
+		// reordered within frame: waits, then releases in order
+		put(&j, 103, 3000, true, T0 + 33333);
+		assert(0 != jbuf_poll(&j, T0 + 33333));
+		assert(2 == s.count);
+		put(&j, 102, 3000, false, T0 + 34000);
+		jbuf_poll(&j, T0 + 34000);
+		assert(4 == s.count && 102 == s.seqs[2] && 103 == s.seqs[3]);
+
+		// late and duplicate packets are dropped
+		put(&j, 101, 0, true, T0 + 35000);
+		assert(1 == j.late);
+		jbuf_poll(&j, T0 + 35000);
+		assert(4 == s.count);
+
+		jbuf_free(&j);
+	}
+
+	// Test nack, and waiting for repair only if it can arrive in time
+	{
+		struct sink s = { 0 };
+		struct jbuf j;
+		uint64_t t = T0, due;
+
+		assert(0 == jbuf_init(&j, JBUF_PROFILE_LOW_LATENCY, emit, nack, &s));
+		jbuf_set_rtt(&j, 5000);
+
+		put(&j, 10, 0, false, t);
+		put(&j, 12, 0, true, t);        // 11 missing
+		due = jbuf_poll(&j, t);
+		assert(1 == s.nacks && 11 == s.nacked[0]);
+		assert(0 == s.count);
+		assert(due > t && due <= t + 5000 + 1000);
+
+		// retransmission arrives in time
+		put(&j, 11, 0, false, t + 4000);
+		jbuf_poll(&j, t + 4000);
+		assert(3 == s.count && 11 == s.seqs[1]);
+		assert(0 == j.lost);
+
+		// round trip too long for the latency budget: released with gap
+		jbuf_set_rtt(&j, 100000);
+		t += 33333;
+		put(&j, 13, 3000, false, t);
+		put(&j, 15, 3000, true, t);
+		jbuf_poll(&j, t);
+		assert(5 == s.count && 13 == s.seqs[3] && 15 == s.seqs[4]);
+		assert(1 == j.lost);
+
+		jbuf_free(&j);
+	}
+
+	// Test profiles: smooth holds frames a round trip, low latency does not
+	{
+		struct sink a = { 0 }, b = { 0 };
+		struct jbuf low, smooth;
+
+		assert(0 == jbuf_init(&low, JBUF_PROFILE_LOW_LATENCY, emit, NULL, &a));
+		assert(0 == jbuf_init(&smooth, JBUF_PROFILE_SMOOTH, emit, NULL, &b));
+
+		// frames every 33 ms, arriving with up to 8 ms of jitter
+		for (int i = 0; i < 100; i++) {
+			uint64_t t = T0 + i * 33333 + (i % 3) * 4000 + (i % 2) * 4000;
+			put(&low, i, i * 3000, true, t);
+			put(&smooth, i, i * 3000, true, t);
+			jbuf_poll(&low, t);
+			jbuf_poll(&smooth, t);
+		}
+
+		assert(low.jitter_us > 1000);
+		assert(low.target_us < 50000);
+		assert(smooth.target_us >= 60000);
+		assert(smooth.target_us > low.target_us + JBUF_DEFAULT_RTT_US);
+		assert(a.count > b.count);
+
+		jbuf_free(&low);
+		jbuf_free(&smooth);
+	}
+
+	// Test stream restart and bad arguments
+	{
+		struct sink s = { 0 };
+		struct jbuf j;
+
+		assert(-URTC_ERR_BAD_ARGUMENT ==
+			jbuf_init(&j, JBUF_PROFILE_SMOOTH, NULL, NULL, NULL));
+		assert(0 == jbuf_init(&j, JBUF_PROFILE_SMOOTH, emit, NULL, &s));
+
+		put(&j, 1000, 0, true, T0);
+		put(&j, 40000, 90000, true, T0 + 1000);     // restarted
+		assert(1 == s.count && 1000 == s.seqs[0]);
+		assert(0 > jbuf_put(&j, (const uint8_t *)"\x80", 1, T0));
+
+		jbuf_free(&j);
+	}
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+
+#include "err.h"
+#include "pacer.h"
+
+/**
+ * Drain pacer until \a until, returning bytes sent
+ */
+static size_t drain(struct pacer *p, uint64_t *now, uint64_t until) {
+	enum pacer_prio prio;
+	uint16_t seq;
+	size_t sent = 0;
+	uint64_t next;
+
+	while (next = pacer_next(p, *now), next && next <= until) {
+		*now = next;
+		while (1 == pacer_pop(p, *now, &prio, &seq, NULL)) sent += 1000;
+	}
+	*now = until;
+
+	return sent;
+}
+
+int main(int argc, char **argv) {
+	uint64_t now = 1000000;
+
+	// Test unpaced pacer releases everything
+	{
+		struct pacer p;
+		enum pacer_prio prio;
+		uint16_t seq;
+		pacer_init(&p, 0, 2.5);
+		for (int i = 0; i < 100; i++) {
+			assert(0 == pacer_push(&p, PACER_PRIO_VIDEO, i, 1000));
+		}
+		for (int i = 0; i < 100; i++) {
+			assert(1 == pacer_pop(&p, now, &prio, &seq, NULL));
+			assert(i == seq);
+		}
+		assert(0 == pacer_pop(&p, now, &prio, &seq, NULL));
+		assert(0 == pacer_next(&p, now));
+	}
+
+	// Test keyframe burst is spread at pacing rate
+	{
+		// 1 Mbps x 2 = 250 bytes per millisecond
+		struct pacer p;
+		pacer_init(&p, 1000000, 2.0);
+		for (int i = 0; i < 100; i++) {
+			assert(0 == pacer_push(&p, PACER_PRIO_VIDEO, i, 1000));
+		}
+
+		// first packet goes at once, the rest follow at the pacing rate
+		size_t sent = drain(&p, &now, now);
+		assert(1000 <= sent && sent <= 2000);
+		sent += drain(&p, &now, now + 100000);
+		assert(25000 <= sent && sent <= 27000);
+		assert(pacer_next(&p, now) > now);
+	}
+
+	// Test long backlog is drained at the rate clearing it in the maximum
+	// delay, rather than the pacing rate
+	{
+		struct pacer p;
+		pacer_init(&p, 100000, 1.0);
+		for (int i = 0; i < 500; i++) {
+			assert(0 == pacer_push(&p, PACER_PRIO_VIDEO, i, 1000));
+		}
+		size_t sent = drain(&p, &now, now + PACER_MAX_DELAY_US);
+		assert(sent >= 300000);
+		sent += drain(&p, &now, now + PACER_MAX_DELAY_US);
+		assert(sent >= 400000);
+	}
+
+	// Test retransmissions jump ahead of video, video ahead of padding
+	{
+		struct pacer p;
+		enum pacer_prio prio;
+		uint16_t seq;
+		pacer_init(&p, 0, 1.0);
+		assert(0 == pacer_push(&p, PACER_PRIO_PADDING, 1, 1000));
+		assert(0 == pacer_push(&p, PACER_PRIO_VIDEO, 2, 1000));
+		assert(0 == pacer_push(&p, PACER_PRIO_VIDEO, 3, 1000));
+		assert(0 == pacer_push(&p, PACER_PRIO_RTX, 4, 1000));
+		assert(0 == pacer_push(&p, PACER_PRIO_AUDIO, 5, 100));
+		uint16_t order[] = { 5, 4, 2, 3, 1 };
+		enum pacer_prio prios[] = {
+			PACER_PRIO_AUDIO, PACER_PRIO_RTX, PACER_PRIO_VIDEO,
+			PACER_PRIO_VIDEO, PACER_PRIO_PADDING
+		};
+		for (int i = 0; i < 5; i++) {
+			assert(1 == pacer_pop(&p, now, &prio, &seq, NULL));
+			assert(order[i] == seq);
+			assert(prios[i] == prio);
+		}
+	}
+
+	// Test horizon releases packets ahead, stamped with departure times
+	{
+		// 1 Mbps x 2 = 250 bytes per millisecond
+		struct pacer p;
+		enum pacer_prio prio;
+		uint16_t seq;
+		uint64_t at, last = 0;
+		int n = 0;
+		pacer_init(&p, 1000000, 2.0);
+		pacer_set_horizon(&p, 20000);
+		for (int i = 0; i < 100; i++) {
+			assert(0 == pacer_push(&p, PACER_PRIO_VIDEO, i, 1000));
+		}
+
+		// 20 ms at 250 bytes per ms, plus the initial burst
+		while (1 == pacer_pop(&p, now, &prio, &seq, &at)) {
+			assert(at >= now && at <= now + 20000);
+			assert(at >= last);
+			if (n > 2) assert(at - last >= 3900 && at - last <= 4100);
+			last = at;
+			n++;
+		}
+		assert(5 <= n && n <= 7);
+
+		// woken when the next packet enters the horizon, not when due
+		uint64_t next = pacer_next(&p, now);
+		assert(next > now && next < last + 4100 - 20000 + 100);
+		assert(1 == pacer_pop(&p, next, &prio, &seq, &at));
+		assert(at >= next + 20000 - 100 && at <= next + 20000 + 100);
+
+		pacer_set_horizon(&p, PACER_MAX_HORIZON_US + 1);
+		assert(PACER_MAX_HORIZON_US == p.horizon_us);
+	}
+
+	// Test probe is released at its own rate, then pacing resumes
+	{
+		// 1 Mbps x 1 = 125 bytes per millisecond, probe at 8 Mbps
+		struct pacer p;
+		pacer_init(&p, 1000000, 1.0);
+		for (int i = 0; i < 100; i++) {
+			assert(0 == pacer_push(&p, PACER_PRIO_PADDING, i, 1000));
+		}
+		drain(&p, &now, now);
+		pacer_probe(&p, 8000000, 10000);
+		size_t sent = drain(&p, &now, now + 10000);
+		assert(10000 <= sent && sent <= 12000);
+		assert(0 == p.probe_left);
+		sent = drain(&p, &now, now + 10000);
+		assert(sent <= 2000);
+	}
+
+	// Test unqueued packets are charged, and full queue is refused
+	{
+		struct pacer p;
+		enum pacer_prio prio;
+		uint16_t seq;
+		pacer_init(&p, 1000000, 1.0);
+		pacer_charge(&p, now, 10000);
+		assert(0 == pacer_push(&p, PACER_PRIO_VIDEO, 1, 1000));
+		assert(0 == pacer_pop(&p, now, &prio, &seq, NULL));
+		assert(pacer_next(&p, now) >= now + 70000);
+
+		for (int i = 1; i < PACER_QUEUE_SIZE; i++) {
+			assert(0 == pacer_push(&p, PACER_PRIO_VIDEO, i, 1));
+		}
+		assert(0 > pacer_push(&p, PACER_PRIO_VIDEO, 0, 1));
+		assert(-URTC_ERR_BAD_ARGUMENT == pacer_push(&p, PACER_PRIOS, 0, 1));
+	}
+
+	return 0;
+}
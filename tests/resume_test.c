@@ -0,0 +1,85 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "err.h"
+#include "resume.h"
+
+int main(int argc, char **argv) {
+
+	// Test miss on empty cache
+	{
+		struct resume_entry e;
+		uint8_t fp[32] = { 0x01 };
+		assert(0 > resume_lookup(&e, fp, RESUME_WINDOW_S));
+		assert(-URTC_ERR_BAD_ARGUMENT == resume_store(NULL));
+	}
+
+	// Test store and lookup
+	{
+		struct resume_entry e = { .fingerprint = { 0x01 } };
+		e.remote.sin_family = AF_INET;
+		e.remote.sin_port = htons(5000);
+		e.ticket_len = 3;
+		memcpy(e.ticket, "abc", 3);
+		assert(0 == resume_store(&e));
+
+		struct resume_entry r;
+		assert(0 == resume_lookup(&r, e.fingerprint, RESUME_WINDOW_S));
+		assert(htons(5000) == r.remote.sin_port);
+		assert(3 == r.ticket_len);
+		assert(0 == memcmp("abc", r.ticket, 3));
+
+		// expired entries miss and are evicted
+		assert(0 > resume_lookup(&r, e.fingerprint, 0));
+		assert(0 > resume_lookup(&r, e.fingerprint, RESUME_WINDOW_S));
+	}
+
+	// Test forget
+	{
+		struct resume_entry e = { .fingerprint = { 0x02 } }, r;
+		assert(0 == resume_store(&e));
+		resume_forget(e.fingerprint);
+		assert(0 > resume_lookup(&r, e.fingerprint, RESUME_WINDOW_S));
+	}
+
+	// Test eviction when full
+	{
+		struct resume_entry e = { 0 }, r;
+		for (int i = 0; i < RESUME_MAX_ENTRIES + 1; i++) {
+			e.fingerprint[0] = 0x10 + i;
+			assert(0 == resume_store(&e));
+		}
+		int hits = 0;
+		for (int i = 0; i < RESUME_MAX_ENTRIES + 1; i++) {
+			e.fingerprint[0] = 0x10 + i;
+			hits += (0 == resume_lookup(&r, e.fingerprint, RESUME_WINDOW_S));
+		}
+		assert(RESUME_MAX_ENTRIES == hits);
+	}
+
+	return 0;
+}
@@ -0,0 +1,382 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "err.h"
+#include "rtcp.h"
+
+int main(int argc, char **argv) {
+
+	// Test generic nack
+	{
+		const uint16_t seqs[] = { 100, 101, 116, 117, 65535, 3 };
+		const uint8_t expect[] = {
+			0x81, 205, 0x00, 0x05,
+			0x00, 0x00, 0x00, 0x01,                 // sender
+			0x00, 0x00, 0x00, 0x02,                 // media source
+			0x00, 100, 0x80, 0x01,                  // 100, 101, 116
+			0x00, 117, 0x00, 0x00,
+			0xff, 0xff, 0x00, 0x08                  // 65535, 3 (wrapped)
+		};
+		uint8_t pkt[64];
+
+		assert(sizeof(expect) ==
+			rtcp_write_nack(pkt, sizeof(pkt), 1, 2, seqs, 6));
+		assert(0 == memcmp(expect, pkt, sizeof(expect)));
+
+		assert(-URTC_ERR_BAD_ARGUMENT ==
+			rtcp_write_nack(pkt, 16, 1, 2, seqs, 6));
+		assert(-URTC_ERR_BAD_ARGUMENT ==
+			rtcp_write_nack(pkt, sizeof(pkt), 1, 2, seqs, 0));
+	}
+
+	// Test reading compound packet and generic nack
+	{
+		const uint8_t compound[] = {
+			0x81, 201, 0x00, 0x01,                  // empty rr
+			0x00, 0x00, 0x00, 0x07,
+			0xa1, 205, 0x00, 0x04,                  // nack, padded
+			0x00, 0x00, 0x00, 0x01,
+			0x00, 0x00, 0x00, 0x02,
+			0x00, 100, 0x80, 0x01,                  // 100, 101, 116
+			0x00, 0x00, 0x00, 0x04
+		};
+		const uint8_t *pkt = compound;
+		size_t n = sizeof(compound);
+		struct rtcp_packet p;
+		uint16_t seqs[8];
+		uint32_t media;
+
+		assert(1 == rtcp_next(&pkt, &n, &p));
+		assert(201 == p.type && 1 == p.fmt && 4 == p.len);
+		assert(-URTC_ERR_BAD_ARGUMENT == rtcp_read_nack(&p, &media, seqs, 8));
+
+		assert(1 == rtcp_next(&pkt, &n, &p));
+		assert(RTCP_RTPFB == p.type && RTCP_RTPFB_NACK == p.fmt);
+		assert(12 == p.len);
+		assert(3 == rtcp_read_nack(&p, &media, seqs, 8));
+		assert(2 == media);
+		assert(100 == seqs[0] && 101 == seqs[1] && 116 == seqs[2]);
+		assert(2 == rtcp_read_nack(&p, &media, seqs, 2));
+
+		assert(0 == rtcp_next(&pkt, &n, &p));
+
+		// length beyond end
+		pkt = compound;
+		n = 7;
+		assert(-URTC_ERR_MALFORMED == rtcp_next(&pkt, &n, &p));
+	}
+
+	// Test transport-wide feedback with both chunk types and delta sizes
+	{
+		const uint8_t fb[] = {
+			0x8f, 205, 0x00, 0x07,
+			0x00, 0x00, 0x00, 0x01,     // sender
+			0x00, 0x00, 0x00, 0x02,     // media
+			0x00, 100, 0x00, 10,        // base 100, 10 packets
+			0x00, 0x00, 0x01, 0x00,     // reference time 64 ms
+			0xd2, 0x40,                 // two-bit vector: 1 0 2 1 0 0 0
+			0x20, 0x03,                 // run of three small deltas
+			0x04, 0xff, 0xf8, 0x08,     // +1 ms, -2 ms, +2 ms
+			0x04, 0x04, 0x04, 0x00      // +1 ms each, padding
+		};
+		const uint8_t *pkt = fb;
+		size_t n = sizeof(fb);
+		struct rtcp_packet p;
+		struct rtcp_twcc_status st[16];
+		uint32_t media;
+
+		assert(1 == rtcp_next(&pkt, &n, &p));
+		assert(10 == rtcp_read_twcc(&p, &media, st, 16));
+		assert(2 == media);
+		bool rx[] = { 1, 0, 1, 1, 0, 0, 0, 1, 1, 1 };
+		int64_t at[] = {
+			65000, 0, 63000, 65000, 0, 0, 0, 66000, 67000, 68000
+		};
+		for (int i = 0; i < 10; i++) {
+			assert(100 + i == st[i].seq);
+			assert(rx[i] == st[i].received);
+			assert(at[i] == st[i].arrival_us);
+		}
+		assert(4 == rtcp_read_twcc(&p, &media, st, 4));
+
+		// deltas cut short
+		p.len = 22;
+		assert(-URTC_ERR_MALFORMED == rtcp_read_twcc(&p, &media, st, 16));
+	}
+
+	// Test transport-wide feedback round trip, with losses, reordering and
+	// a long run
+	{
+		struct rtcp_twcc_status in[100] = { 0 }, out[100];
+		uint8_t fb[RTCP_MAX_PACKET_SIZE];
+		const uint8_t *pkt = fb;
+		struct rtcp_packet p;
+		size_t count = 100, n;
+		uint32_t media;
+		int len;
+
+		for (int i = 0; i < 100; i++) {
+			in[i].seq = 65500 + i;
+			in[i].received = i < 40 || i > 42;
+			in[i].arrival_us = 1000000 + 1000 * i;
+		}
+		in[20].arrival_us = 1000000 + 1000 * 18;    // reordered
+		in[60].arrival_us = 1000000 + 1000 * 300;   // late, large delta
+
+		len = rtcp_write_twcc(fb, sizeof(fb), 1, 2, 7, in, &count);
+		assert(len > 0 && 0 == len % 4);
+		assert(100 == count);
+		assert(len < 20 + 2 * 8 + 100 + 2);
+		assert(7 == fb[19]);
+
+		n = len;
+		assert(1 == rtcp_next(&pkt, &n, &p));
+		assert(100 == rtcp_read_twcc(&p, &media, out, 100));
+		assert(2 == media);
+		for (int i = 0; i < 100; i++) {
+			assert(in[i].seq == out[i].seq);
+			assert(in[i].received == out[i].received);
+			if (in[i].received) assert(in[i].arrival_us == out[i].arrival_us);
+		}
+
+		// does not fit: fewer statuses are reported
+		count = 100;
+		len = rtcp_write_twcc(fb, 40, 1, 2, 8, in, &count);
+		assert(len > 0 && len <= 40);
+		assert(count > 0 && count < 100);
+		pkt = fb;
+		n = len;
+		assert(1 == rtcp_next(&pkt, &n, &p));
+		assert((int)count == rtcp_read_twcc(&p, &media, out, 100));
+
+		// delta too large to write ends the packet
+		in[1].arrival_us = in[0].arrival_us + 10000000;
+		count = 100;
+		assert(0 < rtcp_write_twcc(fb, sizeof(fb), 1, 2, 9, in, &count));
+		assert(1 == count);
+	}
+
+	// Test receiver estimated maximum bitrate round trip
+	{
+		uint8_t fb[32];
+		const uint8_t *pkt = fb;
+		uint32_t ssrcs[] = { 0x11223344 };
+		struct rtcp_packet p;
+		uint64_t bps;
+		size_t n;
+		int len;
+
+		len = rtcp_write_remb(fb, sizeof(fb), 1, 2500000, ssrcs, 1);
+		assert(24 == len);
+		n = len;
+		assert(1 == rtcp_next(&pkt, &n, &p));
+		assert(RTCP_PSFB == p.type && RTCP_PSFB_AFB == p.fmt);
+		assert(1 == rtcp_read_remb(&p, &bps));
+		assert(bps <= 2500000 && bps > 2500000 - 16);
+		assert(0x11 == fb[20]);
+
+		memcpy(fb + 12, "ABCD", 4);
+		assert(-URTC_ERR_MALFORMED == rtcp_read_remb(&p, &bps));
+		assert(0 > rtcp_write_remb(fb, 20, 1, 2500000, ssrcs, 1));
+	}
+
+	// Test picture loss indication and full intra request
+	{
+		const uint8_t pli[] = {
+			0x81, 206, 0x00, 0x02,
+			0x00, 0x00, 0x00, 0x01,	// sender
+			0x00, 0x00, 0x00, 0x2a	// media
+		};
+		const uint8_t fir[] = {
+			0x84, 206, 0x00, 0x06,
+			0x00, 0x00, 0x00, 0x01,	// sender
+			0x00, 0x00, 0x00, 0x00,	// media (unused)
+			0x00, 0x00, 0x00, 0x07,	// first entry
+			0x03, 0x00, 0x00, 0x00,
+			0x00, 0x00, 0x00, 0x2a,	// second entry
+			0x05, 0x00, 0x00, 0x00
+		};
+		const uint8_t *q = pli;
+		size_t n = sizeof(pli);
+		struct rtcp_packet p;
+		uint32_t media;
+		uint8_t seq;
+
+		assert(1 == rtcp_next(&q, &n, &p));
+		assert(0 == rtcp_read_pli(&p, &media));
+		assert(42 == media);
+		assert(0 > rtcp_read_fir(&p, 42, &seq));
+
+		q = fir;
+		n = sizeof(fir);
+		assert(1 == rtcp_next(&q, &n, &p));
+		assert(1 == rtcp_read_fir(&p, 42, &seq));
+		assert(5 == seq);
+		assert(1 == rtcp_read_fir(&p, 7, &seq));
+		assert(3 == seq);
+		assert(0 == rtcp_read_fir(&p, 8, &seq));
+		assert(0 > rtcp_read_pli(&p, &media));
+
+		p.len -= 4;
+		assert(-URTC_ERR_MALFORMED == rtcp_read_fir(&p, 42, &seq));
+	}
+
+	// Test sender report round trip
+	{
+		const struct rtcp_sender_info si = {
+			.ntp = 0x0102030405060708ULL,
+			.rtp_ts = 90000,
+			.packets = 10,
+			.octets = 12000
+		};
+		const struct rtcp_report_block rb = {
+			.ssrc = 42,
+			.fraction_lost = 64,
+			.lost = -3,
+			.highest_seq = 0x10005,
+			.jitter = 7,
+			.lsr = 0x03040506,
+			.dlsr = 0x8000
+		};
+		struct rtcp_sender_info si2;
+		struct rtcp_report_block rb2[2];
+		struct rtcp_packet p;
+		uint8_t pkt[64];
+		const uint8_t *q = pkt;
+		size_t n;
+		uint32_t sender;
+
+		assert(52 == (n = rtcp_write_report(pkt, sizeof(pkt), 1, &si, &rb,
+			1)));
+		assert(0x81 == pkt[0] && RTCP_SR == pkt[1] && 12 == pkt[3]);
+		assert(1 == rtcp_next(&q, &n, &p));
+		assert(1 == rtcp_read_report(&p, &sender, &si2, rb2, 2));
+		assert(1 == sender);
+		assert(si.ntp == si2.ntp && 90000 == si2.rtp_ts);
+		assert(10 == si2.packets && 12000 == si2.octets);
+		assert(42 == rb2[0].ssrc && 64 == rb2[0].fraction_lost);
+		assert(-3 == rb2[0].lost && 0x10005 == rb2[0].highest_seq);
+		assert(7 == rb2[0].jitter && rb.lsr == rb2[0].lsr);
+		assert(0x8000 == rb2[0].dlsr);
+
+		// receiver report, without blocks
+		q = pkt;
+		assert(8 == (n = rtcp_write_report(pkt, sizeof(pkt), 2, NULL, NULL,
+			0)));
+		assert(RTCP_RR == pkt[1]);
+		assert(1 == rtcp_next(&q, &n, &p));
+		assert(0 == rtcp_read_report(&p, &sender, NULL, rb2, 2));
+		assert(2 == sender);
+
+		// blocks claimed beyond packet
+		p.fmt = 1;
+		assert(-URTC_ERR_MALFORMED == rtcp_read_report(&p, &sender, NULL,
+			rb2, 2));
+		assert(0 > rtcp_write_report(pkt, 51, 1, &si, &rb, 1));
+	}
+
+	// Test source description
+	{
+		const uint8_t expect[] = {
+			0x81, 202, 0x00, 0x03,
+			0x00, 0x00, 0x00, 0x01,
+			0x01, 0x04, 'u', 'r', 't', 'c', 0x00, 0x00
+		};
+		uint8_t pkt[32];
+
+		assert(16 == rtcp_write_sdes(pkt, sizeof(pkt), 1, "urtc"));
+		assert(0 == memcmp(expect, pkt, sizeof(expect)));
+		assert(20 == rtcp_write_sdes(pkt, sizeof(pkt), 1, "liburtc"));
+		assert(0 == pkt[18] && 0 == pkt[19]);
+		assert(0 > rtcp_write_sdes(pkt, 15, 1, "urtc"));
+	}
+
+	// Test reception statistics
+	{
+		struct rtcp_rx_stats s = { 0 };
+		struct rtcp_report_block rb;
+
+		assert(0 > rtcp_rx_block(&s, 0, &rb));
+
+		// 10 sent across the sequence number wrap, 2 lost, evenly spaced
+		for (int i = 0; i < 10; i++) {
+			if (3 == i || 4 == i) continue;
+			rtcp_rx_update(&s, 42, 65530 + i, 3000 * i, 3000 * i + 500);
+		}
+		assert(0 == rtcp_rx_block(&s, 0, &rb));
+		assert(42 == rb.ssrc);
+		assert(2 == rb.lost && 51 == rb.fraction_lost);
+		assert(0x10003 == rb.highest_seq);
+		assert(0 == rb.jitter && 0 == rb.lsr && 0 == rb.dlsr);
+
+		// fraction is since the last report, and duplicates count
+		rtcp_rx_update(&s, 42, 4, 30000, 30000 + 2100);
+		rtcp_rx_update(&s, 42, 4, 30000, 30000 + 2100);
+		rtcp_rx_sr(&s, 0x0000123456780000ULL, 1000000);
+		assert(0 == rtcp_rx_block(&s, 1500000, &rb));
+		assert(0 == rb.fraction_lost && 1 == rb.lost);
+		assert(93 == rb.jitter);		// 1600 / 16, then decayed
+		assert(0x12345678 == rb.lsr && 32768 == rb.dlsr);
+
+		// restart on a large jump
+		rtcp_rx_update(&s, 42, 30000, 0, 0);
+		assert(0 == rtcp_rx_block(&s, 1500000, &rb));
+		assert(30000 == rb.highest_seq && 0 == rb.lost);
+		assert(0x12345678 == rb.lsr);
+	}
+
+	// Test ntp time and round trip time
+	{
+		struct rtcp_report_block rb = { .lsr = 0x00010000, .dlsr = 0x8000 };
+
+		assert(2208988800ULL << 32 == rtcp_ntp(0));
+		assert((2208988801ULL << 32 | 0x80000000) == rtcp_ntp(1500000));
+
+		// sent at 1 s, held 0.5 s, back at 2 s
+		assert(500000 == rtcp_rtt_us(&rb, 0x0000000200000000ULL));
+		assert(0 == rtcp_rtt_us(&rb, 0x0000000100000000ULL));
+		rb.lsr = 0;
+		assert(0 == rtcp_rtt_us(&rb, 0x0000000200000000ULL));
+	}
+
+	// Test report interval
+	{
+		// unknown bandwidth: minimum, halved at first
+		assert(5000000 == rtcp_interval_us(0, 100, 2, 1, true, false, 0.5));
+		assert(2500000 == rtcp_interval_us(0, 100, 2, 1, true, true, 0.5));
+		assert(2500000 == rtcp_interval_us(0, 100, 2, 1, true, false, 0));
+
+		// reduced minimum at high bitrates
+		assert(180000 == rtcp_interval_us(2000000, 100, 2, 1, true, false,
+			0.5));
+
+		// bandwidth share, at low bitrates: 2 x 500 bytes in 5% of 8 kbps
+		assert(20000000 == rtcp_interval_us(8000, 500, 2, 1, false, false,
+			0.5));
+	}
+
+	return 0;
+}
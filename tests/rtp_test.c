@@ -0,0 +1,155 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "err.h"
+#include "rtp.h"
+
+int main(int argc, char **argv) {
+
+	// Test header read
+	{
+		uint8_t pkt[RTP_HEADER_SIZE + 4];
+		struct rtp_header h;
+		rtp_header_write(pkt, 96, true, 0x1234, 0xdeadbeef, 0x01020304);
+		memcpy(pkt + RTP_HEADER_SIZE, "abcd", 4);
+		assert(0 == rtp_header_read(pkt, sizeof(pkt), &h));
+		assert(96 == h.pt);
+		assert(h.marker);
+		assert(0x1234 == h.seq);
+		assert(0xdeadbeef == h.ts);
+		assert(0x01020304 == h.ssrc);
+		assert(RTP_HEADER_SIZE == h.payload);
+		assert(4 == h.payload_len);
+		assert(-URTC_ERR_MALFORMED == rtp_header_read(pkt, 11, &h));
+	}
+
+	// Test transport-wide sequence number extension, and its removal
+	{
+		uint8_t orig[RTP_HEADER_SIZE + 4];
+		uint8_t pkt[RTP_HEADER_SIZE + RTP_TWCC_EXT_SIZE + 4], *p;
+		struct rtp_header h;
+		size_t n;
+		rtp_header_write(orig, 96, false, 0x1234, 90000, 1);
+		memcpy(orig + RTP_HEADER_SIZE, "abcd", 4);
+
+		memcpy(pkt, orig, RTP_HEADER_SIZE);
+		n = rtp_twcc_write(pkt, RTP_HEADER_SIZE, 5, 0xabcd);
+		assert(RTP_HEADER_SIZE + RTP_TWCC_EXT_SIZE == n);
+		memcpy(pkt + n, "abcd", 4);
+		n += 4;
+		assert(pkt[0] & 0x10);
+		assert(0x51 == pkt[RTP_HEADER_SIZE + 4]);
+		assert(0xab == pkt[RTP_HEADER_SIZE + 5]);
+		assert(0xcd == pkt[RTP_HEADER_SIZE + 6]);
+		assert(0 == rtp_header_read(pkt, n, &h));
+		assert(RTP_HEADER_SIZE + RTP_TWCC_EXT_SIZE == h.payload);
+		assert(4 == h.payload_len);
+
+		uint16_t seq = 0;
+		assert(0 == rtp_twcc_read(pkt, n, 5, &seq));
+		assert(0xabcd == seq);
+		assert(0 > rtp_twcc_read(pkt, n, 6, &seq));
+		assert(0 > rtp_twcc_read(orig, sizeof(orig), 5, &seq));
+
+		assert((p = rtp_ext_strip(pkt, &n)));
+		assert(sizeof(orig) == n);
+		assert(0 == memcmp(orig, p, n));
+		assert(p == rtp_ext_strip(p, &n));
+		n = RTP_HEADER_SIZE + 2;
+		pkt[0] |= 0x10;
+		assert(!rtp_ext_strip(pkt, &n));
+	}
+
+	// Test transport-wide sequence number in two-byte header form, after
+	// another element and padding
+	{
+		uint8_t pkt[RTP_HEADER_SIZE + 12] = { 0 };
+		uint16_t seq = 0;
+		rtp_header_write(pkt, 96, false, 1, 0, 1);
+		pkt[0] |= 0x10;
+		uint8_t ext[12] = {
+			0x10, 0x00, 0x00, 0x02,     // profile, two words
+			0x03, 0x01, 0xff, 0x00,     // id 3, one byte; padding
+			0x05, 0x02, 0x12, 0x34      // id 5, two bytes
+		};
+		memcpy(pkt + RTP_HEADER_SIZE, ext, sizeof(ext));
+		assert(0 == rtp_twcc_read(pkt, sizeof(pkt), 5, &seq));
+		assert(0x1234 == seq);
+		assert(-URTC_ERR_MALFORMED == rtp_twcc_read(pkt, sizeof(pkt) - 1, 5,
+			&seq));
+	}
+
+	// Test retransmission round trip
+	{
+		uint8_t orig[RTP_HEADER_SIZE + 4], pkt[64];
+		size_t n;
+		rtp_header_write(orig, 96, true, 0x1234, 0xdeadbeef, 0x01020304);
+		memcpy(orig + RTP_HEADER_SIZE, "abcd", 4);
+
+		rtp_rtx_write(pkt, orig, 97, 7, 0x0a0b0c0d);
+		memcpy(pkt + RTP_HEADER_SIZE + RTP_RTX_OSN_SIZE, "abcd", 4);
+		n = RTP_HEADER_SIZE + RTP_RTX_OSN_SIZE + 4;
+
+		struct rtp_header h;
+		assert(0 == rtp_header_read(pkt, n, &h));
+		assert(97 == h.pt);
+		assert(h.marker);
+		assert(7 == h.seq);
+		assert(0xdeadbeef == h.ts);
+		assert(0x0a0b0c0d == h.ssrc);
+		assert(0x12 == pkt[RTP_HEADER_SIZE]);
+		assert(0x34 == pkt[RTP_HEADER_SIZE + 1]);
+
+		assert(0 == rtp_rtx_unwrap(pkt, &n, 96, 0x01020304));
+		assert(sizeof(orig) == n);
+		assert(0 == memcmp(orig, pkt, n));
+	}
+
+	// Test padding is stripped, and padding-only packets are rejected
+	{
+		uint8_t orig[RTP_HEADER_SIZE + 4], pkt[64];
+		size_t n;
+		rtp_header_write(orig, 96, false, 9, 90000, 1);
+		memcpy(orig + RTP_HEADER_SIZE, "abcd", 4);
+
+		rtp_rtx_write(pkt, orig, 97, 8, 2);
+		memcpy(pkt + RTP_HEADER_SIZE + RTP_RTX_OSN_SIZE, "abcd\0\0\3", 7);
+		pkt[0] |= 0x20;
+		n = RTP_HEADER_SIZE + RTP_RTX_OSN_SIZE + 7;
+		assert(0 == rtp_rtx_unwrap(pkt, &n, 96, 1));
+		assert(sizeof(orig) == n);
+		assert(0 == memcmp(orig, pkt, n));
+
+		rtp_header_write(pkt, 97, false, 9, 90000, 2);
+		memset(pkt + RTP_HEADER_SIZE, 0, 4);
+		pkt[RTP_HEADER_SIZE + 3] = 4;
+		pkt[0] |= 0x20;
+		n = RTP_HEADER_SIZE + 4;
+		assert(0 > rtp_rtx_unwrap(pkt, &n, 96, 1));
+	}
+
+	return 0;
+}
@@ -258,6 +258,15 @@ int main(int argc, char **argv) {
 			for (int i = 0; i < sdp.video.count; i++) {
 				assert(expected_type[i] == sdp.video.params[i].type);
 			}
+			assert(SDP_CODEC_H264 == sdp.video.params[6].codec);
+			assert(SDP_CODEC_RTX == sdp.video.params[7].codec);
+			assert(90000 == sdp.video.params[7].clock);
+			assert(102 == sdp.video.params[7].apt);
+			assert(0 == sdp.video.params[6].apt);
+			assert(5 == sdp.video.twcc_ext);
+			assert(sdp.video.remb);
+			assert(sdp.video.pli);
+			assert(sdp.video.fir);
 		}
 		assert(0 == strcmp("DPkQ", sdp.ufrag));
 		assert(0 == strcmp("23oU5vsiyBKLHbND/Ql8f7gZ", sdp.pwd));
@@ -271,6 +280,7 @@ int main(int argc, char **argv) {
 			};
 			assert(0 == memcmp(sdp.fingerprint.sha256, expected_fingerprint, 32));
 		}
+		assert(SDP_SETUP_ACTPASS == sdp.setup);
 		assert(SDP_MODE_RECEIVE_ONLY == sdp.mode);
 		assert(true == sdp.rtcp_mux);
 		assert(true == sdp.rtcp_rsize);
@@ -318,11 +328,60 @@ int main(int argc, char **argv) {
 		char str[2048];
 		sdp_t sdp = {
 			.ice_options.trickle = true,
-			.rtcp_mux = true
+			.rtcp_mux = true,
+			.setup = SDP_SETUP_ACTIVE
 		};
 		assert(0 == sdp_serialize(str, sizeof(str), &sdp));
+		assert(NULL != strstr(str, "a=setup:active\n"));
 		fprintf(stderr, "%s", str);
 	}
 
+	// Test SDP serialize with retransmission stream
+	{
+		char str[2048];
+		sdp_t sdp = {
+			.username = "-",
+			.session_id = "1",
+			.session_version = "2",
+			.video = {
+				.port = 9,
+				.params = {
+					{ .type = 102, .codec = SDP_CODEC_H264, .clock = 90000 },
+					{ .type = 122, .codec = SDP_CODEC_RTX, .clock = 90000,
+					  .apt = 102 }
+				},
+				.count = 2,
+				.ssrc = 1111,
+				.rtx_ssrc = 2222,
+				.cname = "urtc",
+				.twcc_ext = 5,
+				.remb = true,
+				.pli = true
+			}
+		};
+		assert(0 == sdp_serialize(str, sizeof(str), &sdp));
+		assert(NULL != strstr(str, "m=video 9 UDP/TLS/RTP/SAVPF 102 122\n"));
+		assert(NULL != strstr(str, "a=rtpmap:122 rtx/90000\n"));
+		assert(NULL != strstr(str, "a=fmtp:122 apt=102\n"));
+		assert(NULL != strstr(str, "a=ssrc-group:FID 1111 2222\n"));
+		assert(NULL != strstr(str, "a=ssrc:2222 cname:urtc\n"));
+		assert(NULL != strstr(str, "a=extmap:5 " SDP_EXTMAP_TWCC "\n"));
+		assert(NULL != strstr(str, "a=rtcp-fb:102 transport-cc\n"));
+		assert(NULL != strstr(str, "a=rtcp-fb:102 goog-remb\n"));
+		assert(NULL != strstr(str, "a=rtcp-fb:102 nack pli\n"));
+		assert(NULL == strstr(str, "ccm fir"));
+
+		// and back
+		sdp_t parsed = { 0 };
+		assert(0 == sdp_parse(&parsed, str));
+		assert(2 == parsed.video.count);
+		assert(SDP_CODEC_RTX == parsed.video.params[1].codec);
+		assert(102 == parsed.video.params[1].apt);
+		assert(5 == parsed.video.twcc_ext);
+		assert(parsed.video.remb);
+		assert(parsed.video.pli);
+		assert(!parsed.video.fir);
+	}
+
 	return 0;
 }
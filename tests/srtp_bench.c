@@ -0,0 +1,114 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * SRTP protection throughput, per profile
+ *
+ * Build and run with 'make srtp_bench && ./srtp_bench'. Protects a
+ * synthetic video frame of 1200-byte packets, one packet at a time and as
+ * one batch.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "srtp.h"
+
+#define PACKETS_PER_FRAME   64
+#define PAYLOAD_SIZE      1200
+#define FRAMES            2000
+
+static const struct {
+	enum srtp_profile id;
+	const char *name;
+} profiles[] = {
+	{ SRTP_PROFILE_AES128_CM_SHA1_80, "AES_CM_128_HMAC_SHA1_80" },
+	{ SRTP_PROFILE_AES128_CM_SHA1_32, "AES_CM_128_HMAC_SHA1_32" },
+	{ SRTP_PROFILE_AEAD_AES_128_GCM,  "AEAD_AES_128_GCM" },
+	{ SRTP_PROFILE_AEAD_AES_256_GCM,  "AEAD_AES_256_GCM" },
+};
+
+static uint8_t frame[PACKETS_PER_FRAME][PAYLOAD_SIZE + SRTP_MAX_TRAILER_SIZE];
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill(uint16_t seq) {
+	for (int i = 0; i < PACKETS_PER_FRAME; i++) {
+		memset(frame[i], 0xa5, PAYLOAD_SIZE);
+		frame[i][0] = 0x80;
+		frame[i][1] = 0x60;
+		frame[i][2] = (seq + i) >> 8;
+		frame[i][3] = (seq + i);
+	}
+}
+
+static void report(const char *name, const char *mode, double secs) {
+	double pkts = (double)FRAMES * PACKETS_PER_FRAME;
+	printf("%-24s %-7s %8.0f kpkt/s %8.1f MB/s\n", name, mode,
+		pkts / secs / 1e3, pkts * PAYLOAD_SIZE / secs / 1e6);
+}
+
+int main(int argc, char **argv) {
+	uint8_t key[SRTP_MAX_KEY_SIZE] = { 0x01 };
+	uint8_t salt[SRTP_MAX_SALT_SIZE] = { 0x02 };
+	struct srtp_packet batch[PACKETS_PER_FRAME];
+
+	for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++) {
+		struct srtp s;
+		uint16_t seq = 0;
+		double t;
+
+		if (srtp_init(&s, profiles[p].id, key, salt) < 0) return 1;
+
+		t = now();
+		for (int f = 0; f < FRAMES; f++, seq += PACKETS_PER_FRAME) {
+			fill(seq);
+			for (int i = 0; i < PACKETS_PER_FRAME; i++) {
+				size_t len = PAYLOAD_SIZE;
+				srtp_protect(&s, frame[i], &len, sizeof(frame[i]));
+			}
+		}
+		report(profiles[p].name, "single", now() - t);
+
+		t = now();
+		for (int f = 0; f < FRAMES; f++, seq += PACKETS_PER_FRAME) {
+			fill(seq);
+			for (int i = 0; i < PACKETS_PER_FRAME; i++) {
+				batch[i].data = frame[i];
+				batch[i].len = PAYLOAD_SIZE;
+				batch[i].cap = sizeof(frame[i]);
+			}
+			srtp_protect_batch(&s, batch, PACKETS_PER_FRAME);
+		}
+		report(profiles[p].name, "batch", now() - t);
+
+		srtp_free(&s);
+	}
+
+	return 0;
+}
@@ -0,0 +1,405 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "err.h"
+#include "srtp.h"
+
+// RFC 3711 Appendix B.3 master key and salt
+static const uint8_t master_key[16] = {
+	0xe1, 0xf9, 0x7a, 0x0d, 0x3e, 0x01, 0x8b, 0xe0,
+	0xd6, 0x4f, 0xa3, 0x2c, 0x06, 0xde, 0x41, 0x39
+};
+static const uint8_t master_salt[14] = {
+	0x0e, 0xc6, 0x75, 0xad, 0x49, 0x8a, 0xfe, 0xeb,
+	0xb6, 0x96, 0x0b, 0x3a, 0xab, 0xe6
+};
+
+int main(int argc, char **argv) {
+
+	// Test key derivation (RFC 3711 Appendix B.3)
+	{
+		const uint8_t cipher_key[16] = {
+			0xc6, 0x1e, 0x7a, 0x93, 0x74, 0x4f, 0x39, 0xee,
+			0x10, 0x73, 0x4a, 0xfe, 0x3f, 0xf7, 0xa0, 0x87
+		};
+		const uint8_t cipher_salt[14] = {
+			0x30, 0xcb, 0xbc, 0x08, 0x86, 0x3d, 0x8c, 0x85,
+			0xd4, 0x9d, 0xb3, 0x4a, 0x9a, 0xe1
+		};
+		const uint8_t auth_key[20] = {
+			0xce, 0xbe, 0x32, 0x1f, 0x6f, 0xf7, 0x71, 0x6b,
+			0x6f, 0xd4, 0xab, 0x49, 0xaf, 0x25, 0x6a, 0x15,
+			0x6d, 0x38, 0xba, 0xa4
+		};
+		uint8_t out[20];
+
+		assert(0 == srtp_derive(master_key, 16, master_salt, 0, out, 16));
+		assert(0 == memcmp(cipher_key, out, 16));
+		assert(0 == srtp_derive(master_key, 16, master_salt, 2, out, 14));
+		assert(0 == memcmp(cipher_salt, out, 14));
+		assert(0 == srtp_derive(master_key, 16, master_salt, 1, out, 20));
+		assert(0 == memcmp(auth_key, out, 20));
+
+		assert(-URTC_ERR_BAD_ARGUMENT ==
+			srtp_derive(master_key, 15, master_salt, 0, out, 16));
+	}
+
+	// Test known answer for AES_CM_128_HMAC_SHA1_80 protected packet
+	{
+		const uint8_t ciphertext[38] = {
+			0x80, 0x0f, 0x12, 0x34, 0xde, 0xca, 0xfb, 0xad,
+			0xca, 0xfe, 0xba, 0xbe, 0x4e, 0x55, 0xdc, 0x4c,
+			0xe7, 0x99, 0x78, 0xd8, 0x8c, 0xa4, 0xd2, 0x15,
+			0x94, 0x9d, 0x24, 0x02, 0xb7, 0x8d, 0x6a, 0xcc,
+			0x99, 0xea, 0x17, 0x9b, 0x8d, 0xbb
+		};
+		uint8_t pkt[64] = {
+			0x80, 0x0f, 0x12, 0x34, 0xde, 0xca, 0xfb, 0xad,
+			0xca, 0xfe, 0xba, 0xbe
+		};
+		size_t len = 28;
+		struct srtp tx, rx;
+
+		memset(pkt + 12, 0xab, 16);
+
+		assert(0 == srtp_init(&tx, SRTP_PROFILE_AES128_CM_SHA1_80,
+			master_key, master_salt));
+		assert(0 == srtp_init(&rx, SRTP_PROFILE_AES128_CM_SHA1_80,
+			master_key, master_salt));
+
+		// buffer too small for tag
+		assert(-URTC_ERR_INSUFFICIENT_MEMORY ==
+			srtp_protect(&tx, pkt, &len, 30));
+
+		assert(0 == srtp_protect(&tx, pkt, &len, sizeof(pkt)));
+		assert(38 == len);
+		assert(0 == memcmp(ciphertext, pkt, len));
+
+		assert(0 == srtp_unprotect(&rx, pkt, &len));
+		assert(28 == len);
+		for (int i = 12; i < 28; i++) assert(0xab == pkt[i]);
+
+		srtp_free(&tx);
+		srtp_free(&rx);
+	}
+
+	// Test 32-bit tag, tampering, and sequence number rollover
+	{
+		struct srtp tx, rx;
+		uint8_t pkt[64];
+		size_t len;
+
+		assert(0 == srtp_init(&tx, SRTP_PROFILE_AES128_CM_SHA1_32,
+			master_key, master_salt));
+		assert(0 == srtp_init(&rx, SRTP_PROFILE_AES128_CM_SHA1_32,
+			master_key, master_salt));
+
+		for (uint32_t seq = 65530; seq < 65540; seq++) {
+			memset(pkt, 0, sizeof(pkt));
+			pkt[0] = 0x80;
+			pkt[2] = seq >> 8;
+			pkt[3] = seq;
+			pkt[11] = 0x01;
+			memset(pkt + 12, seq & 0xff, 20);
+			len = 32;
+
+			assert(0 == srtp_protect(&tx, pkt, &len, sizeof(pkt)));
+			assert(36 == len);
+
+			pkt[20] ^= 0x01;
+			assert(0 > srtp_unprotect(&rx, pkt, &len));
+			pkt[20] ^= 0x01;
+
+			assert(0 == srtp_unprotect(&rx, pkt, &len));
+			assert(32 == len);
+			for (int i = 12; i < 32; i++) assert((seq & 0xff) == pkt[i]);
+		}
+		assert(1 == tx.streams[0].roc);
+		assert(1 == rx.streams[0].roc);
+
+		srtp_free(&tx);
+		srtp_free(&rx);
+	}
+
+	// Test AEAD profiles, SRTP and SRTCP
+	{
+		const enum srtp_profile aead[] = {
+			SRTP_PROFILE_AEAD_AES_128_GCM,
+			SRTP_PROFILE_AEAD_AES_256_GCM
+		};
+		const uint8_t hdr[12] = {
+			0x80, 0x60, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+			0x12, 0x34, 0x56, 0x78
+		};
+		uint8_t key[32], pkt[64], bad[64];
+		size_t len, badlen;
+
+		memcpy(key, master_key, 16);
+		memcpy(key + 16, master_key, 16);
+
+		for (int i = 0; i < 2; i++) {
+			struct srtp tx, rx;
+
+			assert(0 == srtp_init(&tx, aead[i], key, master_salt));
+			assert(0 == srtp_init(&rx, aead[i], key, master_salt));
+
+			memset(pkt, 0x33, sizeof(pkt));
+			memcpy(pkt, hdr, sizeof(hdr));
+			len = 40;
+
+			assert(0 == srtp_protect(&tx, pkt, &len, sizeof(pkt)));
+			assert(56 == len);      // 16-byte tag
+			assert(0 == memcmp(hdr, pkt, sizeof(hdr)));
+
+			// header is authenticated
+			memcpy(bad, pkt, len);
+			badlen = len;
+			bad[1] ^= 0x01;
+			assert(0 > srtp_unprotect(&rx, bad, &badlen));
+
+			assert(0 == srtp_unprotect(&rx, pkt, &len));
+			assert(40 == len);
+			for (int j = 12; j < 40; j++) assert(0x33 == pkt[j]);
+
+			// sender report
+			memset(pkt, 0x5a, sizeof(pkt));
+			memcpy(pkt, "\x80\xc8\x00\x06\x12\x34\x56\x78", 8);
+			len = 28;
+
+			assert(0 == srtcp_protect(&tx, pkt, &len, sizeof(pkt)));
+			assert(28 + 16 + 4 == len);
+			assert(0x80 == pkt[44]);    // e-flag follows tag
+
+			memcpy(bad, pkt, len);
+			badlen = len;
+			bad[47] ^= 0x01;            // index is authenticated
+			assert(0 > srtcp_unprotect(&rx, bad, &badlen));
+
+			assert(0 == srtcp_unprotect(&rx, pkt, &len));
+			assert(28 == len);
+			for (int j = 8; j < 28; j++) assert(0x5a == pkt[j]);
+
+			srtp_free(&tx);
+			srtp_free(&rx);
+		}
+	}
+
+	// Test batch protection matches per-packet protection
+	{
+		uint8_t a[4][64], b[4][64];
+		struct srtp_packet batch[4];
+		struct srtp s1, s2;
+
+		assert(0 == srtp_init(&s1, SRTP_PROFILE_AEAD_AES_128_GCM,
+			master_key, master_salt));
+		assert(0 == srtp_init(&s2, SRTP_PROFILE_AEAD_AES_128_GCM,
+			master_key, master_salt));
+
+		for (int i = 0; i < 4; i++) {
+			memset(a[i], i, sizeof(a[i]));
+			a[i][0] = 0x80;
+			a[i][1] = 0x60;
+			a[i][2] = 0;
+			a[i][3] = i;
+			memset(a[i] + 8, 0x42, 4);
+			memcpy(b[i], a[i], sizeof(a[i]));
+
+			batch[i].data = b[i];
+			batch[i].len = 32;
+			batch[i].cap = sizeof(b[i]);
+		}
+
+		assert(0 == srtp_protect_batch(&s2, batch, 4));
+		for (int i = 0; i < 4; i++) {
+			size_t len = 32;
+			assert(0 == srtp_protect(&s1, a[i], &len, sizeof(a[i])));
+			assert(len == batch[i].len);
+			assert(0 == memcmp(a[i], b[i], len));
+		}
+
+		// stops at first malformed packet
+		batch[1].len = 4;
+		assert(-URTC_ERR_MALFORMED == srtp_protect_batch(&s2, batch, 4));
+
+		srtp_free(&s1);
+		srtp_free(&s2);
+	}
+
+	// Test gathered protection matches in-place protection
+	{
+		const int profiles[] = {
+			SRTP_PROFILE_AES128_CM_SHA1_80,
+			SRTP_PROFILE_AEAD_AES_128_GCM
+		};
+		for (size_t k = 0; k < sizeof(profiles) / sizeof(*profiles); k++) {
+			uint8_t a[64] = { 0x80, 0x60, 0x00, 0x07 }, b[64];
+			struct iovec iov[3];
+			struct srtp s1, s2;
+			size_t len = 40, n;
+
+			memset(a + 8, 0x42, 4);
+			for (int i = 12; i < 40; i++) a[i] = i;
+			iov[0] = (struct iovec){ a + 12, 1 };
+			iov[1] = (struct iovec){ a + 13, 20 };
+			iov[2] = (struct iovec){ a + 33, 7 };
+
+			assert(0 == srtp_init(&s1, profiles[k], master_key, master_salt));
+			assert(0 == srtp_init(&s2, profiles[k], master_key, master_salt));
+
+			assert(0 == srtp_protect_iov(&s2, a, 12, iov, 3, b, &n,
+				sizeof(b)));
+			assert(0 == srtp_protect(&s1, a, &len, sizeof(a)));
+			assert(len == n);
+			assert(0 == memcmp(a, b, len));
+
+			// header must be complete, output must fit
+			assert(-URTC_ERR_MALFORMED ==
+				srtp_protect_iov(&s2, a, 8, iov, 3, b, &n, sizeof(b)));
+			assert(0 > srtp_protect_iov(&s2, a, 12, iov, 3, b, &n, 40));
+
+			srtp_free(&s1);
+			srtp_free(&s2);
+		}
+	}
+
+	// Test replay window
+	{
+		static uint8_t prot[300][64];
+		static size_t len[300];
+		uint8_t pkt[64];
+		size_t n;
+		struct srtp tx, rx;
+
+		assert(0 == srtp_init(&tx, SRTP_PROFILE_AES128_CM_SHA1_80,
+			master_key, master_salt));
+		assert(0 == srtp_init(&rx, SRTP_PROFILE_AES128_CM_SHA1_80,
+			master_key, master_salt));
+
+		for (int i = 0; i < 300; i++) {
+			memset(prot[i], 0, sizeof(prot[i]));
+			prot[i][0] = 0x80;
+			prot[i][2] = i >> 8;
+			prot[i][3] = i;
+			len[i] = 20;
+			assert(0 == srtp_protect(&tx, prot[i], &len[i], 64));
+		}
+
+		#define RECV(i) (memcpy(pkt, prot[i], len[i]), n = len[i], \
+			srtp_unprotect(&rx, pkt, &n))
+
+		assert(0 == RECV(200));
+		assert(-URTC_ERR_SRTP_REPLAYED == RECV(200));
+
+		// reordered within window, once
+		assert(0 == RECV(150));
+		assert(-URTC_ERR_SRTP_REPLAYED == RECV(150));
+
+		// window edge
+		assert(-URTC_ERR_SRTP_REPLAYED == RECV(200 - SRTP_REPLAY_WINDOW));
+		assert(0 == RECV(201 - SRTP_REPLAY_WINDOW));
+
+		// advance across a word boundary, history is kept
+		assert(0 == RECV(299));
+		assert(-URTC_ERR_SRTP_REPLAYED == RECV(200));
+		assert(-URTC_ERR_SRTP_REPLAYED == RECV(150));
+		assert(0 == RECV(250));
+		assert(0 == RECV(298));
+
+		#undef RECV
+
+		// srtcp, keyed by index
+		uint8_t rtcp[2][64];
+		size_t rlen[2];
+		for (int i = 0; i < 2; i++) {
+			memset(rtcp[i], 0, sizeof(rtcp[i]));
+			memcpy(rtcp[i], "\x80\xc9\x00\x01\xde\xca\xfb\xad", 8);
+			rlen[i] = 8;
+			assert(0 == srtcp_protect(&tx, rtcp[i], &rlen[i], 64));
+		}
+		memcpy(pkt, rtcp[1], rlen[1]);
+		n = rlen[1];
+		assert(0 == srtcp_unprotect(&rx, pkt, &n));
+		memcpy(pkt, rtcp[0], rlen[0]);
+		n = rlen[0];
+		assert(0 == srtcp_unprotect(&rx, pkt, &n));
+		memcpy(pkt, rtcp[0], rlen[0]);
+		n = rlen[0];
+		assert(-URTC_ERR_SRTP_REPLAYED == srtcp_unprotect(&rx, pkt, &n));
+
+		srtp_free(&tx);
+		srtp_free(&rx);
+	}
+
+	// Test unknown profile
+	{
+		struct srtp s;
+		assert(-URTC_ERR_NOT_IMPLEMENTED ==
+			srtp_init(&s, SRTP_PROFILE_NULL, master_key, master_salt));
+	}
+
+	// Test SRTCP round trip
+	{
+		const uint8_t rr[8] = {
+			0x80, 0xc9, 0x00, 0x01, 0xde, 0xca, 0xfb, 0xad
+		};
+		uint8_t pkt[64];
+		size_t len;
+		struct srtp tx, rx;
+
+		assert(0 == srtp_init(&tx, SRTP_PROFILE_AES128_CM_SHA1_32,
+			master_key, master_salt));
+		assert(0 == srtp_init(&rx, SRTP_PROFILE_AES128_CM_SHA1_32,
+			master_key, master_salt));
+
+		// sender report with a body to encrypt
+		memset(pkt, 0x5a, sizeof(pkt));
+		memcpy(pkt, rr, sizeof(rr));
+		pkt[1] = 0xc8;
+		len = 28;
+
+		assert(0 == srtcp_protect(&tx, pkt, &len, sizeof(pkt)));
+		assert(28 + 4 + 10 == len);
+		assert(0 == memcmp(rr + 4, pkt + 4, 4));
+		assert(0x80 == pkt[28]);        // e-flag
+
+		pkt[len - 1] ^= 0x01;
+		assert(0 > srtcp_unprotect(&rx, pkt, &len));
+		pkt[len - 1] ^= 0x01;
+
+		assert(0 == srtcp_unprotect(&rx, pkt, &len));
+		assert(28 == len);
+		for (int i = 8; i < 28; i++) assert(0x5a == pkt[i]);
+
+		// too short to carry index and tag
+		len = 8;
+		assert(-URTC_ERR_MALFORMED == srtcp_unprotect(&rx, pkt, &len));
+
+		srtp_free(&tx);
+		srtp_free(&rx);
+	}
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "rtcp.h"
+#include "twcc.h"
+
+/**
+ * Read back one feedback packet
+ */
+static int readback(
+	const uint8_t *fb,
+	int len,
+	struct rtcp_twcc_status *st,
+	size_t cap
+) {
+	struct rtcp_packet p;
+	size_t n = len;
+	uint32_t media;
+
+	assert(1 == rtcp_next(&fb, &n, &p));
+	return rtcp_read_twcc(&p, &media, st, cap);
+}
+
+int main(int argc, char **argv) {
+
+	// Test nothing to report
+	{
+		static struct twcc t;
+		uint8_t fb[RTCP_MAX_PACKET_SIZE];
+		twcc_init(&t);
+		assert(0 == twcc_write(&t, fb, sizeof(fb), 1, 2));
+	}
+
+	// Test gap is reported lost, late arrival is not reported again, and
+	// times are relative to the first arrival
+	{
+		static struct twcc t;
+		struct rtcp_twcc_status st[16];
+		uint8_t fb[RTCP_MAX_PACKET_SIZE];
+		int len;
+		twcc_init(&t);
+
+		twcc_put(&t, 65534, 5000000000);
+		twcc_put(&t, 65535, 5000001000);
+		twcc_put(&t, 1, 5000003000);
+		twcc_put(&t, 2, 5000002000);
+		assert(0 < (len = twcc_write(&t, fb, sizeof(fb), 1, 2)));
+		assert(5 == readback(fb, len, st, 16));
+		assert(65534 == st[0].seq && st[0].received);
+		assert(0 == st[0].arrival_us);
+		assert(1000 == st[1].arrival_us);
+		assert(0 == st[2].seq && !st[2].received);
+		assert(3000 == st[3].arrival_us);
+		assert(2000 == st[4].arrival_us);
+		assert(0 == fb[19]);
+
+		twcc_put(&t, 0, 5000004000);
+		assert(0 == twcc_write(&t, fb, sizeof(fb), 1, 2));
+		twcc_put(&t, 3, 5000005000);
+		assert(0 < (len = twcc_write(&t, fb, sizeof(fb), 1, 2)));
+		assert(1 == readback(fb, len, st, 16));
+		assert(3 == st[0].seq && 5000 == st[0].arrival_us);
+		assert(1 == fb[19]);
+	}
+
+	// Test many arrivals span several packets
+	{
+		static struct twcc t;
+		static struct rtcp_twcc_status st[TWCC_WINDOW];
+		uint8_t fb[64];
+		int len, total = 0;
+		twcc_init(&t);
+
+		for (int i = 0; i < 200; i++) twcc_put(&t, i, 1000 * i);
+		while (len = twcc_write(&t, fb, sizeof(fb), 1, 2), len > 0) {
+			int n = readback(fb, len, st, TWCC_WINDOW);
+			assert(n > 0);
+			for (int i = 0; i < n; i++) {
+				assert(total + i == st[i].seq);
+				assert(1000 * (total + i) == st[i].arrival_us);
+			}
+			total += n;
+		}
+		assert(0 == len);
+		assert(200 == total);
+	}
+
+	// Test packets beyond the window are given up on
+	{
+		static struct twcc t;
+		static struct rtcp_twcc_status st[TWCC_WINDOW];
+		uint8_t fb[RTCP_MAX_PACKET_SIZE];
+		int len;
+		twcc_init(&t);
+
+		twcc_put(&t, 100, 0);
+		twcc_put(&t, 100 + 2 * TWCC_WINDOW, 1000);
+		assert(0 < (len = twcc_write(&t, fb, sizeof(fb), 1, 2)));
+		assert(TWCC_WINDOW == readback(fb, len, st, TWCC_WINDOW));
+		assert(!st[0].received);
+		assert(st[TWCC_WINDOW - 1].received);
+	}
+
+	return 0;
+}
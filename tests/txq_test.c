@@ -0,0 +1,101 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#include "err.h"
+#include "timer.h"
+#include "txq.h"
+
+int main(int argc, char **argv) {
+	struct sockaddr_in addr = { .sin_family = AF_INET };
+	socklen_t addrlen = sizeof(addr);
+	int tx, rx;
+
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	rx = socket(PF_INET, SOCK_DGRAM, 0);
+	tx = socket(PF_INET, SOCK_DGRAM, 0);
+	assert(rx >= 0 && tx >= 0);
+	assert(0 == bind(rx, (struct sockaddr *)&addr, sizeof(addr)));
+	assert(0 == getsockname(rx, (struct sockaddr *)&addr, &addrlen));
+
+	// Test batch is sent in order, and emptied
+	{
+		struct txq q;
+		uint8_t buf[TXQ_MAX_PACKET_SIZE];
+		txq_init(&q, tx);
+		assert(0 == txq_flush(&q, &addr));
+		for (int i = 0; i < 3; i++) {
+			uint8_t *p = txq_next(&q);
+			assert(p);
+			memset(p, i, 100 + i);
+			txq_commit(&q, 100 + i, 0);
+		}
+		assert(3 == txq_flush(&q, &addr));
+		assert(0 == q.count);
+		for (int i = 0; i < 3; i++) {
+			assert(100 + i == recv(rx, buf, sizeof(buf), 0));
+			assert(i == buf[99]);
+		}
+	}
+
+	// Test full batch is refused
+	{
+		struct txq q;
+		txq_init(&q, tx);
+		for (int i = 0; i < TXQ_BATCH; i++) {
+			assert(txq_next(&q));
+			txq_commit(&q, 1, 0);
+		}
+		assert(!txq_next(&q));
+		txq_commit(&q, 1, 0);
+		assert(TXQ_BATCH == q.count);
+	}
+
+	// Test departure times, where supported, hold nothing already due
+	{
+		struct txq q;
+		uint8_t buf[TXQ_MAX_PACKET_SIZE];
+		txq_init(&q, tx);
+		if (0 == txq_enable_txtime(&q)) {
+			assert(q.txtime);
+			memset(txq_next(&q), 0xab, 10);
+			txq_commit(&q, 10, timer_now_us());
+			assert(1 == txq_flush(&q, &addr));
+			assert(10 == recv(rx, buf, sizeof(buf), 0));
+			assert(0xab == buf[0]);
+		} else {
+			assert(!q.txtime);
+		}
+	}
+
+	close(tx);
+	close(rx);
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+
+#include "uplink.h"
+
+int main(int argc, char **argv) {
+
+	// Test viewers with fast paths split a stream's share
+	{
+		struct uplink_stream s = { .weight = 1, .floor_bps = 150000,
+			.count = 3 };
+		uplink_allocate(3000000, &s, 1);
+		assert(1000000 == s.target_bps);
+		for (int i = 0; i < 3; i++) assert(UPLINK_FULL == s.mode[i]);
+	}
+
+	// Test a slow viewer is thinned rather than hold back the others
+	{
+		struct uplink_stream s = { .weight = 1, .floor_bps = 150000,
+			.estimate_bps = { 1000000, 200000, 1200000 }, .count = 3 };
+		uplink_allocate(3000000, &s, 1);
+		assert(1000000 == s.target_bps);
+		assert(UPLINK_FULL == s.mode[0]);
+		assert(UPLINK_THIN == s.mode[1]);
+		assert(UPLINK_FULL == s.mode[2]);
+
+		// but kept if thinning gains little
+		s.estimate_bps[1] = 980000;
+		uplink_allocate(3000000, &s, 1);
+		assert(980000 == s.target_bps);
+		for (int i = 0; i < 3; i++) assert(UPLINK_FULL == s.mode[i]);
+	}
+
+	// Test floor limits viewers served, and the rest are dropped
+	{
+		struct uplink_stream s = { .weight = 1, .floor_bps = 150000,
+			.count = 10 };
+		int full = 0, drop = 0;
+		uplink_allocate(1000000, &s, 1);
+		assert(s.target_bps >= 150000);
+		for (int i = 0; i < 10; i++) {
+			full += UPLINK_FULL == s.mode[i];
+			drop += UPLINK_DROP == s.mode[i];
+		}
+		assert(6 == full && 4 == drop);
+		assert(6 * s.target_bps <= 1000000);
+	}
+
+	// Test budget is shared by weight
+	{
+		struct uplink_stream s[2] = {
+			{ .weight = 3, .floor_bps = 150000, .count = 1 },
+			{ .weight = 1, .floor_bps = 150000, .count = 1 }
+		};
+		uplink_allocate(4000000, s, 2);
+		assert(3000000 == s[0].target_bps);
+		assert(1000000 == s[1].target_bps);
+	}
+
+	// Test share a stream cannot use is passed on
+	{
+		struct uplink_stream s[3] = {
+			{ .weight = 1, .floor_bps = 150000,
+			  .estimate_bps = { 500000 }, .count = 1 },
+			{ .weight = 1, .floor_bps = 150000, .count = 1 },
+			{ .weight = 1, .floor_bps = 150000, .count = 0 }
+		};
+		uplink_allocate(4000000, s, 3);
+		assert(500000 == s[0].target_bps);
+		assert(3500000 == s[1].target_bps);
+		assert(150000 == s[2].target_bps);
+	}
+
+	return 0;
+}
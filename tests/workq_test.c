@@ -0,0 +1,91 @@
+/**
+ * liburtc
+ * Copyright 2020 Chris Hiszpanski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <unistd.h>
+
+#include "err.h"
+#include "workq.h"
+
+struct sum {
+	struct workq_job job;               // must be first
+	int n;
+	long result;
+};
+
+static void run(struct workq_job *job) {
+	struct sum *s = (struct sum *)job;
+	s->result = 0;
+	for (int i = 1; i <= s->n; i++) {
+		s->result += i;
+	}
+}
+
+int main(int argc, char **argv) {
+	int fds[2];
+	assert(0 == pipe(fds));
+
+	// Test jobs run and post completions
+	{
+		struct sum sums[8];
+		for (int i = 0; i < 8; i++) {
+			sums[i] = (struct sum){ .job = { .run = run, .fd = fds[1] } };
+			sums[i].n = 1000 * (i + 1);
+			assert(0 == workq_submit(&sums[i].job));
+		}
+		for (int i = 0; i < 8; i++) {
+			struct workq_job *job;
+			assert(0 == workq_complete(fds[0], &job));
+			struct sum *s = (struct sum *)job;
+			assert((long)s->n * (s->n + 1) / 2 == s->result);
+		}
+		for (int i = 0; i < 8; i++) {
+			assert(WORKQ_IDLE == sums[i].job.state);
+		}
+	}
+
+	// Test completed job may be resubmitted, and cancel waits for it
+	{
+		struct sum s = { .job = { .run = run, .fd = fds[1] }, .n = 10 };
+		struct workq_job *job;
+		assert(0 == workq_submit(&s.job));
+		assert(0 == workq_complete(fds[0], &job));
+		assert(&s.job == job);
+		assert(0 == workq_submit(&s.job));
+		workq_cancel(&s.job);
+		assert(WORKQ_IDLE == s.job.state);
+	}
+
+	// Test bad arguments
+	{
+		struct workq_job job = { 0 };
+		assert(-URTC_ERR_BAD_ARGUMENT == workq_submit(NULL));
+		assert(-URTC_ERR_BAD_ARGUMENT == workq_submit(&job));
+		workq_cancel(&job);
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+
+	return 0;
+}